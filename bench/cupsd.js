@@ -0,0 +1,212 @@
+/** Private cupsd for the benchmarks.
+ * It runs as the current user on a localhost port, with its own configuration,
+ * spool and logs in a temporary directory: no root, no network, no system queue touched.
+ */
+var fs = require("fs"),
+    net = require("net"),
+    os = require("os"),
+    path = require("path"),
+    child_process = require("child_process");
+
+/** Find a program in the usual CUPS locations, then in PATH
+ */
+function findProgram(name, dirs) {
+    for(var i = 0; i < dirs.length; ++i) {
+        var candidate = path.join(dirs[i], name);
+        if(fs.existsSync(candidate)) {
+            return candidate;
+        }
+    }
+    return name;
+}
+
+function findServerBin() {
+    var dirs = ['/usr/lib/cups', '/usr/libexec/cups', '/usr/local/lib/cups'];
+    for(var i = 0; i < dirs.length; ++i) {
+        if(fs.existsSync(path.join(dirs[i], 'backend'))) {
+            return dirs[i];
+        }
+    }
+    return dirs[0];
+}
+
+/** Get a free localhost port
+ */
+function getFreePort(callback) {
+    var server = net.createServer();
+    server.listen(0, '127.0.0.1', function(){
+        var port = server.address().port;
+        server.close(function(){ callback(null, port); });
+    });
+    server.on('error', callback);
+}
+
+function waitForPort(port, timeout, callback) {
+    var deadline = Date.now() + timeout;
+    (function attempt() {
+        var socket = net.connect(port, '127.0.0.1');
+        socket.on('connect', function(){
+            socket.destroy();
+            callback(null);
+        });
+        socket.on('error', function(err){
+            socket.destroy();
+            if(Date.now() > deadline) {
+                return callback(new Error('cupsd did not start listening on port ' + port + ': ' + err.message));
+            }
+            setTimeout(attempt, 50);
+        });
+    })();
+}
+
+/** Synthetic PPD with optionCount options of choiceCount choices, to measure driver option parsing
+ */
+function makePpd(optionCount, choiceCount) {
+    var lines = [
+        '*PPD-Adobe: "4.3"',
+        '*FormatVersion: "4.3"',
+        '*FileVersion: "1.0"',
+        '*LanguageVersion: English',
+        '*LanguageEncoding: ISOLatin1',
+        '*PCFileName: "BENCH.PPD"',
+        '*Manufacturer: "node-printer"',
+        '*Product: "(Bench)"',
+        '*ModelName: "node-printer bench"',
+        '*ShortNickName: "node-printer bench"',
+        '*NickName: "node-printer bench"',
+        '*PSVersion: "(3010.000) 0"',
+        '*LanguageLevel: "3"',
+        '*ColorDevice: False',
+        '*DefaultColorSpace: Gray',
+        '*FileSystem: False',
+        '*Throughput: "1"',
+        '*TTRasterizer: Type42',
+        '*cupsFilter: "application/vnd.cups-raw 0 -"',
+        '*OpenUI *PageSize/Media Size: PickOne',
+        '*OrderDependency: 10 AnySetup *PageSize',
+        '*DefaultPageSize: A4',
+        '*PageSize A4/A4: "<</PageSize[595 842]>>setpagedevice"',
+        '*PageSize Letter/US Letter: "<</PageSize[612 792]>>setpagedevice"',
+        '*CloseUI: *PageSize',
+        '*DefaultImageableArea: A4',
+        '*ImageableArea A4/A4: "18 36 577 806"',
+        '*ImageableArea Letter/US Letter: "18 36 594 756"',
+        '*DefaultPaperDimension: A4',
+        '*PaperDimension A4/A4: "595 842"',
+        '*PaperDimension Letter/US Letter: "612 792"'
+    ];
+    for(var i = 0; i < optionCount; ++i) {
+        var name = 'BenchOption' + i;
+        lines.push('*OpenUI *' + name + '/Bench option ' + i + ': PickOne');
+        lines.push('*OrderDependency: ' + (20 + i) + ' AnySetup *' + name);
+        lines.push('*Default' + name + ': Choice0');
+        for(var j = 0; j < choiceCount; ++j) {
+            lines.push('*' + name + ' Choice' + j + '/Choice ' + j + ': ""');
+        }
+        lines.push('*CloseUI: *' + name);
+    }
+    return lines.join('\n') + '\n';
+}
+
+/** Start a private cupsd
+ * @param options {cupsd: path of cupsd, ppdOptions: Number, ppdChoices: Number}
+ * @param callback (err, server) with server {host, port, dir, lpadmin(args), stop()}
+ */
+function start(options, callback) {
+    var called = false;
+    function done(err, server) {
+        if(!called) {
+            called = true;
+            callback(err, server);
+        }
+    }
+    var dir = fs.mkdtempSync(path.join(os.tmpdir(), 'node-printer-bench-'));
+    ['spool', 'spool/tmp', 'cache', 'state', 'log', 'ppd'].forEach(function(sub){
+        fs.mkdirSync(path.join(dir, sub), {recursive: true});
+    });
+    var serverBin = findServerBin();
+
+    getFreePort(function(err, port){
+        if(err) {
+            return done(err);
+        }
+        fs.writeFileSync(path.join(dir, 'cupsd.conf'), [
+            'Listen 127.0.0.1:' + port,
+            'LogLevel warn',
+            'Browsing Off',
+            'DefaultShared No',
+            'WebInterface No',
+            'MaxJobs 0',
+            'MaxJobsPerPrinter 0',
+            'MaxJobsPerUser 0',
+            'PreserveJobHistory Yes',
+            'PreserveJobFiles No',
+            '<Location />',
+            'Order Allow,Deny',
+            'Allow from 127.0.0.1',
+            '</Location>',
+            '<Policy default>',
+            '<Limit All>',
+            'Order Allow,Deny',
+            'Allow from 127.0.0.1',
+            '</Limit>',
+            '</Policy>'
+        ].join('\n') + '\n');
+        fs.writeFileSync(path.join(dir, 'cups-files.conf'), [
+            'ServerRoot ' + dir,
+            'ServerBin ' + serverBin,
+            'RequestRoot ' + path.join(dir, 'spool'),
+            'TempDir ' + path.join(dir, 'spool/tmp'),
+            'CacheDir ' + path.join(dir, 'cache'),
+            'StateDir ' + path.join(dir, 'state'),
+            'AccessLog ' + path.join(dir, 'log/access_log'),
+            'ErrorLog ' + path.join(dir, 'log/error_log'),
+            'PageLog ' + path.join(dir, 'log/page_log'),
+            'Printcap ' + path.join(dir, 'printcap'),
+            'FileDevice Yes'
+        ].join('\n') + '\n');
+        var ppdFile = path.join(dir, 'ppd', 'bench.ppd');
+        fs.writeFileSync(ppdFile, makePpd(options.ppdOptions || 20, options.ppdChoices || 8));
+
+        var cupsd = child_process.spawn(options.cupsd || findProgram('cupsd', ['/usr/sbin', '/usr/local/sbin']),
+            ['-f', '-c', path.join(dir, 'cupsd.conf'), '-s', path.join(dir, 'cups-files.conf')],
+            {stdio: ['ignore', 'ignore', 'pipe']});
+        var stderr = '';
+        cupsd.stderr.on('data', function(chunk){ stderr += chunk; });
+        var exited = false;
+        cupsd.on('exit', function(){ exited = true; });
+        cupsd.on('error', function(e){
+            exited = true;
+            done(e);
+        });
+
+        waitForPort(port, 10000, function(err){
+            if(exited) {
+                return done(new Error('cupsd exited: ' + stderr));
+            }
+            if(err) {
+                cupsd.kill();
+                return done(err);
+            }
+            var host = '127.0.0.1:' + port;
+            done(null, {
+                host: host,
+                port: port,
+                dir: dir,
+                ppdFile: ppdFile,
+                lpadmin: function(args) {
+                    child_process.execFileSync(findProgram('lpadmin', ['/usr/sbin', '/usr/local/sbin']), ['-h', host].concat(args), {stdio: 'pipe'});
+                },
+                stop: function() {
+                    if(!exited) {
+                        cupsd.kill('SIGTERM');
+                    }
+                    (fs.rmSync || fs.rmdirSync)(dir, {recursive: true, force: true});
+                }
+            });
+        });
+    });
+}
+
+module.exports.start = start;
+module.exports.makePpd = makePpd;
@@ -0,0 +1,218 @@
+/** Benchmarks against a private cupsd on localhost (POSIX only).
+ *
+ * Usage: node bench [--queues 20] [--jobs 200] [--iterations 50] [--concurrency 8]
+ *                   [--sizes 1024,65536,1048576] [--ppd-options 20] [--cupsd /usr/sbin/cupsd]
+ *
+ * Prints one JSON object per line on stdout: a "meta" record, then one record per
+ * measurement with its parameters, latency percentiles in milliseconds, throughput and RSS.
+ */
+var os = require("os"),
+    cupsd = require("./cupsd");
+
+function parseArgs(argv) {
+    var args = {
+        queues: 20,
+        jobs: 200,
+        iterations: 50,
+        concurrency: 8,
+        sizes: [1024, 64 * 1024, 1024 * 1024],
+        ppdOptions: 20,
+        cupsd: undefined
+    };
+    for(var i = 0; i < argv.length; i += 2) {
+        var name = argv[i].replace(/^--/, ''), value = argv[i + 1];
+        switch(name) {
+        case 'queues': case 'jobs': case 'iterations': case 'concurrency':
+            args[name] = parseInt(value, 10);
+            break;
+        case 'ppd-options':
+            args.ppdOptions = parseInt(value, 10);
+            break;
+        case 'sizes':
+            args.sizes = value.split(',').map(function(size){ return parseInt(size, 10); });
+            break;
+        case 'cupsd':
+            args.cupsd = value;
+            break;
+        default:
+            throw new Error('unknown option ' + argv[i]);
+        }
+    }
+    return args;
+}
+
+function emit(record) {
+    record.rss = process.memoryUsage().rss;
+    process.stdout.write(JSON.stringify(record) + '\n');
+}
+
+function nowMs() {
+    var t = process.hrtime();
+    return t[0] * 1e3 + t[1] / 1e6;
+}
+
+/** Latency summary of samples in milliseconds
+ */
+function summarize(samples) {
+    var sorted = samples.slice().sort(function(a, b){ return a - b; }),
+        sum = sorted.reduce(function(a, b){ return a + b; }, 0);
+    function percentile(q) {
+        return sorted.length ? sorted[Math.min(sorted.length - 1, Math.ceil(q * sorted.length) - 1)] : 0;
+    }
+    return {
+        count: sorted.length,
+        mean: sorted.length ? sum / sorted.length : 0,
+        p50: percentile(0.5),
+        p90: percentile(0.9),
+        p99: percentile(0.99),
+        max: sorted.length ? sorted[sorted.length - 1] : 0
+    };
+}
+
+/** Time fn iterations times, after a few warm up calls
+ */
+function measure(iterations, fn) {
+    var samples = [];
+    for(var w = 0; w < Math.min(3, iterations); ++w) {
+        fn();
+    }
+    for(var i = 0; i < iterations; ++i) {
+        var start = nowMs();
+        fn();
+        samples.push(nowMs() - start);
+    }
+    return summarize(samples);
+}
+
+function merge(target, source) {
+    Object.keys(source).forEach(function(key){ target[key] = source[key]; });
+    return target;
+}
+
+function queueName(i) {
+    return 'bench-' + i;
+}
+
+/** Queue counts at which the listing is measured: 1, then doubling up to count
+ */
+function getSteps(count) {
+    var steps = [];
+    for(var step = 1; step < count; step *= 2) {
+        steps.push(step);
+    }
+    steps.push(count);
+    return steps;
+}
+
+function printSync(printer, data, options) {
+    var jobId;
+    printer.printDirect({
+        data: data,
+        printer: queueName(0),
+        type: 'RAW',
+        options: options,
+        success: function(id){ jobId = id; },
+        error: function(err){ throw err; }
+    });
+    return jobId;
+}
+
+function run(args, server) {
+    // libcups reads CUPS_SERVER when the binding first connects
+    process.env.CUPS_SERVER = server.host;
+    var printer = require("../lib/printer"),
+        created = 0;
+
+    emit({benchmark: 'meta', node: process.version, platform: os.platform(), release: os.release(),
+          cpus: os.cpus().length, cpuModel: os.cpus()[0] && os.cpus()[0].model, args: args});
+
+    // getPrinters as queues are added
+    getSteps(args.queues).forEach(function(count){
+        for(; created < count; ++created) {
+            server.lpadmin(['-p', queueName(created), '-E', '-v', 'file:///dev/null', '-P', server.ppdFile]);
+        }
+        emit(merge({benchmark: 'getPrinters', queues: count}, measure(args.iterations, function(){
+            printer.getPrinters();
+        })));
+    });
+
+    // driver options: PPD download and parsing
+    emit(merge({benchmark: 'getPrinterDriverOptions', ppdOptions: args.ppdOptions}, measure(args.iterations, function(){
+        printer.getPrinterDriverOptions(queueName(0));
+    })));
+
+    // getJob and getPrinter as retained jobs pile up on a queue
+    var held = 0, lastJob = 0;
+    getSteps(args.jobs).forEach(function(count){
+        for(; held < count; ++held) {
+            lastJob = printSync(printer, 'held', {'job-hold-until': 'indefinite'});
+        }
+        emit(merge({benchmark: 'getJob', jobs: count}, measure(args.iterations, function(){
+            printer.getJob(queueName(0), lastJob);
+        })));
+        emit(merge({benchmark: 'getPrinter', jobs: count}, measure(args.iterations, function(){
+            printer.getPrinter(queueName(0));
+        })));
+    });
+    printer.cancelAllJobs(queueName(0), true);
+
+    // printDirect latency (synchronous) then throughput (asynchronous, concurrent) by payload size
+    var sizes = args.sizes.slice();
+    function nextSize() {
+        if(!sizes.length) {
+            return Promise.resolve();
+        }
+        var size = sizes.shift(),
+            data = Buffer.alloc(size, 0x41);
+        emit(merge({benchmark: 'printDirect', size: size}, measure(args.iterations, function(){
+            printSync(printer, data, {});
+        })));
+
+        var samples = [], remaining = args.iterations, start = nowMs();
+        function worker() {
+            if(remaining <= 0) {
+                return Promise.resolve();
+            }
+            --remaining;
+            var t = nowMs();
+            return printer.printDirectAsync({data: data, printer: queueName(0), type: 'RAW'}).then(function(){
+                samples.push(nowMs() - t);
+                return worker();
+            });
+        }
+        var workers = [];
+        for(var i = 0; i < args.concurrency; ++i) {
+            workers.push(worker());
+        }
+        return Promise.all(workers).then(function(){
+            var elapsed = (nowMs() - start) / 1000;
+            emit(merge({benchmark: 'printDirectAsync', size: size, concurrency: args.concurrency,
+                        jobsPerSec: samples.length / elapsed, bytesPerSec: samples.length * size / elapsed}, summarize(samples)));
+            return nextSize();
+        });
+    }
+    return nextSize().then(function(){
+        emit({benchmark: 'nativeStats', stats: printer.getStats()});
+    });
+}
+
+var args = parseArgs(process.argv.slice(2));
+cupsd.start({cupsd: args.cupsd, ppdOptions: args.ppdOptions}, function(err, server){
+    if(err) {
+        console.error(err.message);
+        process.exit(1);
+    }
+    var result;
+    try {
+        result = run(args, server);
+    } catch (e) {
+        result = Promise.reject(e);
+    }
+    result.then(function(){
+        server.stop();
+    }, function(e){
+        server.stop();
+        console.error(e.stack || e);
+        process.exitCode = 1;
+    });
+});
@@ -6,7 +6,18 @@
         # is like "ls -1 src/*.cc", but gyp does not support direct patterns on
         # sources
         'src/node_printer.cc',
+        'src/node_printer_barcode.cc',
+        'src/node_printer_env.cc',
+        'src/node_printer_idempotency.cc',
+        'src/node_printer_pool.cc',
+        'src/node_printer_raster.cc',
+        'src/node_printer_stats.cc',
+        'src/node_printer_template.cc',
+        'src/node_printer_trace.cc',
         'src/node_printer_posix.cc',
+        'src/node_printer_memory_posix.cc',
+        'src/node_printer_socket_posix.cc',
+        'src/node_printer_spool_posix.cc',
         'src/node_printer_win.cc'
       ],
       'include_dirs' : [
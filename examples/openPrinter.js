@@ -0,0 +1,13 @@
+var printer = require("../lib"),
+    util = require('util'),
+    handle = printer.openPrinter(); // default printer
+
+console.log("capabilities: " + util.inspect(handle.capabilities(), {colors:true, depth:10}));
+
+// the same connection is used for all calls until close()
+var jobID = handle.print("print from Node.JS", "node print job", "TEXT", {});
+console.log("sent to printer " + handle.name + " with ID: " + jobID);
+console.log("job info: " + util.inspect(handle.getJob(jobID), {colors:true, depth:10}));
+console.log("active jobs: " + handle.getJobs().length);
+
+handle.close();
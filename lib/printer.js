@@ -2,20 +2,136 @@ var fs = require("fs"),
     child_process = require("child_process"),
     os = require("os"),
     path = require("path"),
-    printer_helper = require('node-gyp-build')(path.join(__dirname, '..'));
+    EventEmitter = require("events").EventEmitter,
+    printer_helper = require('node-gyp-build')(path.join(__dirname, '..')),
+    diagnostics_channel;
+
+try {
+    diagnostics_channel = require('diagnostics_channel');
+} catch (e) {
+    // node < 15.1: no tracing channel
+}
+
+var TRACE_CHANNEL = 'node-printer:ipp',
+    traceChannel = diagnostics_channel && diagnostics_channel.channel(TRACE_CHANNEL),
+    traceEnabled = false;
+
+// coalescing state by printer name: {window, maxBytes, docname, parts, bytes, timer}
+var coalescedPrinters = {};
+
+// idempotent asynchronous submissions in progress, by printer and key: promise of their job id
+var idempotentSubmissions = {};
 
 
 /** Return all installed printers including active jobs
  */
 module.exports.getPrinters = getPrinters;
 
-/** send data to printer
+/** enumerate printers as they are found, local queues first then network printers (POSIX only).
+ * Returns an EventEmitter emitting 'printer' (without jobs), then 'end' with the count, or 'error'.
+ * options: timeout (discovery time in milliseconds, 1000 by default), type and mask
+ * (printer-type filter, see printerTypes), signal. emitter.cancel() ends the enumeration early.
+ * Use events.on(emitter, 'printer') to consume it with for await.
+ */
+module.exports.enumeratePrinters = enumeratePrinters;
+
+/** printer-type bits for the enumeratePrinters type and mask options
+ */
+module.exports.printerTypes = {
+    LOCAL: 0x0,
+    CLASS: 0x1,
+    REMOTE: 0x2,
+    BW: 0x4,
+    COLOR: 0x8,
+    DUPLEX: 0x10,
+    DISCOVERED: 0x1000000,
+    SCANNER: 0x2000000
+};
+
+/** send data to printer.
+ * On POSIX, a socket://host[:port] printer name sends RAW data straight to an AppSocket/JetDirect printer,
+ * an ipp:// or ipps:// printer URI prints on the IPP device itself, without a local cupsd
  */
 module.exports.printDirect = printDirect;
 
 /// send file to printer
 module.exports.printFile = printFile;
 
+/** idempotent submissions: printDirect and printDirectAsync take an `idempotencyKey`
+ * option, a string, or true for a hash of the data, printer, type and options.
+ * A submission with the key of a job created within the window returns that job id
+ * without uploading anything. setIdempotencyOptions({window, maxEntries, file}) sizes the
+ * index of the recent keys (10 minutes, 10000 keys by default) and can persist it to a file
+ */
+module.exports.setIdempotencyOptions = printer_helper.setIdempotencyOptions;
+
+/** XXH64 content hash of a submission, the key used by `idempotencyKey: true`
+ * @param data String or Buffer, printer, type, options Object
+ */
+module.exports.hashDocument = printer_helper.hashDocument;
+
+/** open a durable local spool journal (POSIX only): jobs are added at memory speed and
+ * submitted in order by a background thread, retrying while the print server is down.
+ * They survive restarts of cupsd and crashes of the process. See openSpool below
+ */
+module.exports.openSpool = openSpool;
+
+/** Compile a label template of printer commands (ZPL, EPL, ESC/POS...) with {{field}} placeholders.
+ * template.render(records) returns one Buffer with the labels of all the records.
+ */
+module.exports.compileLabelTemplate = printer_helper.compileLabelTemplate;
+
+/** print a batch of labels rendered from a template as one RAW job
+ */
+module.exports.printLabels = printLabels;
+module.exports.printLabelsAsync = printLabelsAsync;
+
+/** encode a Buffer of pixels (or an Array of Buffers, one per page) to PWG or Apple (URF) raster,
+ * to print with printDirect type 'PWG' or 'URF' without rasterizing a PDF on the print server.
+ * options: width, height, channels (1 gray, 3 RGB, 4 RGBA), format ('pwg' or 'urf'),
+ * colorSpace ('black', 'sgray' or 'srgb'), dither ('threshold' or 'ordered'), threshold,
+ * resolution (dpi), quality ('draft', 'normal' or 'high'), timeout, signal.
+ * Returns a promise of the Buffer; pages are encoded in bands on several threads
+ */
+module.exports.encodeRaster = encodeRaster;
+
+/** convert pixels to a black and white ZPL ^GFA field (ACS compressed hex, in a whole
+ * ^XA...^XZ label unless label is false) or ESC/POS GS v 0 raster commands, ready for a RAW printDirect.
+ * options: width, height, channels, dither, threshold as encodeRaster, language ('zpl' or 'escpos'),
+ * x and y (ZPL field origin), label, bandHeight (ESC/POS rows per command, 256 by default).
+ * Synchronous: it takes about a millisecond for a 4x6 inch label at 203 dpi
+ */
+module.exports.encodeGraphic = printer_helper.encodeGraphic;
+
+/** encode a batch of Code 128, QR or DataMatrix barcodes natively on the thread pool.
+ * options: type ('code128', 'qr' or 'datamatrix'), output ('bitmap', 'pwg' or 'zpl'), moduleSize (dots),
+ * height (Code 128 bars, dots), quietZone (modules), ecLevel (QR: 'L', 'M', 'Q' or 'H'), resolution,
+ * x, y and label (ZPL), timeout, signal.
+ * Returns a promise of an array of {width, height, data}: gray pixels for encodeRaster or encodeGraphic,
+ * a PWG raster page to print with the 'PWG' type, or a ZPL graphic field to print RAW.
+ * A barcode wider or higher than 10000 dots is rejected
+ */
+module.exports.encodeBarcodes = encodeBarcodes;
+
+/** register a print server (POSIX only): addPrintServer(name, {host, port, encryption}),
+ * encryption being 'IF_REQUESTED', 'NEVER', 'REQUIRED' or 'ALWAYS'.
+ * Its printers are then named 'queue@name' in every function, openPrinter included, and
+ * getPrinters(name), getPrintersAsync({server: name}) and enumeratePrinters({server: name}) list them.
+ * 'queue@host:port' printers of unregistered servers use the encryption of libcups.
+ * Each server has its own connections, kept per thread with their TLS session, and its own circuit breaker.
+ * Servers are registered for the calling thread: each worker thread registers its own.
+ */
+module.exports.addPrintServer = printer_helper.addPrintServer;
+module.exports.removePrintServer = printer_helper.removePrintServer;
+module.exports.getPrintServers = printer_helper.getPrintServers;
+
+/** recognize a document from its first bytes (POSIX only): its MIME type, application/vnd.cups-raw
+ * for printer languages (ZPL, ESC/POS, PCL, PJL), or undefined.
+ * The AUTO type uses it: recognized documents skip the type detection of cupsd, and
+ * printer languages its conversion filters, when the printer supports the recognized format
+ */
+module.exports.detectDocumentFormat = printer_helper.detectDocumentFormat;
+
 /** Get supported print format for printDirect
  */
 module.exports.getSupportedPrintFormats = printer_helper.getSupportedPrintFormats;
@@ -40,6 +156,109 @@ module.exports.getDefaultPrinterName = getDefaultPrinterName;
 module.exports.getJob = getJob;
 module.exports.setJob = setJob;
 
+/** send a job command to several jobs of a printer, e.g. CANCEL a list of job ids in one request
+ */
+module.exports.setJobs = setJobs;
+
+/** cancel all jobs of a printer in one request. posix: optionally purge the job history
+ */
+module.exports.cancelAllJobs = cancelAllJobs;
+
+/** move queued jobs to another printer without uploading them again (POSIX only)
+ */
+module.exports.moveJobs = moveJobs;
+
+/** spread the queued jobs of a stopped printer over a pool of printers (POSIX only)
+ */
+module.exports.drainPrinter = drainPrinter;
+
+/** Asynchronous variants. They run on the module thread pool (POSIX only)
+ * and return a Promise instead of blocking the event loop.
+ * All of them accept an optional `signal` (AbortSignal) option to interrupt them
+ * and an optional `timeout` option, in milliseconds, overriding the default timeout.
+ * Rejection errors have a `code`: ABORT_ERR, ETIMEDOUT, ECONNREFUSED or ECIRCUITOPEN.
+ */
+module.exports.getPrintersAsync = getPrintersAsync;
+module.exports.getPrinterAsync = getPrinterAsync;
+module.exports.getPrinterDriverOptionsAsync = getPrinterDriverOptionsAsync;
+module.exports.getJobAsync = getJobAsync;
+module.exports.setJobAsync = setJobAsync;
+module.exports.setJobsAsync = setJobsAsync;
+module.exports.cancelAllJobsAsync = cancelAllJobsAsync;
+module.exports.moveJobsAsync = moveJobsAsync;
+module.exports.drainPrinterAsync = drainPrinterAsync;
+module.exports.printDirectAsync = printDirectAsync;
+module.exports.printFileAsync = printFileAsync;
+
+/** Set/get the number of threads used by asynchronous methods. Default is 4.
+ * This pool is owned by the module and does not use the libuv threadpool.
+ */
+module.exports.setThreadPoolSize = printer_helper.setThreadPoolSize;
+module.exports.getThreadPoolSize = printer_helper.getThreadPoolSize;
+
+/** Set/get the timeout of print server operations in milliseconds (POSIX only).
+ * Default is 0: libcups timeouts apply.
+ */
+module.exports.setDefaultTimeout = printer_helper.setDefaultTimeout;
+module.exports.getDefaultTimeout = printer_helper.getDefaultTimeout;
+
+/** Configure the print server circuit breaker (POSIX only): after
+ * failureThreshold (default 5) consecutive timeouts or connection failures, calls
+ * fail fast with code ECIRCUITOPEN until the server answers a background probe,
+ * sent every resetTimeout (default 5000) milliseconds.
+ */
+module.exports.setCircuitBreakerOptions = printer_helper.setCircuitBreakerOptions;
+module.exports.getCircuitBreakerState = printer_helper.getCircuitBreakerState;
+
+/** Get native latency and throughput statistics by operation and by printer (POSIX only).
+ * getStats({reset: true}) returns the statistics since the last reset and clears them.
+ * Durations are in milliseconds. The statistics are process wide: every worker thread
+ * reads the same counters, and a reset from one thread clears them for all.
+ */
+module.exports.getStats = printer_helper.getStats;
+
+/** Select the print server used by the module functions (POSIX only).
+ * setBackend('memory', {printers: ['a', 'b'], latency: 5, chunkLatency: 0, printTime: 100})
+ * simulates queues, job state transitions and uploads in memory, to test or benchmark
+ * without a cupsd. setBackend('cups') restores the default. openPrinter handles always use CUPS.
+ * The choice applies to the calling thread only: each worker thread selects its own backend.
+ */
+module.exports.setBackend = printer_helper.setBackend;
+
+/** Track the jobs submitted by printDirect and printFile in the background (POSIX only).
+ * startJobTracker({interval: 1000}) polls the printers with pending jobs every interval milliseconds;
+ * getJobLatencyStats({reset}) returns by printer, from its first tracked job, the completed, failed
+ * and pending job counts and the queueWait and printTime histograms, in milliseconds.
+ * The tracker stops with the thread that started it.
+ */
+module.exports.startJobTracker = printer_helper.startJobTracker;
+module.exports.stopJobTracker = printer_helper.stopJobTracker;
+module.exports.getJobLatencyStats = printer_helper.getJobLatencyStats;
+
+/** diagnostics_channel name of the print server operation events (POSIX only).
+ * Each native CUPS call (cupsGetDests2, cupsGetJobs2, cupsGetPPD2, cupsCreateJob,
+ * cupsStartDocument, each cupsWriteRequestData chunk, cupsFinishDocument) publishes
+ * {id, phase: 'start'} then {id, phase: 'end', bytes, status, duration} with its
+ * operation, printer and jobId. Events are asynchronous; nothing is traced without subscriber.
+ */
+module.exports.TRACE_CHANNEL = TRACE_CHANNEL;
+
+/** Coalesce the small RAW jobs sent to a printer (opt-in).
+ * setCoalescing(printerName, {window: 20, maxBytes: 65536, docname}) buffers the RAW printDirect
+ * and printDirectAsync calls without options for up to window milliseconds or maxBytes bytes, then
+ * sends them concatenated as one job. Each call completes with the id of that job.
+ * Calls with a timeout or another docname are sent alone. A signal drops its data while it is
+ * still buffered; once sent, the data completes with the job.
+ * setCoalescing(printerName, null) flushes the pending data and stops coalescing.
+ * flushCoalesced(printerName) sends the pending data now, for all printers if printerName is missing.
+ */
+module.exports.setCoalescing = setCoalescing;
+module.exports.flushCoalesced = flushCoalesced;
+
+/** open a persistent printer handle. It keeps the resolved printer and its connection between calls
+ */
+module.exports.openPrinter = openPrinter;
+
 /**
  * return user defined printer, according to https://www.cups.org/documentation.php/doc-2.0/api-cups.html#cupsGetDefault2 :
  * "Applications should use the cupsGetDests and cupsGetDest functions to get the user-defined default printer,
@@ -66,6 +285,23 @@ function getDefaultPrinterName() {
   // printer not found, return nothing(undefined)
 }
 
+/** Publish a native trace event on the trace channel
+ */
+function publishTrace(event) {
+    traceChannel.publish(event);
+}
+
+/** Turn the native tracing on or off when the channel gets its first subscriber or loses its last one.
+ * Checked before each native call, so that unobserved calls skip the event queue.
+ */
+function syncTracing() {
+    if(!traceChannel || traceChannel.hasSubscribers === traceEnabled) {
+        return;
+    }
+    traceEnabled = traceChannel.hasSubscribers;
+    printer_helper.setTraceCallback(traceEnabled ? publishTrace : null);
+}
+
 /** Get printer info with jobs
  * @param printerName printer name to extract the info
  * @return printer object info:
@@ -76,6 +312,7 @@ function getPrinter(printerName)
     if(!printerName) {
         printerName = getDefaultPrinterName();
     }
+    syncTracing();
     var printer = printer_helper.getPrinter(printerName);
     correctPrinterinfo(printer);
     return printer;
@@ -91,6 +328,7 @@ function getPrinterDriverOptions(printerName)
         printerName = getDefaultPrinterName();
     }
 
+    syncTracing();
     return printer_helper.getPrinterDriverOptions(printerName);
 }
 
@@ -112,16 +350,684 @@ function getSelectedPaperSize(printerName){
 
 function getJob(printerName, jobId)
 {
+    syncTracing();
     return printer_helper.getJob(printerName, jobId);
 }
 
-function setJob(printerName, jobId, command)
+/** Send a command to a job
+ * @param command one of getSupportedJobCommands()
+ * @param value command value: priority from 1 to 100 for PRIORITY (POSIX only)
+ */
+function setJob(printerName, jobId, command, value)
+{
+    return printer_helper.setJob(printerName, jobId, command, value);
+}
+
+/** Send a command to several jobs of a printer
+ * @param jobIds Array of job ids
+ * @param command one of getSupportedJobCommands()
+ * @param value command value, see setJob
+ * @return true if the command succeeded for every job
+ */
+function setJobs(printerName, jobIds, command, value)
+{
+    return printer_helper.setJobs(printerName, jobIds, command, value);
+}
+
+/** Cancel all jobs of a printer
+ * @param purge also remove the completed jobs history (POSIX only)
+ */
+function cancelAllJobs(printerName, purge)
+{
+    return printer_helper.cancelAllJobs(printerName, !!purge);
+}
+
+/** Get the job ids argument of the native moveJobs: an array, or null to move all jobs
+ */
+function getMoveJobIds(options)
+{
+    if(options && options.all === true) {
+        return null;
+    }
+    if(!options || !Array.isArray(options.jobIds)) {
+        throw new TypeError('options must have a jobIds array or all: true');
+    }
+    return options.jobIds;
+}
+
+/** Move queued jobs to another printer with CUPS-Move-Job (POSIX only).
+ * The documents are already on the server, they are not uploaded again.
+ * @param fromPrinter printer name of the jobs
+ * @param toPrinter destination printer name
+ * @param options {jobIds: Array} to move some jobs, or {all: true} to move all of them with a single request
+ * @return Array of the moved job ids, or true/false with all: true
+ */
+function moveJobs(fromPrinter, toPrinter, options)
+{
+    return printer_helper.moveJobs(fromPrinter, toPrinter, getMoveJobIds(options));
+}
+
+/** Pick the drain targets of a printer: the pool printers which are neither the drained one,
+ * stopped nor rejecting jobs
+ * @param printers printer objects of the pool
+ * @return Array of {name, depth}, depth being the number of jobs queued on the printer
+ */
+function getDrainTargets(printerName, printers)
+{
+    var targets = [];
+    for(var i = 0; i < printers.length; ++i) {
+        var printer = printers[i];
+        if(printer.name === printerName || printer.status === 'STOPPED'
+            || (printer.options && printer.options['printer-is-accepting-jobs'] === 'false')) {
+            continue;
+        }
+        targets.push({name: printer.name, depth: printer.jobs ? printer.jobs.length : 0});
+    }
+    if(!targets.length) {
+        throw new Error('No printer of the pool can take the jobs of ' + printerName);
+    }
+    return targets;
+}
+
+/** True if CUPS-Move-Job can move a job: pending or held, not yet processing
+ */
+function isMovableJob(job)
+{
+    var status = job.status || [];
+    return status.indexOf('PENDING') >= 0 || status.indexOf('PAUSED') >= 0;
+}
+
+/** Assign the movable jobs to targets, oldest job first, each one to the target with the
+ * shortest queue at that point: the queue depths end up as even as possible.
+ * @return Object of job ids by target printer name
+ */
+function planDrain(jobs, targets)
+{
+    var plan = {}, i;
+    for(i = 0; i < targets.length; ++i) {
+        plan[targets[i].name] = [];
+    }
+    var jobIds = jobs.filter(isMovableJob).map(function(job){ return job.id; }).sort(function(a, b){ return a - b; });
+    for(i = 0; i < jobIds.length; ++i) {
+        var target = targets[0];
+        for(var j = 1; j < targets.length; ++j) {
+            if(targets[j].depth < target.depth) {
+                target = targets[j];
+            }
+        }
+        plan[target.name].push(jobIds[i]);
+        ++target.depth;
+    }
+    return plan;
+}
+
+/** Check that every planned job was moved
+ * @param moved Object of the moved job ids by target printer name
+ * @return moved
+ * @throws Error with code EMOVEFAILED, `moved` and `failed`: Array of {jobId, target}, if some jobs stayed
+ */
+function checkDrained(printerName, plan, moved)
+{
+    var failed = [];
+    Object.keys(plan).forEach(function(target){
+        plan[target].forEach(function(jobId){
+            if(moved[target].indexOf(jobId) < 0) {
+                failed.push({jobId: jobId, target: target});
+            }
+        });
+    });
+    if(failed.length) {
+        var err = new Error('Unable to move jobs ' + failed.map(function(move){ return move.jobId; }).join(', ') + ' of ' + printerName);
+        err.code = 'EMOVEFAILED';
+        err.moved = moved;
+        err.failed = failed;
+        throw err;
+    }
+    return moved;
+}
+
+/** Move the queued jobs of a printer to the printers of a pool (POSIX only),
+ * weighted by their queue depth. Stopped printers of the pool are skipped.
+ * Pending and held jobs are moved, the one being printed stays.
+ * @param printerName printer to drain, usually stopped
+ * @param pool Array of printer names
+ * @return Object of the moved job ids by target printer name
+ * @throws Error with code EMOVEFAILED if some jobs could not be moved, see checkDrained
+ */
+function drainPrinter(printerName, pool)
+{
+    var source = getPrinter(printerName);
+    var targets = getDrainTargets(source.name, pool.map(getPrinter));
+    var plan = planDrain(source.jobs || [], targets);
+    var result = {};
+    Object.keys(plan).forEach(function(target){
+        result[target] = plan[target].length ? printer_helper.moveJobs(source.name, target, plan[target]) : [];
+    });
+    return checkDrained(source.name, plan, result);
+}
+
+/** Create the error an aborted operation is rejected with
+ */
+function createAbortError(signal)
+{
+    var err = new Error('The operation was aborted');
+    err.name = 'AbortError';
+    err.code = 'ABORT_ERR';
+    if(signal && signal.reason !== undefined) {
+        err.cause = signal.reason;
+    }
+    return err;
+}
+
+/** Call an asynchronous native method.
+ * Argument errors thrown by the binding are returned as a rejected promise.
+ * If options.signal is aborted, the native operation is interrupted and the
+ * promise is rejected right away with an AbortError, without waiting for it.
+ * A submission (submits true) waits instead: a job sent before the abort resolves
+ * with its id rather than being reported as not sent.
+ */
+function callAsync(method, args, options, submits)
+{
+    var signal = options && options.signal;
+    if(signal && signal.aborted) {
+        return Promise.reject(createAbortError(signal));
+    }
+
+    var handle = {}, promise;
+    if(options && options.timeout !== undefined) {
+        handle.timeout = options.timeout;
+    }
+    if(options && typeof options.onProgress === 'function') {
+        handle.onProgress = options.onProgress;
+    }
+    if(options && typeof options.server === 'string') {
+        handle.server = options.server;
+    }
+    syncTracing();
+    try {
+        promise = printer_helper[method].apply(printer_helper, args.concat([handle]));
+    } catch (e) {
+        return Promise.reject(e);
+    }
+    if(!signal) {
+        return promise;
+    }
+
+    return new Promise(function(resolve, reject){
+        function onAbort() {
+            if(handle.abort) {
+                handle.abort();
+            }
+            if(!submits) {
+                reject(createAbortError(signal));
+            }
+        }
+        signal.addEventListener('abort', onAbort, {once: true});
+        promise.then(function(result){
+            signal.removeEventListener('abort', onAbort);
+            resolve(result);
+        }, function(err){
+            signal.removeEventListener('abort', onAbort);
+            reject(err.code === 'ABORT_ERR' ? createAbortError(signal) : err);
+        });
+    });
+}
+
+/** Resolve the printer name, looking for the default printer without blocking if it is missing
+ */
+function resolvePrinterNameAsync(printerName, options)
+{
+    if(printerName) {
+        return Promise.resolve(printerName);
+    }
+    var defaultName = printer_helper.getDefaultPrinterName();
+    if(defaultName) {
+        return Promise.resolve(defaultName);
+    }
+    return getPrintersAsync(options).then(function(printers){
+        for(var i = 0; i < printers.length; ++i) {
+            if(printers[i].isDefault === true) {
+                return printers[i].name;
+            }
+        }
+    });
+}
+
+function encodeRaster(pixels, options)
+{
+    return callAsync('encodeRaster', [pixels, options || {}], options);
+}
+
+function encodeBarcodes(payloads, options)
+{
+    return callAsync('encodeBarcodes', [payloads, options || {}], options);
+}
+
+function getPrintersAsync(options)
+{
+    var servers = options && options.servers;
+    if(!servers) {
+        return callAsync('getPrintersAsync', [], options).then(correctPrinters);
+    }
+
+    // one pool task per server, run in parallel; servers failing are left out unless all fail
+    var errors = [];
+    return Promise.all(servers.map(function(server){
+        return callAsync('getPrintersAsync', [], Object.assign({}, options, {server: server})).then(correctPrinters, function(err){
+            errors.push(err);
+            return [];
+        });
+    })).then(function(results){
+        if(servers.length > 0 && errors.length === servers.length) {
+            throw errors[0];
+        }
+        return [].concat.apply([], results);
+    });
+}
+
+function correctPrinters(printers)
+{
+    for(var i = 0; i < printers.length; ++i) {
+        correctPrinterinfo(printers[i]);
+    }
+    return printers;
+}
+
+function enumeratePrinters(options)
+{
+    options = options || {};
+    var emitter = new EventEmitter(),
+        handle = {},
+        signal = options.signal,
+        received = 0,
+        expected = -1,
+        cancelled = false,
+        finished = false;
+
+    function finish(err) {
+        if(finished) {
+            return;
+        }
+        finished = true;
+        if(signal) {
+            signal.removeEventListener('abort', onAbort);
+        }
+        if(err) {
+            emitter.emit('error', err);
+        } else {
+            emitter.emit('end', received);
+        }
+    }
+    function onAbort() {
+        if(handle.abort) {
+            handle.abort();
+        }
+        finish(createAbortError(signal));
+    }
+    function onPrinter(printer) {
+        if(finished) {
+            return;
+        }
+        correctPrinterinfo(printer);
+        ++received;
+        emitter.emit('printer', printer);
+        // printers and completion are delivered separately: end after the last printer
+        if(received === expected) {
+            finish();
+        }
+    }
+
+    emitter.cancel = function() {
+        cancelled = true;
+        if(handle.abort) {
+            handle.abort();
+        }
+    };
+
+    if(options.timeout !== undefined) {
+        handle.timeout = options.timeout;
+    }
+    process.nextTick(function(){
+        if(signal && signal.aborted) {
+            return finish(createAbortError(signal));
+        }
+        if(cancelled) {
+            return finish();
+        }
+        var promise;
+        syncTracing();
+        try {
+            promise = printer_helper.enumPrintersAsync({type: options.type, mask: options.mask, server: options.server}, onPrinter, handle);
+        } catch (e) {
+            return finish(e);
+        }
+        if(signal) {
+            signal.addEventListener('abort', onAbort, {once: true});
+        }
+        promise.then(function(count){
+            expected = count;
+            if(received >= expected) {
+                finish();
+            }
+        }, function(err){
+            finish(cancelled && err.code === 'ABORT_ERR' ? undefined : err);
+        });
+    });
+    return emitter;
+}
+
+function getPrinterAsync(printerName, options)
+{
+    return resolvePrinterNameAsync(printerName, options).then(function(name){
+        return callAsync('getPrinterAsync', [name], options);
+    }).then(function(printer){
+        correctPrinterinfo(printer);
+        return printer;
+    });
+}
+
+function getPrinterDriverOptionsAsync(printerName, options)
+{
+    return resolvePrinterNameAsync(printerName, options).then(function(name){
+        return callAsync('getPrinterDriverOptionsAsync', [name], options);
+    });
+}
+
+function getJobAsync(printerName, jobId, options)
+{
+    return callAsync('getJobAsync', [printerName, jobId], options);
+}
+
+function setJobAsync(printerName, jobId, command, value, options)
+{
+    if(typeof value === 'object') {
+        options = value;
+        value = undefined;
+    }
+    return callAsync('setJobAsync', [printerName, jobId, command, value], options);
+}
+
+function setJobsAsync(printerName, jobIds, command, value, options)
+{
+    if(typeof value === 'object') {
+        options = value;
+        value = undefined;
+    }
+    return callAsync('setJobsAsync', [printerName, jobIds, command, value], options);
+}
+
+function moveJobsAsync(fromPrinter, toPrinter, options)
+{
+    var jobIds;
+    try {
+        jobIds = getMoveJobIds(options);
+    } catch (e) {
+        return Promise.reject(e);
+    }
+    return callAsync('moveJobsAsync', [fromPrinter, toPrinter, jobIds], options);
+}
+
+function drainPrinterAsync(printerName, pool, options)
+{
+    return Promise.all([getPrinterAsync(printerName, options)].concat(pool.map(function(name){
+        return getPrinterAsync(name, options);
+    }))).then(function(printers){
+        var source = printers.shift();
+        var plan = planDrain(source.jobs || [], getDrainTargets(source.name, printers));
+        var targets = Object.keys(plan);
+        return Promise.all(targets.map(function(target){
+            return plan[target].length ? callAsync('moveJobsAsync', [source.name, target, plan[target]], options) : [];
+        })).then(function(moved){
+            var result = {};
+            for(var i = 0; i < targets.length; ++i) {
+                result[targets[i]] = moved[i];
+            }
+            return checkDrained(source.name, plan, result);
+        });
+    });
+}
+
+function cancelAllJobsAsync(printerName, purge, options)
+{
+    if(typeof purge === 'object') {
+        options = purge;
+        purge = false;
+    }
+    return callAsync('cancelAllJobsAsync', [printerName, !!purge], options);
+}
+
+/** Send the pending parts of a coalesced printer as one job
+ * @return Promise resolved once the parts are completed
+ */
+function flushPrinter(printerName)
+{
+    var state = coalescedPrinters[printerName];
+    if(!state || !state.parts.length) {
+        return Promise.resolve();
+    }
+    var parts = state.parts;
+    state.parts = [];
+    state.bytes = 0;
+    if(state.timer) {
+        clearTimeout(state.timer);
+        state.timer = null;
+    }
+    parts.forEach(function(part){
+        if(part.signal) {
+            part.signal.removeEventListener('abort', part.onAbort);
+        }
+    });
+    var data = Buffer.concat(parts.map(function(part){ return part.data; })),
+        sent;
+    if(printer_helper.printDirectAsync) {
+        sent = callAsync('printDirectAsync', [data, printerName, state.docname, 'RAW', {}], {});
+    } else {
+        sent = new Promise(function(resolve, reject){
+            setImmediate(function(){
+                try {
+                    syncTracing();
+                    resolve(printer_helper.printDirect(data, printerName, state.docname, 'RAW', {}));
+                } catch (e) {
+                    reject(e);
+                }
+            });
+        });
+    }
+    return sent.then(function(jobId){
+        parts.forEach(function(part){ part.resolve(jobId); });
+    }, function(err){
+        parts.forEach(function(part){ part.reject(err); });
+    });
+}
+
+/** Queue data on a coalesced printer
+ * @return Promise resolved with the id of the job the data is sent with
+ */
+function coalesce(printerName, data, signal)
+{
+    var state = coalescedPrinters[printerName];
+    if(signal && signal.aborted) {
+        return Promise.reject(createAbortError(signal));
+    }
+    return new Promise(function(resolve, reject){
+        var part = {data: Buffer.isBuffer(data) ? data : Buffer.from(String(data)), resolve: resolve, reject: reject};
+        if(signal) {
+            // an aborted part is dropped while it is pending, flushPrinter removes the listener
+            part.signal = signal;
+            part.onAbort = function(){
+                var index = state.parts.indexOf(part);
+                if(index >= 0) {
+                    state.parts.splice(index, 1);
+                    state.bytes -= part.data.length;
+                    reject(createAbortError(signal));
+                }
+            };
+            signal.addEventListener('abort', part.onAbort, {once: true});
+        }
+        state.parts.push(part);
+        state.bytes += part.data.length;
+        if(state.bytes >= state.maxBytes) {
+            flushPrinter(printerName);
+        } else if(!state.timer) {
+            state.timer = setTimeout(function(){
+                state.timer = null;
+                flushPrinter(printerName);
+            }, state.window);
+        }
+    });
+}
+
+/** true if a job of this type and options is coalesced on printerName.
+ * A job with its own docname or timeout is sent alone, the batch has neither.
+ */
+function isCoalesced(printerName, type, options, docname, timeout)
 {
-    return printer_helper.setJob(printerName, jobId, command);
+    return type === 'RAW' && coalescedPrinters.hasOwnProperty(printerName) && (!options || !Object.keys(options).length)
+        && (!docname || docname === coalescedPrinters[printerName].docname) && timeout === undefined;
 }
 
-function getPrinters(){
-    var printers = printer_helper.getPrinters();
+function setCoalescing(printerName, options)
+{
+    if(!printerName) {
+        throw new Error('must provide a printer name');
+    }
+    var flushed = flushPrinter(printerName);
+    if(!options) {
+        delete coalescedPrinters[printerName];
+        return flushed;
+    }
+    var state = coalescedPrinters[printerName] || {parts: [], bytes: 0, timer: null};
+    state.window = options.window !== undefined ? options.window : 20;
+    state.maxBytes = options.maxBytes !== undefined ? options.maxBytes : 64 * 1024;
+    state.docname = options.docname || "node print job";
+    coalescedPrinters[printerName] = state;
+    return flushed;
+}
+
+function flushCoalesced(printerName)
+{
+    var printers = printerName ? [printerName] : Object.keys(coalescedPrinters);
+    return Promise.all(printers.map(flushPrinter)).then(function(){});
+}
+
+/** Send data to printer without blocking (POSIX only)
+ * @param parameters same as printDirect, without success/error callbacks, plus
+ *      signal - AbortSignal, optional, interrupts the upload and cancels the created job.
+ *               The promise settles once the upload stopped: with the job id if it was already sent
+ *      timeout - Number, optional, milliseconds before the upload is interrupted
+ *      onProgress - Function(bytesSent, totalBytes), optional, called from the upload loop at most every 50 ms, and once all bytes are sent
+ * @return Promise resolved with the job id
+ */
+function printDirectAsync(parameters)
+{
+    var type = (parameters.type || "RAW").toUpperCase(),
+        docname = parameters.docname || "node print job",
+        options = parameters.options || {};
+
+    function submit(printer) {
+        if(isCoalesced(printer, type, parameters.options, parameters.docname, parameters.timeout)) {
+            return coalesce(printer, parameters.data, parameters.signal);
+        }
+        return callAsync('printDirectAsync', [parameters.data, printer, docname, type, options], parameters, true);
+    }
+
+    return resolvePrinterNameAsync(parameters.printer, parameters).then(function(printer){
+        var key = getIdempotencyKey(parameters, printer, type, options);
+        if(!key) {
+            return submit(printer);
+        }
+        var jobId = printer_helper.findIdempotentJob(key, printer),
+            pendingKey = printer + '\0' + key;
+        if(jobId) {
+            return jobId;
+        }
+        // a retry racing the first submission waits for its job id
+        if(!idempotentSubmissions[pendingKey]) {
+            idempotentSubmissions[pendingKey] = submit(printer).then(function(id){
+                delete idempotentSubmissions[pendingKey];
+                printer_helper.recordIdempotentJob(key, printer, id);
+                return id;
+            }, function(err){
+                delete idempotentSubmissions[pendingKey];
+                throw err;
+            });
+        }
+        return idempotentSubmissions[pendingKey];
+    });
+}
+
+/** Wrap a success callback to record the job id of an idempotent submission first
+ */
+function recordIdempotentJob(key, printer, success)
+{
+    return function(jobId) {
+        printer_helper.recordIdempotentJob(key, printer, jobId);
+        if(success) {
+            success(jobId);
+        }
+    };
+}
+
+/** Idempotency key of a submission: its idempotencyKey option, or the content hash if it is true
+ * @return undefined if the submission is not idempotent
+ */
+function getIdempotencyKey(parameters, printer, type, options)
+{
+    var key = parameters.idempotencyKey;
+    if(key === true) {
+        return printer_helper.hashDocument(parameters.data, printer, type, options);
+    }
+    return key ? String(key) : undefined;
+}
+
+/** Send file to printer without blocking (POSIX only)
+ * @param parameters same as printFile, without success/error callbacks, plus
+ *      signal - AbortSignal, optional, interrupts the upload and cancels the created job.
+ *               The promise settles once the upload stopped: with the job id if it was already sent
+ *      timeout - Number, optional, milliseconds before the upload is interrupted
+ *      onProgress - Function(bytesSent, totalBytes), optional, called from the upload loop at most every 50 ms, and once all bytes are sent
+ * @return Promise resolved with the job id
+ */
+function printFileAsync(parameters)
+{
+    if(!parameters || !parameters.filename) {
+        return Promise.reject(new Error('must provide at least a filename'));
+    }
+    var docname = parameters.docname || parameters.filename,
+        options = parameters.options || {};
+
+    return resolvePrinterNameAsync(parameters.printer, parameters).then(function(printer){
+        if(!printer) {
+            throw new Error('Printer parameter of default printer is not defined');
+        }
+        return callAsync('printFileAsync', [parameters.filename, docname, printer, options], parameters, true);
+    });
+}
+
+/** Open a persistent handle to a printer (POSIX only)
+ * @param printerName printer name (default printer used if printer is not provided)
+ * @return Printer object with the following methods:
+ *      print(data, docname, type, options) - send data to printer, returns job id
+ *      getJobs(which) - get printer jobs. which: ACTIVE (default), COMPLETED or ALL
+ *      getJob(jobId) - get job info
+ *      setJob(jobId, command, value) - send a command to a job
+ *      setJobs(jobIds, command, value) - send a command to several jobs
+ *      cancelAllJobs(purge) - cancel all jobs of the printer
+ *      capabilities() - get supported and default values of the printer options
+ *      close() - release the handle
+ */
+function openPrinter(printerName)
+{
+    if(!printerName) {
+        printerName = getDefaultPrinterName();
+    }
+    syncTracing();
+    return printer_helper.openPrinter(printerName);
+}
+
+function getPrinters(server){
+    syncTracing();
+    var printers = server ? printer_helper.getPrinters(server) : printer_helper.getPrinters();
     if(printers && printers.length){
         var i = printers.length;
         for(i in printers){
@@ -221,6 +1127,9 @@ function printDirect(parameters){
 
     type = type.toUpperCase();
 
+    // a docname of its own keeps the job out of coalescing
+    var coalesced = isCoalesced(printer, type, options, docname);
+
     if(!docname){
         docname = "node print job";
     }
@@ -229,9 +1138,36 @@ function printDirect(parameters){
         options = {};
     }
 
+    var idempotencyKey = arguments.length == 1 ? getIdempotencyKey(parameters, printer, type, options) : undefined;
+    if(idempotencyKey) {
+        var existingJobId = printer_helper.findIdempotentJob(idempotencyKey, printer);
+        if(existingJobId) {
+            if(success) {
+                success(existingJobId);
+            }
+            return;
+        }
+        success = recordIdempotentJob(idempotencyKey, printer, success);
+    }
+
+    if(coalesced) {
+        // completes when the coalesced job is sent
+        coalesce(printer, data).then(function(jobId){
+            if(success) {
+                success(jobId);
+            }
+        }, function(err){
+            if(error) {
+                error(err);
+            }
+        });
+        return;
+    }
+
     //TODO: check parameters type
     if(printer_helper.printDirect){// call C++ binding
         try{
+            syncTracing();
             var res = printer_helper.printDirect(data, printer, docname, type, options);
             if(res){
                 success(res);
@@ -307,6 +1243,7 @@ function printFile(parameters){
     if(printer_helper.printFile){// call C++ binding
         try{
             // TODO: proper success/error callbacks from the extension
+            syncTracing();
             var res = printer_helper.printFile(filename, docname, printer, options);
 
             if(!isNaN(parseInt(res))) {
@@ -321,3 +1258,104 @@ function printFile(parameters){
         error("Not supported");
     }
 }
+
+/** Render the labels of a batch, compiling the template if needed
+ */
+function renderLabels(parameters)
+{
+    var template = parameters.template;
+    if(typeof(template) === 'string' || Buffer.isBuffer(template)) {
+        template = printer_helper.compileLabelTemplate(template, parameters.templateOptions || {});
+    }
+    return template.render(parameters.records);
+}
+
+/** Print a batch of labels as one RAW job
+parameters:
+   parameters - Object, parameters objects with the following structure:
+      template - String/Buffer or template returned by compileLabelTemplate, mandatory
+      records - Array of Objects, Array of Arrays or Object of columns, mandatory, one label per record
+      templateOptions - Object, optional, {open, close} placeholder delimiters if template is not compiled
+      printer, docname, options, success, error - same as printDirect
+*/
+function printLabels(parameters){
+    var data;
+    try {
+        data = renderLabels(parameters);
+    } catch (e) {
+        if(!parameters.error) {
+            throw e;
+        }
+        return parameters.error(e);
+    }
+    printDirect({
+        data: data,
+        printer: parameters.printer,
+        docname: parameters.docname || "node print labels",
+        type: "RAW",
+        options: parameters.options,
+        success: parameters.success || function(){},
+        error: parameters.error || function(err){ throw err; }
+    });
+}
+
+/** Print a batch of labels as one RAW job without blocking (POSIX only)
+ * @param parameters same as printLabels, without success/error callbacks, plus signal and timeout as printDirectAsync
+ * @return Promise resolved with the job id
+ */
+function printLabelsAsync(parameters)
+{
+    var data;
+    try {
+        data = renderLabels(parameters);
+    } catch (e) {
+        return Promise.reject(e);
+    }
+    return printDirectAsync({
+        data: data,
+        printer: parameters.printer,
+        docname: parameters.docname || "node print labels",
+        type: "RAW",
+        options: parameters.options,
+        signal: parameters.signal,
+        timeout: parameters.timeout
+    });
+}
+
+/** open a durable spool journal
+ * @param path journal file, created if missing. One process at a time can open it
+ * @param options optional:
+ *      maxSize - largest journal size in bytes, default 64 MiB
+ *      sync - msync the journal on every change, to survive a power loss too. Default false
+ *      onJob - function(err, {sequence, printer, jobId}), called as each job is submitted or fails
+ * @return {add, getEntries, close}. add takes the parameters of printDirect, without
+ *      success and error, and returns the sequence number of the job in the journal.
+ *      An open spool keeps the process alive: close() it on shutdown
+ */
+function openSpool(path, options)
+{
+    options = options || {};
+    var onJob = options.onJob,
+        spool = printer_helper.openSpool(path, {maxSize: options.maxSize, sync: !!options.sync}, function(err, entry){
+            if(onJob) {
+                onJob(err, entry);
+            }
+        });
+
+    return {
+        add: function(parameters) {
+            var printer = parameters.printer || getDefaultPrinterName();
+            if(!printer) {
+                throw new Error('no printer given and no default printer');
+            }
+            return spool.add(parameters.data, printer, parameters.docname || "node print job",
+                             (parameters.type || "RAW").toUpperCase(), parameters.options || {});
+        },
+        getEntries: function() {
+            return spool.getEntries();
+        },
+        close: function() {
+            spool.close();
+        }
+    };
+}
@@ -13,6 +13,18 @@
 
 #define RETURN_EXCEPTION_STR(msg) RETURN_EXCEPTION(msg)
 
+#define RETURN_EXCEPTION_CODE(msg, code)                               \
+    {                                                                  \
+        Napi::TypeError error = Napi::TypeError::New(env, msg);        \
+        std::string error_code(code);                                  \
+        if (!error_code.empty())                                       \
+        {                                                              \
+            error.Set("code", Napi::String::New(env, error_code));     \
+        }                                                              \
+        error.ThrowAsJavaScriptException();                            \
+    }                                                                  \
+    return env.Null()
+
 #define REQUIRE_ARGUMENTS(args, n)                         \
     if (args.Length() < (n))                               \
     {                                                      \
@@ -1,17 +1,62 @@
 #include "node_printer.hpp"
+#include "node_printer_env.hpp"
 
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
+    // loaded once per environment, main thread or worker
+    env.SetInstanceData(new ModuleData());
+    useThreadPool(env);
+
     MY_NODE_MODULE_SET_METHOD(env, exports, "getPrinters", getPrinters);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getDefaultPrinterName", getDefaultPrinterName);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getPrinter", getPrinter);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getPrinterDriverOptions", getPrinterDriverOptions);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getJob", getJob);
     MY_NODE_MODULE_SET_METHOD(env, exports, "setJob", setJob);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setJobs", setJobs);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "cancelAllJobs", cancelAllJobs);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "moveJobs", moveJobs);
     MY_NODE_MODULE_SET_METHOD(env, exports, "printDirect", PrintDirect);
     MY_NODE_MODULE_SET_METHOD(env, exports, "printFile", PrintFile);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getSupportedPrintFormats", getSupportedPrintFormats);
     MY_NODE_MODULE_SET_METHOD(env, exports, "getSupportedJobCommands", getSupportedJobCommands);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "openPrinter", openPrinter);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getPrintersAsync", getPrintersAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "enumPrintersAsync", enumPrintersAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getPrinterAsync", getPrinterAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getPrinterDriverOptionsAsync", getPrinterDriverOptionsAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getJobAsync", getJobAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setJobAsync", setJobAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setJobsAsync", setJobsAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "cancelAllJobsAsync", cancelAllJobsAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "moveJobsAsync", moveJobsAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "printDirectAsync", PrintDirectAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "printFileAsync", PrintFileAsync);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setThreadPoolSize", setThreadPoolSize);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getThreadPoolSize", getThreadPoolSize);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setDefaultTimeout", setDefaultTimeout);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getDefaultTimeout", getDefaultTimeout);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setCircuitBreakerOptions", setCircuitBreakerOptions);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getCircuitBreakerState", getCircuitBreakerState);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getStats", getStats);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setBackend", setBackend);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "startJobTracker", startJobTracker);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "stopJobTracker", stopJobTracker);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getJobLatencyStats", getJobLatencyStats);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setTraceCallback", setTraceCallback);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "compileLabelTemplate", compileLabelTemplate);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "openSpool", openSpool);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "hashDocument", hashDocument);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "detectDocumentFormat", detectDocumentFormat);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "encodeRaster", encodeRaster);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "encodeGraphic", encodeGraphic);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "encodeBarcodes", encodeBarcodes);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "setIdempotencyOptions", setIdempotencyOptions);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "findIdempotentJob", findIdempotentJob);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "recordIdempotentJob", recordIdempotentJob);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "addPrintServer", addPrintServer);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "removePrintServer", removePrintServer);
+    MY_NODE_MODULE_SET_METHOD(env, exports, "getPrintServers", getPrintServers);
 
     return exports;
 }
@@ -57,25 +57,52 @@ MY_NODE_MODULE_CALLBACK(getPrinterDriverOptions);
  */
 MY_NODE_MODULE_CALLBACK(getJob);
 
-// TODO
 /** Set job command.
  * arguments:
  * @param printer name String
  * @param job id Number
  * @param job command String
- * Possible commands:
+ * @param value Number, posix only, mandatory for PRIORITY: job priority from 1 to 100
+ * Possible commands, see getSupportedJobCommands:
  *      "CANCEL"
  *      "PAUSE"
  *      "RESTART"
  *      "RESUME"
- *      "DELETE"
- *      "SENT-TO-PRINTER"
- *      "LAST-PAGE-EJECTED"
- *      "RETAIN"
+ *      "DELETE" (windows)
+ *      "SENT-TO-PRINTER" (windows)
+ *      "LAST-PAGE-EJECTED" (windows)
+ *      "RETAIN" (windows)
  *      "RELEASE"
+ *      "HOLD" (posix)
+ *      "PRIORITY" (posix)
  */
 MY_NODE_MODULE_CALLBACK(setJob);
 
+/** Set job command on several jobs of a printer.
+ * posix: CANCEL is a single Cancel-Jobs request, other commands share one connection.
+ * @param printer name String
+ * @param job ids Array of Number
+ * @param job command String
+ * @param value Number, optional, see setJob
+ * @returns true if the command succeeded for every job
+ */
+MY_NODE_MODULE_CALLBACK(setJobs);
+
+/** Move queued jobs to another printer with CUPS-Move-Job, posix only.
+ * Documents are moved on the server, they are not uploaded again.
+ * @param from printer name String
+ * @param to printer name String
+ * @param job ids Array of Number, optional: all jobs of the printer are moved with a single request if missing
+ * @returns Array of the moved job ids, or true/false when moving all jobs
+ */
+MY_NODE_MODULE_CALLBACK(moveJobs);
+
+/** Cancel all jobs of a printer with a single request
+ * @param printer name String
+ * @param purge Boolean, optional, posix only: also remove the job history
+ */
+MY_NODE_MODULE_CALLBACK(cancelAllJobs);
+
 /** Get supported print formats for printDirect. It depends on platform
  */
 MY_NODE_MODULE_CALLBACK(getSupportedPrintFormats);
@@ -84,6 +111,213 @@ MY_NODE_MODULE_CALLBACK(getSupportedPrintFormats);
  */
 MY_NODE_MODULE_CALLBACK(getSupportedJobCommands);
 
+/** Open a persistent printer handle. The resolved destination, a dedicated
+ * connection and the destination info are kept until close() is called.
+ * posix only.
+ * @param printer name String
+ * @returns Printer object with print, getJobs, getJob, setJob, capabilities and close methods
+ */
+MY_NODE_MODULE_CALLBACK(openPrinter);
+
+/** Asynchronous variants of the methods above, posix only.
+ * They run on the module thread pool and return a Promise resolved with the
+ * same value as the synchronous variant.
+ * They take the same arguments plus an optional handle object, last argument,
+ * on which an abort() function is set. Calling it interrupts the operation:
+ * its connection is shut down and a partially uploaded job is cancelled.
+ * A `timeout` property of the handle, in milliseconds, overrides the default timeout.
+ * Rejection errors have a `code` property: ABORT_ERR, ETIMEDOUT, ECONNREFUSED or ECIRCUITOPEN.
+ */
+MY_NODE_MODULE_CALLBACK(getPrintersAsync);
+
+/** Enumerate printers with cupsEnumDests, calling a function with each one as it is found.
+ * Arguments: filter Object {type, mask}, onPrinter Function, handle.
+ * The handle timeout bounds the discovery; the promise resolves with the number of printers reported.
+ */
+MY_NODE_MODULE_CALLBACK(enumPrintersAsync);
+MY_NODE_MODULE_CALLBACK(getPrinterAsync);
+MY_NODE_MODULE_CALLBACK(getPrinterDriverOptionsAsync);
+MY_NODE_MODULE_CALLBACK(getJobAsync);
+MY_NODE_MODULE_CALLBACK(setJobAsync);
+MY_NODE_MODULE_CALLBACK(setJobsAsync);
+MY_NODE_MODULE_CALLBACK(cancelAllJobsAsync);
+MY_NODE_MODULE_CALLBACK(moveJobsAsync);
+MY_NODE_MODULE_CALLBACK(PrintDirectAsync);
+MY_NODE_MODULE_CALLBACK(PrintFileAsync);
+
+/** Set the number of threads of the module thread pool used by asynchronous methods
+ * @param size Number, mandatory, at least 1
+ */
+MY_NODE_MODULE_CALLBACK(setThreadPoolSize);
+
+/** Get the number of threads of the module thread pool
+ */
+MY_NODE_MODULE_CALLBACK(getThreadPoolSize);
+
+/** Set the timeout of operations on the print server, posix only.
+ * It applies to synchronous methods, printer handle methods and asynchronous methods
+ * called without a timeout. The time spent waiting for a pool thread is included.
+ * @param timeout Number, mandatory, milliseconds. 0 (default) means libcups timeouts
+ */
+MY_NODE_MODULE_CALLBACK(setDefaultTimeout);
+
+/** Get the default timeout in milliseconds
+ */
+MY_NODE_MODULE_CALLBACK(getDefaultTimeout);
+
+/** Configure the per print server circuit breaker, posix only.
+ * After failureThreshold consecutive timeouts or connection failures, operations
+ * fail fast with code ECIRCUITOPEN until a background probe, run every resetTimeout
+ * milliseconds, gets an answer from the server.
+ * @param options Object, mandatory, {failureThreshold: Number (default 5, 0 disables), resetTimeout: Number (default 5000)}
+ */
+MY_NODE_MODULE_CALLBACK(setCircuitBreakerOptions);
+
+/** Get the circuit breaker state of the print servers used so far
+ * @returns Object by "server:port" of {state: "OPEN" or "CLOSED", failures: Number}
+ */
+MY_NODE_MODULE_CALLBACK(getCircuitBreakerState);
+
+/** Get latency and throughput statistics of the operations, posix only.
+ * Each operation has calls, errors, uploaded bytes and latency histograms:
+ * latency (whole call), ipp (time on the print server connection) and marshal
+ * (conversion of the result to JS). Errors, calls and bytes are also counted per printer.
+ * @param options Object, optional, {reset: Boolean}: clear the statistics while reading them
+ */
+MY_NODE_MODULE_CALLBACK(getStats);
+
+/** Start tracking the jobs submitted by printDirect and printFile, posix only.
+ * A background thread watches their state and records per printer the queue wait
+ * (submission to processing) and the print time (processing to completed).
+ * @param options Object, optional, {interval: Number}: poll interval in milliseconds, default 1000
+ */
+MY_NODE_MODULE_CALLBACK(startJobTracker);
+
+/** Stop the job tracker. The jobs being tracked are forgotten, the statistics are kept
+ */
+MY_NODE_MODULE_CALLBACK(stopJobTracker);
+
+/** Get the job latency statistics of the tracker, posix only
+ * @param options Object, optional, {reset: Boolean}: clear the statistics while reading them
+ * @returns Object by printer of {completed, failed, pending, queueWait, printTime}, durations in milliseconds
+ */
+MY_NODE_MODULE_CALLBACK(getJobLatencyStats);
+
+/** Select the print server under the module functions, posix only.
+ * The persistent printer handles of openPrinter and the job tracker always use CUPS.
+ * @param name String, mandatory: "cups" (default) or "memory", an in-memory simulation for tests and benchmarks
+ * @param options Object, optional, for "memory": {printers: Array of names (default ["memory"]),
+ *   latency: ms per request, chunkLatency: ms per uploaded chunk, printTime: ms a job takes to print}
+ */
+MY_NODE_MODULE_CALLBACK(setBackend);
+
+/** Set the callback receiving the tracing events of the print server operations, posix only.
+ * Events are {id, phase: "start" or "end", operation, printer?, jobId?} and, at the end,
+ * {bytes, status: IPP status, duration: ms}. They are delivered asynchronously, and dropped if too many are pending.
+ * @param callback Function or null to stop tracing
+ */
+MY_NODE_MODULE_CALLBACK(setTraceCallback);
+
+/** Compile a label template: printer commands (ZPL, EPL, ESC/POS...) with {{field}} placeholders.
+ * @param source String or Buffer, mandatory
+ * @param options Object, optional, {open: String, close: String}: placeholder delimiters, default "{{" and "}}"
+ * @returns LabelTemplate object with `fields` (placeholder names in order of appearance) and
+ *   render(records): Buffer with the labels of all the records, records being an Array of Objects,
+ *   an Array of Arrays (values in the order of fields) or an Object of columns {field: Array}
+ */
+MY_NODE_MODULE_CALLBACK(compileLabelTemplate);
+
+/** Open a durable spool: an append-only memory-mapped journal of jobs, drained in order
+ * to the print server by a background thread, posix only. Jobs left by a previous process are drained too.
+ * @param path String, mandatory: journal file, created if missing
+ * @param options Object, mandatory, {maxSize: bytes (default 64 MiB), sync: Boolean, msync every change}
+ * @param onResult Function(err, {sequence, printer, jobId}), mandatory, called as jobs are submitted or fail
+ * @returns Spool object with add(data, printer, docname, type, options): sequence number,
+ *   getEntries(): Array of {sequence, printer, docname, status, jobId?} and close()
+ */
+MY_NODE_MODULE_CALLBACK(openSpool);
+
+/** Idempotency key of a submission: XXH64 of the printer, type, options (in name order) and data
+ * @param data String or Buffer, printer String, type String, options Object, all mandatory
+ * @returns 16 hex digits
+ */
+MY_NODE_MODULE_CALLBACK(hashDocument);
+
+/** Recognize a document from its first bytes, as done for the AUTO type, posix only
+ * @param data String or Buffer, mandatory
+ * @returns MIME type: application/pdf, application/postscript, image/pwg-raster, image/urf,
+ *   image/jpeg, image/png, or application/vnd.cups-raw for printer languages (ZPL, ESC/POS, PCL, PJL);
+ *   undefined if not recognized
+ */
+MY_NODE_MODULE_CALLBACK(detectDocumentFormat);
+
+/** Encode pixels to PWG raster (image/pwg-raster) or Apple raster (image/urf) on the thread pool.
+ * Pages are split in bands of rows, converted and run-length compressed on their own threads.
+ * @param pixels Buffer, or Array of Buffers, one per page, rows of width * channels bytes, mandatory
+ * @param options Object, mandatory, {width, height: pixels, mandatory, channels: 1 gray (default), 3 RGB or 4 RGBA,
+ *   format: "pwg" (default) or "urf", colorSpace: "black" (1 bit), "sgray" (default) or "srgb",
+ *   dither: "threshold" (default) or "ordered" for black, threshold: 0-255 (default 128),
+ *   resolution: dpi (default 203), quality: "draft", "normal" or "high"}
+ * @param handle Object, optional, see PoolTask::bindAbortHandle
+ * @returns Promise of the encoded Buffer
+ */
+MY_NODE_MODULE_CALLBACK(encodeRaster);
+
+/** Convert pixels to a black and white printer graphic, ready to send as RAW data.
+ * Runs on the calling thread: a 4x6 inch label at 203 dpi takes about a millisecond.
+ * @param pixels Buffer, rows of width * channels bytes, mandatory
+ * @param options Object, mandatory, {width, height, channels, dither, threshold: as encodeRaster,
+ *   language: "zpl" (default) or "escpos",
+ *   zpl: x, y: field origin (default 0), label: Boolean, wrap in ^XA...^XZ (default true),
+ *   escpos: bandHeight: rows per GS v 0 command (default 256)}
+ * @returns Buffer: ZPL ^GFA field, ACS compressed, or ESC/POS GS v 0 raster commands
+ */
+MY_NODE_MODULE_CALLBACK(encodeGraphic);
+
+/** Encode a batch of Code 128, QR or DataMatrix barcodes on the thread pool.
+ * @param payloads Array of Strings (UTF-8) or Buffers, mandatory
+ * @param options Object, mandatory, {type: "code128", "qr" or "datamatrix", mandatory,
+ *   output: "bitmap" (8 bits gray pixels, default), "pwg" (1-bit PWG raster page) or "zpl" (^GFA field),
+ *   moduleSize: dots per module (default 3), height: Code 128 bar height in dots (default 100),
+ *   quietZone: modules (default 10 for Code 128, 4 for QR, 1 for DataMatrix), ecLevel: QR "L", "M" (default), "Q" or "H",
+ *   resolution: dpi of the PWG page (default 203), x, y, label: as encodeGraphic for zpl}
+ * @param handle Object, optional, see PoolTask::bindAbortHandle
+ * @returns Promise of an Array of {width, height: dots, data: Buffer}
+ */
+MY_NODE_MODULE_CALLBACK(encodeBarcodes);
+
+/** Configure the process wide index of the job ids of the recent idempotent submissions
+ * @param options Object, mandatory, {window: ms a job id is kept (default 10 minutes),
+ *   maxEntries: Number (default 10000), file: String, optional, log file reloaded on restart}
+ */
+MY_NODE_MODULE_CALLBACK(setIdempotencyOptions);
+
+/** Job id recorded for an idempotency key on a printer within the window
+ * @param key String, printer String, mandatory
+ * @returns Number, or undefined if the key is unknown
+ */
+MY_NODE_MODULE_CALLBACK(findIdempotentJob);
+
+/// Record the job id of an idempotency key on a printer. Arguments: key String, printer String, jobId Number
+MY_NODE_MODULE_CALLBACK(recordIdempotentJob);
+
+/** Register a print server, posix only. Its printers are then named "queue@name" in every function,
+ * each server having its own connections, kept per thread, and circuit breaker.
+ * Unregistered "queue@host[:port]" printers use the encryption of libcups.
+ * @param name String, mandatory, without @
+ * @param options Object, mandatory, {host: String, mandatory, port: Number (default 631),
+ *   encryption: "IF_REQUESTED", "NEVER", "REQUIRED" or "ALWAYS" (default: the one of libcups)}
+ */
+MY_NODE_MODULE_CALLBACK(addPrintServer);
+
+/// Forget a print server of addPrintServer. Argument: name String. Returns false if it was unknown
+MY_NODE_MODULE_CALLBACK(removePrintServer);
+
+/** Get the print servers of addPrintServer
+ * @returns Array of {name, host, port, encryption}
+ */
+MY_NODE_MODULE_CALLBACK(getPrintServers);
+
 // TODO:
 //  optional ability to get printer spool
 
@@ -0,0 +1,213 @@
+#ifndef NODE_PRINTER_BACKEND_HPP
+#define NODE_PRINTER_BACKEND_HPP
+
+#include "node_printer_pool.hpp"
+
+#include <cups/cups.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Job info copied out of libcups structures.
+ * It does not reference any CUPS memory, so it can be built on a pool thread
+ * and converted to JS later on the main thread.
+ */
+struct JobInfo
+{
+    int id;
+    std::string title;
+    std::string dest;
+    std::string user;
+    std::string format;
+    int state;
+    int priority;
+    int size;
+    time_t completed_time;
+    time_t creation_time;
+    time_t processing_time;
+    /// number-of-documents, -1 if unknown
+    int documents;
+
+    JobInfo() : id(0), state(IPP_JOB_PENDING), priority(0), size(0), completed_time(0), creation_time(0), processing_time(0), documents(-1) {}
+
+    explicit JobInfo(const cups_job_t *job)
+        : id(job->id), title(job->title), dest(job->dest), user(job->user), format(job->format),
+          state(job->state), priority(job->priority), size(job->size),
+          completed_time(job->completed_time), creation_time(job->creation_time), processing_time(job->processing_time), documents(-1) {}
+};
+
+/// Printer info copied out of cups_dest_t, including its active jobs
+struct PrinterInfo
+{
+    std::string name;
+    std::string instance;
+    bool isDefault;
+    std::vector<std::pair<std::string, std::string>> options;
+    std::vector<JobInfo> jobs;
+
+    PrinterInfo() : isDefault(false) {}
+};
+
+/** Printer filter of PrintBackend::enumPrinters, as in cupsEnumDests:
+ * a printer matches if its printer-type bits selected by mask equal type
+ */
+struct EnumPrintersFilter
+{
+    unsigned type;
+    unsigned mask;
+
+    EnumPrintersFilter() : type(0), mask(0) {}
+};
+
+/** Receives the printers of PrintBackend::enumPrinters, on the enumerating thread
+ * @return false to stop the enumeration
+ */
+typedef std::function<bool(const PrinterInfo &)> PrinterCallback;
+
+/// PPD options as keyword -> (choice, marked) list, in PPD order
+typedef std::vector<std::pair<std::string, std::vector<std::pair<std::string, bool>>>> DriverOptionsType;
+
+/// Source of the bytes uploaded by submitDocument
+class DocumentSource
+{
+public:
+    virtual ~DocumentSource() {}
+
+    /** Get the next chunk to upload
+     * @return false at the end of the document or on error
+     */
+    virtual bool next(const char *&chunk, size_t &length) = 0;
+
+    /// Size of the document in bytes, -1 if unknown
+    virtual int64_t getSize() const { return -1; }
+
+    /// Read error, empty if none
+    virtual std::string getError() const { return ""; }
+};
+
+/** Print server under the module functions (posix only).
+ * Every method runs on the calling thread, the main thread for synchronous
+ * functions or a pool thread for asynchronous ones, and must honor the
+ * deadline and abort of state. Implementations are thread safe.
+ * Methods return an error string, empty if no error.
+ */
+class PrintBackend
+{
+public:
+    virtual ~PrintBackend() {}
+
+    /// All printers with their active jobs
+    virtual std::string getPrinters(AbortState &state, std::vector<PrinterInfo> &printers) = 0;
+    virtual std::string getPrinter(AbortState &state, const std::string &printername, PrinterInfo &printer) = 0;
+
+    /** Report the printers one by one as they are found, without their jobs.
+     * Reaching the deadline of state ends the enumeration, it is not an error.
+     * The default implementation filters the result of getPrinters.
+     */
+    virtual std::string enumPrinters(AbortState &state, const EnumPrintersFilter &filter, const PrinterCallback &onPrinter);
+
+    virtual std::string getPrinterDriverOptions(AbortState &state, const std::string &printername, DriverOptionsType &options) = 0;
+
+    /** MIME types the printer accepts (document-format-supported), formats stays empty if unknown.
+     * The default implementation does not know them.
+     */
+    virtual std::string getDocumentFormats(AbortState &state, const std::string &printername, std::vector<std::string> &formats) { return ""; }
+    virtual std::string getJob(AbortState &state, const std::string &printername, int jobId, JobInfo &job) = 0;
+
+    /** Find the most recent job of a printer with the given title, job.id stays 0 if there is none.
+     * The default implementation looks at the active jobs of getPrinter.
+     */
+    virtual std::string findJob(AbortState &state, const std::string &printername, const std::string &title, JobInfo &job);
+
+    /// True if findJob also finds the jobs already completed, cancelled or aborted
+    virtual bool findsCompletedJobs() const { return false; }
+
+    /** Send a job command, one of getSupportedJobCommands()
+     * @param value command value, e.g. the priority of PRIORITY
+     * @param result false if the server refused the command
+     */
+    virtual std::string setJob(AbortState &state, const std::string &printername, int jobId, const std::string &jobCommand, int value, bool &result) = 0;
+    virtual std::string setJobs(AbortState &state, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value, bool &result) = 0;
+    virtual std::string cancelAllJobs(AbortState &state, const std::string &printername, bool purge, bool &result) = 0;
+
+    /// Move all the jobs of a printer to another one
+    virtual std::string moveAllJobs(AbortState &state, const std::string &from, const std::string &to, bool &result) = 0;
+
+    /// @param moved ids of the jobs actually moved
+    virtual std::string moveJobs(AbortState &state, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &moved) = 0;
+
+    /** Create a job and upload a document as its only document
+     * @param format MIME type of the document
+     * @param jobId created job id
+     */
+    virtual std::string submitDocument(AbortState &state, const std::string &printername, const std::string &docname, const std::string &format,
+                                       int num_options, cups_option_t *options, DocumentSource &source, int &jobId) = 0;
+};
+
+/** Settings of the in-memory backend
+ */
+struct MemoryBackendOptions
+{
+    /// printer names, the first one is the default printer
+    std::vector<std::string> printers;
+    /// simulated round trip of each request, in milliseconds
+    int latency;
+    /// simulated upload time of each chunk, in milliseconds
+    int chunkLatency;
+    /// time a job spends processing before it completes, in milliseconds. Jobs of a printer print one at a time
+    int printTime;
+
+    MemoryBackendOptions() : latency(0), chunkLatency(0), printTime(0) {}
+};
+
+/** Backend state of one environment: the backend selected by setBackend, the print
+ * servers of addPrintServer and the job tracker. Each worker thread configures its own.
+ */
+struct BackendState;
+
+/// Backend state of env, created on first use. Called on the thread of env
+std::shared_ptr<BackendState> getBackendState(Napi::Env env);
+
+/** Backend printing to printername: the direct transport of socket:// and ipp:// URIs,
+ * CUPS on the named print server of "queue@server" names, else the backend selected by setBackend
+ */
+std::shared_ptr<PrintBackend> getPrinterBackend(BackendState &backends, const std::string &printername);
+
+/// MIME type of a document type name of getSupportedPrintFormats (e.g. RAW), empty if unsupported
+std::string getDocumentFormat(const std::string &type);
+
+/** MIME type of a document from its first bytes: PDF, PostScript, PWG raster, URF, JPEG
+ * and PNG by their type, printer languages (ZPL, ESC/POS, PCL, PJL) as raw.
+ * @return empty if not recognized
+ */
+std::string sniffDocumentFormat(const char *data, size_t size);
+
+/** Format to submit an AUTO document with: sniffed from its first bytes if the printer
+ * accepts the sniffed format, else AUTO. Not for socket:// printers, which take the bytes as they are anyway.
+ * Asks the backend for getDocumentFormats only when something was sniffed.
+ */
+std::string resolveAutoFormat(PrintBackend &backend, AbortState &state, const std::string &printername, const std::string &format, const char *data, size_t size);
+
+/// In-memory print server, for tests and benchmarks of the module itself
+std::shared_ptr<PrintBackend> newMemoryBackend(const MemoryBackendOptions &options);
+
+/// True if printername is an ipp:// or ipps:// printer URI, printed to without a local cupsd
+bool isDeviceUri(const std::string &printername);
+
+/// True if printername is a socket://host[:port] URI, printed to without CUPS
+bool isSocketUri(const std::string &printername);
+
+/** Direct AppSocket/JetDirect transport, taking RAW data only.
+ * Each printer URI has one persistent connection; concurrent jobs are written together.
+ */
+std::shared_ptr<PrintBackend> getSocketBackend();
+
+/** Backend of the ipp:// and ipps:// printers, talked to directly with IPP.
+ * Each call opens its own connection to the device.
+ */
+std::shared_ptr<PrintBackend> getDeviceBackend();
+
+#endif
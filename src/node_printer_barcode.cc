@@ -0,0 +1,1322 @@
+#include "node_printer.hpp"
+#include "node_printer_pool.hpp"
+#include "node_printer_raster.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// Dots per module by default, 2D codes and Code 128 bars
+    const uint32_t DEFAULT_MODULE_SIZE = 3;
+
+    /// Code 128 bar height in dots by default, about 12 mm at 203 dpi
+    const uint32_t DEFAULT_BAR_HEIGHT = 100;
+
+    const uint32_t DEFAULT_BARCODE_RESOLUTION = 203;
+
+    /// Quiet zones in modules: Code 128 needs 10, QR code 4, DataMatrix 1
+    const uint32_t CODE128_QUIET_ZONE = 10;
+    const uint32_t QR_QUIET_ZONE = 4;
+    const uint32_t DATAMATRIX_QUIET_ZONE = 1;
+
+    /// Largest width or height of a barcode in dots, above 1 m at 203 dpi: 100 MB of pixels at most
+    const uint64_t MAX_BARCODE_SIZE = 10000;
+
+    enum BarcodeType
+    {
+        BARCODE_CODE128,
+        BARCODE_QR,
+        BARCODE_DATAMATRIX
+    };
+
+    enum BarcodeOutput
+    {
+        /// 8 bits gray pixels, as taken by encodeRaster and encodeGraphic
+        BARCODE_BITMAP,
+        BARCODE_PWG,
+        BARCODE_ZPL
+    };
+
+    struct BarcodeOptions
+    {
+        BarcodeOptions() : type(BARCODE_QR), output(BARCODE_BITMAP), moduleSize(DEFAULT_MODULE_SIZE), barHeight(DEFAULT_BAR_HEIGHT),
+                           quietZone(-1), ecLevel(1), resolution(DEFAULT_BARCODE_RESOLUTION), x(0), y(0), label(true) {}
+
+        BarcodeType type;
+        BarcodeOutput output;
+        uint32_t moduleSize;
+        uint32_t barHeight;
+        /// in modules, -1 for the default of the type
+        int quietZone;
+        /// QR code error correction: 0 L, 1 M, 2 Q, 3 H
+        int ecLevel;
+        uint32_t resolution;
+        uint32_t x;
+        uint32_t y;
+        bool label;
+    };
+
+    /// Modules of a symbol, true is dark
+    struct Symbol
+    {
+        Symbol() : width(0), height(0) {}
+
+        void resize(uint32_t iWidth, uint32_t iHeight)
+        {
+            width = iWidth;
+            height = iHeight;
+            modules.assign(static_cast<size_t>(width) * height, 0);
+        }
+
+        uint8_t &at(uint32_t x, uint32_t y) { return modules[static_cast<size_t>(y) * width + x]; }
+        uint8_t at(uint32_t x, uint32_t y) const { return modules[static_cast<size_t>(y) * width + x]; }
+
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> modules;
+    };
+
+    struct BarcodeResult
+    {
+        uint32_t width;
+        uint32_t height;
+        std::string data;
+    };
+
+    /** Multiplication tables of GF(256) for a primitive polynomial.
+     * QR codes use 0x11d, DataMatrix 0x12d.
+     */
+    class GaloisField
+    {
+    public:
+        GaloisField(int polynomial)
+        {
+            int value = 1;
+            for (int i = 0; i < 255; ++i)
+            {
+                _exp[i] = static_cast<uint8_t>(value);
+                _log[value] = static_cast<uint8_t>(i);
+                value <<= 1;
+                if (value & 0x100)
+                {
+                    value ^= polynomial;
+                }
+            }
+            _log[0] = 0;
+        }
+
+        uint8_t multiply(uint8_t a, uint8_t b) const
+        {
+            return (a == 0 || b == 0) ? 0 : _exp[(_log[a] + _log[b]) % 255];
+        }
+
+        uint8_t exp(int power) const { return _exp[power % 255]; }
+
+        /** Reed-Solomon error correction codewords of data.
+         * @param firstRoot exponent of the first root of the generator polynomial: 0 for QR codes, 1 for DataMatrix
+         */
+        std::vector<uint8_t> encode(const uint8_t *data, size_t size, size_t eccSize, int firstRoot) const
+        {
+            // generator polynomial, highest degree first, leading 1 implied
+            std::vector<uint8_t> generator(eccSize, 0);
+            generator.back() = 1;
+            for (size_t i = 0; i < eccSize; ++i)
+            {
+                uint8_t root = exp(static_cast<int>(i) + firstRoot);
+                for (size_t j = 0; j < eccSize; ++j)
+                {
+                    generator[j] = multiply(generator[j], root);
+                    if (j + 1 < eccSize)
+                    {
+                        generator[j] ^= generator[j + 1];
+                    }
+                }
+            }
+            std::vector<uint8_t> remainder(eccSize, 0);
+            for (size_t i = 0; i < size; ++i)
+            {
+                uint8_t factor = data[i] ^ remainder[0];
+                remainder.erase(remainder.begin());
+                remainder.push_back(0);
+                for (size_t j = 0; j < eccSize; ++j)
+                {
+                    remainder[j] ^= multiply(generator[j], factor);
+                }
+            }
+            return remainder;
+        }
+
+    private:
+        uint8_t _exp[255];
+        uint8_t _log[256];
+    };
+
+    const GaloisField &getQrField()
+    {
+        static const GaloisField field(0x11d);
+        return field;
+    }
+
+    const GaloisField &getDataMatrixField()
+    {
+        static const GaloisField field(0x12d);
+        return field;
+    }
+
+    // Code 128
+
+    /// Bar and space widths of the symbols 0 to 105, then the stop pattern
+    const char *const CODE128_PATTERNS[107] = {
+        "212222", "222122", "222221", "121223", "121322", "131222", "122213", "122312", "132212", "221213",
+        "221312", "231212", "112232", "122132", "122231", "113222", "123122", "123221", "223211", "221132",
+        "221231", "213212", "223112", "312131", "311222", "321122", "321221", "312212", "322112", "322211",
+        "212123", "212321", "232121", "111323", "131123", "131321", "112313", "132113", "132311", "211313",
+        "231113", "231311", "112133", "112331", "132131", "113123", "113321", "133121", "313121", "211331",
+        "231131", "213113", "213311", "213131", "311123", "311321", "331121", "312113", "312311", "332111",
+        "314111", "221411", "431111", "111224", "111422", "121124", "121421", "141122", "141221", "112214",
+        "112412", "122114", "122411", "142112", "142211", "241211", "221114", "413111", "241112", "134111",
+        "111242", "121142", "121241", "114212", "124112", "124211", "411212", "421112", "421211", "212141",
+        "214121", "412121", "111143", "111341", "131141", "114113", "114311", "411113", "411311", "113141",
+        "114131", "311141", "411131", "211412", "211214", "211232", "2331112"};
+
+    const int CODE128_SHIFT = 98;
+    const int CODE128_CODE_C = 99;
+    const int CODE128_CODE_B = 100;
+    const int CODE128_CODE_A = 101;
+    const int CODE128_START_A = 103;
+    const int CODE128_START_B = 104;
+    const int CODE128_START_C = 105;
+    const int CODE128_STOP = 106;
+
+    size_t countDigits(const std::string &data, size_t position)
+    {
+        size_t end = position;
+        while (end < data.size() && data[end] >= '0' && data[end] <= '9')
+        {
+            ++end;
+        }
+        return end - position;
+    }
+
+    /// Value of c in code set A (true) or B
+    int getCode128Value(unsigned char c, bool setA)
+    {
+        if (setA)
+        {
+            return c < 32 ? c + 64 : c - 32;
+        }
+        return c - 32;
+    }
+
+    /** Symbol values of data, start and check symbols included, stop excluded.
+     * Runs of 4 digits or more at the ends, 6 in the middle, go to code set C;
+     * control characters use code set A, the others B.
+     */
+    std::string encodeCode128Values(const std::string &data, std::vector<int> &values)
+    {
+        for (unsigned char c : data)
+        {
+            if (c > 127)
+            {
+                return "Code 128 encodes ASCII characters only";
+            }
+        }
+        if (data.empty())
+        {
+            return "Empty Code 128 payload";
+        }
+        // set: 'A', 'B' or 'C'. An odd run of digits starts in B, then goes to C after its first digit
+        char set;
+        size_t digits = countDigits(data, 0);
+        if (digits % 2 == 0 && (digits >= 4 || (digits == 2 && data.size() == 2)))
+        {
+            set = 'C';
+        }
+        else
+        {
+            set = static_cast<unsigned char>(data[0]) < 32 ? 'A' : 'B';
+        }
+        values.push_back(set == 'A' ? CODE128_START_A : set == 'B' ? CODE128_START_B : CODE128_START_C);
+
+        size_t position = 0;
+        while (position < data.size())
+        {
+            if (set == 'C')
+            {
+                if (countDigits(data, position) >= 2)
+                {
+                    values.push_back((data[position] - '0') * 10 + (data[position + 1] - '0'));
+                    position += 2;
+                    continue;
+                }
+                set = static_cast<unsigned char>(data[position]) < 32 ? 'A' : 'B';
+                values.push_back(set == 'A' ? CODE128_CODE_A : CODE128_CODE_B);
+                continue;
+            }
+            digits = countDigits(data, position);
+            bool atEnd = position + digits == data.size();
+            if (digits >= 6 || (digits >= 4 && atEnd))
+            {
+                if (digits % 2 != 0)
+                {
+                    values.push_back(getCode128Value(data[position], set == 'A'));
+                    ++position;
+                }
+                set = 'C';
+                values.push_back(CODE128_CODE_C);
+                continue;
+            }
+            unsigned char c = data[position];
+            bool needsA = c < 32, needsB = c >= 96;
+            if ((set == 'B' && needsA) || (set == 'A' && needsB))
+            {
+                // one character of the other set, or a switch if the next one needs it too
+                unsigned char next = position + 1 < data.size() ? data[position + 1] : 32;
+                bool nextToo = set == 'B' ? next < 32 : next >= 96;
+                if (nextToo)
+                {
+                    set = set == 'B' ? 'A' : 'B';
+                    values.push_back(set == 'A' ? CODE128_CODE_A : CODE128_CODE_B);
+                }
+                else
+                {
+                    values.push_back(CODE128_SHIFT);
+                    values.push_back(getCode128Value(c, set == 'B'));
+                    ++position;
+                    continue;
+                }
+            }
+            values.push_back(getCode128Value(c, set == 'A'));
+            ++position;
+        }
+        int checksum = values[0];
+        for (size_t i = 1; i < values.size(); ++i)
+        {
+            checksum += static_cast<int>(i) * values[i];
+        }
+        values.push_back(checksum % 103);
+        return "";
+    }
+
+    /// One row of modules: a bar module is dark
+    std::string encodeCode128(const std::string &data, Symbol &symbol)
+    {
+        std::vector<int> values;
+        std::string error_str = encodeCode128Values(data, values);
+        if (!error_str.empty())
+        {
+            return error_str;
+        }
+        values.push_back(CODE128_STOP);
+        std::vector<uint8_t> row;
+        for (int value : values)
+        {
+            bool bar = true;
+            for (const char *width = CODE128_PATTERNS[value]; *width; ++width, bar = !bar)
+            {
+                row.insert(row.end(), *width - '0', bar ? 1 : 0);
+            }
+        }
+        symbol.resize(static_cast<uint32_t>(row.size()), 1);
+        symbol.modules = row;
+        return "";
+    }
+
+    // QR code
+
+    const int QR_MAX_VERSION = 40;
+
+    /// Error correction codewords per block, by level (L, M, Q, H) and version
+    const int8_t QR_ECC_CODEWORDS_PER_BLOCK[4][41] = {
+        {-1, 7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+        {-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+        {-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+        {-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30}};
+
+    /// Error correction blocks, by level and version
+    const int8_t QR_ECC_BLOCKS[4][41] = {
+        {-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 6, 6, 6, 6, 7, 8, 8, 9, 9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+        {-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5, 5, 8, 9, 9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+        {-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8, 8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+        {-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81}};
+
+    /// Format information bits of the levels L, M, Q, H
+    const int QR_LEVEL_BITS[4] = {1, 0, 3, 2};
+
+    const char *const QR_ALPHANUMERIC = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+    enum QrMode
+    {
+        QR_NUMERIC,
+        QR_ALPHANUMERIC_MODE,
+        QR_BYTE
+    };
+
+    /// Modules available for data and error correction in a version
+    int getQrRawModules(int version)
+    {
+        int result = (16 * version + 128) * version + 64;
+        if (version >= 2)
+        {
+            int alignments = version / 7 + 2;
+            result -= (25 * alignments - 10) * alignments - 55;
+            if (version >= 7)
+            {
+                result -= 36;
+            }
+        }
+        return result;
+    }
+
+    int getQrDataCodewords(int version, int level)
+    {
+        return getQrRawModules(version) / 8 - QR_ECC_CODEWORDS_PER_BLOCK[level][version] * QR_ECC_BLOCKS[level][version];
+    }
+
+    std::vector<int> getQrAlignmentPositions(int version)
+    {
+        std::vector<int> result;
+        if (version == 1)
+        {
+            return result;
+        }
+        int count = version / 7 + 2;
+        int step = version == 32 ? 26 : (version * 4 + count * 2 + 1) / (count * 2 - 2) * 2;
+        for (int i = 0, position = version * 4 + 17 - 7; i < count - 1; ++i, position -= step)
+        {
+            result.insert(result.begin(), position);
+        }
+        result.insert(result.begin(), 6);
+        return result;
+    }
+
+    int getQrCountBits(QrMode mode, int version)
+    {
+        int group = version <= 9 ? 0 : version <= 26 ? 1 : 2;
+        static const int bits[3][3] = {{10, 12, 14}, {9, 11, 13}, {8, 16, 16}};
+        return bits[mode][group];
+    }
+
+    class BitBuffer
+    {
+    public:
+        void append(uint32_t value, int bits)
+        {
+            for (int i = bits - 1; i >= 0; --i)
+            {
+                _bits.push_back((value >> i) & 1);
+            }
+        }
+
+        size_t size() const { return _bits.size(); }
+
+        std::vector<uint8_t> getBytes() const
+        {
+            std::vector<uint8_t> result((_bits.size() + 7) / 8, 0);
+            for (size_t i = 0; i < _bits.size(); ++i)
+            {
+                result[i >> 3] |= static_cast<uint8_t>(_bits[i] << (7 - (i & 7)));
+            }
+            return result;
+        }
+
+    private:
+        std::vector<uint8_t> _bits;
+    };
+
+    /// The most compact single mode encoding all of data
+    QrMode getQrMode(const std::string &data)
+    {
+        bool numeric = true, alphanumeric = true;
+        for (char c : data)
+        {
+            numeric = numeric && c >= '0' && c <= '9';
+            alphanumeric = alphanumeric && c != '\0' && strchr(QR_ALPHANUMERIC, c) != nullptr;
+        }
+        return numeric ? QR_NUMERIC : alphanumeric ? QR_ALPHANUMERIC_MODE : QR_BYTE;
+    }
+
+    void appendQrSegment(const std::string &data, QrMode mode, int version, BitBuffer &bits)
+    {
+        bits.append(mode == QR_NUMERIC ? 1 : mode == QR_ALPHANUMERIC_MODE ? 2 : 4, 4);
+        bits.append(static_cast<uint32_t>(data.size()), getQrCountBits(mode, version));
+        if (mode == QR_NUMERIC)
+        {
+            for (size_t i = 0; i < data.size(); i += 3)
+            {
+                size_t length = std::min<size_t>(3, data.size() - i);
+                bits.append(static_cast<uint32_t>(std::stoi(data.substr(i, length))), static_cast<int>(length * 3 + 1));
+            }
+        }
+        else if (mode == QR_ALPHANUMERIC_MODE)
+        {
+            for (size_t i = 0; i < data.size(); i += 2)
+            {
+                uint32_t value = static_cast<uint32_t>(strchr(QR_ALPHANUMERIC, data[i]) - QR_ALPHANUMERIC);
+                if (i + 1 < data.size())
+                {
+                    bits.append(value * 45 + static_cast<uint32_t>(strchr(QR_ALPHANUMERIC, data[i + 1]) - QR_ALPHANUMERIC), 11);
+                }
+                else
+                {
+                    bits.append(value, 6);
+                }
+            }
+        }
+        else
+        {
+            for (unsigned char c : data)
+            {
+                bits.append(c, 8);
+            }
+        }
+    }
+
+    /// Data codewords, then error correction codewords, interleaved by block
+    std::vector<uint8_t> getQrCodewords(const std::vector<uint8_t> &data, int version, int level)
+    {
+        const int blocks = QR_ECC_BLOCKS[level][version];
+        const int eccSize = QR_ECC_CODEWORDS_PER_BLOCK[level][version];
+        const int rawCodewords = getQrRawModules(version) / 8;
+        const int shortBlocks = blocks - rawCodewords % blocks;
+        const int shortBlockSize = rawCodewords / blocks;
+        std::vector<std::vector<uint8_t>> dataBlocks, eccBlocks;
+        size_t position = 0;
+        for (int i = 0; i < blocks; ++i)
+        {
+            size_t size = shortBlockSize - eccSize + (i < shortBlocks ? 0 : 1);
+            dataBlocks.push_back(std::vector<uint8_t>(data.begin() + position, data.begin() + position + size));
+            eccBlocks.push_back(getQrField().encode(&data[position], size, eccSize, 0));
+            position += size;
+        }
+        std::vector<uint8_t> result;
+        for (int i = 0; i <= shortBlockSize - eccSize; ++i)
+        {
+            for (int block = 0; block < blocks; ++block)
+            {
+                if (i < static_cast<int>(dataBlocks[block].size()))
+                {
+                    result.push_back(dataBlocks[block][i]);
+                }
+            }
+        }
+        for (int i = 0; i < eccSize; ++i)
+        {
+            for (int block = 0; block < blocks; ++block)
+            {
+                result.push_back(eccBlocks[block][i]);
+            }
+        }
+        return result;
+    }
+
+    bool getQrMask(int mask, int x, int y)
+    {
+        switch (mask)
+        {
+        case 0:
+            return (x + y) % 2 == 0;
+        case 1:
+            return y % 2 == 0;
+        case 2:
+            return x % 3 == 0;
+        case 3:
+            return (x + y) % 3 == 0;
+        case 4:
+            return (x / 3 + y / 2) % 2 == 0;
+        case 5:
+            return x * y % 2 + x * y % 3 == 0;
+        case 6:
+            return (x * y % 2 + x * y % 3) % 2 == 0;
+        default:
+            return ((x + y) % 2 + x * y % 3) % 2 == 0;
+        }
+    }
+
+    /// QR code under construction: modules and which of them are function patterns
+    class QrMatrix
+    {
+    public:
+        QrMatrix(int version) : _version(version), _size(version * 4 + 17)
+        {
+            _symbol.resize(_size, _size);
+            _function.assign(static_cast<size_t>(_size) * _size, 0);
+            drawFunctionPatterns();
+        }
+
+        void drawCodewords(const std::vector<uint8_t> &codewords)
+        {
+            size_t bit = 0;
+            // pairs of columns right to left, upwards then downwards, skipping the vertical timing pattern
+            for (int right = _size - 1; right >= 1; right -= 2)
+            {
+                if (right == 6)
+                {
+                    right = 5;
+                }
+                for (int step = 0; step < _size; ++step)
+                {
+                    for (int j = 0; j < 2; ++j)
+                    {
+                        int x = right - j;
+                        bool upward = ((right + 1) & 2) == 0;
+                        int y = upward ? _size - 1 - step : step;
+                        if (!isFunction(x, y) && bit < codewords.size() * 8)
+                        {
+                            _symbol.at(x, y) = (codewords[bit >> 3] >> (7 - (bit & 7))) & 1;
+                            ++bit;
+                        }
+                    }
+                }
+            }
+        }
+
+        void applyMask(int mask)
+        {
+            for (int y = 0; y < _size; ++y)
+            {
+                for (int x = 0; x < _size; ++x)
+                {
+                    if (!isFunction(x, y) && getQrMask(mask, x, y))
+                    {
+                        _symbol.at(x, y) ^= 1;
+                    }
+                }
+            }
+        }
+
+        void drawFormatBits(int level, int mask)
+        {
+            int data = QR_LEVEL_BITS[level] << 3 | mask;
+            int remainder = data;
+            for (int i = 0; i < 10; ++i)
+            {
+                remainder = (remainder << 1) ^ ((remainder >> 9) * 0x537);
+            }
+            int bits = (data << 10 | remainder) ^ 0x5412;
+            // around the top left finder
+            for (int i = 0; i <= 5; ++i)
+            {
+                setFunction(8, i, getBit(bits, i));
+            }
+            setFunction(8, 7, getBit(bits, 6));
+            setFunction(8, 8, getBit(bits, 7));
+            setFunction(7, 8, getBit(bits, 8));
+            for (int i = 9; i < 15; ++i)
+            {
+                setFunction(14 - i, 8, getBit(bits, i));
+            }
+            // copy along the other finders
+            for (int i = 0; i < 8; ++i)
+            {
+                setFunction(_size - 1 - i, 8, getBit(bits, i));
+            }
+            for (int i = 8; i < 15; ++i)
+            {
+                setFunction(8, _size - 15 + i, getBit(bits, i));
+            }
+            setFunction(8, _size - 8, true);
+        }
+
+        /** Penalty of the masked symbol: runs of 5 or more modules, 2x2 blocks,
+         * finder-like 1:1:3:1:1 patterns next to 4 light modules, and dark modules away from half.
+         */
+        long getPenalty() const
+        {
+            long result = 0;
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (int i = 0; i < _size; ++i)
+                {
+                    int run = 0;
+                    bool previous = false;
+                    uint32_t history = 0;
+                    for (int j = 0; j < _size; ++j)
+                    {
+                        bool dark = pass == 0 ? _symbol.at(j, i) != 0 : _symbol.at(i, j) != 0;
+                        if (j > 0 && dark == previous)
+                        {
+                            ++run;
+                            if (run == 5)
+                            {
+                                result += 3;
+                            }
+                            else if (run > 5)
+                            {
+                                ++result;
+                            }
+                        }
+                        else
+                        {
+                            run = 1;
+                            previous = dark;
+                        }
+                        // last 11 modules, light outside the symbol
+                        history = ((history << 1) | (dark ? 1 : 0)) & 0x7ff;
+                        if (j >= 10 && (history == 0x05d || history == 0x5d0))
+                        {
+                            result += 40;
+                        }
+                    }
+                }
+            }
+            int dark = 0;
+            for (int y = 0; y < _size; ++y)
+            {
+                for (int x = 0; x < _size; ++x)
+                {
+                    dark += _symbol.at(x, y);
+                    if (x + 1 < _size && y + 1 < _size)
+                    {
+                        int sum = _symbol.at(x, y) + _symbol.at(x + 1, y) + _symbol.at(x, y + 1) + _symbol.at(x + 1, y + 1);
+                        if (sum == 0 || sum == 4)
+                        {
+                            result += 3;
+                        }
+                    }
+                }
+            }
+            int total = _size * _size;
+            // 10 per 5% away from half dark
+            result += 10 * ((std::abs(dark * 20 - total * 10) + total - 1) / total - 1);
+            return result;
+        }
+
+        const Symbol &getSymbol() const { return _symbol; }
+
+    private:
+        int _version;
+        int _size;
+        Symbol _symbol;
+        std::vector<uint8_t> _function;
+
+        static bool getBit(int value, int bit) { return ((value >> bit) & 1) != 0; }
+
+        bool isFunction(int x, int y) const { return _function[static_cast<size_t>(y) * _size + x] != 0; }
+
+        void setFunction(int x, int y, bool dark)
+        {
+            _symbol.at(x, y) = dark ? 1 : 0;
+            _function[static_cast<size_t>(y) * _size + x] = 1;
+        }
+
+        void drawFinder(int cx, int cy)
+        {
+            for (int dy = -4; dy <= 4; ++dy)
+            {
+                for (int dx = -4; dx <= 4; ++dx)
+                {
+                    int x = cx + dx, y = cy + dy;
+                    if (x >= 0 && x < _size && y >= 0 && y < _size)
+                    {
+                        int distance = std::max(std::abs(dx), std::abs(dy));
+                        setFunction(x, y, distance != 2 && distance != 4);
+                    }
+                }
+            }
+        }
+
+        void drawFunctionPatterns()
+        {
+            for (int i = 0; i < _size; ++i)
+            {
+                setFunction(6, i, i % 2 == 0);
+                setFunction(i, 6, i % 2 == 0);
+            }
+            drawFinder(3, 3);
+            drawFinder(_size - 4, 3);
+            drawFinder(3, _size - 4);
+            std::vector<int> positions = getQrAlignmentPositions(_version);
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                for (size_t j = 0; j < positions.size(); ++j)
+                {
+                    // not over the finders
+                    if ((i == 0 && j == 0) || (i == 0 && j == positions.size() - 1) || (i == positions.size() - 1 && j == 0))
+                    {
+                        continue;
+                    }
+                    for (int dy = -2; dy <= 2; ++dy)
+                    {
+                        for (int dx = -2; dx <= 2; ++dx)
+                        {
+                            setFunction(positions[i] + dx, positions[j] + dy, std::max(std::abs(dx), std::abs(dy)) != 1);
+                        }
+                    }
+                }
+            }
+            // reserved until the mask is known
+            drawFormatBits(0, 0);
+            if (_version >= 7)
+            {
+                int remainder = _version;
+                for (int i = 0; i < 12; ++i)
+                {
+                    remainder = (remainder << 1) ^ ((remainder >> 11) * 0x1f25);
+                }
+                int bits = _version << 12 | remainder;
+                for (int i = 0; i < 18; ++i)
+                {
+                    int a = _size - 11 + i % 3, b = i / 3;
+                    setFunction(a, b, getBit(bits, i));
+                    setFunction(b, a, getBit(bits, i));
+                }
+            }
+        }
+    };
+
+    /** QR code of data in its most compact single mode, smallest version for the level.
+     * @param mask 0 to 7, or -1 for the mask of lowest penalty
+     */
+    std::string encodeQr(const std::string &data, int level, int mask, Symbol &symbol)
+    {
+        QrMode mode = getQrMode(data);
+        int version = 1;
+        BitBuffer bits;
+        for (;; ++version)
+        {
+            if (version > QR_MAX_VERSION)
+            {
+                return "Payload too long for a QR code";
+            }
+            bits = BitBuffer();
+            appendQrSegment(data, mode, version, bits);
+            if (data.size() < (1u << getQrCountBits(mode, version)) && bits.size() <= static_cast<size_t>(getQrDataCodewords(version, level)) * 8)
+            {
+                break;
+            }
+        }
+        size_t capacity = static_cast<size_t>(getQrDataCodewords(version, level)) * 8;
+        bits.append(0, static_cast<int>(std::min<size_t>(4, capacity - bits.size())));
+        bits.append(0, static_cast<int>((8 - bits.size() % 8) % 8));
+        for (uint32_t pad = 0xec; bits.size() < capacity; pad ^= 0xec ^ 0x11)
+        {
+            bits.append(pad, 8);
+        }
+
+        QrMatrix matrix(version);
+        matrix.drawCodewords(getQrCodewords(bits.getBytes(), version, level));
+        if (mask < 0)
+        {
+            long best = 0;
+            for (int candidate = 0; candidate < 8; ++candidate)
+            {
+                matrix.applyMask(candidate);
+                matrix.drawFormatBits(level, candidate);
+                long penalty = matrix.getPenalty();
+                if (mask < 0 || penalty < best)
+                {
+                    mask = candidate;
+                    best = penalty;
+                }
+                // masks are their own inverse
+                matrix.applyMask(candidate);
+            }
+        }
+        matrix.applyMask(mask);
+        matrix.drawFormatBits(level, mask);
+        symbol = matrix.getSymbol();
+        return "";
+    }
+
+    // DataMatrix ECC 200
+
+    struct DataMatrixSize
+    {
+        int size;
+        /// data regions per side
+        int regions;
+        int dataCodewords;
+        int eccCodewords;
+        int blocks;
+    };
+
+    /// Square symbols
+    const DataMatrixSize DATAMATRIX_SIZES[] = {
+        {10, 1, 3, 5, 1}, {12, 1, 5, 7, 1}, {14, 1, 8, 10, 1}, {16, 1, 12, 12, 1}, {18, 1, 18, 14, 1}, {20, 1, 22, 18, 1}, {22, 1, 30, 20, 1}, {24, 1, 36, 24, 1}, {26, 1, 44, 28, 1}, {32, 2, 62, 36, 1}, {36, 2, 86, 42, 1}, {40, 2, 114, 48, 1}, {44, 2, 144, 56, 1}, {48, 2, 174, 68, 1}, {52, 2, 204, 84, 2}, {64, 4, 280, 112, 2}, {72, 4, 368, 144, 4}, {80, 4, 456, 192, 4}, {88, 4, 576, 224, 4}, {96, 4, 696, 272, 4}, {104, 4, 816, 336, 6}, {120, 6, 1050, 408, 6}, {132, 6, 1304, 496, 8}, {144, 6, 1558, 620, 10}};
+
+    /// ASCII encodation: digit pairs in one codeword, characters above 127 after an upper shift
+    std::vector<uint8_t> encodeDataMatrixAscii(const std::string &data)
+    {
+        std::vector<uint8_t> result;
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            unsigned char c = data[i];
+            if (countDigits(data, i) >= 2)
+            {
+                result.push_back(static_cast<uint8_t>(130 + (c - '0') * 10 + (data[i + 1] - '0')));
+                ++i;
+            }
+            else if (c > 127)
+            {
+                result.push_back(235);
+                result.push_back(static_cast<uint8_t>(c - 127));
+            }
+            else
+            {
+                result.push_back(static_cast<uint8_t>(c + 1));
+            }
+        }
+        return result;
+    }
+
+    /// Module placement of ECC 200 (ISO/IEC 16022 annex F): codeword * 8 + bit, bit 0 the most significant
+    class DataMatrixPlacement
+    {
+    public:
+        DataMatrixPlacement(int rows, int columns) : _rows(rows), _columns(columns), _modules(static_cast<size_t>(rows) * columns, -1)
+        {
+            int codeword = 0, row = 4, column = 0;
+            do
+            {
+                if (row == _rows && column == 0)
+                {
+                    corner1(codeword++);
+                }
+                if (row == _rows - 2 && column == 0 && _columns % 4 != 0)
+                {
+                    corner2(codeword++);
+                }
+                if (row == _rows - 2 && column == 0 && _columns % 8 == 4)
+                {
+                    corner3(codeword++);
+                }
+                if (row == _rows + 4 && column == 2 && _columns % 8 == 0)
+                {
+                    corner4(codeword++);
+                }
+                // upward diagonal
+                do
+                {
+                    if (row < _rows && column >= 0 && get(row, column) < 0)
+                    {
+                        utah(row, column, codeword++);
+                    }
+                    row -= 2;
+                    column += 2;
+                } while (row >= 0 && column < _columns);
+                row += 1;
+                column += 3;
+                // downward diagonal
+                do
+                {
+                    if (row >= 0 && column < _columns && get(row, column) < 0)
+                    {
+                        utah(row, column, codeword++);
+                    }
+                    row += 2;
+                    column -= 2;
+                } while (row < _rows && column >= 0);
+                row += 3;
+                column += 1;
+            } while (row < _rows || column < _columns);
+        }
+
+        /// codeword * 8 + bit of a module, -1 for the fixed pattern of the bottom right corner
+        int get(int row, int column) const { return _modules[static_cast<size_t>(row) * _columns + column]; }
+
+    private:
+        int _rows;
+        int _columns;
+        std::vector<int> _modules;
+
+        void module(int row, int column, int codeword, int bit)
+        {
+            if (row < 0)
+            {
+                row += _rows;
+                column += 4 - ((_rows + 4) % 8);
+            }
+            if (column < 0)
+            {
+                column += _columns;
+                row += 4 - ((_columns + 4) % 8);
+            }
+            _modules[static_cast<size_t>(row) * _columns + column] = codeword * 8 + bit;
+        }
+
+        void utah(int row, int column, int codeword)
+        {
+            module(row - 2, column - 2, codeword, 0);
+            module(row - 2, column - 1, codeword, 1);
+            module(row - 1, column - 2, codeword, 2);
+            module(row - 1, column - 1, codeword, 3);
+            module(row - 1, column, codeword, 4);
+            module(row, column - 2, codeword, 5);
+            module(row, column - 1, codeword, 6);
+            module(row, column, codeword, 7);
+        }
+
+        void corner1(int codeword)
+        {
+            module(_rows - 1, 0, codeword, 0);
+            module(_rows - 1, 1, codeword, 1);
+            module(_rows - 1, 2, codeword, 2);
+            module(0, _columns - 2, codeword, 3);
+            module(0, _columns - 1, codeword, 4);
+            module(1, _columns - 1, codeword, 5);
+            module(2, _columns - 1, codeword, 6);
+            module(3, _columns - 1, codeword, 7);
+        }
+
+        void corner2(int codeword)
+        {
+            module(_rows - 3, 0, codeword, 0);
+            module(_rows - 2, 0, codeword, 1);
+            module(_rows - 1, 0, codeword, 2);
+            module(0, _columns - 4, codeword, 3);
+            module(0, _columns - 3, codeword, 4);
+            module(0, _columns - 2, codeword, 5);
+            module(0, _columns - 1, codeword, 6);
+            module(1, _columns - 1, codeword, 7);
+        }
+
+        void corner3(int codeword)
+        {
+            module(_rows - 3, 0, codeword, 0);
+            module(_rows - 2, 0, codeword, 1);
+            module(_rows - 1, 0, codeword, 2);
+            module(0, _columns - 2, codeword, 3);
+            module(0, _columns - 1, codeword, 4);
+            module(1, _columns - 1, codeword, 5);
+            module(2, _columns - 1, codeword, 6);
+            module(3, _columns - 1, codeword, 7);
+        }
+
+        void corner4(int codeword)
+        {
+            module(_rows - 1, 0, codeword, 0);
+            module(_rows - 1, _columns - 1, codeword, 1);
+            module(0, _columns - 3, codeword, 2);
+            module(0, _columns - 2, codeword, 3);
+            module(0, _columns - 1, codeword, 4);
+            module(1, _columns - 3, codeword, 5);
+            module(1, _columns - 2, codeword, 6);
+            module(1, _columns - 1, codeword, 7);
+        }
+    };
+
+    /// Smallest square ECC 200 symbol of data in ASCII encodation
+    std::string encodeDataMatrix(const std::string &data, Symbol &symbol)
+    {
+        std::vector<uint8_t> codewords = encodeDataMatrixAscii(data);
+        const DataMatrixSize *format = nullptr;
+        for (const DataMatrixSize &candidate : DATAMATRIX_SIZES)
+        {
+            if (static_cast<int>(codewords.size()) <= candidate.dataCodewords)
+            {
+                format = &candidate;
+                break;
+            }
+        }
+        if (format == nullptr)
+        {
+            return "Payload too long for a DataMatrix";
+        }
+        // first pad 129, then pseudo-random pads (253-state algorithm)
+        if (static_cast<int>(codewords.size()) < format->dataCodewords)
+        {
+            codewords.push_back(129);
+        }
+        while (static_cast<int>(codewords.size()) < format->dataCodewords)
+        {
+            int position = static_cast<int>(codewords.size()) + 1;
+            int pad = 129 + (149 * position) % 253 + 1;
+            codewords.push_back(static_cast<uint8_t>(pad > 254 ? pad - 254 : pad));
+        }
+        // blocks interleaved codeword by codeword
+        const int blocks = format->blocks, eccPerBlock = format->eccCodewords / blocks;
+        codewords.resize(format->dataCodewords + format->eccCodewords);
+        for (int block = 0; block < blocks; ++block)
+        {
+            std::vector<uint8_t> blockData;
+            for (int i = block; i < format->dataCodewords; i += blocks)
+            {
+                blockData.push_back(codewords[i]);
+            }
+            std::vector<uint8_t> ecc = getDataMatrixField().encode(blockData.data(), blockData.size(), eccPerBlock, 1);
+            for (int i = 0; i < eccPerBlock; ++i)
+            {
+                codewords[format->dataCodewords + block + i * blocks] = ecc[i];
+            }
+        }
+
+        const int regionSize = (format->size - 2 * format->regions) / format->regions;
+        const int mappingSize = regionSize * format->regions;
+        DataMatrixPlacement placement(mappingSize, mappingSize);
+        symbol.resize(format->size, format->size);
+        for (int y = 0; y < format->size; ++y)
+        {
+            for (int x = 0; x < format->size; ++x)
+            {
+                int inY = y % (regionSize + 2), inX = x % (regionSize + 2);
+                bool dark;
+                if (inX == 0 || inY == regionSize + 1)
+                {
+                    // solid L of the finder
+                    dark = true;
+                }
+                else if (inY == 0)
+                {
+                    dark = inX % 2 == 0;
+                }
+                else if (inX == regionSize + 1)
+                {
+                    dark = inY % 2 == 1;
+                }
+                else
+                {
+                    int row = (y / (regionSize + 2)) * regionSize + inY - 1;
+                    int column = (x / (regionSize + 2)) * regionSize + inX - 1;
+                    int bit = placement.get(row, column);
+                    if (bit < 0)
+                    {
+                        // unused corner: checkerboard
+                        dark = (row == mappingSize - 1 && column == mappingSize - 1) || (row == mappingSize - 2 && column == mappingSize - 2);
+                    }
+                    else
+                    {
+                        dark = ((codewords[bit / 8] >> (7 - bit % 8)) & 1) != 0;
+                    }
+                }
+                symbol.at(x, y) = dark ? 1 : 0;
+            }
+        }
+        return "";
+    }
+
+    // rendering
+
+    /** Gray pixels of the symbol scaled to the module size, with its quiet zone
+     * @returns error string, empty on success
+     */
+    std::string renderSymbol(const Symbol &symbol, const BarcodeOptions &options, uint32_t &width, uint32_t &height, std::string &pixels)
+    {
+        uint32_t quietZone = options.quietZone >= 0 ? static_cast<uint32_t>(options.quietZone) : options.type == BARCODE_CODE128 ? CODE128_QUIET_ZONE
+                                                                                              : options.type == BARCODE_QR        ? QR_QUIET_ZONE
+                                                                                                                                  : DATAMATRIX_QUIET_ZONE;
+        const uint32_t margin = quietZone * options.moduleSize;
+        // 1D codes: bars of barHeight dots, quiet zone on the sides only
+        bool linear = symbol.height == 1;
+        uint64_t fullWidth = static_cast<uint64_t>(symbol.width) * options.moduleSize + 2 * margin;
+        uint64_t fullHeight = linear ? options.barHeight : static_cast<uint64_t>(symbol.height) * options.moduleSize + 2 * margin;
+        if (fullWidth > MAX_BARCODE_SIZE || fullHeight > MAX_BARCODE_SIZE)
+        {
+            return "Barcode of " + std::to_string(fullWidth) + "x" + std::to_string(fullHeight) + " dots larger than " +
+                   std::to_string(MAX_BARCODE_SIZE) + ", use a smaller moduleSize";
+        }
+        width = static_cast<uint32_t>(fullWidth);
+        height = static_cast<uint32_t>(fullHeight);
+        pixels.assign(static_cast<size_t>(width) * height, static_cast<char>(255));
+        std::string row(width, static_cast<char>(255));
+        for (uint32_t y = 0; y < symbol.height; ++y)
+        {
+            for (uint32_t x = 0; x < symbol.width; ++x)
+            {
+                if (symbol.at(x, y))
+                {
+                    memset(&row[margin + x * options.moduleSize], 0, options.moduleSize);
+                }
+                else
+                {
+                    memset(&row[margin + x * options.moduleSize], 255, options.moduleSize);
+                }
+            }
+            uint32_t first = linear ? 0 : margin + y * options.moduleSize;
+            uint32_t rows = linear ? height : options.moduleSize;
+            for (uint32_t i = 0; i < rows; ++i)
+            {
+                memcpy(&pixels[static_cast<size_t>(first + i) * width], row.data(), width);
+            }
+        }
+        return "";
+    }
+
+    std::string encodeBarcode(const std::string &payload, const BarcodeOptions &options, AbortState &state, BarcodeResult &result)
+    {
+        Symbol symbol;
+        std::string error_str;
+        switch (options.type)
+        {
+        case BARCODE_CODE128:
+            error_str = encodeCode128(payload, symbol);
+            break;
+        case BARCODE_QR:
+            error_str = encodeQr(payload, options.ecLevel, -1, symbol);
+            break;
+        default:
+            error_str = encodeDataMatrix(payload, symbol);
+            break;
+        }
+        if (!error_str.empty())
+        {
+            return error_str;
+        }
+        std::string pixels;
+        error_str = renderSymbol(symbol, options, result.width, result.height, pixels);
+        if (!error_str.empty())
+        {
+            return error_str;
+        }
+        const uint8_t *gray = reinterpret_cast<const uint8_t *>(pixels.data());
+        switch (options.output)
+        {
+        case BARCODE_PWG:
+            return encodePwgBitmap(gray, result.width, result.height, options.resolution, state, result.data);
+        case BARCODE_ZPL:
+            result.data = encodeZplBitmap(gray, result.width, result.height, options.x, options.y, options.label);
+            break;
+        default:
+            result.data.swap(pixels);
+            break;
+        }
+        return "";
+    }
+
+    /** Read the options of encodeBarcodes.
+     * @returns error string, empty on success
+     */
+    std::string parseBarcodeOptions(const Napi::Object &object, BarcodeOptions &options)
+    {
+        std::string type = object.Get("type").IsString() ? object.Get("type").As<Napi::String>().Utf8Value() : "";
+        if (type == "code128")
+        {
+            options.type = BARCODE_CODE128;
+        }
+        else if (type == "qr")
+        {
+            options.type = BARCODE_QR;
+        }
+        else if (type == "datamatrix")
+        {
+            options.type = BARCODE_DATAMATRIX;
+        }
+        else
+        {
+            return "type must be code128, qr or datamatrix";
+        }
+        if (object.Get("output").IsString())
+        {
+            std::string output = object.Get("output").As<Napi::String>().Utf8Value();
+            if (output == "pwg")
+            {
+                options.output = BARCODE_PWG;
+            }
+            else if (output == "zpl")
+            {
+                options.output = BARCODE_ZPL;
+            }
+            else if (output != "bitmap")
+            {
+                return "output must be bitmap, pwg or zpl";
+            }
+        }
+        if (object.Get("moduleSize").IsNumber())
+        {
+            options.moduleSize = object.Get("moduleSize").As<Napi::Number>().Uint32Value();
+            if (options.moduleSize == 0 || options.moduleSize > 100)
+            {
+                return "moduleSize must be from 1 to 100 dots";
+            }
+        }
+        if (object.Get("height").IsNumber())
+        {
+            options.barHeight = std::max(1u, std::min(10000u, object.Get("height").As<Napi::Number>().Uint32Value()));
+        }
+        if (object.Get("quietZone").IsNumber())
+        {
+            options.quietZone = static_cast<int>(std::min(100u, object.Get("quietZone").As<Napi::Number>().Uint32Value()));
+        }
+        if (object.Get("ecLevel").IsString())
+        {
+            std::string level = object.Get("ecLevel").As<Napi::String>().Utf8Value();
+            const char *const levels = "LMQH";
+            if (level.size() != 1 || strchr(levels, level[0]) == nullptr || level[0] == '\0')
+            {
+                return "ecLevel must be L, M, Q or H";
+            }
+            options.ecLevel = static_cast<int>(strchr(levels, level[0]) - levels);
+        }
+        if (object.Get("resolution").IsNumber())
+        {
+            options.resolution = std::max(1u, object.Get("resolution").As<Napi::Number>().Uint32Value());
+        }
+        if (object.Get("x").IsNumber())
+        {
+            options.x = object.Get("x").As<Napi::Number>().Uint32Value();
+        }
+        if (object.Get("y").IsNumber())
+        {
+            options.y = object.Get("y").As<Napi::Number>().Uint32Value();
+        }
+        if (object.Get("label").IsBoolean())
+        {
+            options.label = object.Get("label").As<Napi::Boolean>().Value();
+        }
+        return "";
+    }
+}
+
+MY_NODE_MODULE_CALLBACK(encodeBarcodes)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_OBJECT(info, 1, optionsArg);
+    if (!info[0].IsArray())
+    {
+        RETURN_EXCEPTION_STR("Argument 0 must be an Array of payloads");
+    }
+    BarcodeOptions options;
+    std::string error_str = parseBarcodeOptions(optionsArg, options);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    Napi::Array payloadsArg = info[0].As<Napi::Array>();
+    std::shared_ptr<std::vector<std::string>> payloads = std::make_shared<std::vector<std::string>>(payloadsArg.Length());
+    for (uint32_t i = 0; i < payloadsArg.Length(); ++i)
+    {
+        if (!getStringOrBufferFromNapiValue(payloadsArg.Get(i), (*payloads)[i]))
+        {
+            RETURN_EXCEPTION_STR("Payload " + std::to_string(i) + " must be a string or a Buffer");
+        }
+    }
+
+    FunctionTask<std::vector<BarcodeResult>> *task = new FunctionTask<std::vector<BarcodeResult>>(
+        env, [payloads, options](std::vector<BarcodeResult> &results, AbortState &state)
+        {
+            results.resize(payloads->size());
+            for (size_t i = 0; i < payloads->size(); ++i)
+            {
+                if (state.shouldStop())
+                {
+                    return std::string("Barcode encoding stopped");
+                }
+                std::string error_str = encodeBarcode((*payloads)[i], options, state, results[i]);
+                if (!error_str.empty())
+                {
+                    return "Payload " + std::to_string(i) + ": " + error_str;
+                }
+            }
+            return std::string(); },
+        [](Napi::Env env, const std::vector<BarcodeResult> &results)
+        {
+            Napi::Array array = Napi::Array::New(env, results.size());
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                Napi::Object result = Napi::Object::New(env);
+                result.Set("width", Napi::Number::New(env, results[i].width));
+                result.Set("height", Napi::Number::New(env, results[i].height));
+                result.Set("data", Napi::Buffer<char>::Copy(env, results[i].data.data(), results[i].data.size()));
+                array.Set(static_cast<uint32_t>(i), result);
+            }
+            return array; });
+    task->bindAbortHandle(info[2]);
+    return task->queue();
+}
@@ -0,0 +1,16 @@
+#include "node_printer.hpp"
+#include "node_printer_env.hpp"
+
+ModuleData::ModuleData() : _tasks(std::make_shared<TaskRegistry>())
+{
+}
+
+ModuleData::~ModuleData()
+{
+    _tasks->close();
+}
+
+ModuleData &ModuleData::get(Napi::Env env)
+{
+    return *env.GetInstanceData<ModuleData>();
+}
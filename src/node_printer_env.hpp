@@ -0,0 +1,49 @@
+#ifndef NODE_PRINTER_ENV_HPP
+#define NODE_PRINTER_ENV_HPP
+
+#include "node_printer_pool.hpp"
+
+#include <napi.h>
+
+#include <memory>
+
+/// Print backends of an environment, see node_printer_backend.hpp (posix only)
+struct BackendState;
+
+/** State of the module in one environment: the main thread or a worker thread.
+ * Set as instance data when the module is loaded and deleted when the environment
+ * is torn down. What stays process wide is shared on purpose: the thread pool and the
+ * statistics of getStats cover every call of the process, a circuit breaker follows the
+ * health of one print server whoever calls it, and socket:// connections and the kept
+ * connections of pool threads belong to the threads, not to the environments.
+ */
+class ModuleData
+{
+public:
+    ModuleData();
+
+    /// Aborts the tasks still running for the environment
+    ~ModuleData();
+
+    static ModuleData &get(Napi::Env env);
+
+    /// Constructor of the objects returned by openPrinter
+    Napi::FunctionReference printerClass;
+
+    /// Constructor of the objects returned by compileLabelTemplate
+    Napi::FunctionReference labelTemplateClass;
+
+    /// Constructor of the objects returned by openSpool
+    Napi::FunctionReference spoolClass;
+
+    /// Tasks queued by the environment and not completed yet
+    const std::shared_ptr<TaskRegistry> &getTasks() const { return _tasks; }
+
+    /// Backend of setBackend, print servers and job tracker of the environment, created on first use
+    std::shared_ptr<BackendState> backends;
+
+private:
+    std::shared_ptr<TaskRegistry> _tasks;
+};
+
+#endif
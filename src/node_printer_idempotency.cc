@@ -0,0 +1,450 @@
+#include "node_printer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /// Default time a job id is remembered for, in milliseconds
+    const int64_t DEFAULT_IDEMPOTENCY_WINDOW = 10 * 60 * 1000;
+
+    /// Default number of job ids remembered
+    const size_t DEFAULT_IDEMPOTENCY_ENTRIES = 10000;
+
+    /** Streaming XXH64.
+     * Scalar: the four independent lanes already keep a superscalar core busy
+     * at several GB/s, well above what the print server takes.
+     */
+    class Xxh64
+    {
+    public:
+        explicit Xxh64(uint64_t seed = 0) : _total(0), _buffered(0)
+        {
+            _v[0] = seed + P1 + P2;
+            _v[1] = seed + P2;
+            _v[2] = seed;
+            _v[3] = seed - P1;
+            _seed = seed;
+        }
+
+        void update(const char *data, size_t length)
+        {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+            const unsigned char *end = p + length;
+            _total += length;
+            if (_buffered + length < sizeof(_buffer))
+            {
+                memcpy(_buffer + _buffered, p, length);
+                _buffered += length;
+                return;
+            }
+            if (_buffered > 0)
+            {
+                size_t fill = sizeof(_buffer) - _buffered;
+                memcpy(_buffer + _buffered, p, fill);
+                consume(_buffer);
+                p += fill;
+                _buffered = 0;
+            }
+            for (; p + sizeof(_buffer) <= end; p += sizeof(_buffer))
+            {
+                consume(p);
+            }
+            _buffered = static_cast<size_t>(end - p);
+            memcpy(_buffer, p, _buffered);
+        }
+
+        void update(const std::string &data) { update(data.data(), data.size()); }
+
+        uint64_t digest() const
+        {
+            uint64_t h;
+            if (_total >= sizeof(_buffer))
+            {
+                h = rotl(_v[0], 1) + rotl(_v[1], 7) + rotl(_v[2], 12) + rotl(_v[3], 18);
+                for (int i = 0; i < 4; ++i)
+                {
+                    h = (h ^ round(0, _v[i])) * P1 + P4;
+                }
+            }
+            else
+            {
+                h = _seed + P5;
+            }
+            h += _total;
+            const unsigned char *p = _buffer;
+            const unsigned char *end = _buffer + _buffered;
+            for (; p + 8 <= end; p += 8)
+            {
+                h ^= round(0, read64(p));
+                h = rotl(h, 27) * P1 + P4;
+            }
+            if (p + 4 <= end)
+            {
+                h ^= static_cast<uint64_t>(read32(p)) * P1;
+                h = rotl(h, 23) * P2 + P3;
+                p += 4;
+            }
+            for (; p < end; ++p)
+            {
+                h ^= *p * P5;
+                h = rotl(h, 11) * P1;
+            }
+            h ^= h >> 33;
+            h *= P2;
+            h ^= h >> 29;
+            h *= P3;
+            h ^= h >> 32;
+            return h;
+        }
+
+    private:
+        static const uint64_t P1 = 11400714785074694791ULL;
+        static const uint64_t P2 = 14029467366897019727ULL;
+        static const uint64_t P3 = 1609587929392839161ULL;
+        static const uint64_t P4 = 9650029242287828579ULL;
+        static const uint64_t P5 = 2870177450012600261ULL;
+
+        uint64_t _v[4];
+        uint64_t _seed;
+        uint64_t _total;
+        unsigned char _buffer[32];
+        size_t _buffered;
+
+        static uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+        static uint64_t round(uint64_t acc, uint64_t input)
+        {
+            acc += input * P2;
+            return rotl(acc, 31) * P1;
+        }
+
+        /// Little endian read: the byte order of every platform the module builds on
+        static uint64_t read64(const unsigned char *p)
+        {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static uint32_t read32(const unsigned char *p)
+        {
+            uint32_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        void consume(const unsigned char *p)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                _v[i] = round(_v[i], read64(p + 8 * i));
+            }
+        }
+    };
+
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /// Entry of the on-disk log
+    struct IdempotencyRecord
+    {
+        uint64_t key;
+        int64_t time;
+        int32_t jobId;
+        /// low bits of the XXH64 of the fields above: a torn record is skipped
+        uint32_t check;
+    };
+
+    uint32_t getRecordCheck(const IdempotencyRecord &record)
+    {
+        Xxh64 hash;
+        hash.update(reinterpret_cast<const char *>(&record), offsetof(IdempotencyRecord, check));
+        return static_cast<uint32_t>(hash.digest());
+    }
+
+    /** Job ids of the submissions made within the window, by key hash, process wide.
+     * Bounded in time and count; optionally mirrored to an append-only log file, which is
+     * reloaded when set and rewritten with the live entries once it doubles their count.
+     */
+    class IdempotencyIndex
+    {
+    public:
+        IdempotencyIndex() : _window(DEFAULT_IDEMPOTENCY_WINDOW), _maxEntries(DEFAULT_IDEMPOTENCY_ENTRIES), _file(nullptr), _logged(0) {}
+
+        /// @return error string
+        std::string configure(int64_t window, size_t maxEntries, const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _window = window;
+            _maxEntries = std::max<size_t>(maxEntries, 1);
+            closeFile();
+            _path = path;
+            if (!_path.empty())
+            {
+                load();
+                if (!rewrite())
+                {
+                    _path.clear();
+                    return "Unable to write the idempotency index " + path;
+                }
+            }
+            evict(nowMs());
+            return "";
+        }
+
+        /// @return job id of key, 0 if none within the window
+        int find(uint64_t key)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            evict(nowMs());
+            auto it = _entries.find(key);
+            return it != _entries.end() ? it->second.jobId : 0;
+        }
+
+        void record(uint64_t key, int jobId)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            IdempotencyRecord record = {key, nowMs(), jobId, 0};
+            add(record);
+            if (_file != nullptr)
+            {
+                record.check = getRecordCheck(record);
+                fwrite(&record, sizeof(record), 1, _file);
+                fflush(_file);
+                if (++_logged > 2 * _maxEntries)
+                {
+                    rewrite();
+                }
+            }
+            evict(record.time);
+        }
+
+    private:
+        struct Entry
+        {
+            int jobId;
+            int64_t time;
+        };
+
+        std::mutex _mutex;
+        int64_t _window;
+        size_t _maxEntries;
+        std::unordered_map<uint64_t, Entry> _entries;
+        /// keys in the order they were recorded, with their time then
+        std::deque<std::pair<uint64_t, int64_t>> _order;
+        std::string _path;
+        FILE *_file;
+        size_t _logged;
+
+        void add(const IdempotencyRecord &record)
+        {
+            Entry entry = {record.jobId, record.time};
+            _entries[record.key] = entry;
+            _order.push_back(std::make_pair(record.key, record.time));
+        }
+
+        void evict(int64_t now)
+        {
+            while (!_order.empty() && (_order.size() > _maxEntries || _order.front().second < now - _window))
+            {
+                auto it = _entries.find(_order.front().first);
+                // unless recorded again since
+                if (it != _entries.end() && it->second.time == _order.front().second)
+                {
+                    _entries.erase(it);
+                }
+                _order.pop_front();
+            }
+        }
+
+        void closeFile()
+        {
+            if (_file != nullptr)
+            {
+                fclose(_file);
+                _file = nullptr;
+            }
+        }
+
+        void load()
+        {
+            FILE *file = fopen(_path.c_str(), "rb");
+            if (file == nullptr)
+            {
+                return;
+            }
+            IdempotencyRecord record;
+            int64_t oldest = nowMs() - _window;
+            while (fread(&record, sizeof(record), 1, file) == 1)
+            {
+                if (record.check == getRecordCheck(record) && record.time >= oldest)
+                {
+                    add(record);
+                }
+            }
+            fclose(file);
+        }
+
+        /// Write the live entries to a new log and keep appending to it
+        bool rewrite()
+        {
+            closeFile();
+            evict(nowMs());
+            std::string temporary = _path + ".tmp";
+            FILE *file = fopen(temporary.c_str(), "wb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            _logged = 0;
+            for (const auto &item : _order)
+            {
+                auto it = _entries.find(item.first);
+                if (it == _entries.end() || it->second.time != item.second)
+                {
+                    continue;
+                }
+                IdempotencyRecord record = {item.first, item.second, it->second.jobId, 0};
+                record.check = getRecordCheck(record);
+                fwrite(&record, sizeof(record), 1, file);
+                ++_logged;
+            }
+#ifdef _WIN32
+            // rename does not replace an existing file there
+            remove(_path.c_str());
+#endif
+            if (fclose(file) != 0 || rename(temporary.c_str(), _path.c_str()) != 0)
+            {
+                remove(temporary.c_str());
+                return false;
+            }
+            _file = fopen(_path.c_str(), "ab");
+            return _file != nullptr;
+        }
+    };
+
+    IdempotencyIndex &getIdempotencyIndex()
+    {
+        static IdempotencyIndex index;
+        return index;
+    }
+
+    /// Index key of a submission key on a printer
+    uint64_t getIndexKey(const std::string &key, const std::string &printer)
+    {
+        Xxh64 hash;
+        hash.update(printer.c_str(), printer.size() + 1);
+        hash.update(key);
+        return hash.digest();
+    }
+}
+
+MY_NODE_MODULE_CALLBACK(hashDocument)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 4);
+    REQUIRE_ARGUMENT_STRING(info, 1, printername);
+    REQUIRE_ARGUMENT_STRING(info, 2, type);
+    REQUIRE_ARGUMENT_OBJECT(info, 3, print_options);
+
+    Xxh64 hash;
+    hash.update(printername.c_str(), printername.size() + 1);
+    hash.update(type.c_str(), type.size() + 1);
+    // options in name order: the same options given in another order give the same key
+    std::vector<std::pair<std::string, std::string>> options;
+    Napi::Array names = print_options.GetPropertyNames();
+    for (uint32_t i = 0; i < names.Length(); ++i)
+    {
+        Napi::Value name = names.Get(i);
+        options.push_back(std::make_pair(name.ToString().Utf8Value(), print_options.Get(name).ToString().Utf8Value()));
+    }
+    std::sort(options.begin(), options.end());
+    for (const auto &option : options)
+    {
+        hash.update(option.first.c_str(), option.first.size() + 1);
+        hash.update(option.second.c_str(), option.second.size() + 1);
+    }
+    if (info[0].IsBuffer())
+    {
+        // hashed in place, not copied
+        Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+        hash.update(buffer.Data(), buffer.Length());
+    }
+    else
+    {
+        std::string data;
+        if (!getStringOrBufferFromNapiValue(info[0], data))
+        {
+            RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
+        }
+        hash.update(data);
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash.digest()));
+    return Napi::String::New(env, key);
+}
+
+MY_NODE_MODULE_CALLBACK(setIdempotencyOptions)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENT_OBJECT(info, 0, options);
+    int64_t window = DEFAULT_IDEMPOTENCY_WINDOW;
+    size_t maxEntries = DEFAULT_IDEMPOTENCY_ENTRIES;
+    std::string path;
+    if (options.Get("window").IsNumber())
+    {
+        window = options.Get("window").As<Napi::Number>().Int64Value();
+    }
+    if (options.Get("maxEntries").IsNumber())
+    {
+        maxEntries = static_cast<size_t>(std::max<int64_t>(1, options.Get("maxEntries").As<Napi::Number>().Int64Value()));
+    }
+    if (options.Get("file").IsString())
+    {
+        path = options.Get("file").As<Napi::String>().Utf8Value();
+    }
+    std::string error_str = getIdempotencyIndex().configure(window, maxEntries, path);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(findIdempotentJob)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_STRING(info, 0, key);
+    REQUIRE_ARGUMENT_STRING(info, 1, printername);
+    int jobId = getIdempotencyIndex().find(getIndexKey(key, printername));
+    if (jobId <= 0)
+    {
+        return env.Undefined();
+    }
+    return Napi::Number::New(env, jobId);
+}
+
+MY_NODE_MODULE_CALLBACK(recordIdempotentJob)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRING(info, 0, key);
+    REQUIRE_ARGUMENT_STRING(info, 1, printername);
+    REQUIRE_ARGUMENT_INTEGER(info, 2, jobId);
+    getIdempotencyIndex().record(getIndexKey(key, printername), jobId);
+    return env.Undefined();
+}
@@ -0,0 +1,532 @@
+#include "node_printer_backend.hpp"
+#include "node_printer_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    /** Print server simulated in memory.
+     * Job states are computed lazily from the clock when a request looks at a queue:
+     * a printer prints its pending jobs one at a time, by priority then id, each for
+     * printTime milliseconds. Uploaded documents are counted, not kept.
+     */
+    class MemoryBackend : public PrintBackend
+    {
+    public:
+        MemoryBackend(const MemoryBackendOptions &options) : _options(options), _nextJobId(1)
+        {
+            for (const auto &printername : options.printers)
+            {
+                _queues[printername];
+            }
+        }
+
+        virtual std::string getPrinters(AbortState &state, std::vector<PrinterInfo> &printers)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &printername : _options.printers)
+            {
+                printers.push_back(PrinterInfo());
+                fillPrinterInfo(printername, printers.back());
+            }
+            return "";
+        }
+
+        virtual std::string getPrinter(AbortState &state, const std::string &printername, PrinterInfo &printer)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queues.find(printername) == _queues.end())
+            {
+                return "Printer not found";
+            }
+            fillPrinterInfo(printername, printer);
+            return "";
+        }
+
+        virtual std::string getPrinterDriverOptions(AbortState &state, const std::string &printername, DriverOptionsType &options)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queues.find(printername) == _queues.end())
+            {
+                return "Printer not found";
+            }
+            std::vector<std::pair<std::string, bool>> pageSizes;
+            pageSizes.push_back(std::make_pair(std::string("A4"), true));
+            pageSizes.push_back(std::make_pair(std::string("Letter"), false));
+            options.push_back(std::make_pair(std::string("PageSize"), pageSizes));
+            return "";
+        }
+
+        virtual std::string getJob(AbortState &state, const std::string &printername, int jobId, JobInfo &job)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            Job *found = findJob(printername, jobId);
+            if (found == nullptr)
+            {
+                return "Printer job not found";
+            }
+            job = found->info;
+            return "";
+        }
+
+        /// Looks at every job of the printer, finished ones included
+        virtual std::string findJob(AbortState &state, const std::string &printername, const std::string &title, JobInfo &job)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto itQueue = _queues.find(printername);
+            if (itQueue == _queues.end())
+            {
+                return "Printer not found";
+            }
+            advance(itQueue->second);
+            for (const auto &itJob : itQueue->second.jobs)
+            {
+                if (itJob.second.info.title == title && itJob.first > job.id)
+                {
+                    job = itJob.second.info;
+                }
+            }
+            return "";
+        }
+
+        virtual bool findsCompletedJobs() const
+        {
+            return true;
+        }
+
+        virtual std::string setJob(AbortState &state, const std::string &printername, int jobId, const std::string &jobCommand, int value, bool &result)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            result = executeJobCommand(printername, jobId, jobCommand, value);
+            return "";
+        }
+
+        virtual std::string setJobs(AbortState &state, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value, bool &result)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            result = true;
+            for (int jobId : jobIds)
+            {
+                result = executeJobCommand(printername, jobId, jobCommand, value) && result;
+            }
+            return "";
+        }
+
+        virtual std::string cancelAllJobs(AbortState &state, const std::string &printername, bool purge, bool &result)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto itQueue = _queues.find(printername);
+            result = (itQueue != _queues.end());
+            if (!result)
+            {
+                return "";
+            }
+            Queue &queue = itQueue->second;
+            advance(queue);
+            for (auto &itJob : queue.jobs)
+            {
+                if (!isTerminal(itJob.second.info.state))
+                {
+                    finishJob(queue, itJob.second, IPP_JOB_CANCELLED, Clock::now());
+                }
+            }
+            if (purge)
+            {
+                queue.jobs.clear();
+            }
+            return "";
+        }
+
+        virtual std::string moveAllJobs(AbortState &state, const std::string &from, const std::string &to, bool &result)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto itFrom = _queues.find(from);
+            result = (itFrom != _queues.end() && _queues.find(to) != _queues.end());
+            if (!result)
+            {
+                return "";
+            }
+            std::vector<int> jobIds;
+            for (const auto &itJob : itFrom->second.jobs)
+            {
+                jobIds.push_back(itJob.first);
+            }
+            for (int jobId : jobIds)
+            {
+                moveJob(from, jobId, to);
+            }
+            return "";
+        }
+
+        virtual std::string moveJobs(AbortState &state, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &moved)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (int jobId : jobIds)
+            {
+                if (moveJob(from, jobId, to))
+                {
+                    moved.push_back(jobId);
+                }
+            }
+            return "";
+        }
+
+        virtual std::string submitDocument(AbortState &state, const std::string &printername, const std::string &docname, const std::string &format,
+                                           int num_options, cups_option_t *options, DocumentSource &source, int &jobId)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            std::string error_str = wait(state, _options.latency);
+            if (!error_str.empty())
+            {
+                return error_str;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_queues.find(printername) == _queues.end())
+                {
+                    return "The printer or class does not exist.";
+                }
+                jobId = _nextJobId++;
+            }
+
+            size_t bytes = 0;
+            const char *chunk = nullptr;
+            size_t length = 0;
+            while (error_str.empty() && source.next(chunk, length))
+            {
+                error_str = wait(state, _options.chunkLatency);
+                if (error_str.empty() && state.shouldStop())
+                {
+                    error_str = state.isAborted() ? ABORT_ERROR_MESSAGE : TIMEOUT_ERROR_MESSAGE;
+                }
+                if (error_str.empty())
+                {
+                    bytes += length;
+                    if (CallStats::getCurrent() != nullptr)
+                    {
+                        CallStats::getCurrent()->addBytes(length);
+                    }
+                }
+            }
+            if (error_str.empty())
+            {
+                error_str = source.getError();
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto itQueue = _queues.find(printername);
+            if (itQueue == _queues.end())
+            {
+                return "The printer or class does not exist.";
+            }
+            Queue &queue = itQueue->second;
+            advance(queue);
+            Job &job = queue.jobs[jobId];
+            job.info.id = jobId;
+            job.info.title = docname;
+            job.info.dest = printername;
+            job.info.user = cupsUser();
+            job.info.format = format;
+            job.info.priority = 50;
+            job.info.size = static_cast<int>((bytes + 1023) / 1024);
+            job.info.creation_time = time(nullptr);
+            job.ready = Clock::now();
+            const char *priority = cupsGetOption("job-priority", num_options, options);
+            if (priority != nullptr)
+            {
+                job.info.priority = atoi(priority);
+            }
+            const char *holdUntil = cupsGetOption("job-hold-until", num_options, options);
+            job.info.state = (holdUntil != nullptr && strcmp(holdUntil, "no-hold") != 0) ? IPP_JOB_HELD : IPP_JOB_PENDING;
+            if (!error_str.empty())
+            {
+                // like the CUPS backend, a cut short upload cancels its job
+                finishJob(queue, job, IPP_JOB_CANCELLED, Clock::now());
+            }
+            return error_str;
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Job
+        {
+            JobInfo info;
+            /// time the job became pending
+            Clock::time_point ready;
+            Clock::time_point processing;
+        };
+
+        struct Queue
+        {
+            std::map<int, Job> jobs;
+            /// job being printed, 0 if none
+            int current;
+            Clock::time_point idleSince;
+
+            Queue() : current(0), idleSince(Clock::now()) {}
+        };
+
+        MemoryBackendOptions _options;
+        std::mutex _mutex;
+        std::map<std::string, Queue> _queues;
+        int _nextJobId;
+
+        /// Simulate a delay of the server, interrupted by abort and deadline
+        static std::string wait(AbortState &state, int msec)
+        {
+            Clock::time_point end = Clock::now() + std::chrono::milliseconds(msec);
+            while (true)
+            {
+                if (state.shouldStop())
+                {
+                    return state.isAborted() ? ABORT_ERROR_MESSAGE : TIMEOUT_ERROR_MESSAGE;
+                }
+                Clock::time_point now = Clock::now();
+                if (now >= end)
+                {
+                    return "";
+                }
+                std::this_thread::sleep_for(std::min<Clock::duration>(end - now, std::chrono::milliseconds(5)));
+            }
+        }
+
+        static bool isTerminal(int jobState)
+        {
+            return jobState == IPP_JOB_COMPLETED || jobState == IPP_JOB_CANCELLED || jobState == IPP_JOB_ABORTED;
+        }
+
+        static time_t toTime(Clock::time_point point)
+        {
+            return time(nullptr) + std::chrono::duration_cast<std::chrono::seconds>(point - Clock::now()).count();
+        }
+
+        void finishJob(Queue &queue, Job &job, int jobState, Clock::time_point when)
+        {
+            if (queue.current == job.info.id)
+            {
+                queue.current = 0;
+                queue.idleSince = when;
+            }
+            job.info.state = jobState;
+            job.info.completed_time = toTime(when);
+        }
+
+        /// Bring the job states of a queue up to now
+        void advance(Queue &queue)
+        {
+            Clock::time_point now = Clock::now();
+            while (true)
+            {
+                if (queue.current != 0)
+                {
+                    Job &job = queue.jobs[queue.current];
+                    Clock::time_point end = job.processing + std::chrono::milliseconds(_options.printTime);
+                    if (end > now)
+                    {
+                        return;
+                    }
+                    finishJob(queue, job, IPP_JOB_COMPLETED, end);
+                }
+                Job *next = nullptr;
+                for (auto &itJob : queue.jobs)
+                {
+                    Job &job = itJob.second;
+                    if (job.info.state == IPP_JOB_PENDING && job.ready <= now && (next == nullptr || job.info.priority > next->info.priority))
+                    {
+                        next = &job;
+                    }
+                }
+                if (next == nullptr)
+                {
+                    return;
+                }
+                next->info.state = IPP_JOB_PROCESSING;
+                next->processing = std::max(next->ready, queue.idleSince);
+                next->info.processing_time = toTime(next->processing);
+                queue.current = next->info.id;
+            }
+        }
+
+        Job *findJob(const std::string &printername, int jobId)
+        {
+            auto itQueue = _queues.find(printername);
+            if (itQueue == _queues.end())
+            {
+                return nullptr;
+            }
+            advance(itQueue->second);
+            auto itJob = itQueue->second.jobs.find(jobId);
+            return (itJob != itQueue->second.jobs.end()) ? &itJob->second : nullptr;
+        }
+
+        void fillPrinterInfo(const std::string &printername, PrinterInfo &printer)
+        {
+            Queue &queue = _queues[printername];
+            advance(queue);
+            printer.name = printername;
+            printer.isDefault = (printername == _options.printers.front());
+            printer.options.push_back(std::make_pair(std::string("device-uri"), "memory://" + printername));
+            printer.options.push_back(std::make_pair(std::string("printer-is-accepting-jobs"), std::string("true")));
+            printer.options.push_back(std::make_pair(std::string("printer-state"), std::string(queue.current != 0 ? "4" : "3")));
+            printer.options.push_back(std::make_pair(std::string("printer-state-reasons"), std::string("none")));
+            for (const auto &itJob : queue.jobs)
+            {
+                if (!isTerminal(itJob.second.info.state))
+                {
+                    printer.jobs.push_back(itJob.second.info);
+                }
+            }
+        }
+
+        /// @return false if the command is not possible in the state of the job
+        bool executeJobCommand(const std::string &printername, int jobId, const std::string &jobCommand, int value)
+        {
+            Job *job = findJob(printername, jobId);
+            if (job == nullptr)
+            {
+                return false;
+            }
+            int &jobState = job->info.state;
+            Clock::time_point now = Clock::now();
+            if (jobCommand == "CANCEL")
+            {
+                if (isTerminal(jobState))
+                {
+                    return false;
+                }
+                finishJob(_queues[printername], *job, IPP_JOB_CANCELLED, now);
+            }
+            else if (jobCommand == "HOLD" || jobCommand == "PAUSE")
+            {
+                if (jobState != IPP_JOB_PENDING)
+                {
+                    return false;
+                }
+                jobState = IPP_JOB_HELD;
+            }
+            else if (jobCommand == "RELEASE" || jobCommand == "RESUME")
+            {
+                if (jobState != IPP_JOB_HELD)
+                {
+                    return false;
+                }
+                jobState = IPP_JOB_PENDING;
+                job->ready = now;
+            }
+            else if (jobCommand == "RESTART")
+            {
+                if (!isTerminal(jobState))
+                {
+                    return false;
+                }
+                jobState = IPP_JOB_PENDING;
+                job->ready = now;
+                job->info.completed_time = 0;
+                job->info.processing_time = 0;
+            }
+            else if (jobCommand == "PRIORITY")
+            {
+                if (isTerminal(jobState))
+                {
+                    return false;
+                }
+                job->info.priority = value;
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        }
+
+        /// Only pending and held jobs can move, as with CUPS-Move-Job
+        bool moveJob(const std::string &from, int jobId, const std::string &to)
+        {
+            auto itTo = _queues.find(to);
+            Job *job = findJob(from, jobId);
+            if (job == nullptr || itTo == _queues.end() || from == to || (job->info.state != IPP_JOB_PENDING && job->info.state != IPP_JOB_HELD))
+            {
+                return false;
+            }
+            advance(itTo->second);
+            Job &moved = itTo->second.jobs[jobId];
+            moved = *job;
+            moved.info.dest = to;
+            _queues[from].jobs.erase(jobId);
+            return true;
+        }
+    };
+}
+
+std::shared_ptr<PrintBackend> newMemoryBackend(const MemoryBackendOptions &options)
+{
+    return std::make_shared<MemoryBackend>(options);
+}
@@ -0,0 +1,416 @@
+#include "node_printer.hpp"
+#include "node_printer_env.hpp"
+#include "node_printer_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Threads owned by the module, started on first use.
+ * Never destroyed: the threads are joined by shutdown, when the last environment is torn down.
+ */
+class ThreadPool
+{
+public:
+    ThreadPool() : _size(DEFAULT_THREAD_POOL_SIZE), _running(0), _stopping(false), _users(0) {}
+
+    void post(PoolTask *task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(task);
+            startThreads();
+        }
+        _condition.notify_one();
+    }
+
+    /// An environment starts using the pool
+    void retain()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_users;
+        _stopping = false;
+        if (!_queue.empty())
+        {
+            startThreads();
+        }
+    }
+
+    /** An environment is torn down, its tasks aborted.
+     * The last one stops and joins the threads: tasks still queued wait for the next start.
+     */
+    void release()
+    {
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_users > 0)
+            {
+                return;
+            }
+            _stopping = true;
+            threads.swap(_threads);
+        }
+        _condition.notify_all();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    void resize(size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _size = size;
+            if (!_queue.empty())
+            {
+                startThreads();
+            }
+        }
+        // let the extra threads exit
+        _condition.notify_all();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _size;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<PoolTask *> _queue;
+    std::vector<std::thread> _threads;
+    size_t _size;
+    size_t _running;
+    bool _stopping;
+    size_t _users;
+
+    /// must be called with _mutex locked
+    void startThreads()
+    {
+        while (!_stopping && _running < _size)
+        {
+            ++_running;
+            _threads.push_back(std::thread(&ThreadPool::work, this));
+        }
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;)
+        {
+            _condition.wait(lock, [this]
+                            { return _stopping || !_queue.empty() || _running > _size; });
+            if (_stopping)
+            {
+                // joined by release
+                --_running;
+                return;
+            }
+            if (_running > _size)
+            {
+                // shrunk by resize: nobody joins it
+                --_running;
+                auto self = std::find_if(_threads.begin(), _threads.end(), [](const std::thread &thread)
+                                         { return thread.get_id() == std::this_thread::get_id(); });
+                if (self != _threads.end())
+                {
+                    self->detach();
+                    _threads.erase(self);
+                }
+                return;
+            }
+            PoolTask *task = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+            task->run();
+            lock.lock();
+        }
+    }
+};
+
+namespace
+{
+    ThreadPool &getThreadPool()
+    {
+        static ThreadPool *pool = new ThreadPool();
+        return *pool;
+    }
+
+    std::atomic<int> defaultTimeout(0);
+}
+
+int getDefaultTaskTimeout()
+{
+    return defaultTimeout;
+}
+
+void useThreadPool(Napi::Env env)
+{
+    getThreadPool().retain();
+    // cleanup hooks run before the instance data is deleted: its tasks are aborted here, not to wait for them
+    std::shared_ptr<TaskRegistry> tasks = ModuleData::get(env).getTasks();
+    env.AddCleanupHook([tasks]()
+                       {
+                           tasks->close();
+                           getThreadPool().release(); });
+}
+
+void AbortState::abort()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _aborted = true;
+    _cancel = 1;
+    if (_interrupt)
+    {
+        _interrupt();
+    }
+}
+
+void AbortState::setInterrupt(const std::function<void()> &interrupt)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _interrupt = interrupt;
+    if (_aborted && _interrupt)
+    {
+        // aborted before the operation started
+        _interrupt();
+    }
+}
+
+void AbortState::clearInterrupt()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _interrupt = nullptr;
+}
+
+void AbortState::setTimeout(int msec)
+{
+    _hasDeadline = (msec > 0);
+    if (_hasDeadline)
+    {
+        _deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+    }
+}
+
+int AbortState::getRemainingTime(int defaultValue) const
+{
+    if (!_hasDeadline)
+    {
+        return defaultValue;
+    }
+    std::chrono::steady_clock::duration remaining = _deadline - std::chrono::steady_clock::now();
+    return static_cast<int>(std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count()));
+}
+
+std::string AbortState::getErrorCode() const
+{
+    if (!_errorCode.empty())
+    {
+        return _errorCode;
+    }
+    if (isAborted())
+    {
+        return ERROR_CODE_ABORTED;
+    }
+    if (isTimedOut())
+    {
+        return ERROR_CODE_TIMEDOUT;
+    }
+    return "";
+}
+
+void TaskRegistry::add(const std::shared_ptr<AbortState> &state)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed)
+    {
+        state->abort();
+        return;
+    }
+    _states.insert(state);
+}
+
+void TaskRegistry::remove(const std::shared_ptr<AbortState> &state)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _states.erase(state);
+}
+
+void TaskRegistry::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    for (const std::shared_ptr<AbortState> &state : _states)
+    {
+        state->abort();
+    }
+    _states.clear();
+}
+
+PoolTask::PoolTask(Napi::Env env)
+    : _deferred(Napi::Promise::Deferred::New(env)), _abort(std::make_shared<AbortState>()),
+      _tasks(ModuleData::get(env).getTasks()), _trace(getTraceSink())
+{
+    // the deadline counts the time spent waiting for a pool thread
+    _abort->setTimeout(getDefaultTaskTimeout());
+}
+
+PoolTask::~PoolTask()
+{
+    _tasks->remove(_abort);
+}
+
+Napi::Promise PoolTask::queue()
+{
+    Napi::Env env = _deferred.Env();
+    _completion = CompletionFunction::New(env, "node-printer", 0, 1);
+    Napi::Promise promise = _deferred.Promise();
+    _tasks->add(_abort);
+    getThreadPool().post(this);
+    return promise;
+}
+
+void PoolTask::bindAbortHandle(const Napi::Value &handle)
+{
+    if (!handle.IsObject())
+    {
+        return;
+    }
+    Napi::Value timeout = handle.As<Napi::Object>().Get("timeout");
+    if (timeout.IsNumber())
+    {
+        _abort->setTimeout(timeout.As<Napi::Number>().Int32Value());
+    }
+    std::shared_ptr<AbortState> abortState = _abort;
+    handle.As<Napi::Object>().Set("abort", Napi::Function::New(handle.Env(), [abortState](const Napi::CallbackInfo &info)
+                                                                 {
+                                                                     abortState->abort();
+                                                                     return info.Env().Undefined(); }));
+}
+
+void PoolTask::setStats(StatsOperation operation, const std::string &printer)
+{
+    _stats.reset(new CallStats(operation, printer));
+}
+
+void PoolTask::setError(const std::string &message, const std::string &code)
+{
+    _error = message;
+    _errorCode = code;
+}
+
+void PoolTask::run()
+{
+    if (_abort->isAborted())
+    {
+        setError(ABORT_ERROR_MESSAGE, ERROR_CODE_ABORTED);
+    }
+    else if (_abort->isTimedOut())
+    {
+        // expired while queued, do not load the print server any further
+        setError(TIMEOUT_ERROR_MESSAGE, ERROR_CODE_TIMEDOUT);
+    }
+    else
+    {
+        {
+            CallStatsScope scope(_stats.get());
+            TraceScope trace(_trace);
+            execute();
+        }
+        if (!_error.empty() && _abort->isAborted())
+        {
+            // aborted once done, e.g. a job already submitted, it keeps its result
+            setError(ABORT_ERROR_MESSAGE, ERROR_CODE_ABORTED);
+        }
+        else if (_errorCode == ERROR_CODE_TIMEDOUT)
+        {
+            // libcups reports timeouts with various messages
+            _error = TIMEOUT_ERROR_MESSAGE;
+        }
+    }
+    CompletionFunction completion = _completion;
+    if (completion.BlockingCall(this) != napi_ok)
+    {
+        // The environment is torn down (e.g. a terminated worker): the task holds
+        // references to JS values that can only be released on its thread. Leak it
+        // rather than deleting them from here.
+        _trace.reset();
+    }
+    completion.Release();
+}
+
+void PoolTask::complete(Napi::Env env, Napi::Function callback, std::nullptr_t *context, PoolTask *task)
+{
+    if (env != nullptr)
+    {
+        if (task->_error.empty())
+        {
+            Napi::Value result;
+            {
+                StatsTimer timer(task->_stats.get(), StatsTimer::MARSHAL);
+                result = task->getResult(env);
+            }
+            task->_deferred.Resolve(result);
+        }
+        else
+        {
+            if (task->_stats)
+            {
+                task->_stats->setError();
+            }
+            Napi::Error error = Napi::Error::New(env, task->_error);
+            if (!task->_errorCode.empty())
+            {
+                error.Set("code", Napi::String::New(env, task->_errorCode));
+            }
+            task->_deferred.Reject(error.Value());
+        }
+    }
+    delete task;
+}
+
+MY_NODE_MODULE_CALLBACK(setThreadPoolSize)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_INTEGER(info, 0, size);
+    if (size < 1)
+    {
+        RETURN_EXCEPTION_STR("Thread pool size must be at least 1");
+    }
+    getThreadPool().resize(static_cast<size_t>(size));
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(getThreadPoolSize)
+{
+    MY_NODE_MODULE_ENV(info);
+    return Napi::Number::New(env, static_cast<double>(getThreadPool().size()));
+}
+
+MY_NODE_MODULE_CALLBACK(setDefaultTimeout)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_INTEGER(info, 0, timeout);
+    if (timeout < 0)
+    {
+        RETURN_EXCEPTION_STR("Timeout must be a positive number of milliseconds or 0");
+    }
+    defaultTimeout = timeout;
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(getDefaultTimeout)
+{
+    MY_NODE_MODULE_ENV(info);
+    return Napi::Number::New(env, getDefaultTaskTimeout());
+}
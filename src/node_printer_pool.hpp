@@ -0,0 +1,215 @@
+#ifndef NODE_PRINTER_POOL_HPP
+#define NODE_PRINTER_POOL_HPP
+
+#include "node_printer_stats.hpp"
+#include "node_printer_trace.hpp"
+
+#include <napi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+/** Abort state shared between a pool task and the abort() function given to JS.
+ * abort() is called on the main thread while the task may be blocked in a
+ * network operation on a pool thread: the registered interrupt function is
+ * used to break that operation (e.g. by shutting down its connection).
+ * It also holds the deadline of the operation, checked by the connection timeout callback.
+ */
+class AbortState
+{
+public:
+    AbortState() : _aborted(false), _cancel(0), _hasDeadline(false) {}
+
+    bool isAborted() const { return _aborted; }
+
+    /// Set the deadline of the operation, in milliseconds from now. 0 or less means no deadline
+    void setTimeout(int msec);
+
+    bool isTimedOut() const { return _hasDeadline && std::chrono::steady_clock::now() >= _deadline; }
+
+    /// Milliseconds left before the deadline, or defaultValue if there is no deadline
+    int getRemainingTime(int defaultValue) const;
+
+    /// True if the operation must stop: aborted or past its deadline
+    bool shouldStop() const { return isAborted() || isTimedOut(); }
+
+    /// Set the code of the error the operation failed with (e.g. ECONNREFUSED)
+    void setErrorCode(const std::string &code) { _errorCode = code; }
+
+    /// Error code set by the operation, else ABORT_ERR or ETIMEDOUT if it was stopped. Empty otherwise
+    std::string getErrorCode() const;
+
+    /// Mark as aborted and interrupt the operation in progress, if any
+    void abort();
+
+    /// Register the function interrupting the blocking operation in progress
+    void setInterrupt(const std::function<void()> &interrupt);
+
+    /// Unregister the interrupt function. Must be called before the interrupted resource is released
+    void clearInterrupt();
+
+    /// Cancel flag for libcups functions taking an `int *cancel` argument
+    int *getCancelFlag() { return &_cancel; }
+
+private:
+    std::atomic<bool> _aborted;
+    int _cancel;
+    std::mutex _mutex;
+    std::function<void()> _interrupt;
+    bool _hasDeadline;
+    std::chrono::steady_clock::time_point _deadline;
+    std::string _errorCode;
+};
+
+/** Abort states of the pool tasks queued by one environment.
+ * Closed when the environment is torn down: its tasks are aborted so they do not
+ * keep the pool threads busy for a result nobody will receive.
+ */
+class TaskRegistry
+{
+public:
+    TaskRegistry() : _closed(false) {}
+
+    void add(const std::shared_ptr<AbortState> &state);
+    void remove(const std::shared_ptr<AbortState> &state);
+
+    /// Abort the registered tasks and the ones added afterwards
+    void close();
+
+private:
+    std::mutex _mutex;
+    std::set<std::shared_ptr<AbortState>> _states;
+    bool _closed;
+};
+
+/** Task executed on the module owned thread pool.
+ *
+ * The pool is independent from the libuv threadpool, so waiting on the print
+ * server does not starve fs, crypto or dns work of the application.
+ * execute() runs on a pool thread and must not touch any JS value,
+ * getResult() runs on the main thread once execute() is done and converts
+ * the native result to JS.
+ */
+class PoolTask
+{
+public:
+    PoolTask(Napi::Env env);
+    virtual ~PoolTask();
+
+    /** Queue the task on the pool. The task is deleted after completion.
+     * @returns promise resolved with getResult() or rejected with the error set by execute()
+     */
+    Napi::Promise queue();
+
+    /** Expose an abort() function on handle, if handle is an object.
+     * Calling it interrupts the task; the promise is then rejected once the task is done.
+     * A `timeout` number property of handle, in milliseconds, overrides the default timeout.
+     */
+    void bindAbortHandle(const Napi::Value &handle);
+
+    /** Measure the task as a call of operation in getStats().
+     * Its IPP time and uploaded bytes are reported by the code run by execute().
+     */
+    void setStats(StatsOperation operation, const std::string &printer = "");
+
+protected:
+    /// Runs on a pool thread
+    virtual void execute() = 0;
+
+    /// Runs on the main thread if execute() did not set an error
+    virtual Napi::Value getResult(Napi::Env env) = 0;
+
+    /// Set the error message the promise will be rejected with, and its `code` property if not empty
+    void setError(const std::string &message, const std::string &code = "");
+
+    AbortState &getAbortState() { return *_abort; }
+
+private:
+    static void complete(Napi::Env env, Napi::Function callback, std::nullptr_t *context, PoolTask *task);
+
+    typedef Napi::TypedThreadSafeFunction<std::nullptr_t, PoolTask, &PoolTask::complete> CompletionFunction;
+
+    void run();
+
+    Napi::Promise::Deferred _deferred;
+    CompletionFunction _completion;
+    std::string _error;
+    std::string _errorCode;
+    std::shared_ptr<AbortState> _abort;
+    std::unique_ptr<CallStats> _stats;
+    std::shared_ptr<TaskRegistry> _tasks;
+    std::shared_ptr<TraceSink> _trace;
+
+    friend class ThreadPool;
+};
+
+/** Pool task executing a function and converting its result.
+ * execute function returns an error string, empty on success. It should
+ * check the abort state between its blocking steps.
+ */
+template <typename ResultType>
+class FunctionTask : public PoolTask
+{
+public:
+    typedef std::function<std::string(ResultType &, AbortState &)> ExecuteFunction;
+    typedef std::function<Napi::Value(Napi::Env, const ResultType &)> ConvertFunction;
+
+    FunctionTask(Napi::Env env, ExecuteFunction iExecute, ConvertFunction iConvert)
+        : PoolTask(env), _execute(iExecute), _convert(iConvert), _result() {}
+
+protected:
+    virtual void execute()
+    {
+        std::string error_str = _execute(_result, getAbortState());
+        if (!error_str.empty())
+        {
+            setError(error_str, getAbortState().getErrorCode());
+        }
+    }
+
+    virtual Napi::Value getResult(Napi::Env env)
+    {
+        return _convert(env, _result);
+    }
+
+private:
+    ExecuteFunction _execute;
+    ConvertFunction _convert;
+    ResultType _result;
+};
+
+/** Default number of pool threads
+ */
+const size_t DEFAULT_THREAD_POOL_SIZE = 4;
+
+/** Error message of aborted tasks
+ */
+const char *const ABORT_ERROR_MESSAGE = "The operation was aborted";
+
+/** Error message of tasks stopped by their deadline
+ */
+const char *const TIMEOUT_ERROR_MESSAGE = "The operation timed out";
+
+/** Error codes set on the `code` property of errors
+ */
+const char *const ERROR_CODE_ABORTED = "ABORT_ERR";
+const char *const ERROR_CODE_TIMEDOUT = "ETIMEDOUT";
+const char *const ERROR_CODE_CONNECTION = "ECONNREFUSED";
+const char *const ERROR_CODE_CIRCUIT_OPEN = "ECIRCUITOPEN";
+
+/** Timeout applied to operations without an explicit one, in milliseconds. 0 means none
+ */
+int getDefaultTaskTimeout();
+
+/** Count env among the environments using the thread pool, until its cleanup hook.
+ * The pool threads are joined when the last one is torn down, and started again by the next task.
+ */
+void useThreadPool(Napi::Env env);
+
+#endif
@@ -1,13 +1,31 @@
 #include "node_printer.hpp"
+#include "node_printer_backend.hpp"
+#include "node_printer_env.hpp"
+#include "node_printer_pool.hpp"
+#include "node_printer_stats.hpp"
+#include "node_printer_trace.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <string>
 #include <map>
 #include <utility>
 #include <sstream>
+#include <vector>
 // #include <node_version.h>
 
 #include <cups/cups.h>
 #include <cups/ppd.h>
+#include <sys/stat.h>
 
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 
@@ -16,14 +34,15 @@ namespace
     typedef std::map<std::string, int> StatusMapType;
     typedef std::map<std::string, std::string> FormatMapType;
 
-    const StatusMapType &getJobStatusMap()
+    /// Bytes looked at to recognize the format of an AUTO document
+    const size_t SNIFF_SIZE = 4096;
+
+    /// Longest run of blanks and ~ control commands before the ^XA of a ZPL label
+    const size_t ZPL_PREFIX_SIZE = 256;
+
+    StatusMapType newJobStatusMap()
     {
-        static StatusMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
-        // add only first time
+        StatusMapType result;
 #define STATUS_PRINTER_ADD(value, type) result.insert(std::make_pair(value, type))
         // Common statuses
         STATUS_PRINTER_ADD("PRINTING", IPP_JOB_PROCESSING);
@@ -39,13 +58,16 @@ namespace
         return result;
     }
 
-    const FormatMapType &getPrinterFormatMap()
+    /// Built once, thread safe, never modified afterwards
+    const StatusMapType &getJobStatusMap()
     {
-        static FormatMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
+        static const StatusMapType result = newJobStatusMap();
+        return result;
+    }
+
+    FormatMapType newPrinterFormatMap()
+    {
+        FormatMapType result;
         result.insert(std::make_pair("RAW", CUPS_FORMAT_RAW));
         result.insert(std::make_pair("TEXT", CUPS_FORMAT_TEXT));
 #ifdef CUPS_FORMAT_PDF
@@ -60,26 +82,36 @@ namespace
 #ifdef CUPS_FORMAT_COMMAND
         result.insert(std::make_pair("COMMAND", CUPS_FORMAT_COMMAND));
 #endif
+        // raster documents, printed without any conversion filter on IPP Everywhere and AirPrint printers
+        result.insert(std::make_pair("PWG", "image/pwg-raster"));
+        result.insert(std::make_pair("URF", "image/urf"));
 #ifdef CUPS_FORMAT_AUTO
         result.insert(std::make_pair("AUTO", CUPS_FORMAT_AUTO));
 #endif
         return result;
     }
 
+    /// Built once, thread safe, never modified afterwards
+    const FormatMapType &getPrinterFormatMap()
+    {
+        static const FormatMapType result = newPrinterFormatMap();
+        return result;
+    }
+
     /** Parse job info object.
      * @return error string. if empty, then no error
      */
-    std::string parseJobObject(const cups_job_t *job, Napi::Object result_printer_job)
+    std::string parseJobObject(const JobInfo &job, Napi::Object result_printer_job)
     {
         Napi::Env env = result_printer_job.Env();
 
         // Common fields
-        result_printer_job.Set("id", Napi::Number::New(env, job->id));
-        result_printer_job.Set("name", Napi::String::New(env, job->title));
-        result_printer_job.Set("printerName", Napi::String::New(env, job->dest));
-        result_printer_job.Set("user", Napi::String::New(env, job->user));
+        result_printer_job.Set("id", Napi::Number::New(env, job.id));
+        result_printer_job.Set("name", Napi::String::New(env, job.title));
+        result_printer_job.Set("printerName", Napi::String::New(env, job.dest));
+        result_printer_job.Set("user", Napi::String::New(env, job.user));
 
-        std::string job_format(job->format);
+        std::string job_format(job.format);
 
         // Try to parse the data format, otherwise will write the unformatted one
         for (const auto &itFormat : getPrinterFormatMap())
@@ -92,15 +124,15 @@ namespace
         }
 
         result_printer_job.Set("format", Napi::String::New(env, job_format));
-        result_printer_job.Set("priority", Napi::Number::New(env, job->priority));
-        result_printer_job.Set("size", Napi::Number::New(env, job->size));
+        result_printer_job.Set("priority", Napi::Number::New(env, job.priority));
+        result_printer_job.Set("size", Napi::Number::New(env, job.size));
 
         Napi::Array result_printer_job_status = Napi::Array::New(env);
         uint32_t i_status = 0;
 
         for (const auto &itStatus : getJobStatusMap())
         {
-            if (job->state == itStatus.second)
+            if (job.state == itStatus.second)
             {
                 result_printer_job_status.Set(i_status++, Napi::String::New(env, itStatus.first));
                 // only one status could be on posix
@@ -111,16 +143,16 @@ namespace
         {
             // A new status? report as unsupported
             std::ostringstream s;
-            s << "unsupported job status: " << job->state;
+            s << "unsupported job status: " << job.state;
             result_printer_job_status.Set(i_status++, Napi::String::New(env, s.str()));
         }
         result_printer_job.Set("status", result_printer_job_status);
 
         // Specific fields
         //  Ecmascript store time in milliseconds, but time_t in seconds
-        double creationTime = static_cast<double>(job->creation_time) * 1000;
-        double completedTime = static_cast<double>(job->completed_time) * 1000;
-        double processingTime = static_cast<double>(job->processing_time) * 1000;
+        double creationTime = static_cast<double>(job.creation_time) * 1000;
+        double completedTime = static_cast<double>(job.completed_time) * 1000;
+        double processingTime = static_cast<double>(job.processing_time) * 1000;
 
         result_printer_job.Set("completedTime", Napi::Date::New(env, completedTime));
         result_printer_job.Set("creationTime", Napi::Date::New(env, creationTime));
@@ -130,23 +162,21 @@ namespace
         return "";
     }
 
-    /** Parses printer driver PPD options
+    /** Collects printer driver PPD options
      */
-    void populatePpdOptions(Napi::Object ppd_options, ppd_file_t *ppd, ppd_group_t *group)
+    void populatePpdOptions(DriverOptionsType &ppd_options, ppd_file_t *ppd, ppd_group_t *group)
     {
-        Napi::Env env = ppd_options.Env();
-
         for (int i = group->num_options; i > 0; --i)
         {
             ppd_option_t *option = &(group->options[group->num_options - i]);
-            Napi::Object ppd_suboptions = Napi::Object::New(env);
+            std::vector<std::pair<std::string, bool>> ppd_suboptions;
             for (int j = option->num_choices; j > 0; --j)
             {
                 ppd_choice_t *choice = &(option->choices[option->num_choices - j]);
-                ppd_suboptions.Set(choice->choice, Napi::Boolean::New(env, static_cast<bool>(choice->marked)));
+                ppd_suboptions.push_back(std::make_pair(std::string(choice->choice), static_cast<bool>(choice->marked)));
             }
 
-            ppd_options.Set(option->keyword, ppd_suboptions);
+            ppd_options.push_back(std::make_pair(std::string(option->keyword), ppd_suboptions));
         }
 
         for (int i = group->num_subgroups; i > 0; --i)
@@ -156,10 +186,28 @@ namespace
         }
     }
 
-    /** Parse printer driver options
+    /// cupsGetDests2, traced
+    int getDestsTraced(http_t *http, cups_dest_t **dests)
+    {
+        TraceSpan span("cupsGetDests2", "");
+        int result = cupsGetDests2(http, dests);
+        span.setStatus(cupsLastError());
+        return result;
+    }
+
+    /// cupsGetJobs2 of all users, traced
+    int getJobsTraced(http_t *http, cups_job_t **jobs, const char *printername, int whichJobs)
+    {
+        TraceSpan span("cupsGetJobs2", printername != nullptr ? printername : "");
+        int result = cupsGetJobs2(http, jobs, printername, 0 /*0 means all users*/, whichJobs);
+        span.setStatus(cupsLastError());
+        return result;
+    }
+
+    /** Retrieve printer driver options
      * @return error string.
      */
-    std::string parseDriverOptions(const cups_dest_t *printer, Napi::Object ppd_options)
+    std::string fetchDriverOptions(http_t *http, const cups_dest_t *printer, DriverOptionsType &ppd_options)
     {
         const char *filename = nullptr;
         ppd_file_t *ppd = nullptr;
@@ -167,7 +215,12 @@ namespace
 
         std::ostringstream error_str; // error string
 
-        if ((filename = cupsGetPPD(printer->name)) != nullptr)
+        {
+            TraceSpan span("cupsGetPPD2", printer->name);
+            filename = cupsGetPPD2(http, printer->name);
+            span.setStatus(cupsLastError());
+        }
+        if (filename != nullptr)
         {
             if ((ppd = ppdOpenFile(filename)) != nullptr)
             {
@@ -195,39 +248,88 @@ namespace
         return error_str.str();
     }
 
-    /** Parse printer info object
-     * @return error string.
+    /** Parse printer driver options
      */
-    std::string parsePrinterInfo(const cups_dest_t *printer, Napi::Object result_printer)
+    void parseDriverOptions(const DriverOptionsType &options, Napi::Object ppd_options)
     {
-        Napi::Env env = result_printer.Env();
+        Napi::Env env = ppd_options.Env();
+
+        for (const auto &itOption : options)
+        {
+            Napi::Object ppd_suboptions = Napi::Object::New(env);
+            for (const auto &itChoice : itOption.second)
+            {
+                ppd_suboptions.Set(itChoice.first, Napi::Boolean::New(env, itChoice.second));
+            }
+            ppd_options.Set(itOption.first, ppd_suboptions);
+        }
+    }
 
-        result_printer.Set("name", Napi::String::New(env, printer->name));
-        result_printer.Set("isDefault", Napi::Boolean::New(env, static_cast<bool>(printer->is_default)));
+    /// Copy the name and options of a destination
+    void copyPrinterInfo(const cups_dest_t *printer, PrinterInfo &info)
+    {
+        info.name = printer->name;
+        info.isDefault = static_cast<bool>(printer->is_default);
 
         if (printer->instance)
         {
-            result_printer.Set("instance", Napi::String::New(env, printer->instance));
+            info.instance = printer->instance;
         }
 
-        Napi::Object result_printer_options = Napi::Object::New(env);
         cups_option_t *dest_option = printer->options;
         for (int j = 0; j < printer->num_options; ++j, ++dest_option)
         {
-            result_printer_options.Set(Napi::String::New(env, dest_option->name), Napi::String::New(env, dest_option->value));
+            info.options.push_back(std::make_pair(std::string(dest_option->name), std::string(dest_option->value)));
         }
-        result_printer.Set("options", result_printer_options);
+    }
+
+    /** Retrieve printer info and its active jobs
+     * @return error string.
+     */
+    std::string fetchPrinterInfo(http_t *http, const cups_dest_t *printer, PrinterInfo &info)
+    {
+        copyPrinterInfo(printer, info);
 
         // Get printer jobs
         cups_job_t *jobs;
-        int totalJobs = cupsGetJobs(&jobs, printer->name, 0 /*0 means all users*/, CUPS_WHICHJOBS_ACTIVE);
+        int totalJobs = getJobsTraced(http, &jobs, printer->name, CUPS_WHICHJOBS_ACTIVE);
+        cups_job_t *job = jobs;
+        for (int jobi = 0; jobi < totalJobs; ++jobi, ++job)
+        {
+            info.jobs.push_back(JobInfo(job));
+        }
+        cupsFreeJobs(totalJobs, jobs);
+        return "";
+    }
+
+    /** Parse printer info object
+     * @return error string.
+     */
+    std::string parsePrinterInfo(const PrinterInfo &printer, Napi::Object result_printer)
+    {
+        Napi::Env env = result_printer.Env();
+
+        result_printer.Set("name", Napi::String::New(env, printer.name));
+        result_printer.Set("isDefault", Napi::Boolean::New(env, printer.isDefault));
+
+        if (!printer.instance.empty())
+        {
+            result_printer.Set("instance", Napi::String::New(env, printer.instance));
+        }
+
+        Napi::Object result_printer_options = Napi::Object::New(env);
+        for (const auto &itOption : printer.options)
+        {
+            result_printer_options.Set(Napi::String::New(env, itOption.first), Napi::String::New(env, itOption.second));
+        }
+        result_printer.Set("options", result_printer_options);
+
         std::string error_str;
-        if (totalJobs > 0)
+        if (!printer.jobs.empty())
         {
-            Napi::Array result_printer_jobs = Napi::Array::New(env, totalJobs);
-            int jobi = 0;
-            cups_job_t *job = jobs;
-            for (; jobi < totalJobs; ++jobi, ++job)
+            Napi::Array result_printer_jobs = Napi::Array::New(env, printer.jobs.size());
+            uint32_t jobi = 0;
+            for (const auto &job : printer.jobs)
             {
                 Napi::Object result_printer_job = Napi::Object::New(env);
                 error_str = parseJobObject(job, result_printer_job);
@@ -236,250 +338,3761 @@ namespace
                     // got an error? break then.
                     break;
                 }
-                result_printer_jobs.Set(jobi, result_printer_job);
+                result_printer_jobs.Set(jobi++, result_printer_job);
             }
             result_printer.Set("jobs", result_printer_jobs);
         }
-        cupsFreeJobs(totalJobs, jobs);
         return error_str;
     }
 
-    /// cups option class to automatically free memory.
-    class CupsOptions : public MemValueBase<cups_option_t>
+    /** Retrieve all printers with their active jobs
+     * @return error string.
+     */
+    std::string fetchPrinters(http_t *http, std::vector<PrinterInfo> &printers)
     {
-    protected:
-        int num_options;
-        virtual void free()
+        cups_dest_t *dests = nullptr;
+        int dests_size = getDestsTraced(http, &dests);
+        printers.resize(dests_size > 0 ? dests_size : 0);
+        std::string error_str;
+        cups_dest_t *dest = dests;
+        for (int i = 0; i < dests_size; ++i, ++dest)
         {
-            if (_value != NULL)
+            error_str = fetchPrinterInfo(http, dest, printers[i]);
+            if (!error_str.empty())
             {
-                cupsFreeOptions(num_options, get());
-                _value = NULL;
-                num_options = 0;
+                // got an error? break then
+                break;
             }
         }
+        cupsFreeDests(dests_size, dests);
+        return error_str;
+    }
 
-    public:
-        CupsOptions() : num_options(0) {}
-        ~CupsOptions() { free(); }
-
-        /// Add options from v8 object
-        CupsOptions(const Napi::Object &options) : num_options(0)
+    /** Retrieve a printer with its active jobs
+     * @return error string.
+     */
+    std::string fetchPrinter(http_t *http, const std::string &printername, PrinterInfo &printer)
+    {
+        cups_dest_t *dests = nullptr;
+        int dests_size = getDestsTraced(http, &dests);
+        cups_dest_t *dest = cupsGetDest(printername.c_str(), nullptr, dests_size, dests);
+        if (dest != nullptr)
         {
-            Napi::Array props = options.GetPropertyNames();
-
-            for (uint32_t i = 0; i < props.Length(); ++i)
-            {
-                Napi::Value key = props.Get(i);
-                std::string keyStr = key.ToString().Utf8Value();
-                Napi::Value val = options.Get(key);
-                std::string valStr = val.ToString().Utf8Value();
-
-                num_options = cupsAddOption(keyStr.c_str(), valStr.c_str(), num_options, &_value);
-            }
+            fetchPrinterInfo(http, dest, printer);
         }
-
-        const int &getNumOptions() { return num_options; }
-    };
-}
-
-MY_NODE_MODULE_CALLBACK(getPrinters)
-{
-    MY_NODE_MODULE_ENV(info);
-
-    cups_dest_t *printers = nullptr;
-    int printers_size = cupsGetDests(&printers);
-    Napi::Array result = Napi::Array::New(env, printers_size);
-    cups_dest_t *printer = printers;
-    std::string error_str;
-    for (int i = 0; i < printers_size; ++i, ++printer)
-    {
-        Napi::Object result_printer = Napi::Object::New(env);
-        error_str = parsePrinterInfo(printer, result_printer);
-        if (!error_str.empty())
+        cupsFreeDests(dests_size, dests);
+        if (dest == nullptr)
         {
-            // got an error? break then
-            break;
+            return "Printer not found";
         }
-        result.Set(i, result_printer);
+        return "";
     }
-    cupsFreeDests(printers_size, printers);
-    if (!error_str.empty())
+
+    /** Retrieve the driver options of a printer
+     * @return error string.
+     */
+    std::string fetchPrinterDriverOptions(http_t *http, const std::string &printername, DriverOptionsType &options)
     {
-        // got an error? return the error then
-        Napi::TypeError::New(env, error_str).ThrowAsJavaScriptException();
-        return env.Null();
+        cups_dest_t *dests = nullptr;
+        int dests_size = getDestsTraced(http, &dests);
+        cups_dest_t *dest = cupsGetDest(printername.c_str(), nullptr, dests_size, dests);
+        if (dest != nullptr)
+        {
+            fetchDriverOptions(http, dest, options);
+        }
+        cupsFreeDests(dests_size, dests);
+        if (dest == nullptr)
+        {
+            return "Printer not found";
+        }
+        return "";
     }
-    return result;
-}
-
-MY_NODE_MODULE_CALLBACK(getDefaultPrinterName)
-{
-    MY_NODE_MODULE_ENV(info);
-    // This does not return default user printer name according to https://www.cups.org/documentation.php/doc-2.0/api-cups.html#cupsGetDefault2
-    // so leave as undefined and JS implementation will loop in all printers
-    /*
-    const char * printerName = cupsGetDefault();
 
-    // return default printer name only if defined
-    if(printerName != NULL) {
-        return Napi::String::New(env, printerName);
+    /** Retrieve a job of a printer
+     * @return error string.
+     */
+    std::string fetchJob(http_t *http, const std::string &printername, int jobId, JobInfo &result)
+    {
+        cups_job_t *jobs = nullptr;
+        bool found = false;
+        int totalJobs = getJobsTraced(http, &jobs, printername.c_str(), CUPS_WHICHJOBS_ALL);
+        cups_job_t *job = jobs;
+        for (int jobi = 0; jobi < totalJobs; ++jobi, ++job)
+        {
+            if (job->id != jobId)
+            {
+                continue;
+            }
+            // Job Found
+            result = JobInfo(job);
+            found = true;
+            break;
+        }
+        cupsFreeJobs(totalJobs, jobs);
+        if (!found)
+        {
+            return "Printer job not found";
+        }
+        return "";
     }
-    */
-    return env.Undefined();
-}
-
-MY_NODE_MODULE_CALLBACK(getPrinter)
-{
-    MY_NODE_MODULE_ENV(info);
 
-    REQUIRE_ARGUMENTS(info, 1);
-    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    typedef std::map<std::string, ipp_op_t> JobCommandMapType;
 
-    cups_dest_t *printers = nullptr;
-    cups_dest_t *printer = nullptr;
-    int printers_size = cupsGetDests(&printers);
-    printer = cupsGetDest(printername.c_str(), nullptr, printers_size, printers);
-    Napi::Object result_printer = Napi::Object::New(env);
-    if (printer != nullptr)
+    /** IPP operation of each job command. PAUSE and RESUME are the names used on windows
+     */
+    JobCommandMapType newJobCommandMap()
     {
-        parsePrinterInfo(printer, result_printer);
+        JobCommandMapType result;
+#define COMMAND_JOB_ADD(value, type) result.insert(std::make_pair(value, type))
+        COMMAND_JOB_ADD("CANCEL", IPP_OP_CANCEL_JOB);
+        COMMAND_JOB_ADD("HOLD", IPP_OP_HOLD_JOB);
+        COMMAND_JOB_ADD("PAUSE", IPP_OP_HOLD_JOB);
+        COMMAND_JOB_ADD("RELEASE", IPP_OP_RELEASE_JOB);
+        COMMAND_JOB_ADD("RESUME", IPP_OP_RELEASE_JOB);
+        COMMAND_JOB_ADD("RESTART", IPP_OP_RESTART_JOB);
+        COMMAND_JOB_ADD("PRIORITY", IPP_OP_SET_JOB_ATTRIBUTES);
+#undef COMMAND_JOB_ADD
+        return result;
     }
-    cupsFreeDests(printers_size, printers);
-    if (printer == nullptr)
+
+    /// Built once, thread safe, never modified afterwards
+    const JobCommandMapType &getJobCommandMap()
     {
-        // printer not found
-        Napi::TypeError::New(env, "Printer not found").ThrowAsJavaScriptException();
-        return env.Null();
+        static const JobCommandMapType result = newJobCommandMap();
+        return result;
     }
-    return result_printer;
-}
-
-MY_NODE_MODULE_CALLBACK(getPrinterDriverOptions)
-{
-    MY_NODE_MODULE_ENV(info);
-
-    REQUIRE_ARGUMENTS(info, 1);
-    REQUIRE_ARGUMENT_STRING(info, 0, printername);
 
-    cups_dest_t *printers = nullptr;
-    cups_dest_t *printer = nullptr;
-    int printers_size = cupsGetDests(&printers);
-    printer = cupsGetDest(printername.c_str(), nullptr, printers_size, printers);
-    Napi::Object driver_options = Napi::Object::New(env);
-    if (printer != nullptr)
+    /** Check a job command name
+     * @return true if command is supported by executeJobCommand
+     */
+    bool isSupportedJobCommand(const std::string &jobCommand)
     {
-        parseDriverOptions(printer, driver_options);
+        return getJobCommandMap().find(jobCommand) != getJobCommandMap().end();
     }
-    cupsFreeDests(printers_size, printers);
-    if (printer == nullptr)
+
+    /** Check a job command and read its value. Only PRIORITY takes a value, from 1 to 100
+     * @return error string. if empty, then no error
+     */
+    std::string checkJobCommand(const std::string &jobCommand, const Napi::Value &valueArg, int &value)
     {
-        // printer not found
-        Napi::TypeError::New(env, "Printer not found").ThrowAsJavaScriptException();
-        return env.Null();
+        if (!isSupportedJobCommand(jobCommand))
+        {
+            return "wrong job command. use getSupportedJobCommands to see the possible commands";
+        }
+        value = 0;
+        if (jobCommand == "PRIORITY")
+        {
+            if (!valueArg.IsNumber())
+            {
+                return "PRIORITY command requires a priority value";
+            }
+            value = valueArg.As<Napi::Number>().Int32Value();
+            if (value < 1 || value > 100)
+            {
+                return "job priority must be between 1 and 100";
+            }
+        }
+        return "";
     }
-    return driver_options;
-}
 
-MY_NODE_MODULE_CALLBACK(getJob)
-{
-    MY_NODE_MODULE_ENV(info);
-
-    REQUIRE_ARGUMENTS(info, 1);
-    REQUIRE_ARGUMENT_STRING(info, 0, printername);
-    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
-
-    Napi::Object result_printer_job = Napi::Object::New(env);
-    // Get printer jobs
-    cups_job_t *jobs = nullptr;
-    cups_job_t *jobFound = nullptr;
-    int totalJobs = cupsGetJobs(&jobs, printername.c_str(), 0 /*0 means all users*/, CUPS_WHICHJOBS_ALL);
-    if (totalJobs > 0)
+    /** Read an array of job ids
+     * @return false if value is not an array of positive integers
+     */
+    bool getJobIds(const Napi::Value &value, std::vector<int> &jobIds)
     {
-        int jobi = 0;
-        cups_job_t *job = jobs;
-        for (; jobi < totalJobs; ++jobi, ++job)
+        if (!value.IsArray())
         {
-            if (job->id != jobId)
+            return false;
+        }
+        Napi::Array array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); ++i)
+        {
+            Napi::Value jobId = array.Get(i);
+            if (!jobId.IsNumber() || jobId.As<Napi::Number>().Int32Value() <= 0)
             {
-                continue;
+                return false;
             }
-            // Job Found
-            jobFound = job;
-            parseJobObject(job, result_printer_job);
-            break;
+            jobIds.push_back(jobId.As<Napi::Number>().Int32Value());
         }
+        return true;
     }
-    cupsFreeJobs(totalJobs, jobs);
-    if (jobFound == nullptr)
+
+    std::string makePrinterUri(const std::string &printername)
     {
-        // printer not found
-        Napi::TypeError::New(env, "Printer job not found").ThrowAsJavaScriptException();
-        return env.Null();
+        char buffer[1024];
+        httpAssembleURIf(HTTP_URI_CODING_ALL, buffer, sizeof(buffer), "ipp", nullptr, "localhost", 0, "/printers/%s", printername.c_str());
+        return buffer;
     }
-    return result_printer_job;
-}
 
-MY_NODE_MODULE_CALLBACK(setJob)
-{
-    MY_NODE_MODULE_ENV(info);
+    /** New job operation request on a printer
+     * @param jobId target job, or 0 if the operation has no job-id
+     */
+    ipp_t *newJobRequest(ipp_op_t operation, const std::string &printername, int jobId)
+    {
+        ipp_t *request = ippNewRequest(operation);
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", nullptr, makePrinterUri(printername).c_str());
+        if (jobId > 0)
+        {
+            ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", jobId);
+        }
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr, cupsUser());
+        return request;
+    }
 
-    REQUIRE_ARGUMENTS(info, 3);
-    REQUIRE_ARGUMENT_STRING(info, 0, printername);
-    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
-    REQUIRE_ARGUMENT_STRING(info, 2, jobCommand);
-    if (jobId < 0)
+    /** Count a failed job operation as an error of the current call
+     * @return ok
+     */
+    bool reportJobResult(bool ok)
     {
-        RETURN_EXCEPTION_STR("Wrong job number");
+        CallStats *stats = CallStats::getCurrent();
+        if (!ok && stats != nullptr)
+        {
+            stats->setError();
+        }
+        return ok;
     }
-    bool result_ok = false;
-    if (jobCommand == "CANCEL")
+
+    /** Send a job operation request and free it
+     * @param jobId target job for the trace, 0 if none
+     * @return true on success
+     */
+    bool doJobRequest(http_t *http, const std::string &printername, int jobId, ipp_t *request)
     {
-        result_ok = (cupsCancelJob(printername.c_str(), jobId) == 1);
+        TraceSpan span("cupsDoRequest", printername, jobId);
+        ippDelete(cupsDoRequest(http, request, "/jobs/"));
+        span.setStatus(cupsLastError());
+        return reportJobResult(cupsLastError() <= IPP_STATUS_OK_CONFLICTING);
     }
-    else
+
+    /** Cancel a job, or all jobs with CUPS_JOBID_ALL
+     * @return true on success
+     */
+    bool cancelJobTraced(http_t *http, const std::string &printername, int jobId, int purge)
     {
-        RETURN_EXCEPTION_STR("wrong job command. use getSupportedJobCommands to see the possible commands");
+        TraceSpan span("cupsCancelJob2", printername, jobId);
+        ipp_status_t status = cupsCancelJob2(http, printername.c_str(), jobId, purge);
+        span.setStatus(status);
+        return reportJobResult(status == IPP_STATUS_OK);
     }
-    return Napi::Boolean::New(env, result_ok);
-}
 
-MY_NODE_MODULE_CALLBACK(getSupportedJobCommands)
-{
-    MY_NODE_MODULE_ENV(info);
+    /** Execute a job command
+     * @param value command value, see checkJobCommand
+     * @return true on success
+     */
+    bool executeJobCommand(http_t *http, const std::string &printername, int jobId, const std::string &jobCommand, int value)
+    {
+        JobCommandMapType::const_iterator itJobCommand = getJobCommandMap().find(jobCommand);
+        if (itJobCommand == getJobCommandMap().end())
+        {
+            return false;
+        }
+        if (itJobCommand->second == IPP_OP_CANCEL_JOB)
+        {
+            return cancelJobTraced(http, printername, jobId, 0);
+        }
+        ipp_t *request = newJobRequest(itJobCommand->second, printername, jobId);
+        if (itJobCommand->second == IPP_OP_HOLD_JOB)
+        {
+            ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "job-hold-until", nullptr, "indefinite");
+        }
+        else if (itJobCommand->second == IPP_OP_SET_JOB_ATTRIBUTES)
+        {
+            ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-priority", value);
+        }
+        return doJobRequest(http, printername, jobId, request);
+    }
+
+    /** Execute a job command on several jobs of a printer.
+     * CANCEL is sent as a single Cancel-Jobs request. IPP has no multi-job variant
+     * of the other operations: they are sent one after the other on the same connection.
+     * @return true if the command succeeded for every job
+     */
+    bool executeJobsCommand(http_t *http, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value)
+    {
+        if (jobIds.empty())
+        {
+            return true;
+        }
+        if (jobCommand == "CANCEL")
+        {
+            ipp_t *request = newJobRequest(IPP_OP_CANCEL_JOBS, printername, 0);
+            ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-ids", static_cast<int>(jobIds.size()), &jobIds[0]);
+            return doJobRequest(http, printername, 0, request);
+        }
+        bool result = true;
+        for (int jobId : jobIds)
+        {
+            result = executeJobCommand(http, printername, jobId, jobCommand, value) && result;
+        }
+        return result;
+    }
+
+    /** Cancel all jobs of a printer with a single request
+     * @param purge also remove the job history and files (Purge-Jobs)
+     * @return true on success
+     */
+    bool cancelAllPrinterJobs(http_t *http, const std::string &printername, bool purge)
+    {
+        return cancelJobTraced(http, printername, CUPS_JOBID_ALL, purge ? 1 : 0);
+    }
+
+    /** Move a job, or all jobs if jobId is 0, to another printer with CUPS-Move-Job.
+     * The documents stay on the server: nothing is uploaded again.
+     * @return true on success
+     */
+    bool moveJob(http_t *http, const std::string &from, int jobId, const std::string &to)
+    {
+        ipp_t *request = newJobRequest(IPP_OP_CUPS_MOVE_JOB, from, jobId);
+        ippAddString(request, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri", nullptr, makePrinterUri(to).c_str());
+        return doJobRequest(http, from, jobId, request);
+    }
+
+    /** Move jobs to another printer. IPP has no multi-job move: requests share one connection.
+     * @param movedJobIds jobs successfully moved
+     */
+    void moveJobsTo(http_t *http, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &movedJobIds)
+    {
+        for (int jobId : jobIds)
+        {
+            if (moveJob(http, from, jobId, to))
+            {
+                movedJobIds.push_back(jobId);
+            }
+        }
+    }
+
+    Napi::Value convertJobIds(Napi::Env env, const std::vector<int> &jobIds)
+    {
+        Napi::Array result = Napi::Array::New(env, jobIds.size());
+        for (size_t i = 0; i < jobIds.size(); ++i)
+        {
+            result.Set(static_cast<uint32_t>(i), Napi::Number::New(env, jobIds[i]));
+        }
+        return result;
+    }
+
+    Napi::Value convertPrinters(Napi::Env env, const std::vector<PrinterInfo> &printers)
+    {
+        Napi::Array result = Napi::Array::New(env, printers.size());
+        for (size_t i = 0; i < printers.size(); ++i)
+        {
+            Napi::Object result_printer = Napi::Object::New(env);
+            parsePrinterInfo(printers[i], result_printer);
+            result.Set(static_cast<uint32_t>(i), result_printer);
+        }
+        return result;
+    }
+
+    Napi::Value convertPrinter(Napi::Env env, const PrinterInfo &printer)
+    {
+        Napi::Object result_printer = Napi::Object::New(env);
+        parsePrinterInfo(printer, result_printer);
+        return result_printer;
+    }
+
+    Napi::Value convertDriverOptions(Napi::Env env, const DriverOptionsType &options)
+    {
+        Napi::Object driver_options = Napi::Object::New(env);
+        parseDriverOptions(options, driver_options);
+        return driver_options;
+    }
+
+    Napi::Value convertJob(Napi::Env env, const JobInfo &job)
+    {
+        Napi::Object result_printer_job = Napi::Object::New(env);
+        parseJobObject(job, result_printer_job);
+        return result_printer_job;
+    }
+
+    Napi::Value convertBoolean(Napi::Env env, const bool &value)
+    {
+        return Napi::Boolean::New(env, value);
+    }
+
+    Napi::Value convertJobId(Napi::Env env, const int &jobId)
+    {
+        return Napi::Number::New(env, jobId);
+    }
+
+    /** Address of a print server.
+     * Printers of a server other than the one of libcups are named "queue@name",
+     * name being the server name given to addPrintServer or "host[:port]".
+     */
+    struct PrintServer
+    {
+        /// empty for the server of libcups
+        std::string name;
+        std::string host;
+        int port;
+        http_encryption_t encryption;
+
+        PrintServer() : port(0), encryption(HTTP_ENCRYPTION_IF_REQUESTED) {}
+
+        /// The server of libcups: CUPS_SERVER, client.conf or the local scheduler
+        static PrintServer getDefault()
+        {
+            PrintServer server;
+            server.host = cupsServer();
+            server.port = ippPort();
+            server.encryption = cupsEncryption();
+            return server;
+        }
+
+        /// Identifies the connections to the server
+        std::string getKey() const { return host + ":" + std::to_string(port) + ":" + std::to_string(static_cast<int>(encryption)); }
+
+        /// Name of a queue of this server as given to the module functions
+        std::string getPrinterName(const std::string &queue) const { return (name.empty() || queue.empty()) ? queue : queue + "@" + name; }
+
+        /// Queue name of a printer of this server
+        std::string getQueue(const std::string &printername) const
+        {
+            if (name.empty() || printername.size() <= name.size() || printername.compare(printername.size() - name.size() - 1, std::string::npos, "@" + name) != 0)
+            {
+                return printername;
+            }
+            return printername.substr(0, printername.size() - name.size() - 1);
+        }
+    };
+
+    /** Print servers registered with addPrintServer in an environment, by name
+     */
+    struct PrintServers
+    {
+        std::mutex mutex;
+        std::map<std::string, PrintServer> servers;
+    };
+
+    /** Server of a name: the one registered in printServers, else name is read as "host[:port]"
+     * with the port and encryption of libcups. An empty name is the server of libcups.
+     */
+    PrintServer getPrintServer(PrintServers &printServers, const std::string &name)
+    {
+        if (name.empty())
+        {
+            return PrintServer::getDefault();
+        }
+        {
+            std::lock_guard<std::mutex> lock(printServers.mutex);
+            std::map<std::string, PrintServer>::const_iterator itServer = printServers.servers.find(name);
+            if (itServer != printServers.servers.end())
+            {
+                return itServer->second;
+            }
+        }
+        PrintServer server;
+        server.name = name;
+        server.host = name;
+        server.port = ippPort();
+        server.encryption = cupsEncryption();
+        // a port after the last ':', unless it is part of an [IPv6] address
+        size_t colon = name.rfind(':');
+        if (colon != std::string::npos && colon + 1 < name.size() && name.find(']', colon) == std::string::npos &&
+            name.find_first_not_of("0123456789", colon + 1) == std::string::npos)
+        {
+            server.host = name.substr(0, colon);
+            server.port = std::atoi(name.c_str() + colon + 1);
+        }
+        return server;
+    }
+
+    /// Name of the server of a printer, after its last '@'. Empty for a printer of the libcups server
+    std::string getServerName(const std::string &printername)
+    {
+        size_t at = printername.rfind('@');
+        return at == std::string::npos ? std::string() : printername.substr(at + 1);
+    }
+
+    /** Connect timeout used when the operation has no deadline, in milliseconds
+     */
+    const int DEFAULT_CONNECT_TIMEOUT = 30000;
+
+    /** Interval at which libcups calls onConnectionTimeout while it waits for the server, in seconds
+     */
+    const double CONNECTION_TIMEOUT_CHECK_INTERVAL = 0.25;
+
+    /** Timeout callback of the module connections.
+     * user_data points to the state of the operation in progress, if any.
+     * @return 1 to keep waiting, 0 to fail the operation
+     */
+    int onConnectionTimeout(http_t *http, void *user_data)
+    {
+        const AbortState *state = *static_cast<AbortState *const *>(user_data);
+        return (state == nullptr || !state->shouldStop()) ? 1 : 0;
+    }
+
+    /** Connect to a print server, honoring the deadline of state.
+     * @param slot receives the operation state the timeout callback checks. It must outlive the connection
+     */
+    http_t *connectServer(const PrintServer &server, AbortState &state, AbortState **slot)
+    {
+        http_t *http = httpConnect2(server.host.c_str(), server.port, nullptr, AF_UNSPEC, server.encryption, 1 /*blocking*/,
+                                    state.getRemainingTime(DEFAULT_CONNECT_TIMEOUT), state.getCancelFlag());
+        if (http != nullptr)
+        {
+            httpSetTimeout(http, CONNECTION_TIMEOUT_CHECK_INTERVAL, onConnectionTimeout, slot);
+        }
+        return http;
+    }
+
+    /** Check that a print server answers an IPP request within timeout milliseconds
+     */
+    bool probeServer(const PrintServer &server, int timeout)
+    {
+        AbortState state;
+        state.setTimeout(timeout);
+        AbortState *slot = &state;
+        http_t *http = connectServer(server, state, &slot);
+        if (http == nullptr)
+        {
+            return false;
+        }
+        ipp_t *response = cupsDoRequest(http, ippNewRequest(IPP_OP_CUPS_GET_DEFAULT), "/");
+        // any IPP answer, even "not found", means the scheduler is alive
+        bool alive = (response != nullptr);
+        ippDelete(response);
+        httpClose(http);
+        return alive;
+    }
+
+    /** Circuit breaker settings, shared by all print servers
+     */
+    std::atomic<int> circuitFailureThreshold(5);
+    std::atomic<int> circuitResetTimeout(5000);
+
+    /** Circuit breaker of a print server.
+     * After circuitFailureThreshold consecutive timeouts or connection failures the
+     * circuit opens: operations fail fast with ECIRCUITOPEN instead of waiting on the
+     * server, while a background thread probes it every circuitResetTimeout
+     * milliseconds and closes the circuit as soon as it answers again.
+     */
+    class CircuitBreaker
+    {
+    public:
+        CircuitBreaker(const PrintServer &server) : _server(server), _failures(0), _open(false), _stopping(false) {}
+
+        ~CircuitBreaker()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _condition.notify_all();
+            if (_probe.joinable())
+            {
+                _probe.join();
+            }
+        }
+
+        bool isOpen()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _open;
+        }
+
+        int getFailures()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _failures;
+        }
+
+        void recordSuccess()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_open)
+            {
+                _failures = 0;
+            }
+        }
+
+        void recordFailure()
+        {
+            std::thread previous;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                ++_failures;
+                int threshold = circuitFailureThreshold;
+                if (_open || _stopping || threshold <= 0 || _failures < threshold)
+                {
+                    return;
+                }
+                _open = true;
+                // the previous probe exits once it closed the circuit
+                previous.swap(_probe);
+                _probe = std::thread(&CircuitBreaker::probe, this);
+            }
+            if (previous.joinable())
+            {
+                previous.join();
+            }
+        }
+
+        /// Close the circuit without waiting for a successful probe
+        void reset()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _open = false;
+                _failures = 0;
+            }
+            _condition.notify_all();
+        }
+
+    private:
+        PrintServer _server;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        int _failures;
+        bool _open;
+        bool _stopping;
+        std::thread _probe;
+
+        void probe()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_open && !_stopping)
+            {
+                int resetTimeout = circuitResetTimeout;
+                _condition.wait_for(lock, std::chrono::milliseconds(resetTimeout));
+                if (!_open || _stopping)
+                {
+                    break;
+                }
+                lock.unlock();
+                bool alive = probeServer(_server, resetTimeout);
+                lock.lock();
+                if (alive)
+                {
+                    _open = false;
+                    _failures = 0;
+                }
+            }
+        }
+    };
+
+    typedef std::map<std::string, std::shared_ptr<CircuitBreaker>> CircuitBreakerMapType;
+
+    /** Circuit breakers of the print servers used so far, by "server:port"
+     */
+    struct CircuitBreakers
+    {
+        std::mutex mutex;
+        CircuitBreakerMapType breakers;
+    };
+
+    CircuitBreakers &getCircuitBreakers()
+    {
+        static CircuitBreakers result;
+        return result;
+    }
+
+    std::shared_ptr<CircuitBreaker> getCircuitBreaker(const PrintServer &server)
+    {
+        CircuitBreakers &circuitBreakers = getCircuitBreakers();
+        std::lock_guard<std::mutex> lock(circuitBreakers.mutex);
+        std::shared_ptr<CircuitBreaker> &breaker = circuitBreakers.breakers[server.host + ":" + std::to_string(server.port)];
+        if (!breaker)
+        {
+            breaker = std::make_shared<CircuitBreaker>(server);
+        }
+        return breaker;
+    }
+
+    /** Connection of a thread to a print server.
+     * It is opened on first use and kept for the next operations of the same thread:
+     * pool threads for asynchronous methods, the main thread for synchronous ones.
+     * Keeping it open also keeps its TLS session.
+     */
+    struct ThreadConnection
+    {
+        http_t *http;
+        /// state of the operation in progress, checked by the timeout callback
+        AbortState *state;
+
+        ThreadConnection() : http(nullptr), state(nullptr) {}
+        ThreadConnection(const ThreadConnection &) = delete;
+        ~ThreadConnection()
+        {
+            if (http != nullptr)
+            {
+                httpClose(http);
+            }
+        }
+    };
+
+    /// Connections of the current thread, by PrintServer::getKey()
+    thread_local std::map<std::string, ThreadConnection> threadConnections;
+
+    /** Use the connection of the current thread to a server for an operation.
+     * The operation fails when its deadline expires, and aborting it shuts the
+     * connection down, which interrupts any blocking read or write. Such a connection
+     * is closed at the end of the operation and reopened by the next one.
+     * Outcomes are reported to the circuit breaker of the server; while it is open no connection is attempted.
+     */
+    class TaskConnection
+    {
+    public:
+        TaskConnection(AbortState &state, const PrintServer &server)
+            : _ippTimer(CallStats::getCurrent(), StatsTimer::IPP), _state(state), _server(server),
+              _connection(threadConnections[server.getKey()]), _breaker(getCircuitBreaker(server)), _connected(false)
+        {
+            if (_breaker->isOpen())
+            {
+                _state.setErrorCode(ERROR_CODE_CIRCUIT_OPEN);
+                return;
+            }
+            if (_state.shouldStop())
+            {
+                return;
+            }
+            if (_connection.http == nullptr)
+            {
+                _connection.http = connectServer(_server, _state, &_connection.state);
+                if (_connection.http == nullptr)
+                {
+                    if (!_state.isAborted())
+                    {
+                        _breaker->recordFailure();
+                    }
+                    if (!_state.shouldStop())
+                    {
+                        _state.setErrorCode(ERROR_CODE_CONNECTION);
+                    }
+                    return;
+                }
+            }
+            _connected = true;
+            _connection.state = &_state;
+            http_t *http = _connection.http;
+            _state.setInterrupt([http]()
+                                { httpShutdown(http); });
+        }
+
+        ~TaskConnection()
+        {
+            if (!_connected)
+            {
+                return;
+            }
+            _state.clearInterrupt();
+            _connection.state = nullptr;
+            if (_state.isTimedOut())
+            {
+                _breaker->recordFailure();
+            }
+            else if (!_state.isAborted())
+            {
+                _breaker->recordSuccess();
+            }
+            if (_state.shouldStop())
+            {
+                httpClose(_connection.http);
+                _connection.http = nullptr;
+            }
+        }
+
+        http_t *get() const { return _connected ? _connection.http : nullptr; }
+
+        std::string getError() const
+        {
+            if (_state.isAborted())
+            {
+                return ABORT_ERROR_MESSAGE;
+            }
+            if (_state.isTimedOut())
+            {
+                return TIMEOUT_ERROR_MESSAGE;
+            }
+            if (_state.getErrorCode() == ERROR_CODE_CIRCUIT_OPEN)
+            {
+                return "The print server " + _server.host + " is not responding";
+            }
+            return "Unable to connect to the print server " + _server.host;
+        }
+
+    private:
+        /// the time a connection is used is the IPP time of the call
+        StatsTimer _ippTimer;
+        AbortState &_state;
+        PrintServer _server;
+        ThreadConnection &_connection;
+        std::shared_ptr<CircuitBreaker> _breaker;
+        bool _connected;
+    };
+
+    /** Run a task function on the main thread, with the default timeout
+     * @param error_code set to the code of the error, if any
+     * @return error string. if empty, then no error
+     */
+    template <typename ResultType>
+    std::string runSync(const typename FunctionTask<ResultType>::ExecuteFunction &fn, ResultType &result, std::string &error_code)
+    {
+        AbortState state;
+        state.setTimeout(getDefaultTaskTimeout());
+        std::string error_str = fn(result, state);
+        if (!error_str.empty())
+        {
+            if (CallStats::getCurrent() != nullptr)
+            {
+                CallStats::getCurrent()->setError();
+            }
+            error_code = state.getErrorCode();
+            if (error_code == ERROR_CODE_TIMEDOUT)
+            {
+                error_str = TIMEOUT_ERROR_MESSAGE;
+            }
+        }
+        return error_str;
+    }
+
+    /** Tracker of the end-to-end latency of the jobs an environment submits, one per environment.
+     * Once started, every job its uploadDocument calls create is watched by a background thread,
+     * which polls the active jobs of the printers having tracked jobs. Per printer it records
+     * the queue wait, from submission to IPP_JOB_PROCESSING, and the print time, from
+     * IPP_JOB_PROCESSING to IPP_JOB_COMPLETED. Their resolution is the poll interval;
+     * jobs completed between two polls are split with the server processing time.
+     */
+    class JobTracker
+    {
+    public:
+        /// Stop watching a job after this time, e.g. a job held forever
+        static const int MAX_TRACKING_TIME = 24 * 3600 * 1000;
+
+        /// @param printServers servers of the environment, to poll the printers of "queue@server" names
+        explicit JobTracker(const std::shared_ptr<PrintServers> &printServers)
+            : _printServers(printServers), _running(false), _stopping(false), _interval(0), _polling(nullptr) {}
+
+        ~JobTracker() { stop(); }
+
+        /// @param interval poll interval in milliseconds
+        void start(int interval)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(_mutex);
+            _interval = interval;
+            _stopping = false;
+            _running = true;
+            _thread = std::thread(&JobTracker::run, this);
+        }
+
+        /** Stop the thread and forget the jobs being tracked. Statistics are kept.
+         * The poll in progress is aborted, which shuts its connection down: no wait for a slow server
+         */
+        void stop()
+        {
+            std::thread thread;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _running = false;
+                _stopping = true;
+                _jobs.clear();
+                thread.swap(_thread);
+                if (_polling != nullptr)
+                {
+                    _polling->abort();
+                }
+            }
+            _condition.notify_all();
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+
+        /// Watch a submitted job. Thread safe, no-op if the tracker is stopped
+        void track(const std::string &printername, int jobId)
+        {
+            if (!_running)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_running)
+            {
+                TrackedJob &job = _jobs[printername][jobId];
+                job.submitted = Clock::now();
+                // listed by snapshot from its first pending job
+                std::unique_ptr<PrinterLatency> &entry = _printers[printername];
+                if (!entry)
+                {
+                    entry.reset(new PrinterLatency());
+                }
+            }
+        }
+
+        /** Get {printer: {completed, failed, pending, queueWait, printTime}}, durations in milliseconds
+         * @param reset clear the statistics while reading them
+         */
+        Napi::Object snapshot(Napi::Env env, bool reset)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Napi::Object result = Napi::Object::New(env);
+            for (const auto &itPrinter : _printers)
+            {
+                PrinterLatency &latency = *itPrinter.second;
+                auto itJobs = _jobs.find(itPrinter.first);
+                Napi::Object result_printer = Napi::Object::New(env);
+                result_printer.Set("completed", Napi::Number::New(env, static_cast<double>(reset ? latency.completed.exchange(0) : latency.completed.load())));
+                result_printer.Set("failed", Napi::Number::New(env, static_cast<double>(reset ? latency.failed.exchange(0) : latency.failed.load())));
+                result_printer.Set("pending", Napi::Number::New(env, static_cast<double>(itJobs != _jobs.end() ? itJobs->second.size() : 0)));
+                result_printer.Set("queueWait", latency.queueWait.snapshot(env, reset));
+                result_printer.Set("printTime", latency.printTime.snapshot(env, reset));
+                result.Set(itPrinter.first, result_printer);
+            }
+            return result;
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct TrackedJob
+        {
+            Clock::time_point submitted;
+            Clock::time_point processing;
+            bool isProcessing;
+
+            TrackedJob() : isProcessing(false) {}
+        };
+
+        struct PrinterLatency
+        {
+            std::atomic<uint64_t> completed;
+            std::atomic<uint64_t> failed;
+            LatencyHistogram queueWait;
+            LatencyHistogram printTime;
+
+            PrinterLatency() : completed(0), failed(0) {}
+        };
+
+        typedef std::map<int, TrackedJob> TrackedJobsType;
+
+        std::shared_ptr<PrintServers> _printServers;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::thread _thread;
+        std::atomic<bool> _running;
+        bool _stopping;
+        int _interval;
+        std::map<std::string, TrackedJobsType> _jobs;
+        /// entries are never removed
+        std::map<std::string, std::unique_ptr<PrinterLatency>> _printers;
+        /// state of the poll in progress, aborted by stop
+        AbortState *_polling;
+
+        static uint64_t toMicros(Clock::duration duration)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stopping)
+            {
+                _condition.wait_for(lock, std::chrono::milliseconds(_interval));
+                if (_stopping)
+                {
+                    break;
+                }
+                std::vector<std::string> printers;
+                for (const auto &itJobs : _jobs)
+                {
+                    printers.push_back(itJobs.first);
+                }
+                lock.unlock();
+                poll(printers);
+                lock.lock();
+            }
+        }
+
+        /// Poll the printers with tracked jobs, server by server
+        void poll(const std::vector<std::string> &printers)
+        {
+            std::map<std::string, std::vector<std::string>> serverPrinters;
+            for (const auto &printername : printers)
+            {
+                serverPrinters[getServerName(printername)].push_back(printername);
+            }
+            for (const auto &itServer : serverPrinters)
+            {
+                PrintServer server = getPrintServer(*_printServers, itServer.first);
+                AbortState state;
+                state.setTimeout(DEFAULT_CONNECT_TIMEOUT);
+                if (!setPolling(&state))
+                {
+                    return;
+                }
+                pollServer(state, server, itServer.second);
+                setPolling(nullptr);
+            }
+        }
+
+        /// @return false if the tracker is stopping
+        bool setPolling(AbortState *state)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _polling = state;
+            return !_stopping;
+        }
+
+        void pollServer(AbortState &state, const PrintServer &server, const std::vector<std::string> &printers)
+        {
+            TaskConnection connection(state, server);
+            if (connection.get() == nullptr)
+            {
+                return;
+            }
+            for (const auto &printername : printers)
+            {
+                if (!_running || state.shouldStop())
+                {
+                    return;
+                }
+                pollPrinter(connection.get(), server, printername);
+            }
+        }
+
+        void pollPrinter(http_t *http, const PrintServer &server, const std::string &printername)
+        {
+            std::string queue = server.getQueue(printername);
+            cups_job_t *jobs = nullptr;
+            int totalJobs = cupsGetJobs2(http, &jobs, queue.c_str(), 0 /*0 means all users*/, CUPS_WHICHJOBS_ACTIVE);
+            if (totalJobs < 0)
+            {
+                return;
+            }
+            std::map<int, int> active;
+            for (int jobi = 0; jobi < totalJobs; ++jobi)
+            {
+                active[jobs[jobi].id] = jobs[jobi].state;
+            }
+            cupsFreeJobs(totalJobs, jobs);
+
+            Clock::time_point now = Clock::now();
+            std::vector<std::pair<int, TrackedJob>> finished;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                auto itJobs = _jobs.find(printername);
+                if (itJobs == _jobs.end())
+                {
+                    return;
+                }
+                for (auto itJob = itJobs->second.begin(); itJob != itJobs->second.end();)
+                {
+                    auto itActive = active.find(itJob->first);
+                    if (itActive == active.end())
+                    {
+                        // no longer active: completed, cancelled or aborted
+                        finished.push_back(*itJob);
+                        itJob = itJobs->second.erase(itJob);
+                        continue;
+                    }
+                    if (itActive->second == IPP_JOB_PROCESSING && !itJob->second.isProcessing)
+                    {
+                        itJob->second.isProcessing = true;
+                        itJob->second.processing = now;
+                    }
+                    if (now - itJob->second.submitted > std::chrono::milliseconds(MAX_TRACKING_TIME))
+                    {
+                        itJob = itJobs->second.erase(itJob);
+                        continue;
+                    }
+                    ++itJob;
+                }
+                if (itJobs->second.empty())
+                {
+                    _jobs.erase(itJobs);
+                }
+            }
+
+            for (const auto &itJob : finished)
+            {
+                recordFinished(http, printername, queue, itJob.first, itJob.second, now);
+            }
+        }
+
+        void recordFinished(http_t *http, const std::string &printername, const std::string &queue, int jobId, const TrackedJob &job, Clock::time_point now)
+        {
+            ipp_t *response = cupsDoRequest(http, newJobRequest(IPP_OP_GET_JOB_ATTRIBUTES, queue, jobId), "/");
+            ipp_attribute_t *attr = (response != nullptr) ? ippFindAttribute(response, "job-state", IPP_TAG_ENUM) : nullptr;
+            int jobState = (attr != nullptr) ? ippGetInteger(attr, 0) : IPP_JOB_ABORTED;
+            attr = (response != nullptr) ? ippFindAttribute(response, "time-at-processing", IPP_TAG_INTEGER) : nullptr;
+            int processingTime = (attr != nullptr) ? ippGetInteger(attr, 0) : 0;
+            attr = (response != nullptr) ? ippFindAttribute(response, "time-at-completed", IPP_TAG_INTEGER) : nullptr;
+            int completedTime = (attr != nullptr) ? ippGetInteger(attr, 0) : 0;
+            ippDelete(response);
+
+            PrinterLatency *latency = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                std::unique_ptr<PrinterLatency> &entry = _printers[printername];
+                if (!entry)
+                {
+                    entry.reset(new PrinterLatency());
+                }
+                latency = entry.get();
+            }
+            if (jobState != IPP_JOB_COMPLETED)
+            {
+                latency->failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            uint64_t total = toMicros(now - job.submitted);
+            uint64_t printTime = 0;
+            if (job.isProcessing)
+            {
+                printTime = toMicros(now - job.processing);
+            }
+            else if (processingTime > 0 && completedTime >= processingTime)
+            {
+                // printed between two polls: the server knows how long it took, with a second resolution
+                printTime = std::min(total, static_cast<uint64_t>(completedTime - processingTime) * 1000000);
+            }
+            latency->completed.fetch_add(1, std::memory_order_relaxed);
+            latency->queueWait.record(total - printTime);
+            latency->printTime.record(printTime);
+        }
+    };
+
+    /** Size of the chunks written to the print server. Abort is checked between chunks.
+     */
+    const size_t WRITE_CHUNK_SIZE = 64 * 1024;
+
+    /// Document held in memory
+    class MemorySource : public DocumentSource
+    {
+    public:
+        MemorySource(const char *data, size_t size) : _data(data), _size(size), _offset(0) {}
+
+        virtual bool next(const char *&chunk, size_t &length)
+        {
+            if (_offset >= _size)
+            {
+                return false;
+            }
+            chunk = _data + _offset;
+            length = std::min(WRITE_CHUNK_SIZE, _size - _offset);
+            _offset += length;
+            return true;
+        }
+
+        virtual int64_t getSize() const { return static_cast<int64_t>(_size); }
+
+    private:
+        const char *_data;
+        size_t _size;
+        size_t _offset;
+    };
+
+    /// Document read from a file
+    class FileSource : public DocumentSource
+    {
+    public:
+        FileSource(const std::string &filename) : _filename(filename), _file(fopen(filename.c_str(), "rb")), _buffer(WRITE_CHUNK_SIZE) {}
+
+        ~FileSource()
+        {
+            if (_file != nullptr)
+            {
+                fclose(_file);
+            }
+        }
+
+        bool isOpen() const { return _file != nullptr; }
+
+        virtual bool next(const char *&chunk, size_t &length)
+        {
+            if (_file == nullptr)
+            {
+                return false;
+            }
+            length = fread(&_buffer[0], 1, _buffer.size(), _file);
+            chunk = &_buffer[0];
+            return length > 0;
+        }
+
+        /// resolveAutoFormat of the file: its first bytes are read, then the file is rewound
+        std::string resolveFormat(PrintBackend &backend, AbortState &state, const std::string &printername, const std::string &format)
+        {
+            size_t length = fread(&_buffer[0], 1, std::min(_buffer.size(), SNIFF_SIZE), _file);
+            rewind(_file);
+            return resolveAutoFormat(backend, state, printername, format, &_buffer[0], length);
+        }
+
+        virtual int64_t getSize() const
+        {
+            struct stat info;
+            if (_file == nullptr || fstat(fileno(_file), &info) != 0)
+            {
+                return -1;
+            }
+            return static_cast<int64_t>(info.st_size);
+        }
+
+        virtual std::string getError() const
+        {
+            if (_file == nullptr)
+            {
+                return "Unable to open file " + _filename;
+            }
+            if (ferror(_file))
+            {
+                return "Unable to read file " + _filename;
+            }
+            return "";
+        }
+
+    private:
+        std::string _filename;
+        FILE *_file;
+        std::vector<char> _buffer;
+    };
+
+    /** Time given to the cancellation of a job whose upload failed, in milliseconds
+     */
+    const int JOB_CANCEL_TIMEOUT = 5000;
+
+    /** Cancel a job on a new connection with a short deadline.
+     * The connection of the failed upload may be shut down, or the server slow to answer.
+     */
+    void cancelJobBounded(const PrintServer &server, const std::string &printername, int job_id)
+    {
+        AbortState state;
+        state.setTimeout(JOB_CANCEL_TIMEOUT);
+        AbortState *slot = &state;
+        http_t *http = connectServer(server, state, &slot);
+        if (http != nullptr)
+        {
+            cupsCancelJob2(http, printername.c_str(), job_id, 0);
+            httpClose(http);
+        }
+    }
+
+    /// Upload a chunk of the current document
+    bool writeChunk(http_t *http, const std::string &printername, int job_id, const char *chunk, size_t length)
+    {
+        TraceSpan span("cupsWriteRequestData", printername, job_id);
+        bool result = HTTP_STATUS_CONTINUE == cupsWriteRequestData(http, chunk, length);
+        span.setBytes(result ? length : 0);
+        if (!result)
+        {
+            span.setStatus(cupsLastError());
+        }
+        return result;
+    }
+
+    void finishDocument(http_t *http, const std::string &printername, int job_id)
+    {
+        TraceSpan span("cupsFinishDocument", printername, job_id);
+        cupsFinishDocument(http, printername.c_str());
+        span.setStatus(cupsLastError());
+    }
+
+    /** Create a job and upload a document as its only document.
+     * If the upload is cut short (error, abort or deadline), the created job is cancelled.
+     * @param printername queue name on server
+     * @param abort optional operation state, checked between chunks
+     * @param tracker job tracker watching the job once submitted
+     * @param job_id created job id
+     * @return error string. if empty, then no error
+     */
+    std::string uploadDocument(http_t *http, const PrintServer &server, const std::string &printername, const std::string &docname, const std::string &format,
+                               int num_options, cups_option_t *options, DocumentSource &source, AbortState *abort, JobTracker &tracker, int &job_id)
+    {
+        {
+            TraceSpan span("cupsCreateJob", printername);
+            job_id = cupsCreateJob(http, printername.c_str(), docname.c_str(), num_options, options);
+            span.setJobId(job_id);
+            span.setStatus(cupsLastError());
+        }
+        if (job_id == 0)
+        {
+            return cupsLastErrorString();
+        }
+
+        std::string error_str;
+        {
+            TraceSpan span("cupsStartDocument", printername, job_id);
+            if (HTTP_STATUS_CONTINUE != cupsStartDocument(http, printername.c_str(), job_id, docname.c_str(), format.c_str(), 1 /*last document*/))
+            {
+                error_str = cupsLastErrorString();
+                span.setStatus(cupsLastError());
+            }
+        }
+
+        /* cupsWriteRequestData can be called as many times as needed */
+        const char *chunk = nullptr;
+        size_t length = 0;
+        while (error_str.empty() && source.next(chunk, length))
+        {
+            if (abort != nullptr && abort->shouldStop())
+            {
+                error_str = abort->isAborted() ? ABORT_ERROR_MESSAGE : TIMEOUT_ERROR_MESSAGE;
+            }
+            else if (!writeChunk(http, printername, job_id, chunk, length))
+            {
+                error_str = cupsLastErrorString();
+            }
+            else if (CallStats::getCurrent() != nullptr)
+            {
+                CallStats::getCurrent()->addBytes(length);
+            }
+        }
+        if (error_str.empty())
+        {
+            error_str = source.getError();
+        }
+
+        if (error_str.empty())
+        {
+            finishDocument(http, printername, job_id);
+            tracker.track(server.getPrinterName(printername), job_id);
+            return "";
+        }
+
+        if (abort == nullptr || !abort->shouldStop())
+        {
+            finishDocument(http, printername, job_id);
+        }
+        cancelJobBounded(server, printername, job_id);
+        return error_str;
+    }
+
+    /** Run fn with the connection of the current thread to server
+     * @return error string. if empty, then no error
+     */
+    template <typename Function>
+    std::string runWithConnection(AbortState &state, const PrintServer &server, const Function &fn)
+    {
+        TaskConnection connection(state, server);
+        if (connection.get() == nullptr)
+        {
+            return connection.getError();
+        }
+        return fn(connection.get());
+    }
+
+    /** Discovery time of enumPrinters without deadline, in milliseconds.
+     * Same as cupsGetDests2, which waits 1 second for the network printers.
+     */
+    const int DEFAULT_ENUM_TIMEOUT = 1000;
+
+    /// cupsEnumDests callback: user_data is the PrinterCallback
+    int onEnumDest(void *user_data, unsigned flags, cups_dest_t *dest)
+    {
+        if (flags & CUPS_DEST_FLAGS_REMOVED)
+        {
+            return 1;
+        }
+        PrinterInfo info;
+        copyPrinterInfo(dest, info);
+        return (*static_cast<const PrinterCallback *>(user_data))(info) ? 1 : 0;
+    }
+
+    /** Print server of the module functions: the server of libcups, the default backend,
+     * or a named one of addPrintServer, whose printers are named "queue@name".
+     * A backend is made for each call with the server resolved then, so addPrintServer applies to the next calls.
+     */
+    class CupsBackend : public PrintBackend
+    {
+    public:
+        /// @param tracker job tracker of the environment
+        CupsBackend(const PrintServer &server, const std::shared_ptr<JobTracker> &tracker) : _server(server), _tracker(tracker) {}
+
+        virtual std::string getPrinters(AbortState &state, std::vector<PrinterInfo> &printers)
+        {
+            const PrintServer &server = _server;
+            std::string error_str = runWithConnection(state, server, [&](http_t *http)
+                                                      { return fetchPrinters(http, printers); });
+            for (PrinterInfo &printer : printers)
+            {
+                setPrinterNames(server, printer);
+            }
+            return error_str;
+        }
+
+        virtual std::string getPrinter(AbortState &state, const std::string &printername, PrinterInfo &printer)
+        {
+            const PrintServer &server = _server;
+            std::string error_str = runWithConnection(state, server, [&](http_t *http)
+                                                      { return fetchPrinter(http, server.getQueue(printername), printer); });
+            setPrinterNames(server, printer);
+            return error_str;
+        }
+
+        /// Jobs of all states, completed ones included
+        virtual std::string findJob(AbortState &state, const std::string &printername, const std::string &title, JobInfo &job)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         cups_job_t *jobs = nullptr;
+                                         int totalJobs = getJobsTraced(http, &jobs, server.getQueue(printername).c_str(), CUPS_WHICHJOBS_ALL);
+                                         for (int jobi = 0; jobi < totalJobs; ++jobi)
+                                         {
+                                             if (jobs[jobi].title != nullptr && title == jobs[jobi].title && jobs[jobi].id > job.id)
+                                             {
+                                                 job = JobInfo(&jobs[jobi]);
+                                                 job.dest = server.getPrinterName(job.dest);
+                                             }
+                                         }
+                                         cupsFreeJobs(totalJobs, jobs);
+                                         if (totalJobs < 0)
+                                         {
+                                             return std::string(cupsLastErrorString());
+                                         }
+                                         if (job.id > 0 && (job.state == IPP_JOB_PENDING || job.state == IPP_JOB_HELD))
+                                         {
+                                             // created but maybe still waiting for its document: unknown is an error, not a sent job
+                                             ipp_t *response = cupsDoRequest(http, newJobRequest(IPP_OP_GET_JOB_ATTRIBUTES, server.getQueue(printername), job.id), "/");
+                                             ipp_attribute_t *attr = (response != nullptr && ippGetStatusCode(response) <= IPP_STATUS_OK_CONFLICTING)
+                                                                         ? ippFindAttribute(response, "number-of-documents", IPP_TAG_INTEGER)
+                                                                         : nullptr;
+                                             std::string error_str;
+                                             if (attr != nullptr)
+                                             {
+                                                 job.documents = ippGetInteger(attr, 0);
+                                             }
+                                             else
+                                             {
+                                                 error_str = "Unable to read the documents of job " + std::to_string(job.id) + ": " + cupsLastErrorString();
+                                             }
+                                             ippDelete(response);
+                                             return error_str;
+                                         }
+                                         return std::string(); });
+        }
+
+        virtual bool findsCompletedJobs() const
+        {
+            return true;
+        }
+
+        /// cupsEnumDests: local queues first, then the network printers as they answer
+        virtual std::string enumPrinters(AbortState &state, const EnumPrintersFilter &filter, const PrinterCallback &onPrinter)
+        {
+            if (!_server.name.empty())
+            {
+                // cupsEnumDests only knows the server of libcups
+                return PrintBackend::enumPrinters(state, filter, onPrinter);
+            }
+            StatsTimer ippTimer(CallStats::getCurrent(), StatsTimer::IPP);
+            TraceSpan span("cupsEnumDests", "");
+            int ok = cupsEnumDests(CUPS_DEST_FLAGS_NONE, state.getRemainingTime(DEFAULT_ENUM_TIMEOUT), state.getCancelFlag(),
+                                   filter.type, filter.mask, onEnumDest, const_cast<PrinterCallback *>(&onPrinter));
+            span.setStatus(cupsLastError());
+            if (state.isAborted())
+            {
+                return ABORT_ERROR_MESSAGE;
+            }
+            if (!ok && !state.isTimedOut())
+            {
+                return cupsLastErrorString();
+            }
+            return "";
+        }
+
+        virtual std::string getPrinterDriverOptions(AbortState &state, const std::string &printername, DriverOptionsType &options)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     { return fetchPrinterDriverOptions(http, server.getQueue(printername), options); });
+        }
+
+        virtual std::string getDocumentFormats(AbortState &state, const std::string &printername, std::vector<std::string> &formats)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         static const char *const requested[] = {"document-format-supported"};
+                                         ipp_t *request = newJobRequest(IPP_OP_GET_PRINTER_ATTRIBUTES, server.getQueue(printername), 0);
+                                         ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", 1, nullptr, requested);
+                                         ipp_t *response = cupsDoRequest(http, request, "/");
+                                         ipp_attribute_t *attr = (response != nullptr) ? ippFindAttribute(response, requested[0], IPP_TAG_MIMETYPE) : nullptr;
+                                         for (int i = 0; attr != nullptr && i < ippGetCount(attr); ++i)
+                                         {
+                                             formats.push_back(ippGetString(attr, i, nullptr));
+                                         }
+                                         ippDelete(response);
+                                         return std::string(); });
+        }
+
+        virtual std::string getJob(AbortState &state, const std::string &printername, int jobId, JobInfo &job)
+        {
+            const PrintServer &server = _server;
+            std::string error_str = runWithConnection(state, server, [&](http_t *http)
+                                                      { return fetchJob(http, server.getQueue(printername), jobId, job); });
+            job.dest = server.getPrinterName(job.dest);
+            return error_str;
+        }
+
+        virtual std::string setJob(AbortState &state, const std::string &printername, int jobId, const std::string &jobCommand, int value, bool &result)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         result = executeJobCommand(http, server.getQueue(printername), jobId, jobCommand, value);
+                                         return std::string(); });
+        }
+
+        virtual std::string setJobs(AbortState &state, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value, bool &result)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         result = executeJobsCommand(http, server.getQueue(printername), jobIds, jobCommand, value);
+                                         return std::string(); });
+        }
+
+        virtual std::string cancelAllJobs(AbortState &state, const std::string &printername, bool purge, bool &result)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         result = cancelAllPrinterJobs(http, server.getQueue(printername), purge);
+                                         return std::string(); });
+        }
+
+        /// Jobs move between the queues of the server only
+        virtual std::string moveAllJobs(AbortState &state, const std::string &from, const std::string &to, bool &result)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         result = moveJob(http, server.getQueue(from), 0, server.getQueue(to));
+                                         return std::string(); });
+        }
+
+        virtual std::string moveJobs(AbortState &state, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &moved)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     {
+                                         moveJobsTo(http, server.getQueue(from), jobIds, server.getQueue(to), moved);
+                                         return std::string(); });
+        }
+
+        virtual std::string submitDocument(AbortState &state, const std::string &printername, const std::string &docname, const std::string &format,
+                                           int num_options, cups_option_t *options, DocumentSource &source, int &jobId)
+        {
+            const PrintServer &server = _server;
+            return runWithConnection(state, server, [&](http_t *http)
+                                     { return uploadDocument(http, server, server.getQueue(printername), docname, format, num_options, options, source, &state, *_tracker, jobId); });
+        }
+
+    private:
+        PrintServer _server;
+        std::shared_ptr<JobTracker> _tracker;
+
+        /// Name the printer and its jobs as the module functions take them
+        static void setPrinterNames(const PrintServer &server, PrinterInfo &printer)
+        {
+            printer.name = server.getPrinterName(printer.name);
+            for (JobInfo &job : printer.jobs)
+            {
+                job.dest = server.getPrinterName(job.dest);
+            }
+        }
+    };
+
+}
+
+struct BackendState
+{
+    BackendState() : printServers(std::make_shared<PrintServers>()), jobTracker(std::make_shared<JobTracker>(printServers)) {}
+
+    std::mutex mutex;
+    /// selected by setBackend, null for CUPS. The printer handle of openPrinter always uses CUPS
+    std::shared_ptr<PrintBackend> backend;
+    std::shared_ptr<PrintServers> printServers;
+    std::shared_ptr<JobTracker> jobTracker;
+};
+
+std::shared_ptr<BackendState> getBackendState(Napi::Env env)
+{
+    std::shared_ptr<BackendState> &backends = ModuleData::get(env).backends;
+    if (!backends)
+    {
+        backends = std::make_shared<BackendState>();
+        // backends may outlive the environment in its pending tasks, the tracker thread must not
+        std::shared_ptr<JobTracker> tracker = backends->jobTracker;
+        env.AddCleanupHook([tracker]()
+                           { tracker->stop(); });
+    }
+    return backends;
+}
+
+namespace
+{
+    void setBackend(BackendState &backends, const std::shared_ptr<PrintBackend> &backend)
+    {
+        std::lock_guard<std::mutex> lock(backends.mutex);
+        backends.backend = backend;
+    }
+
+    /** Backend of a print server, see getPrintServer: the backend of setBackend for the server of libcups.
+     * Named servers always use CUPS, setBackend only replaces the default server.
+     */
+    std::shared_ptr<PrintBackend> getServerBackend(BackendState &backends, const std::string &serverName)
+    {
+        if (serverName.empty())
+        {
+            std::lock_guard<std::mutex> lock(backends.mutex);
+            if (backends.backend)
+            {
+                return backends.backend;
+            }
+        }
+        return std::make_shared<CupsBackend>(getPrintServer(*backends.printServers, serverName), backends.jobTracker);
+    }
+
+    /** Make a task function running fn on the backend of a print server in env, see getServerBackend.
+     * The backend is taken when the call is made: switching backends does not affect queued calls.
+     */
+    template <typename ResultType>
+    typename FunctionTask<ResultType>::ExecuteFunction withServerBackend(Napi::Env env, const std::string &serverName, const std::function<std::string(PrintBackend &, AbortState &, ResultType &)> &fn)
+    {
+        std::shared_ptr<PrintBackend> backend = getServerBackend(*getBackendState(env), serverName);
+        return [fn, backend](ResultType &result, AbortState &state)
+        {
+            return fn(*backend, state, result);
+        };
+    }
+
+    /** Same as withServerBackend, on the backend of a printer: the direct transports
+     * for socket:// and ipp:// printers, the print server of "queue@server" printers.
+     */
+    template <typename ResultType>
+    typename FunctionTask<ResultType>::ExecuteFunction withBackend(Napi::Env env, const std::string &printername, const std::function<std::string(PrintBackend &, AbortState &, ResultType &)> &fn)
+    {
+        std::shared_ptr<PrintBackend> backend = getPrinterBackend(*getBackendState(env), printername);
+        return [fn, backend](ResultType &result, AbortState &state)
+        {
+            return fn(*backend, state, result);
+        };
+    }
+
+    /** Printers pushed to a JS function from a pool thread, by enumPrintersAsync.
+     * The queue is bounded: the enumeration waits while JS catches up.
+     */
+    class PrinterStream
+    {
+    public:
+        PrinterStream(Napi::Env env, Napi::Function callback)
+            : _function(PrinterFunction::New(env, callback, "node-printer-enum", PRINTER_QUEUE_SIZE, 1)), _closed(false) {}
+
+        ~PrinterStream() { close(); }
+
+        /// @return false if the environment is going away
+        bool push(const PrinterInfo &printer)
+        {
+            PrinterInfo *copy = new PrinterInfo(printer);
+            if (_function.BlockingCall(copy) != napi_ok)
+            {
+                delete copy;
+                return false;
+            }
+            return true;
+        }
+
+        /// Release the function, queued printers are still delivered
+        void close()
+        {
+            if (!_closed.exchange(true))
+            {
+                _function.Release();
+            }
+        }
+
+    private:
+        static void callPrinter(Napi::Env env, Napi::Function callback, std::nullptr_t *context, PrinterInfo *printer)
+        {
+            if (env != nullptr && callback != nullptr)
+            {
+                Napi::Object result = Napi::Object::New(env);
+                parsePrinterInfo(*printer, result);
+                callback.Call({result});
+            }
+            delete printer;
+        }
+
+        typedef Napi::TypedThreadSafeFunction<std::nullptr_t, PrinterInfo, &PrinterStream::callPrinter> PrinterFunction;
+
+        static const size_t PRINTER_QUEUE_SIZE = 64;
+
+        PrinterFunction _function;
+        std::atomic<bool> _closed;
+    };
+
+    /** Minimum time between two upload progress events, in milliseconds
+     */
+    const int PROGRESS_INTERVAL = 50;
+
+    /** Upload progress pushed to a JS function onProgress(bytesSent, totalBytes) from a pool thread.
+     * The queue is short and intermediate events are dropped while JS is behind: the upload never waits for them.
+     */
+    class UploadProgress
+    {
+    public:
+        UploadProgress(Napi::Env env, Napi::Function callback)
+            : _function(ProgressFunction::New(env, callback, "node-printer-progress", PROGRESS_QUEUE_SIZE, 1)) {}
+
+        ~UploadProgress() { _function.Release(); }
+
+        /** @param total document size, -1 if unknown
+         * @param last the last event of the upload, delivered even if the queue is full
+         */
+        void report(uint64_t sent, int64_t total, bool last)
+        {
+            Progress *progress = new Progress{sent, total};
+            napi_status status = last ? _function.BlockingCall(progress) : _function.NonBlockingCall(progress);
+            if (status != napi_ok)
+            {
+                delete progress;
+            }
+        }
+
+    private:
+        struct Progress
+        {
+            uint64_t sent;
+            int64_t total;
+        };
+
+        static void callProgress(Napi::Env env, Napi::Function callback, std::nullptr_t *context, Progress *progress)
+        {
+            if (env != nullptr && callback != nullptr)
+            {
+                callback.Call({Napi::Number::New(env, static_cast<double>(progress->sent)),
+                               Napi::Number::New(env, static_cast<double>(progress->total))});
+            }
+            delete progress;
+        }
+
+        typedef Napi::TypedThreadSafeFunction<std::nullptr_t, Progress, &UploadProgress::callProgress> ProgressFunction;
+
+        static const size_t PROGRESS_QUEUE_SIZE = 2;
+
+        ProgressFunction _function;
+    };
+
+    /** Document source reporting the bytes uploaded from another source.
+     * A chunk is counted as sent once the backend asks for the next one, so the
+     * progress follows the writes to the server whatever the backend.
+     * Events are throttled to one per PROGRESS_INTERVAL, plus the last one.
+     */
+    class ProgressSource : public DocumentSource
+    {
+    public:
+        /// @param progress optional, the source is forwarded as is if null
+        ProgressSource(DocumentSource &source, const std::shared_ptr<UploadProgress> &progress)
+            : _source(source), _progress(progress), _sent(0), _pending(0), _lastReport(std::chrono::steady_clock::now()) {}
+
+        virtual bool next(const char *&chunk, size_t &length)
+        {
+            _sent += _pending;
+            _pending = 0;
+            bool hasChunk = _source.next(chunk, length);
+            if (!_progress)
+            {
+                return hasChunk;
+            }
+            if (!hasChunk)
+            {
+                if (_source.getError().empty())
+                {
+                    _progress->report(_sent, _source.getSize(), true);
+                }
+                return false;
+            }
+            _pending = length;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (_sent > 0 && now - _lastReport >= std::chrono::milliseconds(PROGRESS_INTERVAL))
+            {
+                _lastReport = now;
+                _progress->report(_sent, _source.getSize(), false);
+            }
+            return true;
+        }
+
+        virtual int64_t getSize() const { return _source.getSize(); }
+
+        virtual std::string getError() const { return _source.getError(); }
+
+    private:
+        DocumentSource &_source;
+        std::shared_ptr<UploadProgress> _progress;
+        uint64_t _sent;
+        size_t _pending;
+        std::chrono::steady_clock::time_point _lastReport;
+    };
+
+    /// UploadProgress of the onProgress function of an async handle, null if there is none
+    std::shared_ptr<UploadProgress> getUploadProgress(const Napi::Value &handle)
+    {
+        if (!handle.IsObject())
+        {
+            return nullptr;
+        }
+        Napi::Value onProgress = handle.As<Napi::Object>().Get("onProgress");
+        if (!onProgress.IsFunction())
+        {
+            return nullptr;
+        }
+        return std::make_shared<UploadProgress>(handle.Env(), onProgress.As<Napi::Function>());
+    }
+
+    /** Document bytes of an asynchronous submission.
+     * Buffers are referenced instead of being copied; they must not be modified until the promise is settled.
+     * It must be released on the main thread.
+     */
+    class DocumentData
+    {
+    public:
+        /// @return false if value is neither a String nor a Buffer
+        bool assign(const Napi::Value &value)
+        {
+            if (value.IsBuffer())
+            {
+                Napi::Buffer<char> buffer = value.As<Napi::Buffer<char>>();
+                _reference = Napi::Persistent(value.As<Napi::Object>());
+                _data = buffer.Data();
+                _size = buffer.Length();
+                return true;
+            }
+            if (getStringOrBufferFromNapiValue(value, _copy))
+            {
+                _data = _copy.c_str();
+                _size = _copy.size();
+                return true;
+            }
+            return false;
+        }
+
+        const char *data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+        Napi::ObjectReference _reference;
+        std::string _copy;
+        const char *_data = nullptr;
+        size_t _size = 0;
+    };
+
+    /// cups option class to automatically free memory.
+    class CupsOptions : public MemValueBase<cups_option_t>
+    {
+    protected:
+        int num_options;
+        virtual void free()
+        {
+            if (_value != NULL)
+            {
+                cupsFreeOptions(num_options, get());
+                _value = NULL;
+                num_options = 0;
+            }
+        }
+
+    public:
+        CupsOptions() : num_options(0) {}
+        ~CupsOptions() { free(); }
+
+        /// Add options from v8 object
+        CupsOptions(const Napi::Object &options) : num_options(0)
+        {
+            Napi::Array props = options.GetPropertyNames();
+
+            for (uint32_t i = 0; i < props.Length(); ++i)
+            {
+                Napi::Value key = props.Get(i);
+                std::string keyStr = key.ToString().Utf8Value();
+                Napi::Value val = options.Get(key);
+                std::string valStr = val.ToString().Utf8Value();
+
+                num_options = cupsAddOption(keyStr.c_str(), valStr.c_str(), num_options, &_value);
+            }
+        }
+
+        const int &getNumOptions() { return num_options; }
+    };
+
+    /** Resolve a jobs filter name (ACTIVE, COMPLETED, ALL)
+     * @return CUPS_WHICHJOBS_* value, or -2 if name is unknown
+     */
+    int getWhichJobs(const std::string &iWhich)
+    {
+        if (iWhich.empty() || iWhich == "ACTIVE")
+        {
+            return CUPS_WHICHJOBS_ACTIVE;
+        }
+        if (iWhich == "COMPLETED")
+        {
+            return CUPS_WHICHJOBS_COMPLETED;
+        }
+        if (iWhich == "ALL")
+        {
+            return CUPS_WHICHJOBS_ALL;
+        }
+        return -2;
+    }
+
+    /** Fill a job info from a Get-Job-Attributes response.
+     * @return true if the response contains a job
+     */
+    bool readJobAttributes(ipp_t *response, JobInfo &job)
+    {
+        ipp_attribute_t *attr = ippFindAttribute(response, "job-id", IPP_TAG_INTEGER);
+        if (attr == nullptr)
+        {
+            return false;
+        }
+        job = JobInfo();
+        job.id = ippGetInteger(attr, 0);
+        job.format = CUPS_FORMAT_AUTO;
+
+        if ((attr = ippFindAttribute(response, "job-printer-uri", IPP_TAG_URI)) != nullptr)
+        {
+            const char *uri = ippGetString(attr, 0, nullptr);
+            const char *slash = strrchr(uri, '/');
+            job.dest = (slash != nullptr ? slash + 1 : uri);
+        }
+        if ((attr = ippFindAttribute(response, "job-name", IPP_TAG_NAME)) != nullptr)
+        {
+            job.title = ippGetString(attr, 0, nullptr);
+        }
+        if ((attr = ippFindAttribute(response, "job-originating-user-name", IPP_TAG_NAME)) != nullptr)
+        {
+            job.user = ippGetString(attr, 0, nullptr);
+        }
+        if ((attr = ippFindAttribute(response, "document-format", IPP_TAG_MIMETYPE)) != nullptr)
+        {
+            job.format = ippGetString(attr, 0, nullptr);
+        }
+        if ((attr = ippFindAttribute(response, "job-state", IPP_TAG_ENUM)) != nullptr)
+        {
+            job.state = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "job-priority", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.priority = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "number-of-documents", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.documents = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "job-k-octets", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.size = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "time-at-completed", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.completed_time = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "time-at-creation", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.creation_time = ippGetInteger(attr, 0);
+        }
+        if ((attr = ippFindAttribute(response, "time-at-processing", IPP_TAG_INTEGER)) != nullptr)
+        {
+            job.processing_time = ippGetInteger(attr, 0);
+        }
+        return true;
+    }
+
+    /** Append all values of an IPP attribute as strings
+     */
+    void appendAttributeValues(ipp_attribute_t *attr, std::vector<std::string> &outValues)
+    {
+        int count = ippGetCount(attr);
+        for (int i = 0; i < count; ++i)
+        {
+            switch (ippGetValueTag(attr))
+            {
+            case IPP_TAG_INTEGER:
+            case IPP_TAG_ENUM:
+                outValues.push_back(std::to_string(ippGetInteger(attr, i)));
+                break;
+            case IPP_TAG_BOOLEAN:
+                outValues.push_back(ippGetBoolean(attr, i) ? "true" : "false");
+                break;
+            case IPP_TAG_RANGE:
+            {
+                int upper = 0;
+                int lower = ippGetRange(attr, i, &upper);
+                outValues.push_back(std::to_string(lower) + "-" + std::to_string(upper));
+                break;
+            }
+            default:
+            {
+                const char *value = ippGetString(attr, i, nullptr);
+                if (value != nullptr)
+                {
+                    outValues.push_back(value);
+                }
+                else
+                {
+                    // collections, resolutions, etc.: use the CUPS textual representation
+                    char buffer[1024];
+                    ippAttributeString(attr, buffer, sizeof(buffer));
+                    outValues.push_back(buffer);
+                    i = count;
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    /** Default timeout applied to one synchronous call on a connection
+     * whose timeout callback checks slot.
+     */
+    class CallDeadline
+    {
+    public:
+        CallDeadline(AbortState *&slot) : _slot(slot)
+        {
+            _state.setTimeout(getDefaultTaskTimeout());
+            _slot = &_state;
+        }
+
+        ~CallDeadline() { _slot = nullptr; }
+
+        /// Message of a failed call
+        std::string getError(const std::string &message) const
+        {
+            return _state.isTimedOut() ? std::string(TIMEOUT_ERROR_MESSAGE) : message;
+        }
+
+        std::string getErrorCode() const { return _state.getErrorCode(); }
+
+        AbortState &getState() { return _state; }
+
+    private:
+        AbortState *&_slot;
+        AbortState _state;
+    };
+
+    /// Error of a failed device operation: abort and deadline first, else message
+    std::string getDeviceError(const AbortState &state, const std::string &message)
+    {
+        if (state.isAborted())
+        {
+            return ABORT_ERROR_MESSAGE;
+        }
+        if (state.isTimedOut())
+        {
+            return TIMEOUT_ERROR_MESSAGE;
+        }
+        return message;
+    }
+
+    /** Connection to an IPP printer addressed by its ipp:// or ipps:// URI, for one operation.
+     * It talks to the device itself (CUPS_DEST_FLAGS_DEVICE), no local cupsd is involved.
+     * Aborting the operation shuts the connection down.
+     */
+    class DeviceConnection
+    {
+    public:
+        DeviceConnection(AbortState &state, const std::string &uri)
+            : _ippTimer(CallStats::getCurrent(), StatsTimer::IPP), _state(state), _slot(&state), _uri(uri),
+              _dest(cupsGetDestWithURI(nullptr, uri.c_str())), _http(nullptr)
+        {
+            _resource[0] = '\0';
+            if (_dest == nullptr || _state.shouldStop())
+            {
+                return;
+            }
+            TraceSpan span("cupsConnectDest", uri);
+            _http = cupsConnectDest(_dest, CUPS_DEST_FLAGS_DEVICE, _state.getRemainingTime(DEFAULT_CONNECT_TIMEOUT), _state.getCancelFlag(),
+                                    _resource, sizeof(_resource), nullptr, nullptr);
+            if (_http == nullptr)
+            {
+                span.setStatus(cupsLastError());
+                if (!_state.shouldStop())
+                {
+                    _state.setErrorCode(ERROR_CODE_CONNECTION);
+                }
+                return;
+            }
+            httpSetTimeout(_http, CONNECTION_TIMEOUT_CHECK_INTERVAL, onConnectionTimeout, &_slot);
+            http_t *http = _http;
+            _state.setInterrupt([http]()
+                                { httpShutdown(http); });
+        }
+
+        ~DeviceConnection()
+        {
+            if (_http != nullptr)
+            {
+                _state.clearInterrupt();
+                httpClose(_http);
+            }
+            if (_dest != nullptr)
+            {
+                cupsFreeDests(1, _dest);
+            }
+        }
+
+        http_t *get() const { return _http; }
+        cups_dest_t *getDest() const { return _dest; }
+        const char *getResource() const { return _resource; }
+
+        /// Error of a failed operation: abort and deadline first, else message
+        std::string getError(const std::string &message) const
+        {
+            return getDeviceError(_state, message);
+        }
+
+        /// Error of a failed connection
+        std::string getConnectError() const
+        {
+            return getError(_dest == nullptr ? "Invalid printer URI " + _uri : "Unable to connect to the printer " + _uri);
+        }
+
+        /** New job operation request on the device
+         * @param jobId target job, or 0 if the operation has no job-id
+         */
+        ipp_t *newRequest(ipp_op_t operation, int jobId) const
+        {
+            ipp_t *request = ippNewRequest(operation);
+            ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", nullptr, _uri.c_str());
+            if (jobId > 0)
+            {
+                ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", jobId);
+            }
+            ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr, cupsUser());
+            return request;
+        }
+
+        /** Send a request and free it
+         * @return the response, to free with ippDelete, or nullptr if the request failed
+         */
+        ipp_t *doRequest(ipp_t *request) const
+        {
+            ipp_t *response = cupsDoRequest(_http, request, _resource);
+            if (response != nullptr && ippGetStatusCode(response) > IPP_STATUS_OK_CONFLICTING)
+            {
+                ippDelete(response);
+                response = nullptr;
+            }
+            return response;
+        }
+
+    private:
+        StatsTimer _ippTimer;
+        AbortState &_state;
+        /// operation state checked by the connection timeout callback
+        AbortState *_slot;
+        std::string _uri;
+        cups_dest_t *_dest;
+        http_t *_http;
+        char _resource[256];
+    };
+
+    /** Document format for a device: without a cupsd to convert or pass through the data,
+     * raw and auto-typed documents, and the formats the device does not list, are sent
+     * for the printer to sense
+     */
+    std::string getDeviceFormat(http_t *http, cups_dest_t *dest, cups_dinfo_t *dinfo, const std::string &format)
+    {
+        if (format == CUPS_FORMAT_RAW || format == CUPS_FORMAT_AUTO || !cupsCheckDestSupported(http, dest, dinfo, "document-format", format.c_str()))
+        {
+            return "application/octet-stream";
+        }
+        return format;
+    }
+
+    /** Cancel a device job on a new connection with a short deadline, as cancelJobBounded:
+     * the connection of the failed upload may be shut down, and the state of the call stopped
+     */
+    void cancelDeviceJobBounded(const std::string &uri, int jobId)
+    {
+        AbortState state;
+        state.setTimeout(JOB_CANCEL_TIMEOUT);
+        DeviceConnection connection(state, uri);
+        if (connection.get() != nullptr)
+        {
+            TraceSpan span("cupsCancelDestJob", uri, jobId);
+            span.setStatus(cupsCancelDestJob(connection.get(), connection.getDest(), jobId));
+        }
+    }
+
+    /** Create a job on a device and upload a document as its only document, the device
+     * counterpart of uploadDocument. If the upload is cut short, the created job is cancelled.
+     * @param http connection to the device of dest
+     * @param uri ipp:// or ipps:// URI of the device
+     * @param jobId created job id
+     * @return error string. if empty, then no error
+     */
+    std::string uploadDeviceDocument(http_t *http, cups_dest_t *dest, cups_dinfo_t *dinfo, AbortState &state, const std::string &uri, const std::string &docname,
+                                     const std::string &format, int num_options, cups_option_t *options, DocumentSource &source, int &jobId)
+    {
+        std::string error_str;
+        {
+            TraceSpan span("cupsCreateDestJob", uri);
+            if (IPP_STATUS_OK != cupsCreateDestJob(http, dest, dinfo, &jobId, docname.c_str(), num_options, options))
+            {
+                error_str = getDeviceError(state, cupsLastErrorString());
+                jobId = 0;
+            }
+            span.setJobId(jobId);
+            span.setStatus(cupsLastError());
+        }
+        if (error_str.empty())
+        {
+            TraceSpan span("cupsStartDestDocument", uri, jobId);
+            if (HTTP_STATUS_CONTINUE != cupsStartDestDocument(http, dest, dinfo, jobId, docname.c_str(), getDeviceFormat(http, dest, dinfo, format).c_str(),
+                                                              0, nullptr, 1 /*last document*/))
+            {
+                error_str = getDeviceError(state, cupsLastErrorString());
+                span.setStatus(cupsLastError());
+            }
+        }
+        bool started = error_str.empty();
+
+        const char *chunk = nullptr;
+        size_t length = 0;
+        while (error_str.empty() && source.next(chunk, length))
+        {
+            if (state.shouldStop())
+            {
+                error_str = getDeviceError(state, "");
+            }
+            else if (!writeChunk(http, uri, jobId, chunk, length))
+            {
+                error_str = getDeviceError(state, cupsLastErrorString());
+            }
+            else if (CallStats::getCurrent() != nullptr)
+            {
+                CallStats::getCurrent()->addBytes(length);
+            }
+        }
+        if (error_str.empty())
+        {
+            error_str = source.getError();
+        }
+
+        if (started && !state.shouldStop())
+        {
+            TraceSpan span("cupsFinishDestDocument", uri, jobId);
+            ipp_status_t status = cupsFinishDestDocument(http, dest, dinfo);
+            span.setStatus(status);
+            if (error_str.empty() && status > IPP_STATUS_OK_CONFLICTING)
+            {
+                error_str = cupsLastErrorString();
+            }
+        }
+        if (!error_str.empty() && jobId > 0)
+        {
+            // cut short, aborted or timed out included: do not let the printer print a partial document
+            cancelDeviceJobBounded(uri, jobId);
+        }
+        return error_str;
+    }
+
+    /** IPP printers addressed by URI, printed to without a CUPS queue.
+     * Jobs are created with Create-Job and Send-Document on the device, and read
+     * back with Get-Job-Attributes. Every call opens its own connection.
+     */
+    class DeviceBackend : public PrintBackend
+    {
+    public:
+        virtual std::string getPrinters(AbortState &state, std::vector<PrinterInfo> &printers)
+        {
+            return "ipp:// printers are not listed";
+        }
+
+        virtual std::string getPrinter(AbortState &state, const std::string &printername, PrinterInfo &printer)
+        {
+            DeviceConnection connection(state, printername);
+            if (connection.get() == nullptr)
+            {
+                return connection.getConnectError();
+            }
+            static const char *const requested[] = {"printer-state", "printer-state-reasons", "printer-is-accepting-jobs",
+                                                    "printer-info", "printer-location", "printer-make-and-model", "queued-job-count"};
+            ipp_t *request = connection.newRequest(IPP_OP_GET_PRINTER_ATTRIBUTES, 0);
+            ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                          static_cast<int>(sizeof(requested) / sizeof(requested[0])), nullptr, requested);
+            ipp_t *response = connection.doRequest(request);
+            if (response == nullptr)
+            {
+                return connection.getError(cupsLastErrorString());
+            }
+            printer.name = printername;
+            printer.options.push_back(std::make_pair(std::string("device-uri"), printername));
+            for (const char *name : requested)
+            {
+                ipp_attribute_t *attr = ippFindAttribute(response, name, IPP_TAG_ZERO);
+                if (attr == nullptr)
+                {
+                    continue;
+                }
+                std::vector<std::string> values;
+                appendAttributeValues(attr, values);
+                std::string value;
+                for (const std::string &item : values)
+                {
+                    value += (value.empty() ? "" : ",") + item;
+                }
+                printer.options.push_back(std::make_pair(std::string(name), value));
+            }
+            ippDelete(response);
+            return "";
+        }
+
+        virtual std::string getPrinterDriverOptions(AbortState &state, const std::string &printername, DriverOptionsType &options)
+        {
+            return "ipp:// printers have no PPD, use openPrinter(uri).capabilities()";
+        }
+
+        virtual std::string getJob(AbortState &state, const std::string &printername, int jobId, JobInfo &job)
+        {
+            DeviceConnection connection(state, printername);
+            if (connection.get() == nullptr)
+            {
+                return connection.getConnectError();
+            }
+            ipp_t *response = connection.doRequest(connection.newRequest(IPP_OP_GET_JOB_ATTRIBUTES, jobId));
+            bool found = (response != nullptr && readJobAttributes(response, job));
+            ippDelete(response);
+            if (!found)
+            {
+                return connection.getError("Printer job not found");
+            }
+            job.dest = printername;
+            return "";
+        }
+
+        virtual std::string setJob(AbortState &state, const std::string &printername, int jobId, const std::string &jobCommand, int value, bool &result)
+        {
+            return setJobs(state, printername, std::vector<int>(1, jobId), jobCommand, value, result);
+        }
+
+        virtual std::string setJobs(AbortState &state, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value, bool &result)
+        {
+            JobCommandMapType::const_iterator itJobCommand = getJobCommandMap().find(jobCommand);
+            result = false;
+            if (itJobCommand == getJobCommandMap().end())
+            {
+                return "";
+            }
+            DeviceConnection connection(state, printername);
+            if (connection.get() == nullptr)
+            {
+                return connection.getConnectError();
+            }
+            result = true;
+            for (int jobId : jobIds)
+            {
+                ipp_t *request = connection.newRequest(itJobCommand->second, jobId);
+                if (itJobCommand->second == IPP_OP_HOLD_JOB)
+                {
+                    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "job-hold-until", nullptr, "indefinite");
+                }
+                else if (itJobCommand->second == IPP_OP_SET_JOB_ATTRIBUTES)
+                {
+                    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-priority", value);
+                }
+                ipp_t *response = connection.doRequest(request);
+                result = reportJobResult(response != nullptr) && result;
+                ippDelete(response);
+            }
+            return "";
+        }
+
+        virtual std::string cancelAllJobs(AbortState &state, const std::string &printername, bool purge, bool &result)
+        {
+            DeviceConnection connection(state, printername);
+            if (connection.get() == nullptr)
+            {
+                return connection.getConnectError();
+            }
+            ipp_t *response = connection.doRequest(connection.newRequest(purge ? IPP_OP_PURGE_JOBS : IPP_OP_CANCEL_JOBS, 0));
+            result = reportJobResult(response != nullptr);
+            ippDelete(response);
+            return "";
+        }
+
+        virtual std::string moveAllJobs(AbortState &state, const std::string &from, const std::string &to, bool &result)
+        {
+            return "Jobs cannot be moved between ipp:// printers";
+        }
+
+        virtual std::string moveJobs(AbortState &state, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &moved)
+        {
+            return "Jobs cannot be moved between ipp:// printers";
+        }
+
+        virtual std::string submitDocument(AbortState &state, const std::string &printername, const std::string &docname, const std::string &format,
+                                           int num_options, cups_option_t *options, DocumentSource &source, int &jobId)
+        {
+            DeviceConnection connection(state, printername);
+            if (connection.get() == nullptr)
+            {
+                return connection.getConnectError();
+            }
+            cups_dinfo_t *dinfo = cupsCopyDestInfo(connection.get(), connection.getDest());
+            if (dinfo == nullptr)
+            {
+                return connection.getError(cupsLastErrorString());
+            }
+            std::string error_str = uploadDeviceDocument(connection.get(), connection.getDest(), dinfo, state, printername, docname, format,
+                                                         num_options, options, source, jobId);
+            cupsFreeDestInfo(dinfo);
+            return error_str;
+        }
+    };
+
+}
+
+std::string PrintBackend::enumPrinters(AbortState &state, const EnumPrintersFilter &filter, const PrinterCallback &onPrinter)
+{
+    std::vector<PrinterInfo> printers;
+    std::string error_str = getPrinters(state, printers);
+    if (!error_str.empty())
+    {
+        return (state.isTimedOut() && !state.isAborted()) ? "" : error_str;
+    }
+    for (PrinterInfo &printer : printers)
+    {
+        unsigned type = CUPS_PRINTER_LOCAL;
+        for (const auto &option : printer.options)
+        {
+            if (option.first == "printer-type")
+            {
+                type = static_cast<unsigned>(std::strtoul(option.second.c_str(), nullptr, 10));
+            }
+        }
+        if ((type & filter.mask) != filter.type)
+        {
+            continue;
+        }
+        printer.jobs.clear();
+        if (!onPrinter(printer))
+        {
+            break;
+        }
+    }
+    return "";
+}
+
+std::string PrintBackend::findJob(AbortState &state, const std::string &printername, const std::string &title, JobInfo &job)
+{
+    PrinterInfo printer;
+    std::string error_str = getPrinter(state, printername, printer);
+    for (const JobInfo &candidate : printer.jobs)
+    {
+        if (candidate.title == title && candidate.id > job.id)
+        {
+            job = candidate;
+        }
+    }
+    return error_str;
+}
+
+std::shared_ptr<PrintBackend> getPrinterBackend(BackendState &backends, const std::string &printername)
+{
+    if (isSocketUri(printername))
+    {
+        return getSocketBackend();
+    }
+    if (isDeviceUri(printername))
+    {
+        return getDeviceBackend();
+    }
+    return getServerBackend(backends, getServerName(printername));
+}
+
+namespace
+{
+    bool startsWith(const char *data, size_t size, const char *magic, size_t length)
+    {
+        return size >= length && memcmp(data, magic, length) == 0;
+    }
+
+    /** True if data is a ZPL label: ^XA is the first format command, after blanks and ~ control
+     * commands, and a ^XZ closes it. memmem does the scanning, with the vector instructions of the C library.
+     */
+    bool isZpl(const char *data, size_t size)
+    {
+        const char *start = static_cast<const char *>(memmem(data, std::min(size, ZPL_PREFIX_SIZE + 3), "^XA", 3));
+        if (start == nullptr)
+        {
+            return false;
+        }
+        bool blank = true;
+        bool control = false;
+        for (const char *p = data; p < start; ++p)
+        {
+            if (*p == '^' && isupper(static_cast<unsigned char>(p[1])) && isupper(static_cast<unsigned char>(p[2])))
+            {
+                return false;
+            }
+            blank = blank && isspace(static_cast<unsigned char>(*p));
+            control = control || *p == '~';
+        }
+        return (blank || control) && memmem(start + 3, size - (start + 3 - data), "^XZ", 3) != nullptr;
+    }
+
+    /// True if data starts with a PCL printer reset followed by another PCL escape sequence
+    bool isPcl(const char *data, size_t size)
+    {
+        return startsWith(data, size, "\x1b" "E\x1b", 3) && size > 3 && memchr("&*()%", data[3], 5) != nullptr;
+    }
+
+    /** Length of the ESC/POS command at the start of data, 0 if it is not a known one.
+     * Commands followed by a variable length block only count their header.
+     */
+    size_t getEscPosCommandLength(const unsigned char *data, size_t size)
+    {
+        if (size < 2)
+        {
+            return 0;
+        }
+        unsigned char n = size > 2 ? data[2] : 0xff;
+        if (data[0] == 0x1b)
+        {
+            switch (data[1])
+            {
+            case '@': // initialize
+            case '2': // default line spacing
+                return 2;
+            case 'E': // emphasized
+            case 'G': // double strike
+                return (n == 0 || n == 1 || n == '0' || n == '1') ? 3 : 0;
+            case 'a': // justification
+            case '-': // underline
+                return (n <= 2 || (n >= '0' && n <= '2')) ? 3 : 0;
+            case '!': // print mode
+            case '3': // line spacing
+            case 'J': // feed
+            case 'M': // font
+            case 'R': // character set
+            case 'd': // feed lines
+            case 't': // code page
+                return size > 2 ? 3 : 0;
+            case 'p': // drawer pulse
+                return size > 4 ? 5 : 0;
+            }
+        }
+        else if (data[0] == 0x1d)
+        {
+            switch (data[1])
+            {
+            case 'V': // cut
+                if (n == 0 || n == 1 || n == '0' || n == '1')
+                {
+                    return 3;
+                }
+                return ((n == 'A' || n == 'B') && size > 3) ? 4 : 0;
+            case '!': // character size
+            case 'B': // reverse
+            case 'H': // barcode text
+            case 'h': // barcode height
+            case 'w': // barcode width
+            case 'f': // barcode font
+            case 'k': // barcode
+                return size > 2 ? 3 : 0;
+            case 'L': // left margin
+            case 'W': // print area width
+                return size > 3 ? 4 : 0;
+            case 'v': // raster image
+                return (n == '0' && size > 7) ? 8 : 0;
+            case '(': // QR code and graphics
+                return ((n == 'k' || n == 'L') && size > 4) ? 5 : 0;
+            }
+        }
+        return 0;
+    }
+
+    /// True if data starts with an ESC/POS command and holds at least another one
+    bool isEscPos(const char *data, size_t size)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        size_t length = getEscPosCommandLength(bytes, size);
+        if (length == 0)
+        {
+            return false;
+        }
+        for (size_t i = length; i < size; ++i)
+        {
+            if ((bytes[i] == 0x1b || bytes[i] == 0x1d) && getEscPosCommandLength(bytes + i, size - i) > 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// True if format is listed in supported, or supported is empty: unknown
+    bool isSupportedFormat(const std::string &format, const std::vector<std::string> &supported)
+    {
+        return supported.empty() || std::find(supported.begin(), supported.end(), format) != supported.end();
+    }
+
+    /** Format to submit an AUTO document with, see resolveAutoFormat
+     * @param supported document-format-supported of the printer, empty if unknown
+     */
+    std::string selectAutoFormat(const std::string &format, const char *data, size_t size, const std::vector<std::string> &supported)
+    {
+        if (format != CUPS_FORMAT_AUTO)
+        {
+            return format;
+        }
+        std::string sniffed = sniffDocumentFormat(data, size);
+        return (!sniffed.empty() && isSupportedFormat(sniffed, supported)) ? sniffed : format;
+    }
+}
+
+std::string sniffDocumentFormat(const char *data, size_t size)
+{
+    size_t window = std::min(size, SNIFF_SIZE);
+    if (startsWith(data, window, "%PDF-", 5))
+    {
+        return "application/pdf";
+    }
+    if (startsWith(data, window, "%!", 2) || startsWith(data, window, "\x04%!", 3))
+    {
+        return "application/postscript";
+    }
+    if (startsWith(data, window, "RaS2", 4))
+    {
+        return "image/pwg-raster";
+    }
+    if (startsWith(data, window, "UNIRAST", 7))
+    {
+        return "image/urf";
+    }
+    if (startsWith(data, window, "\xff\xd8\xff", 3))
+    {
+        return "image/jpeg";
+    }
+    if (startsWith(data, window, "\x89PNG\r\n\x1a\n", 8))
+    {
+        return "image/png";
+    }
+    // printer languages, nothing for cupsd to convert: PJL, PCL, ESC/POS, ZPL. The ^XZ closing a label may be past the window
+    if (startsWith(data, window, "\x1b%-12345X", 9) || isPcl(data, window) || isEscPos(data, window) || isZpl(data, size))
+    {
+        return CUPS_FORMAT_RAW;
+    }
+    return "";
+}
+
+std::string resolveAutoFormat(PrintBackend &backend, AbortState &state, const std::string &printername, const std::string &format, const char *data, size_t size)
+{
+    if (format != CUPS_FORMAT_AUTO || isSocketUri(printername) || sniffDocumentFormat(data, size).empty())
+    {
+        return format;
+    }
+    // unknown if the printer cannot tell: the sniffed format is kept
+    std::vector<std::string> supported;
+    backend.getDocumentFormats(state, printername, supported);
+    return selectAutoFormat(format, data, size, supported);
+}
+
+std::string getDocumentFormat(const std::string &type)
+{
+    FormatMapType::const_iterator itFormat = getPrinterFormatMap().find(type);
+    return itFormat != getPrinterFormatMap().end() ? itFormat->second : std::string();
+}
+
+bool isDeviceUri(const std::string &printername)
+{
+    return printername.compare(0, 6, "ipp://") == 0 || printername.compare(0, 7, "ipps://") == 0;
+}
+
+std::shared_ptr<PrintBackend> getDeviceBackend()
+{
+    static std::shared_ptr<PrintBackend> backend = std::make_shared<DeviceBackend>();
+    return backend;
+}
+
+namespace
+{
+    /** Persistent handle to a printer.
+     * Keeps the resolved destination, a dedicated connection and destination info
+     * between calls, so every method costs only its own IPP operation.
+     * The default timeout applies to each call.
+     */
+    class Printer : public Napi::ObjectWrap<Printer>
+    {
+    public:
+        /// Defined once per environment: a constructor cannot be shared with workers
+        static Napi::Function getClass(Napi::Env env)
+        {
+            Napi::FunctionReference &constructor = ModuleData::get(env).printerClass;
+            if (constructor.IsEmpty())
+            {
+                Napi::Function func = DefineClass(env, "Printer",
+                                                  {InstanceAccessor("name", &Printer::getName, nullptr),
+                                                   InstanceMethod("print", &Printer::print),
+                                                   InstanceMethod("getJobs", &Printer::getJobs),
+                                                   InstanceMethod("getJob", &Printer::getJob),
+                                                   InstanceMethod("setJob", &Printer::setJob),
+                                                   InstanceMethod("setJobs", &Printer::setJobs),
+                                                   InstanceMethod("cancelAllJobs", &Printer::cancelAllJobs),
+                                                   InstanceMethod("capabilities", &Printer::capabilities),
+                                                   InstanceMethod("close", &Printer::close)});
+                constructor = Napi::Persistent(func);
+            }
+            return constructor.Value();
+        }
+
+        Printer(const Napi::CallbackInfo &info)
+            : Napi::ObjectWrap<Printer>(info), _dest(nullptr), _http(nullptr), _dinfo(nullptr), _callState(nullptr), _capabilitiesLoaded(false)
+        {
+            MY_NODE_MODULE_ENV(info);
+            if (info.Length() <= 0 || !info[0].IsString())
+            {
+                Napi::TypeError::New(env, "Argument 0 must be a string").ThrowAsJavaScriptException();
+                return;
+            }
+            std::string printername = info[0].As<Napi::String>().Utf8Value();
+
+            // ipp:// and ipps:// printers are opened on the device, without a local queue
+            bool device = isDeviceUri(printername);
+            int timeout = getDefaultTaskTimeout();
+            if (device)
+            {
+                _deviceUri = printername;
+            }
+            else
+            {
+                _server = getPrintServer(*getBackendState(env)->printServers, getServerName(printername));
+            }
+            if (device)
+            {
+                _dest = cupsGetDestWithURI(nullptr, printername.c_str());
+            }
+            else if (_server.name.empty())
+            {
+                _dest = cupsGetNamedDest(CUPS_HTTP_DEFAULT, printername.c_str(), nullptr);
+            }
+            else
+            {
+                // a printer of a named server is looked up and used on a connection to that server, with its encryption
+                AbortState connecting;
+                connecting.setTimeout(timeout > 0 ? timeout : DEFAULT_CONNECT_TIMEOUT);
+                _http = connectServer(_server, connecting, &_callState);
+                std::string queue = _server.getQueue(printername);
+                _dest = (_http != nullptr) ? cupsGetNamedDest(_http, queue.c_str(), nullptr) : nullptr;
+                if (_dest != nullptr)
+                {
+                    setResource(queue);
+                }
+            }
+            if (_dest == nullptr)
+            {
+                release();
+                Napi::TypeError::New(env, "Printer not found").ThrowAsJavaScriptException();
+                return;
+            }
+            if (_http == nullptr)
+            {
+                _http = cupsConnectDest(_dest, device ? CUPS_DEST_FLAGS_DEVICE : CUPS_DEST_FLAGS_NONE, timeout > 0 ? timeout : DEFAULT_CONNECT_TIMEOUT, nullptr, _resource, sizeof(_resource), nullptr, nullptr);
+            }
+            if (_http == nullptr)
+            {
+                std::string error_str(cupsLastErrorString());
+                release();
+                Napi::TypeError::New(env, error_str).ThrowAsJavaScriptException();
+                return;
+            }
+            httpSetTimeout(_http, CONNECTION_TIMEOUT_CHECK_INTERVAL, onConnectionTimeout, &_callState);
+
+            CallDeadline deadline(_callState);
+            TraceSpan span("cupsCopyDestInfo", printername);
+            _dinfo = cupsCopyDestInfo(_http, _dest);
+            span.setStatus(cupsLastError());
+            if (_dinfo == nullptr)
+            {
+                std::string error_str(deadline.getError(cupsLastErrorString()));
+                std::string error_code(deadline.getErrorCode());
+                release();
+                Napi::TypeError error = Napi::TypeError::New(env, error_str);
+                if (!error_code.empty())
+                {
+                    error.Set("code", Napi::String::New(env, error_code));
+                }
+                error.ThrowAsJavaScriptException();
+                return;
+            }
+        }
+
+        ~Printer() { release(); }
+
+    private:
+        cups_dest_t *_dest;
+        http_t *_http;
+        cups_dinfo_t *_dinfo;
+        /// state of the call in progress, checked by the connection timeout callback
+        AbortState *_callState;
+        char _resource[256];
+        /// server of a "queue@server" printer, the one of libcups otherwise
+        PrintServer _server;
+        /// URI of an ipp:// or ipps:// printer, empty for a queue
+        std::string _deviceUri;
+        bool _capabilitiesLoaded;
+        std::map<std::string, std::vector<std::string>> _supported;
+        std::map<std::string, std::vector<std::string>> _defaults;
+
+        void release()
+        {
+            if (_dinfo != nullptr)
+            {
+                cupsFreeDestInfo(_dinfo);
+                _dinfo = nullptr;
+            }
+            if (_http != nullptr)
+            {
+                httpClose(_http);
+                _http = nullptr;
+            }
+            if (_dest != nullptr)
+            {
+                cupsFreeDests(1, _dest);
+                _dest = nullptr;
+            }
+            _capabilitiesLoaded = false;
+            _supported.clear();
+            _defaults.clear();
+        }
+
+        /// Resource of the printer-uri-supported of _dest, as cupsConnectDest does, else the printer one of queue
+        void setResource(const std::string &queue)
+        {
+            const char *uri = cupsGetOption("printer-uri-supported", _dest->num_options, _dest->options);
+            char scheme[32], userpass[256], host[256];
+            int port = 0;
+            if (uri == nullptr || httpSeparateURI(HTTP_URI_CODING_ALL, uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port,
+                                                  _resource, sizeof(_resource)) < HTTP_URI_STATUS_OK)
+            {
+                snprintf(_resource, sizeof(_resource), "/printers/%s", queue.c_str());
+            }
+        }
+
+        std::string getPrinterUri() const
+        {
+            const char *uri = cupsGetOption("printer-uri-supported", _dest->num_options, _dest->options);
+            if (uri != nullptr)
+            {
+                return uri;
+            }
+            return makePrinterUri(_dest->name);
+        }
+
+        /// resolveAutoFormat with the document formats of the destination info
+        std::string getAutoFormat(const std::string &format, const std::string &data)
+        {
+            std::vector<std::string> supported;
+            ipp_attribute_t *attr = (format == CUPS_FORMAT_AUTO) ? cupsFindDestSupported(_http, _dest, _dinfo, "document-format") : nullptr;
+            for (int i = 0; attr != nullptr && i < ippGetCount(attr); ++i)
+            {
+                supported.push_back(ippGetString(attr, i, nullptr));
+            }
+            return selectAutoFormat(format, data.data(), data.size(), supported);
+        }
+
+        /** Open the connection of the handle again, as TaskConnection does after an interrupted operation.
+         * A failure shows on the next call.
+         */
+        void reconnect()
+        {
+            int timeout = getDefaultTaskTimeout();
+            httpReconnect2(_http, timeout > 0 ? timeout : DEFAULT_CONNECT_TIMEOUT, nullptr);
+        }
+
+#define REQUIRE_PRINTER_OPEN()                    \
+    if (_http == nullptr)                         \
+    {                                             \
+        RETURN_EXCEPTION_STR("Printer is closed"); \
+    }
+
+        Napi::Value getName(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            return Napi::String::New(env, _server.getPrinterName(_dest->name));
+        }
+
+        /** Send data to the printer
+         * @param data String/NativeBuffer, mandatory, raw data bytes
+         * @param docname String, mandatory, specifying document name
+         * @param type String, mandatory, specifying data type. E.G.: RAW, TEXT, ...
+         * @param options Object, mandatory, CUPS options
+         * @returns job id, tracked and counted in the stats as a printDirect one
+         */
+        Napi::Value print(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            REQUIRE_ARGUMENTS(info, 4);
+
+            std::string data;
+            if (!getStringOrBufferFromNapiValue(info[0], data))
+            {
+                RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
+            }
+            REQUIRE_ARGUMENT_STRING(info, 1, docname);
+            REQUIRE_ARGUMENT_STRING(info, 2, type);
+            REQUIRE_ARGUMENT_OBJECT(info, 3, print_options);
+
+            FormatMapType::const_iterator itFormat = getPrinterFormatMap().find(type);
+            if (itFormat == getPrinterFormatMap().end())
+            {
+                RETURN_EXCEPTION_STR("unsupported format type");
+            }
+
+            CupsOptions options(print_options);
+            std::string format = getAutoFormat(itFormat->second, data);
+            std::string printername = _deviceUri.empty() ? _server.getPrinterName(_dest->name) : _deviceUri;
+            ScopedCallStats stats(STATS_PRINT_DIRECT, printername);
+
+            // the upload of the module functions, on the connection of the handle
+            CallDeadline deadline(_callState);
+            MemorySource source(data.data(), data.size());
+            int job_id = 0;
+            std::string error_str;
+            {
+                StatsTimer ippTimer(&stats, StatsTimer::IPP);
+                if (_deviceUri.empty())
+                {
+                    error_str = uploadDocument(_http, _server, _dest->name, docname, format, options.getNumOptions(), options.get(), source,
+                                               &deadline.getState(), *getBackendState(env)->jobTracker, job_id);
+                }
+                else
+                {
+                    error_str = uploadDeviceDocument(_http, _dest, _dinfo, deadline.getState(), _deviceUri, docname, format, options.getNumOptions(), options.get(),
+                                                     source, job_id);
+                }
+            }
+            if (!error_str.empty())
+            {
+                stats.setError();
+                std::string error_code = deadline.getErrorCode();
+                error_str = deadline.getError(error_str);
+                // the request may be left half written, or the connection shut down
+                reconnect();
+                RETURN_EXCEPTION_CODE(error_str, error_code);
+            }
+
+            return Napi::Number::New(env, job_id);
+        }
+
+        /** Retrieve printer jobs
+         * @param which String, optional, one of ACTIVE (default), COMPLETED, ALL
+         */
+        Napi::Value getJobs(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+
+            std::string which;
+            if (info.Length() > 0 && !info[0].IsUndefined())
+            {
+                REQUIRE_ARGUMENT_STRING(info, 0, whichArg);
+                which = whichArg;
+            }
+            int whichJobs = getWhichJobs(which);
+            if (whichJobs == -2)
+            {
+                RETURN_EXCEPTION_STR("wrong jobs filter. use one of ACTIVE, COMPLETED, ALL");
+            }
+
+            CallDeadline deadline(_callState);
+            cups_job_t *jobs = nullptr;
+            int totalJobs = getJobsTraced(_http, &jobs, _dest->name, whichJobs);
+            if (totalJobs < 0)
+            {
+                RETURN_EXCEPTION_CODE(deadline.getError(cupsLastErrorString()), deadline.getErrorCode());
+            }
+            Napi::Array result = Napi::Array::New(env, totalJobs > 0 ? totalJobs : 0);
+            cups_job_t *job = jobs;
+            for (int jobi = 0; jobi < totalJobs; ++jobi, ++job)
+            {
+                result.Set(jobi, convertJob(env, JobInfo(job)));
+            }
+            cupsFreeJobs(totalJobs, jobs);
+            return result;
+        }
+
+        /** Retrieve job info with a single Get-Job-Attributes request
+         * @param job id Number
+         */
+        Napi::Value getJob(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            REQUIRE_ARGUMENTS(info, 1);
+            REQUIRE_ARGUMENT_INTEGER(info, 0, jobId);
+
+            ipp_t *request = ippNewRequest(IPP_OP_GET_JOB_ATTRIBUTES);
+            ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", nullptr, getPrinterUri().c_str());
+            ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", jobId);
+            ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr, cupsUser());
+
+            CallDeadline deadline(_callState);
+            TraceSpan span("cupsDoRequest", _dest->name, jobId);
+            ipp_t *response = cupsDoRequest(_http, request, _resource);
+            span.setStatus(cupsLastError());
+            JobInfo job;
+            bool found = (response != nullptr && ippGetStatusCode(response) <= IPP_STATUS_OK_CONFLICTING && readJobAttributes(response, job));
+            ippDelete(response);
+            if (!found)
+            {
+                RETURN_EXCEPTION_CODE(deadline.getError("Printer job not found"), deadline.getErrorCode());
+            }
+            if (job.dest.empty())
+            {
+                job.dest = _dest->name;
+            }
+            return convertJob(env, job);
+        }
+
+        /** Set job command.
+         * @param job id Number
+         * @param job command String
+         * @param value Number, priority of the PRIORITY command
+         */
+        Napi::Value setJob(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            REQUIRE_ARGUMENTS(info, 2);
+            REQUIRE_ARGUMENT_INTEGER(info, 0, jobId);
+            REQUIRE_ARGUMENT_STRING(info, 1, jobCommand);
+            if (jobId < 0)
+            {
+                RETURN_EXCEPTION_STR("Wrong job number");
+            }
+            int value = 0;
+            std::string error_str = checkJobCommand(jobCommand, info[2], value);
+            if (!error_str.empty())
+            {
+                RETURN_EXCEPTION_STR(error_str);
+            }
+            CallDeadline deadline(_callState);
+            return Napi::Boolean::New(env, executeJobCommand(_http, _dest->name, jobId, jobCommand, value));
+        }
+
+        /** Set job command on several jobs
+         * @param job ids Array of Number
+         * @param job command String
+         * @param value Number, priority of the PRIORITY command
+         */
+        Napi::Value setJobs(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            REQUIRE_ARGUMENTS(info, 2);
+            std::vector<int> jobIds;
+            if (!getJobIds(info[0], jobIds))
+            {
+                RETURN_EXCEPTION_STR("Argument 0 must be an array of job numbers");
+            }
+            REQUIRE_ARGUMENT_STRING(info, 1, jobCommand);
+            int value = 0;
+            std::string error_str = checkJobCommand(jobCommand, info[2], value);
+            if (!error_str.empty())
+            {
+                RETURN_EXCEPTION_STR(error_str);
+            }
+            CallDeadline deadline(_callState);
+            return Napi::Boolean::New(env, executeJobsCommand(_http, _dest->name, jobIds, jobCommand, value));
+        }
+
+        /** Cancel all jobs of the printer
+         * @param purge Boolean, optional, also remove the job history
+         */
+        Napi::Value cancelAllJobs(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+            bool purge = (info.Length() > 0 && info[0].ToBoolean().Value());
+            CallDeadline deadline(_callState);
+            return Napi::Boolean::New(env, cancelAllPrinterJobs(_http, _dest->name, purge));
+        }
+
+        /** Get supported and default values of the main job options.
+         * Values are retrieved on first call and cached for the life of the handle.
+         */
+        Napi::Value capabilities(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_PRINTER_OPEN();
+
+            if (!_capabilitiesLoaded)
+            {
+                CallDeadline deadline(_callState);
+                static const char *const optionNames[] = {
+                    "copies", "document-format", "finishings", "media", "media-source", "media-type",
+                    "number-up", "orientation-requested", "output-bin", "print-color-mode",
+                    "print-quality", "printer-resolution", "sides"};
+                for (const char *optionName : optionNames)
+                {
+                    ipp_attribute_t *attr = cupsFindDestSupported(_http, _dest, _dinfo, optionName);
+                    if (attr != nullptr)
+                    {
+                        appendAttributeValues(attr, _supported[optionName]);
+                    }
+                    attr = cupsFindDestDefault(_http, _dest, _dinfo, optionName);
+                    if (attr != nullptr)
+                    {
+                        appendAttributeValues(attr, _defaults[optionName]);
+                    }
+                }
+                _capabilitiesLoaded = true;
+            }
+
+            Napi::Object result = Napi::Object::New(env);
+            for (const auto &itSupported : _supported)
+            {
+                Napi::Object result_option = Napi::Object::New(env);
+                Napi::Array result_values = Napi::Array::New(env, itSupported.second.size());
+                for (size_t i = 0; i < itSupported.second.size(); ++i)
+                {
+                    result_values.Set(static_cast<uint32_t>(i), Napi::String::New(env, itSupported.second[i]));
+                }
+                result_option.Set("supported", result_values);
+
+                std::map<std::string, std::vector<std::string>>::const_iterator itDefault = _defaults.find(itSupported.first);
+                if (itDefault != _defaults.end() && !itDefault->second.empty())
+                {
+                    result_option.Set("default", Napi::String::New(env, itDefault->second.front()));
+                }
+                result.Set(itSupported.first, result_option);
+            }
+            return result;
+        }
+
+        /** Release the connection and the destination. The handle cannot be used after.
+         */
+        Napi::Value close(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            release();
+            return env.Undefined();
+        }
+#undef REQUIRE_PRINTER_OPEN
+    };
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinters)
+{
+    MY_NODE_MODULE_ENV(info);
+    std::string server = (info.Length() > 0 && info[0].IsString()) ? info[0].As<Napi::String>().Utf8Value() : std::string();
+
+    std::vector<PrinterInfo> printers;
+    ScopedCallStats stats(STATS_GET_PRINTERS);
+    std::string error_code;
+    std::string error_str = runSync(withServerBackend<std::vector<PrinterInfo>>(env, server, [](PrintBackend &backend, AbortState &state, std::vector<PrinterInfo> &result)
+                                                                     { return backend.getPrinters(state, result); }),
+                                    printers, error_code);
+    if (!error_str.empty())
+    {
+        // got an error? return the error then
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    StatsTimer timer(&stats, StatsTimer::MARSHAL);
+    return convertPrinters(env, printers);
+}
+
+MY_NODE_MODULE_CALLBACK(getDefaultPrinterName)
+{
+    MY_NODE_MODULE_ENV(info);
+    // This does not return default user printer name according to https://www.cups.org/documentation.php/doc-2.0/api-cups.html#cupsGetDefault2
+    // so leave as undefined and JS implementation will loop in all printers
+    /*
+    const char * printerName = cupsGetDefault();
+
+    // return default printer name only if defined
+    if(printerName != NULL) {
+        return Napi::String::New(env, printerName);
+    }
+    */
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinter)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+
+    PrinterInfo printer;
+    ScopedCallStats stats(STATS_GET_PRINTER, printername);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<PrinterInfo>(env, printername, [&printername](PrintBackend &backend, AbortState &state, PrinterInfo &result)
+                                                             { return backend.getPrinter(state, printername, result); }),
+                                    printer, error_code);
+    if (!error_str.empty())
+    {
+        // printer not found
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    StatsTimer timer(&stats, StatsTimer::MARSHAL);
+    return convertPrinter(env, printer);
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinterDriverOptions)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+
+    DriverOptionsType driver_options;
+    ScopedCallStats stats(STATS_GET_PRINTER_DRIVER_OPTIONS, printername);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<DriverOptionsType>(env, printername, [&printername](PrintBackend &backend, AbortState &state, DriverOptionsType &result)
+                                                                   { return backend.getPrinterDriverOptions(state, printername, result); }),
+                                    driver_options, error_code);
+    if (!error_str.empty())
+    {
+        // printer not found
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    StatsTimer timer(&stats, StatsTimer::MARSHAL);
+    return convertDriverOptions(env, driver_options);
+}
+
+MY_NODE_MODULE_CALLBACK(getJob)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
+
+    JobInfo job;
+    ScopedCallStats stats(STATS_GET_JOB, printername);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<JobInfo>(env, printername, [&printername, jobId](PrintBackend &backend, AbortState &state, JobInfo &result)
+                                                         { return backend.getJob(state, printername, jobId, result); }),
+                                    job, error_code);
+    if (!error_str.empty())
+    {
+        // job not found
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    StatsTimer timer(&stats, StatsTimer::MARSHAL);
+    return convertJob(env, job);
+}
+
+MY_NODE_MODULE_CALLBACK(setJob)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
+    REQUIRE_ARGUMENT_STRING(info, 2, jobCommand);
+    if (jobId < 0)
+    {
+        RETURN_EXCEPTION_STR("Wrong job number");
+    }
+    int value = 0;
+    std::string error_str = checkJobCommand(jobCommand, info[3], value);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    bool result_ok = false;
+    ScopedCallStats stats(STATS_SET_JOB, printername);
+    std::string error_code;
+    error_str = runSync(withBackend<bool>(env, printername, [&printername, jobId, &jobCommand, value](PrintBackend &backend, AbortState &state, bool &result)
+                                          { return backend.setJob(state, printername, jobId, jobCommand, value, result); }),
+                        result_ok, error_code);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    return Napi::Boolean::New(env, result_ok);
+}
+
+MY_NODE_MODULE_CALLBACK(getSupportedJobCommands)
+{
+    MY_NODE_MODULE_ENV(info);
+    Napi::Array result = Napi::Array::New(env);
+    uint32_t i = 0;
+    for (const auto &itJobCommand : getJobCommandMap())
+    {
+        result.Set(i++, Napi::String::New(env, itJobCommand.first));
+    }
+    return result;
+}
+
+MY_NODE_MODULE_CALLBACK(setJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    std::vector<int> jobIds;
+    if (!getJobIds(info[1], jobIds))
+    {
+        RETURN_EXCEPTION_STR("Argument 1 must be an array of job numbers");
+    }
+    REQUIRE_ARGUMENT_STRING(info, 2, jobCommand);
+    int value = 0;
+    std::string error_str = checkJobCommand(jobCommand, info[3], value);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    bool result_ok = false;
+    ScopedCallStats stats(STATS_SET_JOBS, printername);
+    std::string error_code;
+    error_str = runSync(withBackend<bool>(env, printername, [&printername, &jobIds, &jobCommand, value](PrintBackend &backend, AbortState &state, bool &result)
+                                          { return backend.setJobs(state, printername, jobIds, jobCommand, value, result); }),
+                        result_ok, error_code);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    return Napi::Boolean::New(env, result_ok);
+}
+
+MY_NODE_MODULE_CALLBACK(moveJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_STRING(info, 0, from);
+    REQUIRE_ARGUMENT_STRING(info, 1, to);
+    bool all = (info.Length() <= 2 || info[2].IsUndefined() || info[2].IsNull());
+    std::vector<int> jobIds;
+    if (!all && !getJobIds(info[2], jobIds))
+    {
+        RETURN_EXCEPTION_STR("Argument 2 must be an array of job numbers");
+    }
+
+    ScopedCallStats stats(STATS_MOVE_JOBS, from);
+    std::string error_code;
+    std::string error_str;
+    if (all)
+    {
+        bool result_ok = false;
+        error_str = runSync(withBackend<bool>(env, from, [&from, &to](PrintBackend &backend, AbortState &state, bool &result)
+                                              { return backend.moveAllJobs(state, from, to, result); }),
+                            result_ok, error_code);
+        if (error_str.empty())
+        {
+            return Napi::Boolean::New(env, result_ok);
+        }
+    }
+    else
+    {
+        std::vector<int> movedJobIds;
+        error_str = runSync(withBackend<std::vector<int>>(env, from, [&from, &jobIds, &to](PrintBackend &backend, AbortState &state, std::vector<int> &result)
+                                                          { return backend.moveJobs(state, from, jobIds, to, result); }),
+                            movedJobIds, error_code);
+        if (error_str.empty())
+        {
+            StatsTimer timer(&stats, StatsTimer::MARSHAL);
+            return convertJobIds(env, movedJobIds);
+        }
+    }
+    RETURN_EXCEPTION_CODE(error_str, error_code);
+}
+
+MY_NODE_MODULE_CALLBACK(cancelAllJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    bool purge = (info.Length() > 1 && info[1].ToBoolean().Value());
+
+    bool result_ok = false;
+    ScopedCallStats stats(STATS_CANCEL_ALL_JOBS, printername);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<bool>(env, printername, [&printername, purge](PrintBackend &backend, AbortState &state, bool &result)
+                                                      { return backend.cancelAllJobs(state, printername, purge, result); }),
+                                    result_ok, error_code);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+    return Napi::Boolean::New(env, result_ok);
+}
+
+MY_NODE_MODULE_CALLBACK(getSupportedPrintFormats)
+{
+    MY_NODE_MODULE_ENV(info);
     Napi::Array result = Napi::Array::New(env);
     uint32_t i = 0;
-    result.Set(i++, Napi::String::New(env, "CANCEL"));
+    for (const auto &itFormat : getPrinterFormatMap())
+    {
+        result.Set(i++, Napi::String::New(env, itFormat.first));
+        ;
+    }
     return result;
 }
 
-MY_NODE_MODULE_CALLBACK(getSupportedPrintFormats)
+MY_NODE_MODULE_CALLBACK(PrintDirect)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 5);
+
+    // can be string or buffer
+    if (info.Length() <= 0)
+    {
+        RETURN_EXCEPTION_STR("Argument 0 missing");
+    }
+
+    std::string data;
+    Napi::Value arg0(info[0]);
+    if (!getStringOrBufferFromNapiValue(arg0, data))
+    {
+        RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
+    }
+
+    REQUIRE_ARGUMENT_STRING(info, 1, printername);
+    REQUIRE_ARGUMENT_STRING(info, 2, docname);
+    REQUIRE_ARGUMENT_STRING(info, 3, type);
+    REQUIRE_ARGUMENT_OBJECT(info, 4, print_options);
+
+    FormatMapType::const_iterator itFormat = getPrinterFormatMap().find(type);
+    if (itFormat == getPrinterFormatMap().end())
+    {
+        RETURN_EXCEPTION_STR("unsupported format type");
+    }
+    type = itFormat->second;
+
+    CupsOptions options(print_options);
+
+    int job_id = 0;
+    ScopedCallStats stats(STATS_PRINT_DIRECT, printername);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<int>(env, printername, [&](PrintBackend &backend, AbortState &state, int &result)
+                                                     {
+                                                         MemorySource source(data.c_str(), data.size());
+                                                         std::string format = resolveAutoFormat(backend, state, printername, type, data.data(), data.size());
+                                                         return backend.submitDocument(state, printername, docname, format, options.getNumOptions(), options.get(), source, result); }),
+                                    job_id, error_code);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_CODE(error_str, error_code);
+    }
+
+    return Napi::Number::New(env, job_id);
+}
+
+MY_NODE_MODULE_CALLBACK(detectDocumentFormat)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    std::string format;
+    if (info[0].IsBuffer())
+    {
+        Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+        format = sniffDocumentFormat(buffer.Data(), buffer.Length());
+    }
+    else
+    {
+        std::string data;
+        if (!getStringOrBufferFromNapiValue(info[0], data))
+        {
+            RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
+        }
+        format = sniffDocumentFormat(data.data(), data.size());
+    }
+    if (format.empty())
+    {
+        return env.Undefined();
+    }
+    return Napi::String::New(env, format);
+}
+
+MY_NODE_MODULE_CALLBACK(PrintFile)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 3);
+
+    // can be string or buffer
+    if (info.Length() <= 0)
+    {
+        RETURN_EXCEPTION_STR("Argument 0 missing");
+    }
+
+    REQUIRE_ARGUMENT_STRING(info, 0, filename);
+    REQUIRE_ARGUMENT_STRING(info, 1, docname);
+    REQUIRE_ARGUMENT_STRING(info, 2, printer);
+    REQUIRE_ARGUMENT_OBJECT(info, 3, print_options);
+
+    CupsOptions options(print_options);
+
+    int job_id = 0;
+    ScopedCallStats stats(STATS_PRINT_FILE, printer);
+    std::string error_code;
+    std::string error_str = runSync(withBackend<int>(env, printer, [&](PrintBackend &backend, AbortState &state, int &result)
+                                                     {
+                                                         FileSource source(filename);
+                                                         if (!source.isOpen())
+                                                         {
+                                                             return source.getError();
+                                                         }
+                                                         return backend.submitDocument(state, printer, docname, source.resolveFormat(backend, state, printer, CUPS_FORMAT_AUTO), options.getNumOptions(), options.get(), source, result); }),
+                                    job_id, error_code);
+
+    if (!error_str.empty())
+    {
+        return Napi::String::New(env, error_str);
+    }
+    else
+    {
+        return Napi::Number::New(env, job_id);
+    }
+}
+
+MY_NODE_MODULE_CALLBACK(openPrinter)
 {
     MY_NODE_MODULE_ENV(info);
-    Napi::Array result = Napi::Array::New(env);
-    uint32_t i = 0;
-    for (const auto &itFormat : getPrinterFormatMap())
+
+    REQUIRE_ARGUMENTS(info, 1);
+    ARG_CHECK_STRING(info, 0);
+
+    Napi::Object printer = Printer::getClass(env).New({info[0]});
+    if (env.IsExceptionPending())
     {
-        result.Set(i++, Napi::String::New(env, itFormat.first));
-        ;
+        return env.Null();
     }
-    return result;
+    return printer;
 }
 
-MY_NODE_MODULE_CALLBACK(PrintDirect)
+MY_NODE_MODULE_CALLBACK(getPrintersAsync)
 {
     MY_NODE_MODULE_ENV(info);
-    REQUIRE_ARGUMENTS(info, 5);
+    std::string server;
+    if (info.Length() > 0 && info[0].IsObject() && info[0].As<Napi::Object>().Get("server").IsString())
+    {
+        server = info[0].As<Napi::Object>().Get("server").As<Napi::String>().Utf8Value();
+    }
 
-    // can be string or buffer
-    if (info.Length() <= 0)
+    FunctionTask<std::vector<PrinterInfo>> *task = new FunctionTask<std::vector<PrinterInfo>>(
+        env, withServerBackend<std::vector<PrinterInfo>>(env, server, [](PrintBackend &backend, AbortState &state, std::vector<PrinterInfo> &printers)
+                                                   { return backend.getPrinters(state, printers); }),
+        convertPrinters);
+    task->setStats(STATS_GET_PRINTERS);
+    task->bindAbortHandle(info[0]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(enumPrintersAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_OBJECT(info, 0, filterArg);
+    if (!info[1].IsFunction())
     {
-        RETURN_EXCEPTION_STR("Argument 0 missing");
+        RETURN_EXCEPTION_STR("Argument 1 must be a function");
     }
+    EnumPrintersFilter filter;
+    if (filterArg.Get("type").IsNumber())
+    {
+        filter.type = filterArg.Get("type").As<Napi::Number>().Uint32Value();
+    }
+    if (filterArg.Get("mask").IsNumber())
+    {
+        filter.mask = filterArg.Get("mask").As<Napi::Number>().Uint32Value();
+    }
+    std::string server;
+    if (filterArg.Get("server").IsString())
+    {
+        server = filterArg.Get("server").As<Napi::String>().Utf8Value();
+    }
+    std::shared_ptr<PrinterStream> stream = std::make_shared<PrinterStream>(env, info[1].As<Napi::Function>());
 
-    std::string data;
-    Napi::Value arg0(info[0]);
-    if (!getStringOrBufferFromNapiValue(arg0, data))
+    FunctionTask<int> *task = new FunctionTask<int>(
+        env, withServerBackend<int>(env, server, [filter, stream](PrintBackend &backend, AbortState &state, int &count)
+                              {
+                                  std::string error_str = backend.enumPrinters(state, filter, [&](const PrinterInfo &printer)
+                                                                               {
+                                                                                   if (state.isAborted() || !stream->push(printer))
+                                                                                   {
+                                                                                       return false;
+                                                                                   }
+                                                                                   ++count;
+                                                                                   return true;
+                                                                               });
+                                  stream->close();
+                                  return error_str; }),
+        [](Napi::Env env, const int &count)
+        { return Napi::Number::New(env, count); });
+    task->setStats(STATS_GET_PRINTERS);
+    task->bindAbortHandle(info[2]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinterAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+
+    FunctionTask<PrinterInfo> *task = new FunctionTask<PrinterInfo>(
+        env, withBackend<PrinterInfo>(env, printername, [printername](PrintBackend &backend, AbortState &state, PrinterInfo &printer)
+                                      { return backend.getPrinter(state, printername, printer); }),
+        convertPrinter);
+    task->setStats(STATS_GET_PRINTER, printername);
+    task->bindAbortHandle(info[1]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinterDriverOptionsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+
+    FunctionTask<DriverOptionsType> *task = new FunctionTask<DriverOptionsType>(
+        env, withBackend<DriverOptionsType>(env, printername, [printername](PrintBackend &backend, AbortState &state, DriverOptionsType &options)
+                                            { return backend.getPrinterDriverOptions(state, printername, options); }),
+        convertDriverOptions);
+    task->setStats(STATS_GET_PRINTER_DRIVER_OPTIONS, printername);
+    task->bindAbortHandle(info[1]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(getJobAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
+
+    FunctionTask<JobInfo> *task = new FunctionTask<JobInfo>(
+        env, withBackend<JobInfo>(env, printername, [printername, jobId](PrintBackend &backend, AbortState &state, JobInfo &job)
+                                  { return backend.getJob(state, printername, jobId, job); }),
+        convertJob);
+    task->setStats(STATS_GET_JOB, printername);
+    task->bindAbortHandle(info[2]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(setJobAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    REQUIRE_ARGUMENT_INTEGER(info, 1, jobId);
+    REQUIRE_ARGUMENT_STRING(info, 2, jobCommand);
+    if (jobId < 0)
+    {
+        RETURN_EXCEPTION_STR("Wrong job number");
+    }
+    int value = 0;
+    std::string error_str = checkJobCommand(jobCommand, info[3], value);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+
+    FunctionTask<bool> *task = new FunctionTask<bool>(
+        env, withBackend<bool>(env, printername, [printername, jobId, jobCommand, value](PrintBackend &backend, AbortState &state, bool &result)
+                               { return backend.setJob(state, printername, jobId, jobCommand, value, result); }),
+        convertBoolean);
+    task->setStats(STATS_SET_JOB, printername);
+    task->bindAbortHandle(info[4]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(setJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    std::vector<int> jobIds;
+    if (!getJobIds(info[1], jobIds))
+    {
+        RETURN_EXCEPTION_STR("Argument 1 must be an array of job numbers");
+    }
+    REQUIRE_ARGUMENT_STRING(info, 2, jobCommand);
+    int value = 0;
+    std::string error_str = checkJobCommand(jobCommand, info[3], value);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+
+    FunctionTask<bool> *task = new FunctionTask<bool>(
+        env, withBackend<bool>(env, printername, [printername, jobIds, jobCommand, value](PrintBackend &backend, AbortState &state, bool &result)
+                               { return backend.setJobs(state, printername, jobIds, jobCommand, value, result); }),
+        convertBoolean);
+    task->setStats(STATS_SET_JOBS, printername);
+    task->bindAbortHandle(info[4]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(moveJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_STRING(info, 0, from);
+    REQUIRE_ARGUMENT_STRING(info, 1, to);
+    bool all = (info.Length() <= 2 || info[2].IsUndefined() || info[2].IsNull());
+    std::vector<int> jobIds;
+    if (!all && !getJobIds(info[2], jobIds))
+    {
+        RETURN_EXCEPTION_STR("Argument 2 must be an array of job numbers");
+    }
+
+    if (all)
+    {
+        FunctionTask<bool> *task = new FunctionTask<bool>(
+            env, withBackend<bool>(env, from, [from, to](PrintBackend &backend, AbortState &state, bool &result)
+                                   { return backend.moveAllJobs(state, from, to, result); }),
+            convertBoolean);
+        task->setStats(STATS_MOVE_JOBS, from);
+        task->bindAbortHandle(info[3]);
+        return task->queue();
+    }
+    FunctionTask<std::vector<int>> *task = new FunctionTask<std::vector<int>>(
+        env, withBackend<std::vector<int>>(env, from, [from, jobIds, to](PrintBackend &backend, AbortState &state, std::vector<int> &result)
+                                           { return backend.moveJobs(state, from, jobIds, to, result); }),
+        convertJobIds);
+    task->setStats(STATS_MOVE_JOBS, from);
+    task->bindAbortHandle(info[3]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(cancelAllJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, printername);
+    bool purge = (info.Length() > 1 && info[1].ToBoolean().Value());
+
+    FunctionTask<bool> *task = new FunctionTask<bool>(
+        env, withBackend<bool>(env, printername, [printername, purge](PrintBackend &backend, AbortState &state, bool &result)
+                               { return backend.cancelAllJobs(state, printername, purge, result); }),
+        convertBoolean);
+    task->setStats(STATS_CANCEL_ALL_JOBS, printername);
+    task->bindAbortHandle(info[2]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(PrintDirectAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 5);
+
+    std::shared_ptr<DocumentData> data = std::make_shared<DocumentData>();
+    if (!data->assign(info[0]))
     {
         RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
     }
@@ -494,60 +4107,320 @@ MY_NODE_MODULE_CALLBACK(PrintDirect)
     {
         RETURN_EXCEPTION_STR("unsupported format type");
     }
-    type = itFormat->second;
+    std::string format = itFormat->second;
 
-    CupsOptions options(print_options);
+    std::shared_ptr<CupsOptions> options = std::make_shared<CupsOptions>(print_options);
+    std::shared_ptr<UploadProgress> progress = getUploadProgress(info[5]);
+
+    FunctionTask<int> *task = new FunctionTask<int>(
+        env, withBackend<int>(env, printername, [data, printername, docname, format, options, progress](PrintBackend &backend, AbortState &abort, int &job_id)
+                              {
+                                  MemorySource memory(data->data(), data->size());
+                                  ProgressSource source(memory, progress);
+                                  std::string resolved = resolveAutoFormat(backend, abort, printername, format, data->data(), data->size());
+                                  return backend.submitDocument(abort, printername, docname, resolved, options->getNumOptions(), options->get(), source, job_id); }),
+        convertJobId);
+    task->setStats(STATS_PRINT_DIRECT, printername);
+    task->bindAbortHandle(info[5]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(PrintFileAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 4);
+
+    REQUIRE_ARGUMENT_STRING(info, 0, filename);
+    REQUIRE_ARGUMENT_STRING(info, 1, docname);
+    REQUIRE_ARGUMENT_STRING(info, 2, printer);
+    REQUIRE_ARGUMENT_OBJECT(info, 3, print_options);
+
+    std::shared_ptr<CupsOptions> options = std::make_shared<CupsOptions>(print_options);
+    std::shared_ptr<UploadProgress> progress = getUploadProgress(info[4]);
+
+    FunctionTask<int> *task = new FunctionTask<int>(
+        env, withBackend<int>(env, printer, [filename, docname, printer, options, progress](PrintBackend &backend, AbortState &abort, int &job_id)
+                              {
+                                  FileSource file(filename);
+                                  if (!file.isOpen())
+                                  {
+                                      return file.getError();
+                                  }
+                                  ProgressSource source(file, progress);
+                                  return backend.submitDocument(abort, printer, docname, file.resolveFormat(backend, abort, printer, CUPS_FORMAT_AUTO), options->getNumOptions(), options->get(), source, job_id); }),
+        convertJobId);
+    task->setStats(STATS_PRINT_FILE, printer);
+    task->bindAbortHandle(info[4]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(setCircuitBreakerOptions)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_OBJECT(info, 0, options);
 
-    int job_id = cupsCreateJob(CUPS_HTTP_DEFAULT, printername.c_str(), docname.c_str(), options.getNumOptions(), options.get());
-    if (job_id == 0)
+    Napi::Value failureThreshold = options.Get("failureThreshold");
+    if (!failureThreshold.IsUndefined())
+    {
+        if (!failureThreshold.IsNumber() || failureThreshold.As<Napi::Number>().Int32Value() < 0)
+        {
+            RETURN_EXCEPTION_STR("failureThreshold must be a positive number or 0");
+        }
+        circuitFailureThreshold = failureThreshold.As<Napi::Number>().Int32Value();
+    }
+    Napi::Value resetTimeout = options.Get("resetTimeout");
+    if (!resetTimeout.IsUndefined())
     {
-        RETURN_EXCEPTION_STR(cupsLastErrorString());
+        if (!resetTimeout.IsNumber() || resetTimeout.As<Napi::Number>().Int32Value() < 1)
+        {
+            RETURN_EXCEPTION_STR("resetTimeout must be a positive number of milliseconds");
+        }
+        circuitResetTimeout = resetTimeout.As<Napi::Number>().Int32Value();
     }
 
-    if (HTTP_CONTINUE != cupsStartDocument(CUPS_HTTP_DEFAULT, printername.c_str(), job_id, docname.c_str(), type.c_str(), 1 /*last document*/))
+    if (circuitFailureThreshold <= 0)
     {
-        RETURN_EXCEPTION_STR(cupsLastErrorString());
+        // disabled: close the open circuits
+        CircuitBreakers &circuitBreakers = getCircuitBreakers();
+        std::lock_guard<std::mutex> lock(circuitBreakers.mutex);
+        for (const auto &itBreaker : circuitBreakers.breakers)
+        {
+            itBreaker.second->reset();
+        }
     }
+    return env.Undefined();
+}
 
-    /* cupsWriteRequestData can be called as many times as needed */
-    // TODO: to split big buffer
-    if (HTTP_CONTINUE != cupsWriteRequestData(CUPS_HTTP_DEFAULT, data.c_str(), data.size()))
+MY_NODE_MODULE_CALLBACK(getCircuitBreakerState)
+{
+    MY_NODE_MODULE_ENV(info);
+    Napi::Object result = Napi::Object::New(env);
+    CircuitBreakers &circuitBreakers = getCircuitBreakers();
+    std::lock_guard<std::mutex> lock(circuitBreakers.mutex);
+    for (const auto &itBreaker : circuitBreakers.breakers)
     {
-        cupsFinishDocument(CUPS_HTTP_DEFAULT, printername.c_str());
-        RETURN_EXCEPTION_STR(cupsLastErrorString());
+        Napi::Object result_breaker = Napi::Object::New(env);
+        result_breaker.Set("state", Napi::String::New(env, itBreaker.second->isOpen() ? "OPEN" : "CLOSED"));
+        result_breaker.Set("failures", Napi::Number::New(env, itBreaker.second->getFailures()));
+        result.Set(itBreaker.first, result_breaker);
     }
+    return result;
+}
 
-    cupsFinishDocument(CUPS_HTTP_DEFAULT, printername.c_str());
+namespace
+{
+    typedef std::map<std::string, http_encryption_t> EncryptionMapType;
 
-    return Napi::Number::New(env, job_id);
+    EncryptionMapType newEncryptionMap()
+    {
+        EncryptionMapType result;
+        result.insert(std::make_pair("IF_REQUESTED", HTTP_ENCRYPTION_IF_REQUESTED));
+        result.insert(std::make_pair("NEVER", HTTP_ENCRYPTION_NEVER));
+        result.insert(std::make_pair("REQUIRED", HTTP_ENCRYPTION_REQUIRED));
+        result.insert(std::make_pair("ALWAYS", HTTP_ENCRYPTION_ALWAYS));
+        return result;
+    }
+
+    /// Built once, thread safe, never modified afterwards
+    const EncryptionMapType &getEncryptionMap()
+    {
+        static const EncryptionMapType result = newEncryptionMap();
+        return result;
+    }
+
+    std::string getEncryptionName(http_encryption_t encryption)
+    {
+        for (const auto &itEncryption : getEncryptionMap())
+        {
+            if (itEncryption.second == encryption)
+            {
+                return itEncryption.first;
+            }
+        }
+        return "";
+    }
 }
 
-MY_NODE_MODULE_CALLBACK(PrintFile)
+MY_NODE_MODULE_CALLBACK(addPrintServer)
 {
     MY_NODE_MODULE_ENV(info);
-    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_STRING(info, 0, name);
+    REQUIRE_ARGUMENT_OBJECT(info, 1, options);
 
-    // can be string or buffer
-    if (info.Length() <= 0)
+    if (name.empty() || name.find('@') != std::string::npos)
     {
-        RETURN_EXCEPTION_STR("Argument 0 missing");
+        RETURN_EXCEPTION_STR("name must be a non empty string without @");
     }
+    PrintServer server;
+    server.name = name;
+    server.port = ippPort();
+    server.encryption = cupsEncryption();
 
-    REQUIRE_ARGUMENT_STRING(info, 0, filename);
-    REQUIRE_ARGUMENT_STRING(info, 1, docname);
-    REQUIRE_ARGUMENT_STRING(info, 2, printer);
-    REQUIRE_ARGUMENT_OBJECT(info, 3, print_options);
+    Napi::Value host = options.Get("host");
+    if (!host.IsString() || host.As<Napi::String>().Utf8Value().empty())
+    {
+        RETURN_EXCEPTION_STR("host must be a non empty string");
+    }
+    server.host = host.As<Napi::String>().Utf8Value();
+    Napi::Value port = options.Get("port");
+    if (!port.IsUndefined())
+    {
+        if (!port.IsNumber() || port.As<Napi::Number>().Int32Value() <= 0 || port.As<Napi::Number>().Int32Value() > 65535)
+        {
+            RETURN_EXCEPTION_STR("port must be a number between 1 and 65535");
+        }
+        server.port = port.As<Napi::Number>().Int32Value();
+    }
+    Napi::Value encryption = options.Get("encryption");
+    if (!encryption.IsUndefined())
+    {
+        EncryptionMapType::const_iterator itEncryption = encryption.IsString() ? getEncryptionMap().find(encryption.As<Napi::String>().Utf8Value()) : getEncryptionMap().end();
+        if (itEncryption == getEncryptionMap().end())
+        {
+            RETURN_EXCEPTION_STR("encryption must be one of IF_REQUESTED, NEVER, REQUIRED or ALWAYS");
+        }
+        server.encryption = itEncryption->second;
+    }
 
-    CupsOptions options(print_options);
+    PrintServers &printServers = *getBackendState(env)->printServers;
+    std::lock_guard<std::mutex> lock(printServers.mutex);
+    printServers.servers[name] = server;
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(removePrintServer)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, name);
 
-    int job_id = cupsPrintFile(printer.c_str(), filename.c_str(), docname.c_str(), options.getNumOptions(), options.get());
+    PrintServers &printServers = *getBackendState(env)->printServers;
+    std::lock_guard<std::mutex> lock(printServers.mutex);
+    return Napi::Boolean::New(env, printServers.servers.erase(name) > 0);
+}
 
-    if (job_id == 0)
+MY_NODE_MODULE_CALLBACK(getPrintServers)
+{
+    MY_NODE_MODULE_ENV(info);
+    PrintServers &printServers = *getBackendState(env)->printServers;
+    std::lock_guard<std::mutex> lock(printServers.mutex);
+    Napi::Array result = Napi::Array::New(env, printServers.servers.size());
+    uint32_t i = 0;
+    for (const auto &itServer : printServers.servers)
     {
-        return Napi::String::New(env, cupsLastErrorString());
+        Napi::Object result_server = Napi::Object::New(env);
+        result_server.Set("name", Napi::String::New(env, itServer.first));
+        result_server.Set("host", Napi::String::New(env, itServer.second.host));
+        result_server.Set("port", Napi::Number::New(env, itServer.second.port));
+        result_server.Set("encryption", Napi::String::New(env, getEncryptionName(itServer.second.encryption)));
+        result.Set(i++, result_server);
     }
-    else
+    return result;
+}
+
+MY_NODE_MODULE_CALLBACK(startJobTracker)
+{
+    MY_NODE_MODULE_ENV(info);
+    int interval = 1000;
+    if (info.Length() > 0 && info[0].IsObject())
     {
-        return Napi::Number::New(env, job_id);
+        Napi::Value intervalValue = info[0].As<Napi::Object>().Get("interval");
+        if (!intervalValue.IsUndefined())
+        {
+            if (!intervalValue.IsNumber() || intervalValue.As<Napi::Number>().Int32Value() <= 0)
+            {
+                RETURN_EXCEPTION_STR("interval must be a positive number");
+            }
+            interval = intervalValue.As<Napi::Number>().Int32Value();
+        }
+    }
+    getBackendState(env)->jobTracker->start(interval);
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(stopJobTracker)
+{
+    MY_NODE_MODULE_ENV(info);
+    getBackendState(env)->jobTracker->stop();
+    return env.Undefined();
+}
+
+MY_NODE_MODULE_CALLBACK(getJobLatencyStats)
+{
+    MY_NODE_MODULE_ENV(info);
+    bool reset = false;
+    if (info.Length() > 0 && info[0].IsObject())
+    {
+        reset = info[0].As<Napi::Object>().Get("reset").ToBoolean().Value();
     }
+    return getBackendState(env)->jobTracker->snapshot(env, reset);
+}
+
+MY_NODE_MODULE_CALLBACK(setBackend)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRING(info, 0, name);
+
+    if (name == "cups")
+    {
+        setBackend(*getBackendState(env), nullptr);
+        return env.Undefined();
+    }
+    if (name != "memory")
+    {
+        RETURN_EXCEPTION_STR("unsupported backend. use one of cups, memory");
+    }
+
+    MemoryBackendOptions options;
+    if (info.Length() > 1 && info[1].IsObject())
+    {
+        Napi::Object optionsObj = info[1].As<Napi::Object>();
+        Napi::Value printers = optionsObj.Get("printers");
+        if (!printers.IsUndefined())
+        {
+            if (!printers.IsArray())
+            {
+                RETURN_EXCEPTION_STR("printers must be an array of printer names");
+            }
+            Napi::Array printersArray = printers.As<Napi::Array>();
+            for (uint32_t i = 0; i < printersArray.Length(); ++i)
+            {
+                Napi::Value printer = printersArray.Get(i);
+                if (!printer.IsString())
+                {
+                    RETURN_EXCEPTION_STR("printers must be an array of printer names");
+                }
+                options.printers.push_back(printer.As<Napi::String>().Utf8Value());
+            }
+        }
+        static const struct
+        {
+            const char *name;
+            int MemoryBackendOptions::*member;
+        } durations[] = {{"latency", &MemoryBackendOptions::latency},
+                         {"chunkLatency", &MemoryBackendOptions::chunkLatency},
+                         {"printTime", &MemoryBackendOptions::printTime}};
+        for (const auto &duration : durations)
+        {
+            Napi::Value value = optionsObj.Get(duration.name);
+            if (value.IsUndefined())
+            {
+                continue;
+            }
+            if (!value.IsNumber() || value.As<Napi::Number>().Int32Value() < 0)
+            {
+                RETURN_EXCEPTION_STR(std::string(duration.name) + " must be a positive number");
+            }
+            options.*duration.member = value.As<Napi::Number>().Int32Value();
+        }
+    }
+    if (options.printers.empty())
+    {
+        options.printers.push_back("memory");
+    }
+    setBackend(*getBackendState(env), newMemoryBackend(options));
+    return env.Undefined();
 }
@@ -0,0 +1,772 @@
+#include "node_printer.hpp"
+#include "node_printer_pool.hpp"
+#include "node_printer_raster.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// Size of a PWG raster page header
+    const size_t PWG_HEADER_SIZE = 1796;
+
+    /// Size of an URF page header
+    const size_t URF_HEADER_SIZE = 32;
+
+    /// Rows below which a page is not split in more bands
+    const uint32_t MIN_BAND_ROWS = 64;
+
+    /// Bands of a page, whatever the number of cores: the encoding depends only on the page
+    const uint32_t MAX_BANDS = 8;
+
+    const uint32_t DEFAULT_RESOLUTION = 203;
+
+    /// Largest count of one ZPL ACS repeat prefix: z (400) and Y (19)
+    const uint32_t ZPL_MAX_COUNT = 419;
+
+    /// Rows of an ESC/POS GS v 0 command, within the buffer of common receipt printers
+    const uint32_t DEFAULT_ESCPOS_BAND_ROWS = 256;
+
+    /// ESC/POS GS v 0 takes 2 bytes for the width in bytes and the height
+    const uint32_t ESCPOS_MAX_SIZE = 0xffff;
+
+    /// PWG color spaces (cups_cspace_t values)
+    const uint32_t PWG_CSPACE_BLACK = 3;
+    const uint32_t PWG_CSPACE_SGRAY = 18;
+    const uint32_t PWG_CSPACE_SRGB = 19;
+
+    /// URF color spaces
+    const uint8_t URF_CSPACE_SGRAY = 0;
+    const uint8_t URF_CSPACE_SRGB = 1;
+
+    enum RasterFormat
+    {
+        RASTER_PWG,
+        RASTER_URF
+    };
+
+    enum RasterColorSpace
+    {
+        /// 1 bit per pixel, 1 is black
+        RASTER_BLACK,
+        RASTER_SGRAY,
+        RASTER_SRGB
+    };
+
+    /// 8x8 Bayer matrix, thresholds for the ordered dithering
+    const uint8_t BAYER_MATRIX[8][8] = {
+        {0, 128, 32, 160, 8, 136, 40, 168},
+        {192, 64, 224, 96, 200, 72, 232, 104},
+        {48, 176, 16, 144, 56, 184, 24, 152},
+        {240, 112, 208, 80, 248, 120, 216, 88},
+        {12, 140, 44, 172, 4, 132, 36, 164},
+        {204, 76, 236, 108, 196, 68, 228, 100},
+        {60, 188, 28, 156, 52, 180, 20, 148},
+        {252, 124, 220, 92, 244, 116, 212, 84}};
+
+    struct RasterOptions
+    {
+        RasterOptions() : format(RASTER_PWG), colorSpace(RASTER_SGRAY), width(0), height(0), channels(1),
+                          resolution(DEFAULT_RESOLUTION), dither(false), threshold(128), quality(0) {}
+
+        RasterFormat format;
+        RasterColorSpace colorSpace;
+        uint32_t width;
+        uint32_t height;
+        /// of the input pixels: 1 gray, 3 RGB, 4 RGBA
+        uint32_t channels;
+        uint32_t resolution;
+        bool dither;
+        uint8_t threshold;
+        /// PrintQuality: 0 default, 3 draft, 4 normal, 5 high
+        uint32_t quality;
+
+        /// Bytes of an encoded pixel, the unit of the run-length compression
+        size_t getPixelSize() const
+        {
+            if (colorSpace == RASTER_SRGB)
+            {
+                return 3;
+            }
+            // 1-bit lines are compressed by bytes of 8 pixels
+            return 1;
+        }
+
+        size_t getBytesPerLine() const
+        {
+            if (colorSpace == RASTER_BLACK && format == RASTER_PWG)
+            {
+                return (width + 7) / 8;
+            }
+            return width * getPixelSize();
+        }
+    };
+
+    void putUint32(char *data, uint32_t value)
+    {
+        data[0] = static_cast<char>(value >> 24);
+        data[1] = static_cast<char>(value >> 16);
+        data[2] = static_cast<char>(value >> 8);
+        data[3] = static_cast<char>(value);
+    }
+
+    /// x / 255 rounded, for x up to 255 * 255, without a division
+    inline uint16_t divide255(uint16_t x)
+    {
+        x = static_cast<uint16_t>(x + 128);
+        return static_cast<uint16_t>((x + (x >> 8)) >> 8);
+    }
+
+    /** Convert one row of input pixels to gray or RGB, composited over white.
+     * Branchless loops in 16 bits arithmetic (255 * 255 fits), which the compiler
+     * vectorizes with the widest lanes of the target.
+     */
+    void convertRow(const uint8_t *input, const RasterOptions &options, uint8_t *output)
+    {
+        const size_t width = options.width;
+        if (options.colorSpace == RASTER_SRGB)
+        {
+            if (options.channels == 1)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    output[3 * x] = output[3 * x + 1] = output[3 * x + 2] = input[x];
+                }
+            }
+            else if (options.channels == 3)
+            {
+                memcpy(output, input, width * 3);
+            }
+            else
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    uint16_t alpha = input[4 * x + 3], white = static_cast<uint16_t>(255 * (255 - alpha));
+                    output[3 * x] = static_cast<uint8_t>(divide255(static_cast<uint16_t>(input[4 * x] * alpha + white)));
+                    output[3 * x + 1] = static_cast<uint8_t>(divide255(static_cast<uint16_t>(input[4 * x + 1] * alpha + white)));
+                    output[3 * x + 2] = static_cast<uint8_t>(divide255(static_cast<uint16_t>(input[4 * x + 2] * alpha + white)));
+                }
+            }
+            return;
+        }
+        // gray: Rec. 601 luma in 8 bits fixed point, the weights add up to 256
+        if (options.channels == 1)
+        {
+            memcpy(output, input, width);
+        }
+        else if (options.channels == 3)
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                uint16_t r = input[3 * x], g = input[3 * x + 1], b = input[3 * x + 2];
+                output[x] = static_cast<uint8_t>(static_cast<uint16_t>(77 * r + 150 * g + 29 * b + 128) >> 8);
+            }
+        }
+        else
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                uint16_t r = input[4 * x], g = input[4 * x + 1], b = input[4 * x + 2], alpha = input[4 * x + 3];
+                uint16_t luma = static_cast<uint16_t>(static_cast<uint16_t>(77 * r + 150 * g + 29 * b + 128) >> 8);
+                output[x] = static_cast<uint8_t>(divide255(static_cast<uint16_t>(luma * alpha + 255 * (255 - alpha))));
+            }
+        }
+    }
+
+    /** Threshold or dither a gray row to black and white.
+     * PWG: packed 1 bit per pixel, most significant first, 1 is black. URF has no 1-bit
+     * color space: 8 bits per pixel, 0 or 255.
+     */
+    void binarizeRow(const uint8_t *gray, uint32_t y, const RasterOptions &options, uint8_t *output)
+    {
+        const size_t width = options.width;
+        const uint8_t *bayer = BAYER_MATRIX[y & 7];
+        if (options.format == RASTER_URF)
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                uint8_t threshold = options.dither ? bayer[x & 7] : options.threshold;
+                output[x] = gray[x] < threshold ? 0 : 255;
+            }
+            return;
+        }
+        // the dither matrix is 8 pixels wide: one byte of output has the same thresholds
+        uint8_t thresholds[8];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            thresholds[bit] = options.dither ? bayer[bit] : options.threshold;
+        }
+        const size_t bytes = width / 8;
+        for (size_t byte = 0; byte < bytes; ++byte)
+        {
+            const uint8_t *pixels = gray + 8 * byte;
+            uint8_t bits = 0;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                bits |= static_cast<uint8_t>((pixels[bit] < thresholds[bit]) << (7 - bit));
+            }
+            output[byte] = bits;
+        }
+        if (width & 7)
+        {
+            // padding bits are white
+            uint8_t bits = 0;
+            for (size_t x = bytes * 8; x < width; ++x)
+            {
+                bits |= static_cast<uint8_t>((gray[x] < thresholds[x & 7]) << (7 - (x & 7)));
+            }
+            output[bytes] = bits;
+        }
+    }
+
+    /** PackBits-style compression of a line, shared by PWG and URF: a byte 0-127 repeats the next
+     * pixel 1 to 128 times, a byte 129-255 is followed by 257 - byte pixels (2 to 128) copied as is.
+     */
+    void compressLine(const uint8_t *line, size_t pixels, size_t pixelSize, std::string &output)
+    {
+        size_t x = 0;
+        while (x < pixels)
+        {
+            const uint8_t *pixel = line + x * pixelSize;
+            size_t count = 1;
+            while (x + count < pixels && count < 128 && memcmp(pixel, pixel + count * pixelSize, pixelSize) == 0)
+            {
+                ++count;
+            }
+            if (count > 1 || x + 1 == pixels)
+            {
+                output += static_cast<char>(count - 1);
+                output.append(reinterpret_cast<const char *>(pixel), pixelSize);
+                x += count;
+                continue;
+            }
+            // literal pixels up to the next repeated one
+            count = 1;
+            while (x + count < pixels && count < 128 &&
+                   (x + count + 1 == pixels || memcmp(pixel + count * pixelSize, pixel + (count + 1) * pixelSize, pixelSize) != 0))
+            {
+                ++count;
+            }
+            if (count == 1)
+            {
+                output += static_cast<char>(0);
+            }
+            else
+            {
+                output += static_cast<char>(257 - count);
+            }
+            output.append(reinterpret_cast<const char *>(pixel), count * pixelSize);
+            x += count;
+        }
+    }
+
+    /** Encode rows [first, last) of a page: each line is a repeat count (identical lines
+     * following it, up to 255) then its compressed pixels.
+     */
+    std::string encodeBand(const uint8_t *page, uint32_t first, uint32_t last, const RasterOptions &options, AbortState &state)
+    {
+        const size_t inputRowSize = static_cast<size_t>(options.width) * options.channels;
+        const size_t lineSize = options.getBytesPerLine();
+        const size_t pixelSize = options.getPixelSize();
+        std::vector<uint8_t> gray(options.colorSpace == RASTER_BLACK ? options.width : 0);
+        std::vector<uint8_t> line(lineSize), previous(lineSize);
+        std::string output;
+        uint32_t repeat = 0;
+        for (uint32_t y = first; y < last; ++y)
+        {
+            if ((y & 63) == 0 && state.shouldStop())
+            {
+                return "";
+            }
+            if (options.colorSpace == RASTER_BLACK)
+            {
+                convertRow(page + y * inputRowSize, options, gray.data());
+                binarizeRow(gray.data(), y, options, line.data());
+            }
+            else
+            {
+                convertRow(page + y * inputRowSize, options, line.data());
+            }
+            if (y > first && repeat < 255 && line == previous)
+            {
+                ++repeat;
+                continue;
+            }
+            if (y > first)
+            {
+                output += static_cast<char>(repeat);
+                compressLine(previous.data(), lineSize / pixelSize, pixelSize, output);
+            }
+            repeat = 0;
+            previous.swap(line);
+        }
+        if (last > first)
+        {
+            output += static_cast<char>(repeat);
+            compressLine(previous.data(), lineSize / pixelSize, pixelSize, output);
+        }
+        return output;
+    }
+
+    void appendPwgHeader(const RasterOptions &options, uint32_t pageCount, std::string &output)
+    {
+        char header[PWG_HEADER_SIZE];
+        memset(header, 0, sizeof(header));
+        strcpy(header, "PwgRaster");
+        // HWResolution
+        putUint32(header + 276, options.resolution);
+        putUint32(header + 280, options.resolution);
+        // PageSize, in points
+        putUint32(header + 352, static_cast<uint32_t>((static_cast<uint64_t>(options.width) * 72 + options.resolution / 2) / options.resolution));
+        putUint32(header + 356, static_cast<uint32_t>((static_cast<uint64_t>(options.height) * 72 + options.resolution / 2) / options.resolution));
+        putUint32(header + 372, options.width);
+        putUint32(header + 376, options.height);
+        uint32_t bitsPerPixel = options.colorSpace == RASTER_BLACK ? 1 : options.colorSpace == RASTER_SGRAY ? 8 : 24;
+        putUint32(header + 384, options.colorSpace == RASTER_BLACK ? 1 : 8);
+        putUint32(header + 388, bitsPerPixel);
+        putUint32(header + 392, static_cast<uint32_t>(options.getBytesPerLine()));
+        // ColorOrder: chunky
+        putUint32(header + 396, 0);
+        putUint32(header + 400, options.colorSpace == RASTER_BLACK ? PWG_CSPACE_BLACK : options.colorSpace == RASTER_SGRAY ? PWG_CSPACE_SGRAY : PWG_CSPACE_SRGB);
+        putUint32(header + 420, options.colorSpace == RASTER_SRGB ? 3 : 1);
+        putUint32(header + 452, pageCount);
+        // CrossFeedTransform, FeedTransform
+        putUint32(header + 456, 1);
+        putUint32(header + 460, 1);
+        // ImageBoxRight, ImageBoxBottom
+        putUint32(header + 472, options.width);
+        putUint32(header + 476, options.height);
+        putUint32(header + 484, options.quality);
+        output.append(header, sizeof(header));
+    }
+
+    void appendUrfHeader(const RasterOptions &options, std::string &output)
+    {
+        char header[URF_HEADER_SIZE];
+        memset(header, 0, sizeof(header));
+        header[0] = static_cast<char>(options.colorSpace == RASTER_SRGB ? 24 : 8);
+        header[1] = static_cast<char>(options.colorSpace == RASTER_SRGB ? URF_CSPACE_SRGB : URF_CSPACE_SGRAY);
+        // simplex
+        header[2] = 1;
+        header[3] = static_cast<char>(options.quality);
+        putUint32(header + 12, options.width);
+        putUint32(header + 16, options.height);
+        putUint32(header + 20, options.resolution);
+        output.append(header, sizeof(header));
+    }
+
+    /** Encode the pages, each split in bands of at least MIN_BAND_ROWS rows, up to MAX_BANDS.
+     * A band starts its own line repeats, so the output depends on the band count: it is
+     * fixed by the page height, not by the machine. The bands are encoded by at most
+     * hardware_concurrency threads, started once for all the pages, and concatenated in order.
+     */
+    std::string encodePages(const std::vector<std::string> &pages, const RasterOptions &options, AbortState &state, std::string &output)
+    {
+        uint32_t bandCount = std::max(1u, std::min(MAX_BANDS, options.height / MIN_BAND_ROWS));
+        uint32_t bandRows = (options.height + bandCount - 1) / bandCount;
+        uint32_t threads = std::min(bandCount, std::max(1u, std::thread::hardware_concurrency()));
+
+        if (options.format == RASTER_PWG)
+        {
+            output = "RaS2";
+        }
+        else
+        {
+            output.assign("UNIRAST\0", 8);
+            char count[4];
+            putUint32(count, static_cast<uint32_t>(pages.size()));
+            output.append(count, sizeof(count));
+        }
+
+        // band b of page p is bands[p * bandCount + b], thread t encodes the bands t, t + threads...
+        std::vector<std::string> bands(pages.size() * bandCount);
+        auto encodeBands = [&](uint32_t thread)
+        {
+            for (size_t index = thread; index < bands.size() && !state.shouldStop(); index += threads)
+            {
+                uint32_t band = static_cast<uint32_t>(index % bandCount);
+                uint32_t first = std::min(options.height, band * bandRows), last = std::min(options.height, first + bandRows);
+                bands[index] = encodeBand(reinterpret_cast<const uint8_t *>(pages[index / bandCount].data()), first, last, options, state);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (uint32_t thread = 1; thread < threads; ++thread)
+        {
+            workers.push_back(std::thread(encodeBands, thread));
+        }
+        // the first share on the pool thread itself
+        encodeBands(0);
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        if (state.shouldStop())
+        {
+            return "Raster encoding stopped";
+        }
+
+        for (size_t page = 0; page < pages.size(); ++page)
+        {
+            if (options.format == RASTER_PWG)
+            {
+                appendPwgHeader(options, static_cast<uint32_t>(pages.size()), output);
+            }
+            else
+            {
+                appendUrfHeader(options, output);
+            }
+            for (uint32_t band = 0; band < bandCount; ++band)
+            {
+                std::string &encoded = bands[page * bandCount + band];
+                output += encoded;
+                std::string().swap(encoded);
+            }
+        }
+        return "";
+    }
+
+    const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    /// Append a ZPL ACS repeat count: g-z for 20 to 400, G-Y for 1 to 19
+    void appendZplCount(uint32_t count, std::string &output)
+    {
+        while (count > 0)
+        {
+            uint32_t part = std::min<uint32_t>(count, ZPL_MAX_COUNT);
+            if (part >= 20)
+            {
+                output += static_cast<char>('f' + part / 20);
+            }
+            if (part % 20)
+            {
+                output += static_cast<char>('F' + part % 20);
+            }
+            count -= part;
+        }
+    }
+
+    /** Append a row as ZPL ACS compressed hex: runs of a digit prefixed by their count,
+     * "," or "!" for a row ending with zeros or ones, ":" for a row equal to the previous one.
+     */
+    void appendZplRow(const uint8_t *row, size_t size, std::string &hex, std::string &output)
+    {
+        hex.resize(2 * size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hex[2 * i] = HEX_DIGITS[row[i] >> 4];
+            hex[2 * i + 1] = HEX_DIGITS[row[i] & 0xf];
+        }
+        size_t position = 0;
+        while (position < hex.size())
+        {
+            char digit = hex[position];
+            size_t end = hex.find_first_not_of(digit, position);
+            if (end == std::string::npos && (digit == '0' || digit == 'F'))
+            {
+                output += digit == '0' ? ',' : '!';
+                return;
+            }
+            end = (end == std::string::npos) ? hex.size() : end;
+            if (end - position > 2)
+            {
+                appendZplCount(static_cast<uint32_t>(end - position), output);
+                output += digit;
+            }
+            else
+            {
+                output.append(end - position, digit);
+            }
+            position = end;
+        }
+    }
+
+    /// Convert and binarize all the rows, packed 8 pixels per byte
+    std::string packBitmap(const uint8_t *pixels, const RasterOptions &options)
+    {
+        const size_t inputRowSize = static_cast<size_t>(options.width) * options.channels;
+        const size_t rowSize = options.getBytesPerLine();
+        std::vector<uint8_t> gray(options.width);
+        std::string bitmap(rowSize * options.height, '\0');
+        for (uint32_t y = 0; y < options.height; ++y)
+        {
+            convertRow(pixels + y * inputRowSize, options, gray.data());
+            binarizeRow(gray.data(), y, options, reinterpret_cast<uint8_t *>(&bitmap[y * rowSize]));
+        }
+        return bitmap;
+    }
+
+    /// ^GFA field of the bitmap, ACS compressed, at x, y; in a whole ^XA...^XZ label if label is true
+    std::string encodeZpl(const std::string &bitmap, const RasterOptions &options, uint32_t x, uint32_t y, bool label)
+    {
+        const size_t rowSize = options.getBytesPerLine();
+        std::string output, hex;
+        // compressed hex is usually far smaller than 2 digits per byte
+        output.reserve(bitmap.size() / 2 + 64);
+        if (label)
+        {
+            output += "^XA";
+        }
+        output += "^FO" + std::to_string(x) + "," + std::to_string(y);
+        output += "^GFA," + std::to_string(bitmap.size()) + "," + std::to_string(bitmap.size()) + "," + std::to_string(rowSize) + ",";
+        const uint8_t *rows = reinterpret_cast<const uint8_t *>(bitmap.data());
+        for (uint32_t row = 0; row < options.height; ++row)
+        {
+            const uint8_t *current = rows + row * rowSize;
+            if (row > 0 && memcmp(current, current - rowSize, rowSize) == 0)
+            {
+                output += ':';
+            }
+            else
+            {
+                appendZplRow(current, rowSize, hex, output);
+            }
+        }
+        output += "^FS";
+        if (label)
+        {
+            output += "^XZ";
+        }
+        return output;
+    }
+
+    /// GS v 0 raster commands of the bitmap, one per band of at most bandRows rows
+    std::string encodeEscPos(const std::string &bitmap, const RasterOptions &options, uint32_t bandRows)
+    {
+        const size_t rowSize = options.getBytesPerLine();
+        std::string output;
+        output.reserve(bitmap.size() + (options.height / bandRows + 1) * 8);
+        for (uint32_t first = 0; first < options.height; first += bandRows)
+        {
+            uint32_t rows = std::min(bandRows, options.height - first);
+            const char command[8] = {'\x1d', 'v', '0', 0,
+                                     static_cast<char>(rowSize & 0xff), static_cast<char>(rowSize >> 8),
+                                     static_cast<char>(rows & 0xff), static_cast<char>(rows >> 8)};
+            output.append(command, sizeof(command));
+            output.append(bitmap, first * rowSize, rows * rowSize);
+        }
+        return output;
+    }
+
+    /** Read the options of encodeRaster.
+     * @returns error string, empty on success
+     */
+    std::string parseRasterOptions(const Napi::Object &object, RasterOptions &options)
+    {
+        if (!object.Get("width").IsNumber() || !object.Get("height").IsNumber())
+        {
+            return "width and height are mandatory";
+        }
+        int64_t width = object.Get("width").As<Napi::Number>().Int64Value();
+        int64_t height = object.Get("height").As<Napi::Number>().Int64Value();
+        if (width <= 0 || height <= 0 || width > 0xffffff || height > 0xffffff)
+        {
+            return "Invalid width or height";
+        }
+        options.width = static_cast<uint32_t>(width);
+        options.height = static_cast<uint32_t>(height);
+        if (object.Get("channels").IsNumber())
+        {
+            options.channels = object.Get("channels").As<Napi::Number>().Uint32Value();
+            if (options.channels != 1 && options.channels != 3 && options.channels != 4)
+            {
+                return "channels must be 1 (gray), 3 (RGB) or 4 (RGBA)";
+            }
+        }
+        if (object.Get("resolution").IsNumber())
+        {
+            options.resolution = object.Get("resolution").As<Napi::Number>().Uint32Value();
+            if (options.resolution == 0)
+            {
+                return "Invalid resolution";
+            }
+        }
+        if (object.Get("format").IsString())
+        {
+            std::string format = object.Get("format").As<Napi::String>().Utf8Value();
+            if (format == "urf")
+            {
+                options.format = RASTER_URF;
+            }
+            else if (format != "pwg")
+            {
+                return "format must be pwg or urf";
+            }
+        }
+        if (object.Get("colorSpace").IsString())
+        {
+            std::string colorSpace = object.Get("colorSpace").As<Napi::String>().Utf8Value();
+            if (colorSpace == "black")
+            {
+                options.colorSpace = RASTER_BLACK;
+            }
+            else if (colorSpace == "srgb")
+            {
+                options.colorSpace = RASTER_SRGB;
+            }
+            else if (colorSpace != "sgray")
+            {
+                return "colorSpace must be black, sgray or srgb";
+            }
+        }
+        if (object.Get("dither").IsString())
+        {
+            std::string dither = object.Get("dither").As<Napi::String>().Utf8Value();
+            if (dither == "ordered")
+            {
+                options.dither = true;
+            }
+            else if (dither != "threshold")
+            {
+                return "dither must be threshold or ordered";
+            }
+        }
+        if (object.Get("threshold").IsNumber())
+        {
+            options.threshold = static_cast<uint8_t>(std::min<uint32_t>(255, object.Get("threshold").As<Napi::Number>().Uint32Value()));
+        }
+        if (object.Get("quality").IsString())
+        {
+            std::string quality = object.Get("quality").As<Napi::String>().Utf8Value();
+            options.quality = quality == "draft" ? 3 : quality == "normal" ? 4 : quality == "high" ? 5 : 0;
+        }
+        return "";
+    }
+}
+
+std::string encodePwgBitmap(const uint8_t *gray, uint32_t width, uint32_t height, uint32_t resolution, AbortState &state, std::string &output)
+{
+    RasterOptions options;
+    options.colorSpace = RASTER_BLACK;
+    options.width = width;
+    options.height = height;
+    options.resolution = resolution;
+    std::vector<std::string> pages(1, std::string(reinterpret_cast<const char *>(gray), static_cast<size_t>(width) * height));
+    return encodePages(pages, options, state, output);
+}
+
+std::string encodeZplBitmap(const uint8_t *gray, uint32_t width, uint32_t height, uint32_t x, uint32_t y, bool label)
+{
+    RasterOptions options;
+    options.colorSpace = RASTER_BLACK;
+    options.width = width;
+    options.height = height;
+    return encodeZpl(packBitmap(gray, options), options, x, y, label);
+}
+
+MY_NODE_MODULE_CALLBACK(encodeRaster)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_OBJECT(info, 1, optionsArg);
+
+    RasterOptions options;
+    std::string error_str = parseRasterOptions(optionsArg, options);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    const size_t pageSize = static_cast<size_t>(options.width) * options.height * options.channels;
+
+    // copied: the pixels are read on other threads while JS keeps running
+    std::shared_ptr<std::vector<std::string>> pagesPtr = std::make_shared<std::vector<std::string>>();
+    std::vector<std::string> &pages = *pagesPtr;
+    if (info[0].IsArray())
+    {
+        Napi::Array array = info[0].As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); ++i)
+        {
+            pages.push_back(std::string());
+            if (!array.Get(i).IsBuffer() || !getStringOrBufferFromNapiValue(array.Get(i), pages.back()))
+            {
+                RETURN_EXCEPTION_STR("Argument 0 must be a Buffer or an Array of Buffers");
+            }
+        }
+    }
+    else
+    {
+        pages.push_back(std::string());
+        if (!info[0].IsBuffer() || !getStringOrBufferFromNapiValue(info[0], pages.back()))
+        {
+            RETURN_EXCEPTION_STR("Argument 0 must be a Buffer or an Array of Buffers");
+        }
+    }
+    if (pages.empty())
+    {
+        RETURN_EXCEPTION_STR("No page to encode");
+    }
+    for (const std::string &page : pages)
+    {
+        if (page.size() < pageSize)
+        {
+            RETURN_EXCEPTION_STR("Page buffer smaller than width * height * channels (" + std::to_string(pageSize) + " bytes)");
+        }
+    }
+
+    FunctionTask<std::string> *task = new FunctionTask<std::string>(
+        env, [pagesPtr, options](std::string &output, AbortState &state)
+        { return encodePages(*pagesPtr, options, state, output); },
+        [](Napi::Env env, const std::string &output)
+        { return Napi::Buffer<char>::Copy(env, output.data(), output.size()); });
+    task->bindAbortHandle(info[2]);
+    return task->queue();
+}
+
+MY_NODE_MODULE_CALLBACK(encodeGraphic)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 2);
+    REQUIRE_ARGUMENT_OBJECT(info, 1, optionsArg);
+
+    RasterOptions options;
+    std::string error_str = parseRasterOptions(optionsArg, options);
+    if (!error_str.empty())
+    {
+        RETURN_EXCEPTION_STR(error_str);
+    }
+    // packed 1 bit per pixel, 1 is black: the bitmap layout of ZPL and ESC/POS
+    options.format = RASTER_PWG;
+    options.colorSpace = RASTER_BLACK;
+    if (!info[0].IsBuffer())
+    {
+        RETURN_EXCEPTION_STR("Argument 0 must be a Buffer");
+    }
+    Napi::Buffer<uint8_t> pixels = info[0].As<Napi::Buffer<uint8_t>>();
+    if (pixels.Length() < static_cast<size_t>(options.width) * options.height * options.channels)
+    {
+        RETURN_EXCEPTION_STR("Buffer smaller than width * height * channels");
+    }
+    std::string language = optionsArg.Get("language").IsString() ? optionsArg.Get("language").As<Napi::String>().Utf8Value() : "zpl";
+    if (language != "zpl" && language != "escpos")
+    {
+        RETURN_EXCEPTION_STR("language must be zpl or escpos");
+    }
+
+    // converted in place: a label is done in well under a millisecond
+    std::string bitmap = packBitmap(pixels.Data(), options);
+    std::string output;
+    if (language == "zpl")
+    {
+        uint32_t x = optionsArg.Get("x").IsNumber() ? optionsArg.Get("x").As<Napi::Number>().Uint32Value() : 0;
+        uint32_t y = optionsArg.Get("y").IsNumber() ? optionsArg.Get("y").As<Napi::Number>().Uint32Value() : 0;
+        output = encodeZpl(bitmap, options, x, y, !optionsArg.Get("label").IsBoolean() || optionsArg.Get("label").As<Napi::Boolean>().Value());
+    }
+    else
+    {
+        uint32_t bandRows = DEFAULT_ESCPOS_BAND_ROWS;
+        if (optionsArg.Get("bandHeight").IsNumber())
+        {
+            bandRows = std::max(1u, std::min(ESCPOS_MAX_SIZE, optionsArg.Get("bandHeight").As<Napi::Number>().Uint32Value()));
+        }
+        if (options.getBytesPerLine() > ESCPOS_MAX_SIZE)
+        {
+            RETURN_EXCEPTION_STR("Image too wide for ESC/POS");
+        }
+        output = encodeEscPos(bitmap, options, bandRows);
+    }
+    return Napi::Buffer<char>::Copy(env, output.data(), output.size());
+}
@@ -0,0 +1,21 @@
+#ifndef NODE_PRINTER_RASTER_HPP
+#define NODE_PRINTER_RASTER_HPP
+
+#include <cstdint>
+#include <string>
+
+class AbortState;
+
+/** Encode 8 bits gray pixels (0 black, 255 white) as a one page 1-bit black PWG raster document.
+ * @param resolution dots per inch written in the page header
+ * @param state state of the calling task, stopping the encoding when aborted or timed out
+ * @return error string, empty on success
+ */
+std::string encodePwgBitmap(const uint8_t *gray, uint32_t width, uint32_t height, uint32_t resolution, AbortState &state, std::string &output);
+
+/** Encode 8 bits gray pixels as a ZPL ^GFA field, ACS compressed, at x, y.
+ * @param label wrap the field in ^XA...^XZ
+ */
+std::string encodeZplBitmap(const uint8_t *gray, uint32_t width, uint32_t height, uint32_t x, uint32_t y, bool label);
+
+#endif
@@ -0,0 +1,636 @@
+#include "node_printer_backend.hpp"
+#include "node_printer_stats.hpp"
+#include "node_printer_trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    const char *const SOCKET_URI_PREFIX = "socket://";
+    const char *const DEFAULT_SOCKET_PORT = "9100";
+
+    /// Connection timeout without deadline, in milliseconds
+    const int SOCKET_CONNECT_TIMEOUT = 5000;
+
+    /// Longest wait of a blocked write before checking the operation state again, in milliseconds
+    const int SOCKET_POLL_INTERVAL = 50;
+
+    /// Jobs kept for getJob
+    const size_t SOCKET_JOB_HISTORY = 1000;
+
+    /// Batch written at once: at most IOV_MAX documents
+    const size_t MAX_BATCH_DOCUMENTS = 64;
+
+    /** Document waiting to be written on an endpoint connection
+     */
+    struct PendingDocument
+    {
+        std::string data;
+        /// State of the caller waiting for the document: its own abort flag and deadline
+        AbortState *state;
+        /// Bytes of data already written
+        size_t sent;
+        bool done;
+        std::string error;
+        std::string errorCode;
+
+        PendingDocument() : state(nullptr), sent(0), done(false) {}
+
+        std::string getStopError() const
+        {
+            return state->isAborted() ? ABORT_ERROR_MESSAGE : TIMEOUT_ERROR_MESSAGE;
+        }
+    };
+
+    /** Connection to one AppSocket endpoint (host:port), kept open between jobs.
+     * Concurrent submissions are coalesced: the first one becomes the writer and
+     * sends every document queued meanwhile with one writev, the others wait for it.
+     * Each document keeps the abort flag and deadline of its caller, and gets its own outcome.
+     */
+    class Endpoint
+    {
+    public:
+        Endpoint(const std::string &host, const std::string &port) : _host(host), _port(port), _fd(-1), _writing(false) {}
+
+        ~Endpoint()
+        {
+            closeSocket();
+        }
+
+        std::string write(AbortState &state, const std::string &printername, PendingDocument &document)
+        {
+            document.state = &state;
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(&document);
+            while (!document.done)
+            {
+                if (!_writing)
+                {
+                    _writing = true;
+                    std::vector<PendingDocument *> batch;
+                    while (!_queue.empty() && batch.size() < MAX_BATCH_DOCUMENTS)
+                    {
+                        batch.push_back(_queue.front());
+                        _queue.pop_front();
+                    }
+                    lock.unlock();
+                    writeBatch(printername, batch);
+                    lock.lock();
+                    _writing = false;
+                    _condition.notify_all();
+                }
+                else
+                {
+                    _condition.wait_for(lock, std::chrono::milliseconds(SOCKET_POLL_INTERVAL));
+                    auto itQueued = std::find(_queue.begin(), _queue.end(), &document);
+                    if (!document.done && itQueued != _queue.end() && state.shouldStop())
+                    {
+                        // not picked by a writer yet: nothing was sent
+                        _queue.erase(itQueued);
+                        return document.getStopError();
+                    }
+                }
+            }
+            if (!document.errorCode.empty())
+            {
+                state.setErrorCode(document.errorCode);
+            }
+            return document.error;
+        }
+
+    private:
+        std::string _host;
+        std::string _port;
+        /// Only used by the current writer
+        int _fd;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<PendingDocument *> _queue;
+        bool _writing;
+
+        void closeSocket()
+        {
+            if (_fd >= 0)
+            {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+
+        /// Hand its outcome to the caller waiting for document. document must not be used afterwards
+        void complete(PendingDocument *document, const std::string &error, const std::string &errorCode)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            document->done = true;
+            document->error = error;
+            document->errorCode = errorCode;
+            _condition.notify_all();
+        }
+
+        /// Give documents back to the next writer, ahead of the ones queued meanwhile
+        void requeue(std::vector<PendingDocument *> &batch)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.insert(_queue.begin(), batch.begin(), batch.end());
+            batch.clear();
+        }
+
+        /// Complete the documents not started yet whose caller stopped: none of their bytes was sent
+        void dropStopped(std::vector<PendingDocument *> &batch)
+        {
+            for (auto it = batch.begin(); it != batch.end();)
+            {
+                PendingDocument *pending = *it;
+                if (pending->sent == 0 && pending->state->shouldStop())
+                {
+                    it = batch.erase(it);
+                    complete(pending, pending->getStopError(), "");
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        /** Wait for events on the socket, in slices to notice when stopped() turns true
+         * @param timeout in milliseconds, -1 to wait until the socket is ready or stopped() turns true
+         * @return error string, empty when the socket is ready
+         */
+        std::string waitFor(short events, int timeout, const std::function<bool()> &stopped, std::string &errorCode)
+        {
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+            for (;;)
+            {
+                if (stopped())
+                {
+                    return ABORT_ERROR_MESSAGE;
+                }
+                int remaining = SOCKET_POLL_INTERVAL;
+                if (timeout >= 0)
+                {
+                    remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count());
+                    if (remaining <= 0)
+                    {
+                        errorCode = ERROR_CODE_TIMEDOUT;
+                        return TIMEOUT_ERROR_MESSAGE;
+                    }
+                }
+                struct pollfd pfd = {_fd, events, 0};
+                int result = poll(&pfd, 1, std::min(remaining, SOCKET_POLL_INTERVAL));
+                if (result > 0)
+                {
+                    return "";
+                }
+                if (result < 0 && errno != EINTR)
+                {
+                    return strerror(errno);
+                }
+            }
+        }
+
+        /// True if the printer closed the connection, e.g. after its idle timeout. Status bytes it sent are discarded
+        bool isClosedByPeer()
+        {
+            char discard[512];
+            for (;;)
+            {
+                ssize_t result = recv(_fd, discard, sizeof(discard), MSG_DONTWAIT);
+                if (result == 0)
+                {
+                    return true;
+                }
+                if (result < 0)
+                {
+                    return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+                }
+            }
+        }
+
+        /// Connect for the documents of batch: gives up once all their callers stopped, or after the latest deadline
+        std::string connectSocket(const std::string &printername, const std::vector<PendingDocument *> &batch, std::string &errorCode)
+        {
+            TraceSpan span("connect", printername);
+            int timeout = 0;
+            for (PendingDocument *pending : batch)
+            {
+                timeout = std::max(timeout, pending->state->getRemainingTime(SOCKET_CONNECT_TIMEOUT));
+            }
+            std::function<bool()> stopped = [&batch]()
+            {
+                return std::all_of(batch.begin(), batch.end(), [](PendingDocument *pending)
+                                   { return pending->state->shouldStop(); });
+            };
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo *addresses = nullptr;
+            int gai_error = getaddrinfo(_host.c_str(), _port.c_str(), &hints, &addresses);
+            if (gai_error != 0)
+            {
+                errorCode = ERROR_CODE_CONNECTION;
+                return std::string("Cannot resolve ") + _host + ": " + gai_strerror(gai_error);
+            }
+            std::string error_str = "No address for " + _host;
+            for (struct addrinfo *address = addresses; address != nullptr; address = address->ai_next)
+            {
+                _fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (_fd < 0)
+                {
+                    error_str = strerror(errno);
+                    continue;
+                }
+                fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+                fcntl(_fd, F_SETFD, FD_CLOEXEC);
+                int one = 1;
+                setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+                setsockopt(_fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+                if (connect(_fd, address->ai_addr, address->ai_addrlen) == 0)
+                {
+                    error_str.clear();
+                    break;
+                }
+                if (errno == EINPROGRESS)
+                {
+                    error_str = waitFor(POLLOUT, timeout, stopped, errorCode);
+                    if (error_str.empty())
+                    {
+                        int so_error = 0;
+                        socklen_t length = sizeof(so_error);
+                        getsockopt(_fd, SOL_SOCKET, SO_ERROR, &so_error, &length);
+                        if (so_error == 0)
+                        {
+                            break;
+                        }
+                        error_str = strerror(so_error);
+                    }
+                    else if (stopped() || errorCode == ERROR_CODE_TIMEDOUT)
+                    {
+                        closeSocket();
+                        break;
+                    }
+                }
+                else
+                {
+                    error_str = strerror(errno);
+                }
+                closeSocket();
+            }
+            freeaddrinfo(addresses);
+            if (!error_str.empty())
+            {
+                closeSocket();
+                if (errorCode.empty())
+                {
+                    errorCode = ERROR_CODE_CONNECTION;
+                }
+                span.setStatus(-1);
+                return "Cannot connect to " + _host + ":" + _port + ": " + error_str;
+            }
+            return "";
+        }
+
+        /** Send the documents of batch in order, completing each one once all its bytes are written.
+         * Documents not started yet are dropped as soon as their caller stops. If the caller of the
+         * document being written stops, that document fails alone and interrupted is set: the connection
+         * then carries a truncated document and must be closed before the rest is sent.
+         * @return error the documents left in batch failed with
+         */
+        std::string sendAll(std::vector<PendingDocument *> &batch, size_t &written, bool &interrupted, std::string &errorCode)
+        {
+            for (;;)
+            {
+                dropStopped(batch);
+                if (batch.empty())
+                {
+                    return "";
+                }
+                PendingDocument *head = batch.front();
+                if (head->state->shouldStop())
+                {
+                    batch.erase(batch.begin());
+                    complete(head, head->getStopError(), "");
+                    interrupted = true;
+                    return "";
+                }
+                std::vector<struct iovec> iov;
+                for (PendingDocument *pending : batch)
+                {
+                    struct iovec part;
+                    part.iov_base = &pending->data[pending->sent];
+                    part.iov_len = pending->data.size() - pending->sent;
+                    iov.push_back(part);
+                }
+                struct msghdr message;
+                memset(&message, 0, sizeof(message));
+                message.msg_iov = iov.data();
+                message.msg_iovlen = iov.size();
+#ifdef MSG_NOSIGNAL
+                ssize_t result = sendmsg(_fd, &message, MSG_NOSIGNAL);
+#else
+                ssize_t result = sendmsg(_fd, &message, 0);
+#endif
+                if (result >= 0)
+                {
+                    size_t remaining = static_cast<size_t>(result);
+                    written += remaining;
+                    while (!batch.empty() && batch.front()->sent + remaining >= batch.front()->data.size())
+                    {
+                        PendingDocument *pending = batch.front();
+                        remaining -= pending->data.size() - pending->sent;
+                        batch.erase(batch.begin());
+                        complete(pending, "", "");
+                    }
+                    if (!batch.empty())
+                    {
+                        batch.front()->sent += remaining;
+                    }
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    // without deadline, wait as long as the printer holds its window closed (out of paper, lid open):
+                    // a timeout would leave it a truncated document. A dead peer still fails once TCP gives up
+                    AbortState *state = head->state;
+                    std::string error_str = waitFor(POLLOUT, state->getRemainingTime(-1), [state]()
+                                                    { return state->shouldStop(); }, errorCode);
+                    if (!error_str.empty() && !state->shouldStop())
+                    {
+                        return error_str;
+                    }
+                }
+                else if (errno != EINTR)
+                {
+                    errorCode = ERROR_CODE_CONNECTION;
+                    return strerror(errno);
+                }
+            }
+        }
+
+        /// Write batch and complete every document in it, or give back the ones not started when the connection had to be closed
+        void writeBatch(const std::string &printername, std::vector<PendingDocument *> &batch)
+        {
+            StatsTimer timer(CallStats::getCurrent(), StatsTimer::IPP);
+            TraceSpan span("socketWrite", printername);
+            bool reused = (_fd >= 0);
+            if (reused && isClosedByPeer())
+            {
+                closeSocket();
+                reused = false;
+            }
+            std::string error_str;
+            std::string errorCode;
+            size_t written = 0;
+            bool interrupted = false;
+            dropStopped(batch);
+            if (!batch.empty() && _fd < 0)
+            {
+                error_str = connectSocket(printername, batch, errorCode);
+                dropStopped(batch);
+            }
+            if (error_str.empty() && !batch.empty())
+            {
+                error_str = sendAll(batch, written, interrupted, errorCode);
+                if (!error_str.empty() && reused && written == 0)
+                {
+                    // the kept connection was dead: retry once on a new one
+                    errorCode.clear();
+                    closeSocket();
+                    error_str = connectSocket(printername, batch, errorCode);
+                    dropStopped(batch);
+                    if (error_str.empty())
+                    {
+                        error_str = sendAll(batch, written, interrupted, errorCode);
+                    }
+                }
+            }
+            if (!error_str.empty() || interrupted)
+            {
+                // partially written data cannot be taken back: do not reuse the connection
+                closeSocket();
+                span.setStatus(-1);
+            }
+            if (interrupted)
+            {
+                // the documents after the stopped one were not started: they go on a new connection
+                requeue(batch);
+            }
+            for (PendingDocument *pending : batch)
+            {
+                complete(pending, error_str, errorCode);
+            }
+            span.setBytes(written);
+            if (CallStats::getCurrent() != nullptr)
+            {
+                CallStats::getCurrent()->addBytes(written);
+            }
+        }
+    };
+
+    /** RAW printing straight to AppSocket/JetDirect printers, named by their socket://host[:port] URI.
+     * No job is queued anywhere: a job is done once its bytes are written to the printer.
+     * The last jobs are kept so getJob reports their state in the usual shape.
+     */
+    class SocketBackend : public PrintBackend
+    {
+    public:
+        SocketBackend() : _nextJobId(1) {}
+
+        virtual std::string getPrinters(AbortState &state, std::vector<PrinterInfo> &printers)
+        {
+            return "socket:// printers are not listed";
+        }
+
+        virtual std::string getPrinter(AbortState &state, const std::string &printername, PrinterInfo &printer)
+        {
+            std::string host, port;
+            if (!parseUri(printername, host, port))
+            {
+                return "Invalid socket:// URI";
+            }
+            printer.name = printername;
+            printer.options.push_back(std::make_pair(std::string("device-uri"), printername));
+            printer.options.push_back(std::make_pair(std::string("printer-is-accepting-jobs"), std::string("true")));
+            printer.options.push_back(std::make_pair(std::string("printer-state"), std::string("3")));
+            return "";
+        }
+
+        virtual std::string getPrinterDriverOptions(AbortState &state, const std::string &printername, DriverOptionsType &options)
+        {
+            return "socket:// printers have no driver";
+        }
+
+        virtual std::string getJob(AbortState &state, const std::string &printername, int jobId, JobInfo &job)
+        {
+            std::lock_guard<std::mutex> lock(_historyMutex);
+            for (const JobInfo &info : _history)
+            {
+                if (info.id == jobId && info.dest == printername)
+                {
+                    job = info;
+                    return "";
+                }
+            }
+            return "Job not found";
+        }
+
+        virtual std::string setJob(AbortState &state, const std::string &printername, int jobId, const std::string &jobCommand, int value, bool &result)
+        {
+            // jobs are printed as soon as they are submitted
+            result = false;
+            return "";
+        }
+
+        virtual std::string setJobs(AbortState &state, const std::string &printername, const std::vector<int> &jobIds, const std::string &jobCommand, int value, bool &result)
+        {
+            result = false;
+            return "";
+        }
+
+        virtual std::string cancelAllJobs(AbortState &state, const std::string &printername, bool purge, bool &result)
+        {
+            result = true;
+            return "";
+        }
+
+        virtual std::string moveAllJobs(AbortState &state, const std::string &from, const std::string &to, bool &result)
+        {
+            return "socket:// printers have no queue";
+        }
+
+        virtual std::string moveJobs(AbortState &state, const std::string &from, const std::vector<int> &jobIds, const std::string &to, std::vector<int> &moved)
+        {
+            return "socket:// printers have no queue";
+        }
+
+        virtual std::string submitDocument(AbortState &state, const std::string &printername, const std::string &docname, const std::string &format,
+                                           int num_options, cups_option_t *options, DocumentSource &source, int &jobId)
+        {
+            if (format != CUPS_FORMAT_RAW && format != CUPS_FORMAT_AUTO && format != CUPS_FORMAT_TEXT)
+            {
+                return "socket:// printers only take RAW data";
+            }
+            std::string host, port;
+            if (!parseUri(printername, host, port))
+            {
+                return "Invalid socket:// URI";
+            }
+
+            JobInfo job;
+            job.id = _nextJobId++;
+            job.title = docname;
+            job.dest = printername;
+            job.user = cupsUser();
+            job.format = format;
+            job.creation_time = job.processing_time = time(nullptr);
+
+            PendingDocument document;
+            const char *chunk = nullptr;
+            size_t length = 0;
+            while (source.next(chunk, length))
+            {
+                document.data.append(chunk, length);
+            }
+            std::string error_str = source.getError();
+            if (error_str.empty())
+            {
+                error_str = getEndpoint(host, port)->write(state, printername, document);
+            }
+
+            job.size = static_cast<int>((document.data.size() + 1023) / 1024);
+            job.state = error_str.empty() ? IPP_JOB_COMPLETED : IPP_JOB_ABORTED;
+            job.completed_time = time(nullptr);
+            addToHistory(job);
+            jobId = job.id;
+            return error_str;
+        }
+
+    private:
+        std::mutex _endpointsMutex;
+        std::map<std::string, std::shared_ptr<Endpoint>> _endpoints;
+        std::atomic<int> _nextJobId;
+        std::mutex _historyMutex;
+        std::deque<JobInfo> _history;
+
+        /// socket://host[:port][/...], host possibly an [IPv6] address
+        static bool parseUri(const std::string &uri, std::string &host, std::string &port)
+        {
+            if (!isSocketUri(uri))
+            {
+                return false;
+            }
+            std::string authority = uri.substr(strlen(SOCKET_URI_PREFIX));
+            authority = authority.substr(0, authority.find_first_of("/?"));
+            size_t portSeparator = authority.rfind(':');
+            if (!authority.empty() && authority[0] == '[')
+            {
+                size_t end = authority.find(']');
+                if (end == std::string::npos)
+                {
+                    return false;
+                }
+                host = authority.substr(1, end - 1);
+                portSeparator = (end + 1 < authority.size() && authority[end + 1] == ':') ? end + 1 : std::string::npos;
+            }
+            else
+            {
+                host = authority.substr(0, portSeparator);
+            }
+            port = (portSeparator != std::string::npos) ? authority.substr(portSeparator + 1) : DEFAULT_SOCKET_PORT;
+            return !host.empty() && !port.empty();
+        }
+
+        std::shared_ptr<Endpoint> getEndpoint(const std::string &host, const std::string &port)
+        {
+            std::lock_guard<std::mutex> lock(_endpointsMutex);
+            std::shared_ptr<Endpoint> &endpoint = _endpoints[host + ":" + port];
+            if (!endpoint)
+            {
+                endpoint = std::make_shared<Endpoint>(host, port);
+            }
+            return endpoint;
+        }
+
+        void addToHistory(const JobInfo &job)
+        {
+            std::lock_guard<std::mutex> lock(_historyMutex);
+            _history.push_front(job);
+            if (_history.size() > SOCKET_JOB_HISTORY)
+            {
+                _history.pop_back();
+            }
+        }
+    };
+}
+
+bool isSocketUri(const std::string &printername)
+{
+    return printername.compare(0, strlen(SOCKET_URI_PREFIX), SOCKET_URI_PREFIX) == 0;
+}
+
+std::shared_ptr<PrintBackend> getSocketBackend()
+{
+    static std::shared_ptr<PrintBackend> backend = std::make_shared<SocketBackend>();
+    return backend;
+}
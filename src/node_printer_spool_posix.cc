@@ -0,0 +1,817 @@
+#include "node_printer.hpp"
+#include "node_printer_backend.hpp"
+#include "node_printer_env.hpp"
+#include "node_printer_trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char SPOOL_FILE_MAGIC[8] = {'N', 'P', 'S', 'P', 'O', 'O', 'L', '1'};
+    const uint32_t SPOOL_RECORD_MAGIC = 0x5250534e; // "NSPR"
+
+    /// Largest journal by default, in bytes. The whole of it is mapped, the file grows as needed
+    const uint64_t DEFAULT_SPOOL_SIZE = 64 * 1024 * 1024;
+
+    /// The file grows by this much at a time, in bytes
+    const uint64_t SPOOL_GROW_SIZE = 1024 * 1024;
+
+    /// Wait between two attempts while the print server is unreachable, doubling from min to max, in milliseconds
+    const int MIN_RETRY_DELAY = 100;
+    const int MAX_RETRY_DELAY = 5000;
+
+    /// Attempts of a job the print server refuses, before it is marked failed
+    const int MAX_REFUSED_ATTEMPTS = 3;
+
+    /// Deadline of one submission, in milliseconds
+    const int SPOOL_SUBMIT_TIMEOUT = 60000;
+
+    enum SpoolState
+    {
+        SPOOL_PENDING = 0,
+        /// submission started: on recovery, the job is looked for on the server before being sent again
+        SPOOL_SUBMITTING = 1,
+        SPOOL_SUBMITTED = 2,
+        SPOOL_FAILED = 3,
+        /// submission cut short and the job is not found, but the server does not show finished jobs: not sent again
+        SPOOL_IN_DOUBT = 4
+    };
+
+    struct SpoolFileHeader
+    {
+        char magic[8];
+        /// random, makes the job titles of this journal unique
+        uint64_t journalId;
+        /// first sequence number after the last compaction
+        uint64_t firstSequence;
+        uint8_t reserved[40];
+    };
+
+    /** Record of the journal, followed by its payload: printer name, document name,
+     * MIME type, options as name\0value\0 pairs, then the document. Records are 8-byte
+     * aligned; a record counts only once its magic is written, after everything else.
+     */
+    struct SpoolRecordHeader
+    {
+        uint32_t magic;
+        uint32_t state;
+        uint64_t sequence;
+        int32_t jobId;
+        /// FNV-1a of the payload
+        uint32_t checksum;
+        uint32_t printerLength;
+        uint32_t docnameLength;
+        uint32_t formatLength;
+        uint32_t optionsLength;
+        uint64_t dataLength;
+    };
+
+    uint64_t align8(uint64_t size)
+    {
+        return (size + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    uint32_t checksum(const char *data, uint64_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    std::string systemError(const char *operation)
+    {
+        return std::string(operation) + ": " + strerror(errno);
+    }
+
+    /// Outcome of a journal entry, reported to JS
+    struct SpoolResult
+    {
+        uint64_t sequence;
+        std::string printer;
+        int jobId;
+        std::string error;
+    };
+
+    /// Document uploaded straight from the mapped journal
+    class MappedSource : public DocumentSource
+    {
+    public:
+        MappedSource(const char *data, uint64_t size) : _data(data), _size(size), _offset(0) {}
+
+        virtual bool next(const char *&chunk, size_t &length)
+        {
+            if (_offset >= _size)
+            {
+                return false;
+            }
+            chunk = _data + _offset;
+            length = static_cast<size_t>(std::min<uint64_t>(64 * 1024, _size - _offset));
+            _offset += length;
+            return true;
+        }
+
+    private:
+        const char *_data;
+        uint64_t _size;
+        uint64_t _offset;
+    };
+
+    /** Append-only journal of print jobs in a memory-mapped file, drained by its own thread.
+     * Adding a job copies it to the mapping and returns: it survives a crash of the process
+     * as soon as it is added, and a power loss too if the journal is synchronous.
+     * The drainer submits the jobs in order, waiting for the print server while it is
+     * unreachable, and records their job ids. A job whose submission was cut short by a crash
+     * is looked for on the server by its title before being sent again; if the server only
+     * shows its active jobs and the job is not among them, it is left in doubt instead.
+     * The file is locked: only one process drains a journal.
+     */
+    class Journal
+    {
+    public:
+        typedef std::function<void(const SpoolResult &)> ResultCallback;
+
+        Journal() : _fd(-1), _map(nullptr), _capacity(0), _size(0), _end(0), _next(0), _nextSequence(0),
+                    _sync(false), _stopping(false), _current(nullptr) {}
+
+        ~Journal() { close(); }
+
+        /// @return error string
+        std::string open(const std::string &path, uint64_t maxSize, bool sync)
+        {
+            _sync = sync;
+            _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            if (_fd < 0)
+            {
+                return systemError("open");
+            }
+            if (flock(_fd, LOCK_EX | LOCK_NB) != 0)
+            {
+                return errno == EWOULDBLOCK ? "Spool journal is used by another process" : systemError("flock");
+            }
+            struct stat info;
+            if (fstat(_fd, &info) != 0)
+            {
+                return systemError("fstat");
+            }
+            _size = static_cast<uint64_t>(info.st_size);
+            bool created = (_size == 0);
+            if (created && posix_fallocate(_fd, 0, SPOOL_GROW_SIZE) != 0)
+            {
+                return "Unable to allocate the spool journal";
+            }
+            if (created)
+            {
+                _size = SPOOL_GROW_SIZE;
+            }
+            _capacity = std::max(std::max(maxSize, _size), static_cast<uint64_t>(SPOOL_GROW_SIZE));
+            void *map = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            if (map == MAP_FAILED)
+            {
+                return systemError("mmap");
+            }
+            _map = static_cast<char *>(map);
+
+            SpoolFileHeader *header = getHeader();
+            if (created)
+            {
+                memcpy(header->magic, SPOOL_FILE_MAGIC, sizeof(header->magic));
+                header->journalId = std::random_device()() | (static_cast<uint64_t>(std::random_device()()) << 32);
+                header->firstSequence = 1;
+                flush(0, _size);
+            }
+            else if (_size < sizeof(SpoolFileHeader) || memcmp(header->magic, SPOOL_FILE_MAGIC, sizeof(header->magic)) != 0)
+            {
+                return "Not a spool journal: " + path;
+            }
+            recover();
+            return "";
+        }
+
+        /** Start the drainer
+         * @param onResult called on the drainer thread for every job submitted or failed
+         * @param backends backends of the environment opening the journal
+         */
+        void start(const ResultCallback &onResult, const std::shared_ptr<TraceSink> &trace, const std::shared_ptr<BackendState> &backends)
+        {
+            _onResult = onResult;
+            _backends = backends;
+            _drainer = std::thread([this, trace]()
+                                   {
+                                       TraceScope scope(trace);
+                                       drain(); });
+        }
+
+        /// Stop the drainer, interrupting the submission in progress, and unmap the journal
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+                if (_current != nullptr)
+                {
+                    _current->abort();
+                }
+            }
+            _wakeup.notify_all();
+            if (_drainer.joinable())
+            {
+                _drainer.join();
+            }
+            if (_map != nullptr)
+            {
+                munmap(_map, _capacity);
+                _map = nullptr;
+            }
+            if (_fd >= 0)
+            {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+
+        /** Add a job at the end of the journal
+         * @param options name, value pairs
+         * @return error string
+         */
+        std::string append(const std::string &printer, const std::string &docname, const std::string &format,
+                           const std::vector<std::pair<std::string, std::string>> &options, const char *data, size_t size, uint64_t &sequence)
+        {
+            std::string encodedOptions;
+            for (const auto &option : options)
+            {
+                encodedOptions.append(option.first).push_back('\0');
+                encodedOptions.append(option.second).push_back('\0');
+            }
+            uint64_t payload = printer.size() + docname.size() + format.size() + encodedOptions.size() + size;
+            uint64_t total = align8(sizeof(SpoolRecordHeader) + payload);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_map == nullptr || _stopping)
+            {
+                return "Spool journal is closed";
+            }
+            if (_end + total + sizeof(uint32_t) > _capacity)
+            {
+                return "Spool journal is full";
+            }
+            if (_end + total + sizeof(uint32_t) > _size)
+            {
+                uint64_t size = std::min(_capacity, (_end + total + sizeof(uint32_t) + SPOOL_GROW_SIZE - 1) / SPOOL_GROW_SIZE * SPOOL_GROW_SIZE);
+                // allocated, not sparse: a full disk fails here instead of faulting on the mapping
+                if (posix_fallocate(_fd, 0, static_cast<off_t>(size)) != 0)
+                {
+                    return "Unable to grow the spool journal";
+                }
+                _size = size;
+            }
+
+            SpoolRecordHeader *record = reinterpret_cast<SpoolRecordHeader *>(_map + _end);
+            char *out = reinterpret_cast<char *>(record + 1);
+            memcpy(out, printer.data(), printer.size());
+            out += printer.size();
+            memcpy(out, docname.data(), docname.size());
+            out += docname.size();
+            memcpy(out, format.data(), format.size());
+            out += format.size();
+            memcpy(out, encodedOptions.data(), encodedOptions.size());
+            out += encodedOptions.size();
+            memcpy(out, data, size);
+
+            record->state = SPOOL_PENDING;
+            record->sequence = sequence = _nextSequence++;
+            record->jobId = 0;
+            record->checksum = checksum(reinterpret_cast<const char *>(record + 1), payload);
+            record->printerLength = static_cast<uint32_t>(printer.size());
+            record->docnameLength = static_cast<uint32_t>(docname.size());
+            record->formatLength = static_cast<uint32_t>(format.size());
+            record->optionsLength = static_cast<uint32_t>(encodedOptions.size());
+            record->dataLength = size;
+            // end marker first: a torn record left by a crash must not be followed by stale ones
+            *reinterpret_cast<uint32_t *>(_map + _end + total) = 0;
+            __atomic_store_n(&record->magic, SPOOL_RECORD_MAGIC, __ATOMIC_RELEASE);
+            flush(_end, total + sizeof(uint32_t));
+
+            _offsets.push_back(_end);
+            _end += total;
+            _wakeup.notify_one();
+            return "";
+        }
+
+        /// Journal entry for getEntries
+        struct EntryInfo
+        {
+            uint64_t sequence;
+            std::string printer;
+            std::string docname;
+            uint32_t state;
+            int jobId;
+        };
+
+        std::vector<EntryInfo> getEntries()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::vector<EntryInfo> entries;
+            for (uint64_t offset : _offsets)
+            {
+                const SpoolRecordHeader *record = reinterpret_cast<const SpoolRecordHeader *>(_map + offset);
+                const char *payload = reinterpret_cast<const char *>(record + 1);
+                EntryInfo entry = {record->sequence, std::string(payload, record->printerLength),
+                                   std::string(payload + record->printerLength, record->docnameLength),
+                                   __atomic_load_n(&record->state, __ATOMIC_ACQUIRE), record->jobId};
+                entries.push_back(entry);
+            }
+            return entries;
+        }
+
+    private:
+        int _fd;
+        char *_map;
+        /// mapped size: the largest the file can grow to
+        uint64_t _capacity;
+        /// file size
+        uint64_t _size;
+        /// offset of the next record
+        uint64_t _end;
+        /// offsets of the records, in order
+        std::vector<uint64_t> _offsets;
+        /// index in _offsets of the first record not submitted yet
+        size_t _next;
+        uint64_t _nextSequence;
+        bool _sync;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeup;
+        bool _stopping;
+        /// submission in progress, aborted by close
+        AbortState *_current;
+        std::thread _drainer;
+        ResultCallback _onResult;
+        std::shared_ptr<BackendState> _backends;
+
+        SpoolFileHeader *getHeader() const { return reinterpret_cast<SpoolFileHeader *>(_map); }
+
+        /// Write a range of the mapping to disk if the journal is synchronous
+        void flush(uint64_t offset, uint64_t length)
+        {
+            if (!_sync)
+            {
+                return;
+            }
+            uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+            uint64_t start = offset / page * page;
+            msync(_map + start, offset + length - start, MS_SYNC);
+        }
+
+        /// Index the valid records, the journal ends at the first torn or corrupted one
+        void recover()
+        {
+            uint64_t offset = sizeof(SpoolFileHeader);
+            _nextSequence = getHeader()->firstSequence;
+            while (offset + sizeof(SpoolRecordHeader) <= _size)
+            {
+                const SpoolRecordHeader *record = reinterpret_cast<const SpoolRecordHeader *>(_map + offset);
+                if (record->magic != SPOOL_RECORD_MAGIC)
+                {
+                    break;
+                }
+                uint64_t payload = static_cast<uint64_t>(record->printerLength) + record->docnameLength + record->formatLength +
+                                   record->optionsLength + record->dataLength;
+                uint64_t total = align8(sizeof(SpoolRecordHeader) + payload);
+                if (record->dataLength > _size || offset + total > _size ||
+                    checksum(reinterpret_cast<const char *>(record + 1), payload) != record->checksum)
+                {
+                    break;
+                }
+                _offsets.push_back(offset);
+                _nextSequence = std::max(_nextSequence, record->sequence + 1);
+                offset += total;
+            }
+            _end = offset;
+            while (_next < _offsets.size() && getRecord(_next)->state >= SPOOL_SUBMITTED)
+            {
+                ++_next;
+            }
+        }
+
+        SpoolRecordHeader *getRecord(size_t index) const
+        {
+            return reinterpret_cast<SpoolRecordHeader *>(_map + _offsets[index]);
+        }
+
+        void setState(SpoolRecordHeader *record, SpoolState state, int jobId = 0)
+        {
+            if (jobId > 0)
+            {
+                record->jobId = jobId;
+            }
+            __atomic_store_n(&record->state, static_cast<uint32_t>(state), __ATOMIC_RELEASE);
+            flush(reinterpret_cast<char *>(record) - _map, sizeof(SpoolRecordHeader));
+        }
+
+        /// Title of the job of a record, unique to look for it after a crash
+        std::string getTitle(const SpoolRecordHeader *record) const
+        {
+            char suffix[48];
+            snprintf(suffix, sizeof(suffix), " #spool-%016llx-%llu", static_cast<unsigned long long>(getHeader()->journalId),
+                     static_cast<unsigned long long>(record->sequence));
+            return std::string(reinterpret_cast<const char *>(record + 1) + record->printerLength, record->docnameLength) + suffix;
+        }
+
+        /** Empty the journal once every record is done and it uses a quarter of its capacity.
+         * Sequence numbers go on from where they were.
+         */
+        void compact()
+        {
+            if (_next < _offsets.size() || _end < std::max(_capacity / 4, static_cast<uint64_t>(SPOOL_GROW_SIZE)))
+            {
+                return;
+            }
+            getHeader()->firstSequence = _nextSequence;
+            flush(0, sizeof(SpoolFileHeader));
+            *reinterpret_cast<uint32_t *>(_map + sizeof(SpoolFileHeader)) = 0;
+            flush(sizeof(SpoolFileHeader), sizeof(uint32_t));
+            _offsets.clear();
+            _next = 0;
+            _end = sizeof(SpoolFileHeader);
+            if (ftruncate(_fd, SPOOL_GROW_SIZE) == 0)
+            {
+                _size = SPOOL_GROW_SIZE;
+            }
+        }
+
+        enum SubmitOutcome
+        {
+            SUBMIT_DONE,
+            /// the print server could not be reached or refused the job: retry later
+            SUBMIT_RETRY,
+            /// the journal is closing
+            SUBMIT_STOPPED
+        };
+
+        /** Submit a record, or settle it if a previous submission was cut short
+         * @param attempts previous attempts the print server refused
+         */
+        SubmitOutcome submit(SpoolRecordHeader *record, int attempts)
+        {
+            const char *payload = reinterpret_cast<const char *>(record + 1);
+            std::string printer(payload, record->printerLength);
+            payload += record->printerLength + record->docnameLength;
+            std::string format(payload, record->formatLength);
+            payload += record->formatLength;
+            const char *options = payload;
+            const char *data = payload + record->optionsLength;
+            std::string title = getTitle(record);
+
+            AbortState state;
+            state.setTimeout(SPOOL_SUBMIT_TIMEOUT);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_stopping)
+                {
+                    return SUBMIT_STOPPED;
+                }
+                _current = &state;
+            }
+            std::shared_ptr<PrintBackend> backend = getPrinterBackend(*_backends, printer);
+            SpoolResult result = {record->sequence, printer, 0, ""};
+            SubmitOutcome outcome = SUBMIT_DONE;
+            bool sent = false;
+            bool inDoubt = false;
+
+            if (record->state == SPOOL_SUBMITTING)
+            {
+                JobInfo job;
+                result.error = backend->findJob(state, printer, title, job);
+                bool cancelled = (job.state == IPP_JOB_CANCELLED || job.state == IPP_JOB_ABORTED);
+                if (!result.error.empty() && job.id > 0)
+                {
+                    // found, but whether its document arrived is unknown: neither settled nor sent again
+                    inDoubt = true;
+                }
+                else if (!result.error.empty() || cancelled)
+                {
+                    // looked for again next time, or sent again
+                }
+                else if (job.id > 0 && job.documents == 0)
+                {
+                    // created, but its document never arrived: replace it
+                    bool ok = false;
+                    result.error = backend->setJob(state, printer, job.id, "CANCEL", 0, ok);
+                    if (result.error.empty() && !ok)
+                    {
+                        result.error = "Unable to cancel job " + std::to_string(job.id) + ", created without its document";
+                    }
+                }
+                else if (job.id > 0)
+                {
+                    result.jobId = job.id;
+                }
+                else if (!backend->findsCompletedJobs())
+                {
+                    // it may be printed and gone from the active jobs: sending it again could print it twice
+                    inDoubt = true;
+                    result.error = "Job submission was interrupted and the job is not found among the active jobs: not sent again";
+                }
+            }
+            if (result.jobId == 0 && result.error.empty())
+            {
+                setState(record, SPOOL_SUBMITTING);
+                sent = true;
+                int num_options = 0;
+                cups_option_t *cupsOptions = nullptr;
+                for (const char *option = options; option < data;)
+                {
+                    const char *value = option + strlen(option) + 1;
+                    num_options = cupsAddOption(option, value, num_options, &cupsOptions);
+                    option = value + strlen(value) + 1;
+                }
+                MappedSource source(data, record->dataLength);
+                format = resolveAutoFormat(*backend, state, printer, format, data, record->dataLength);
+                result.error = backend->submitDocument(state, printer, title, format, num_options, cupsOptions, source, result.jobId);
+                cupsFreeOptions(num_options, cupsOptions);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _current = nullptr;
+                if (_stopping && !result.error.empty())
+                {
+                    outcome = SUBMIT_STOPPED;
+                }
+            }
+            if (sent && !result.error.empty() && result.jobId == 0)
+            {
+                // no job was created: send it again. Otherwise the job stays in doubt, looked for next time
+                setState(record, SPOOL_PENDING);
+            }
+            if (outcome == SUBMIT_STOPPED)
+            {
+                return outcome;
+            }
+            if (inDoubt)
+            {
+                setState(record, SPOOL_IN_DOUBT);
+            }
+            else if (result.error.empty())
+            {
+                setState(record, SPOOL_SUBMITTED, result.jobId);
+            }
+            else if (!state.getErrorCode().empty() || attempts + 1 < MAX_REFUSED_ATTEMPTS)
+            {
+                // unreachable server: wait for it as long as it takes
+                return SUBMIT_RETRY;
+            }
+            else
+            {
+                setState(record, SPOOL_FAILED);
+            }
+            if (_onResult)
+            {
+                _onResult(result);
+            }
+            return SUBMIT_DONE;
+        }
+
+        void drain()
+        {
+            int attempts = 0;
+            int delay = MIN_RETRY_DELAY;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stopping)
+            {
+                if (_next >= _offsets.size())
+                {
+                    compact();
+                    _wakeup.wait(lock);
+                    continue;
+                }
+                SpoolRecordHeader *record = getRecord(_next);
+                lock.unlock();
+                SubmitOutcome outcome = submit(record, attempts);
+                lock.lock();
+                if (outcome == SUBMIT_DONE)
+                {
+                    ++_next;
+                    attempts = 0;
+                    delay = MIN_RETRY_DELAY;
+                }
+                else if (outcome == SUBMIT_RETRY)
+                {
+                    ++attempts;
+                    _wakeup.wait_for(lock, std::chrono::milliseconds(delay), [this]()
+                                     { return _stopping; });
+                    delay = std::min(delay * 2, MAX_RETRY_DELAY);
+                }
+            }
+        }
+    };
+
+    /** Spool object returned by openSpool: a journal and the function receiving its results.
+     */
+    class Spool : public Napi::ObjectWrap<Spool>
+    {
+    public:
+        static Napi::Function getClass(Napi::Env env)
+        {
+            Napi::FunctionReference &constructor = ModuleData::get(env).spoolClass;
+            if (constructor.IsEmpty())
+            {
+                Napi::Function func = DefineClass(env, "Spool",
+                                                  {InstanceMethod("add", &Spool::add),
+                                                   InstanceMethod("getEntries", &Spool::getEntries),
+                                                   InstanceMethod("close", &Spool::close)});
+                constructor = Napi::Persistent(func);
+            }
+            return constructor.Value();
+        }
+
+        /// Arguments: path String, options Object {maxSize, sync}, onResult Function
+        Spool(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Spool>(info), _journal(new Journal()), _closed(false)
+        {
+            MY_NODE_MODULE_ENV(info);
+            if (info.Length() < 3 || !info[0].IsString() || !info[1].IsObject() || !info[2].IsFunction())
+            {
+                _closed = true;
+                Napi::TypeError::New(env, "Arguments must be a path, an options object and a function").ThrowAsJavaScriptException();
+                return;
+            }
+            Napi::Object options = info[1].As<Napi::Object>();
+            uint64_t maxSize = DEFAULT_SPOOL_SIZE;
+            if (options.Get("maxSize").IsNumber())
+            {
+                maxSize = static_cast<uint64_t>(options.Get("maxSize").As<Napi::Number>().Int64Value());
+            }
+            bool sync = options.Get("sync").ToBoolean().Value();
+            std::string error = _journal->open(info[0].As<Napi::String>().Utf8Value(), maxSize, sync);
+            if (!error.empty())
+            {
+                _closed = true;
+                _journal.reset();
+                Napi::Error::New(env, error).ThrowAsJavaScriptException();
+                return;
+            }
+            // keeps the process alive until close(), as a listening server does
+            _results = ResultFunction::New(env, info[2].As<Napi::Function>(), "node-printer-spool", 0, 1);
+            ResultFunction results = _results;
+            _journal->start([results](const SpoolResult &result) mutable
+                            {
+                                SpoolResult *copy = new SpoolResult(result);
+                                if (results.NonBlockingCall(copy) != napi_ok)
+                                {
+                                    delete copy;
+                                } },
+                            getTraceSink(), getBackendState(env));
+        }
+
+        ~Spool() { release(); }
+
+    private:
+        static void callResult(Napi::Env env, Napi::Function callback, std::nullptr_t *context, SpoolResult *result)
+        {
+            if (env != nullptr && callback != nullptr)
+            {
+                Napi::Object entry = Napi::Object::New(env);
+                entry.Set("sequence", Napi::Number::New(env, static_cast<double>(result->sequence)));
+                entry.Set("printer", Napi::String::New(env, result->printer));
+                Napi::Value error = env.Null();
+                if (result->error.empty())
+                {
+                    entry.Set("jobId", Napi::Number::New(env, result->jobId));
+                }
+                else
+                {
+                    error = Napi::Error::New(env, result->error).Value();
+                }
+                callback.Call({error, entry});
+            }
+            delete result;
+        }
+
+        typedef Napi::TypedThreadSafeFunction<std::nullptr_t, SpoolResult, &Spool::callResult> ResultFunction;
+
+        std::unique_ptr<Journal> _journal;
+        ResultFunction _results;
+        bool _closed;
+
+        void release()
+        {
+            if (_closed)
+            {
+                return;
+            }
+            _closed = true;
+            _journal->close();
+            _results.Release();
+        }
+
+        /** Add a job to the journal
+         * Arguments: data String or Buffer, printer String, docname String, type String, options Object
+         * @returns sequence number of the job
+         */
+        Napi::Value add(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_ARGUMENTS(info, 5);
+            std::string data;
+            if (!getStringOrBufferFromNapiValue(info[0], data))
+            {
+                RETURN_EXCEPTION_STR("Argument 0 must be a string or Buffer");
+            }
+            REQUIRE_ARGUMENT_STRING(info, 1, printername);
+            REQUIRE_ARGUMENT_STRING(info, 2, docname);
+            REQUIRE_ARGUMENT_STRING(info, 3, type);
+            REQUIRE_ARGUMENT_OBJECT(info, 4, print_options);
+            std::string format = getDocumentFormat(type);
+            if (format.empty())
+            {
+                RETURN_EXCEPTION_STR("unsupported format type");
+            }
+            if (_closed)
+            {
+                RETURN_EXCEPTION_STR("Spool journal is closed");
+            }
+            std::vector<std::pair<std::string, std::string>> options;
+            Napi::Array names = print_options.GetPropertyNames();
+            for (uint32_t i = 0; i < names.Length(); ++i)
+            {
+                Napi::Value name = names.Get(i);
+                options.push_back(std::make_pair(name.ToString().Utf8Value(), print_options.Get(name).ToString().Utf8Value()));
+            }
+            uint64_t sequence = 0;
+            std::string error = _journal->append(printername, docname, format, options, data.data(), data.size(), sequence);
+            if (!error.empty())
+            {
+                RETURN_EXCEPTION_STR(error);
+            }
+            return Napi::Number::New(env, static_cast<double>(sequence));
+        }
+
+        /// @returns Array of {sequence, printer, docname, status: PENDING, SUBMITTING, SUBMITTED, FAILED or IN_DOUBT, jobId?}
+        Napi::Value getEntries(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            static const char *const states[] = {"PENDING", "SUBMITTING", "SUBMITTED", "FAILED", "IN_DOUBT"};
+            std::vector<Journal::EntryInfo> entries;
+            if (!_closed)
+            {
+                entries = _journal->getEntries();
+            }
+            Napi::Array result = Napi::Array::New(env, entries.size());
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                Napi::Object entry = Napi::Object::New(env);
+                entry.Set("sequence", Napi::Number::New(env, static_cast<double>(entries[i].sequence)));
+                entry.Set("printer", Napi::String::New(env, entries[i].printer));
+                entry.Set("docname", Napi::String::New(env, entries[i].docname));
+                entry.Set("status", Napi::String::New(env, states[std::min<uint32_t>(entries[i].state, SPOOL_IN_DOUBT)]));
+                if (entries[i].jobId > 0)
+                {
+                    entry.Set("jobId", Napi::Number::New(env, entries[i].jobId));
+                }
+                result.Set(static_cast<uint32_t>(i), entry);
+            }
+            return result;
+        }
+
+        /// Stop draining and close the journal. Jobs not submitted yet stay in it for the next openSpool
+        Napi::Value close(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            release();
+            return env.Undefined();
+        }
+    };
+}
+
+MY_NODE_MODULE_CALLBACK(openSpool)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 3);
+    Napi::Object spool = Spool::getClass(env).New({info[0], info[1], info[2]});
+    if (env.IsExceptionPending())
+    {
+        return env.Null();
+    }
+    return spool;
+}
@@ -0,0 +1,326 @@
+#include "node_printer.hpp"
+#include "node_printer_stats.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    const char *const operationNames[STATS_OPERATION_COUNT] = {
+        "getPrinters",
+        "getPrinter",
+        "getPrinterDriverOptions",
+        "getJob",
+        "setJob",
+        "setJobs",
+        "cancelAllJobs",
+        "moveJobs",
+        "printDirect",
+        "printFile"};
+
+    struct OperationStats
+    {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> bytes;
+        LatencyHistogram latency;
+        LatencyHistogram ipp;
+        LatencyHistogram marshal;
+
+        OperationStats() : calls(0), errors(0), bytes(0) {}
+    };
+
+    struct PrinterStats
+    {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> bytes;
+        LatencyHistogram ipp;
+
+        PrinterStats() : calls(0), errors(0), bytes(0) {}
+    };
+
+    typedef std::map<std::string, std::unique_ptr<PrinterStats>> PrinterStatsMapType;
+
+    struct Stats
+    {
+        OperationStats operations[STATS_OPERATION_COUNT];
+        /// guards the map only, counters are atomic
+        std::mutex printersMutex;
+        PrinterStatsMapType printers;
+        std::atomic<int64_t> since;
+
+        Stats() : since(now()) {}
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    };
+
+    Stats &getStats()
+    {
+        static Stats result;
+        return result;
+    }
+
+    thread_local CallStats *currentCallStats = nullptr;
+
+    uint64_t toMicros(CallStats::Duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+
+    double toMillis(uint64_t micros)
+    {
+        return static_cast<double>(micros) / 1000.0;
+    }
+
+    uint64_t readCounter(std::atomic<uint64_t> &counter, bool reset)
+    {
+        return reset ? counter.exchange(0) : counter.load();
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : _sum(0), _max(0)
+{
+    for (auto &bucket : _buckets)
+    {
+        bucket = 0;
+    }
+}
+
+size_t LatencyHistogram::getBucket(uint64_t micros)
+{
+    if (micros < SUB_BUCKET_COUNT)
+    {
+        return static_cast<size_t>(micros);
+    }
+    const uint64_t maxValue = (uint64_t(1) << (MAX_EXPONENT + 1)) - 1;
+    if (micros > maxValue)
+    {
+        micros = maxValue;
+    }
+    int exponent = MAX_EXPONENT;
+    while ((micros >> exponent) == 0)
+    {
+        --exponent;
+    }
+    size_t subBucket = static_cast<size_t>(micros >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(size_t bucket)
+{
+    if (bucket < SUB_BUCKET_COUNT)
+    {
+        return bucket + 1;
+    }
+    int exponent = static_cast<int>(bucket / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = bucket % SUB_BUCKET_COUNT;
+    return (SUB_BUCKET_COUNT + subBucket + 1) << (exponent - SUB_BUCKET_BITS);
+}
+
+void LatencyHistogram::record(uint64_t micros)
+{
+    _buckets[getBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (micros > max && !_max.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+Napi::Object LatencyHistogram::snapshot(Napi::Env env, bool reset)
+{
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        counts[i] = readCounter(_buckets[i], reset);
+        count += counts[i];
+    }
+    uint64_t sum = readCounter(_sum, reset);
+    uint64_t max = readCounter(_max, reset);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("count", Napi::Number::New(env, static_cast<double>(count)));
+    result.Set("sum", Napi::Number::New(env, toMillis(sum)));
+    result.Set("max", Napi::Number::New(env, toMillis(max)));
+    result.Set("mean", Napi::Number::New(env, count > 0 ? toMillis(sum) / static_cast<double>(count) : 0.0));
+
+    static const struct
+    {
+        const char *name;
+        double quantile;
+    } percentiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+    for (const auto &percentile : percentiles)
+    {
+        uint64_t value = 0;
+        if (count > 0)
+        {
+            uint64_t rank = static_cast<uint64_t>(percentile.quantile * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; ++i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    value = getBucketUpperBound(i);
+                    break;
+                }
+            }
+            if (value > max)
+            {
+                value = max;
+            }
+        }
+        result.Set(percentile.name, Napi::Number::New(env, toMillis(value)));
+    }
+
+    // sparse [upper bound in ms, count] pairs, e.g. for prometheus "le" buckets
+    Napi::Array buckets = Napi::Array::New(env);
+    uint32_t j = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        Napi::Array bucket = Napi::Array::New(env, 2);
+        bucket.Set(uint32_t(0), Napi::Number::New(env, toMillis(getBucketUpperBound(i))));
+        bucket.Set(uint32_t(1), Napi::Number::New(env, static_cast<double>(counts[i])));
+        buckets.Set(j++, bucket);
+    }
+    result.Set("buckets", buckets);
+    return result;
+}
+
+CallStats::CallStats(StatsOperation operation, const std::string &printer)
+    : _operation(operation), _printer(printer), _start(std::chrono::steady_clock::now()),
+      _ipp(Duration::zero()), _marshal(Duration::zero()), _bytes(0), _error(false), _finished(false)
+{
+}
+
+void CallStats::finish()
+{
+    if (_finished)
+    {
+        return;
+    }
+    _finished = true;
+
+    OperationStats &operation = getStats().operations[_operation];
+    operation.calls.fetch_add(1, std::memory_order_relaxed);
+    if (_error)
+    {
+        operation.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    operation.bytes.fetch_add(_bytes, std::memory_order_relaxed);
+    operation.latency.record(toMicros(std::chrono::steady_clock::now() - _start));
+    operation.ipp.record(toMicros(_ipp));
+    operation.marshal.record(toMicros(_marshal));
+
+    if (_printer.empty())
+    {
+        return;
+    }
+    PrinterStats *printer = nullptr;
+    {
+        Stats &stats = getStats();
+        std::lock_guard<std::mutex> lock(stats.printersMutex);
+        std::unique_ptr<PrinterStats> &entry = stats.printers[_printer];
+        if (!entry)
+        {
+            entry.reset(new PrinterStats());
+        }
+        // entries are never removed
+        printer = entry.get();
+    }
+    printer->calls.fetch_add(1, std::memory_order_relaxed);
+    if (_error)
+    {
+        printer->errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    printer->bytes.fetch_add(_bytes, std::memory_order_relaxed);
+    printer->ipp.record(toMicros(_ipp));
+}
+
+CallStats *CallStats::getCurrent()
+{
+    return currentCallStats;
+}
+
+CallStatsScope::CallStatsScope(CallStats *stats) : _previous(currentCallStats)
+{
+    currentCallStats = stats;
+}
+
+CallStatsScope::~CallStatsScope()
+{
+    currentCallStats = _previous;
+}
+
+StatsTimer::~StatsTimer()
+{
+    if (_stats == nullptr)
+    {
+        return;
+    }
+    CallStats::Duration duration = std::chrono::steady_clock::now() - _start;
+    if (_kind == IPP)
+    {
+        _stats->addIppTime(duration);
+    }
+    else
+    {
+        _stats->addMarshalTime(duration);
+    }
+}
+
+MY_NODE_MODULE_CALLBACK(getStats)
+{
+    MY_NODE_MODULE_ENV(info);
+    bool reset = false;
+    if (info.Length() > 0 && info[0].IsObject())
+    {
+        reset = info[0].As<Napi::Object>().Get("reset").ToBoolean().Value();
+    }
+
+    Stats &stats = getStats();
+    Napi::Object result = Napi::Object::New(env);
+    int64_t now = Stats::now();
+    result.Set("since", Napi::Date::New(env, static_cast<double>(reset ? stats.since.exchange(now) : stats.since.load())));
+
+    Napi::Object result_operations = Napi::Object::New(env);
+    for (size_t i = 0; i < STATS_OPERATION_COUNT; ++i)
+    {
+        OperationStats &operation = stats.operations[i];
+        Napi::Object result_operation = Napi::Object::New(env);
+        result_operation.Set("calls", Napi::Number::New(env, static_cast<double>(readCounter(operation.calls, reset))));
+        result_operation.Set("errors", Napi::Number::New(env, static_cast<double>(readCounter(operation.errors, reset))));
+        result_operation.Set("bytes", Napi::Number::New(env, static_cast<double>(readCounter(operation.bytes, reset))));
+        result_operation.Set("latency", operation.latency.snapshot(env, reset));
+        result_operation.Set("ipp", operation.ipp.snapshot(env, reset));
+        result_operation.Set("marshal", operation.marshal.snapshot(env, reset));
+        result_operations.Set(operationNames[i], result_operation);
+    }
+    result.Set("operations", result_operations);
+
+    Napi::Object result_printers = Napi::Object::New(env);
+    {
+        std::lock_guard<std::mutex> lock(stats.printersMutex);
+        for (const auto &itPrinter : stats.printers)
+        {
+            Napi::Object result_printer = Napi::Object::New(env);
+            result_printer.Set("calls", Napi::Number::New(env, static_cast<double>(readCounter(itPrinter.second->calls, reset))));
+            result_printer.Set("errors", Napi::Number::New(env, static_cast<double>(readCounter(itPrinter.second->errors, reset))));
+            result_printer.Set("bytes", Napi::Number::New(env, static_cast<double>(readCounter(itPrinter.second->bytes, reset))));
+            result_printer.Set("ipp", itPrinter.second->ipp.snapshot(env, reset));
+            result_printers.Set(itPrinter.first, result_printer);
+        }
+    }
+    result.Set("printers", result_printers);
+    return result;
+}
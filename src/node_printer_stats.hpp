@@ -0,0 +1,141 @@
+#ifndef NODE_PRINTER_STATS_HPP
+#define NODE_PRINTER_STATS_HPP
+
+#include <napi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** Operations measured by getStats(). Synchronous and asynchronous variants share the same entry
+ */
+enum StatsOperation
+{
+    STATS_GET_PRINTERS,
+    STATS_GET_PRINTER,
+    STATS_GET_PRINTER_DRIVER_OPTIONS,
+    STATS_GET_JOB,
+    STATS_SET_JOB,
+    STATS_SET_JOBS,
+    STATS_CANCEL_ALL_JOBS,
+    STATS_MOVE_JOBS,
+    STATS_PRINT_DIRECT,
+    STATS_PRINT_FILE,
+    STATS_OPERATION_COUNT
+};
+
+/** Latency histogram in microseconds, HDR style.
+ * Buckets are log-linear: 8 sub-buckets per power of two, so a value is known
+ * within 12.5%, from 1us to more than a week. Recording is lock free.
+ */
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_EXPONENT = 40;
+    static const size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+
+    /** Get count, sum, max, percentiles and non empty buckets, durations in milliseconds
+     * @param reset clear the histogram while reading it
+     */
+    Napi::Object snapshot(Napi::Env env, bool reset);
+
+    static size_t getBucket(uint64_t micros);
+
+    /// First value above the bucket
+    static uint64_t getBucketUpperBound(size_t bucket);
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+/** Measures one call of an operation and records it in the global statistics
+ * when finished. A call is built and finished on the main thread; its IPP part
+ * may run on a pool thread, never concurrently with the main thread part.
+ */
+class CallStats
+{
+public:
+    typedef std::chrono::steady_clock::duration Duration;
+
+    /// @param printer printer name, empty if the call does not target one printer
+    CallStats(StatsOperation operation, const std::string &printer = "");
+    ~CallStats() { finish(); }
+
+    void addIppTime(Duration duration) { _ipp += duration; }
+    void addMarshalTime(Duration duration) { _marshal += duration; }
+    void addBytes(size_t bytes) { _bytes += bytes; }
+    void setError() { _error = true; }
+
+    /// Record the call. Called by the destructor if not done before
+    void finish();
+
+    /// Call running on the current thread, set by CallStatsScope. nullptr if none
+    static CallStats *getCurrent();
+
+private:
+    friend class CallStatsScope;
+
+    StatsOperation _operation;
+    std::string _printer;
+    std::chrono::steady_clock::time_point _start;
+    Duration _ipp;
+    Duration _marshal;
+    uint64_t _bytes;
+    bool _error;
+    bool _finished;
+};
+
+/** Make a call the current one of the thread for the scope
+ */
+class CallStatsScope
+{
+public:
+    CallStatsScope(CallStats *stats);
+    ~CallStatsScope();
+
+private:
+    CallStats *_previous;
+};
+
+/** Call of a synchronous method, current for its whole scope
+ */
+class ScopedCallStats : public CallStats
+{
+public:
+    ScopedCallStats(StatsOperation operation, const std::string &printer = "") : CallStats(operation, printer), _scope(this) {}
+
+private:
+    CallStatsScope _scope;
+};
+
+/** Add the time spent in a scope to the IPP or marshalling time of a call. No-op if stats is nullptr
+ */
+class StatsTimer
+{
+public:
+    enum Kind
+    {
+        IPP,
+        MARSHAL
+    };
+
+    StatsTimer(CallStats *stats, Kind kind) : _stats(stats), _kind(kind), _start(std::chrono::steady_clock::now()) {}
+    ~StatsTimer();
+
+private:
+    CallStats *_stats;
+    Kind _kind;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include "node_printer.hpp"
+#include "node_printer_env.hpp"
+
+#include <string>
+#include <map>
+#include <vector>
+
+namespace
+{
+    const char *const DEFAULT_OPEN_DELIMITER = "{{";
+    const char *const DEFAULT_CLOSE_DELIMITER = "}}";
+
+    /** Template of printer commands (ZPL, EPL, ESC/POS...) with named placeholders.
+     * The source is parsed once in literal and field segments; render() writes the
+     * labels of all the records in one buffer, meant to be sent as one RAW job.
+     */
+    class LabelTemplate : public Napi::ObjectWrap<LabelTemplate>
+    {
+    public:
+        static Napi::Function getClass(Napi::Env env)
+        {
+            Napi::FunctionReference &constructor = ModuleData::get(env).labelTemplateClass;
+            if (constructor.IsEmpty())
+            {
+                Napi::Function func = DefineClass(env, "LabelTemplate",
+                                                  {InstanceAccessor("fields", &LabelTemplate::getFields, nullptr),
+                                                   InstanceMethod("render", &LabelTemplate::render)});
+                constructor = Napi::Persistent(func);
+            }
+            return constructor.Value();
+        }
+
+        /// Arguments: source String or Buffer, options Object {open, close}
+        LabelTemplate(const Napi::CallbackInfo &info) : Napi::ObjectWrap<LabelTemplate>(info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            std::string source;
+            if (info.Length() <= 0 || !getStringOrBufferFromNapiValue(info[0], source))
+            {
+                Napi::TypeError::New(env, "Argument 0 must be a string or a buffer").ThrowAsJavaScriptException();
+                return;
+            }
+            std::string open(DEFAULT_OPEN_DELIMITER), close(DEFAULT_CLOSE_DELIMITER);
+            if (info.Length() > 1 && info[1].IsObject())
+            {
+                Napi::Object options = info[1].As<Napi::Object>();
+                if (options.Has("open"))
+                {
+                    open = options.Get("open").ToString().Utf8Value();
+                }
+                if (options.Has("close"))
+                {
+                    close = options.Get("close").ToString().Utf8Value();
+                }
+            }
+            if (open.empty() || close.empty())
+            {
+                Napi::TypeError::New(env, "Placeholder delimiters must not be empty").ThrowAsJavaScriptException();
+                return;
+            }
+            std::string error = parse(source, open, close);
+            if (!error.empty())
+            {
+                Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            }
+        }
+
+    private:
+        /// Part of the template: literal bytes followed by a field, if field >= 0
+        struct Segment
+        {
+            size_t offset;
+            size_t length;
+            int field;
+        };
+
+        std::string _literals;
+        std::vector<Segment> _segments;
+        std::vector<std::string> _fields;
+
+        std::string parse(const std::string &source, const std::string &open, const std::string &close)
+        {
+            std::map<std::string, int> fieldIndexes;
+            size_t position = 0;
+            for (;;)
+            {
+                size_t start = source.find(open, position);
+                Segment segment = {_literals.size(), 0, -1};
+                if (start == std::string::npos)
+                {
+                    _literals.append(source, position, std::string::npos);
+                    segment.length = _literals.size() - segment.offset;
+                    _segments.push_back(segment);
+                    return "";
+                }
+                size_t end = source.find(close, start + open.size());
+                if (end == std::string::npos)
+                {
+                    return "Unterminated placeholder at offset " + std::to_string(start);
+                }
+                std::string name = source.substr(start + open.size(), end - start - open.size());
+                name.erase(0, name.find_first_not_of(" \t"));
+                name.erase(name.find_last_not_of(" \t") + 1);
+                if (name.empty())
+                {
+                    return "Empty placeholder at offset " + std::to_string(start);
+                }
+                auto itField = fieldIndexes.find(name);
+                if (itField == fieldIndexes.end())
+                {
+                    itField = fieldIndexes.insert(std::make_pair(name, static_cast<int>(_fields.size()))).first;
+                    _fields.push_back(name);
+                }
+                _literals.append(source, position, start - position);
+                segment.length = _literals.size() - segment.offset;
+                segment.field = itField->second;
+                _segments.push_back(segment);
+                position = end + close.size();
+            }
+        }
+
+        /// Append a record value: strings as UTF-8, buffers as is, null and undefined as nothing
+        static void appendValue(const Napi::Value &value, std::string &output)
+        {
+            if (value.IsString())
+            {
+                output += value.As<Napi::String>().Utf8Value();
+            }
+            else if (value.IsBuffer())
+            {
+                Napi::Buffer<char> buffer = value.As<Napi::Buffer<char>>();
+                output.append(buffer.Data(), buffer.Length());
+            }
+            else if (!value.IsNull() && !value.IsUndefined())
+            {
+                output += value.ToString().Utf8Value();
+            }
+        }
+
+        void appendLabel(const std::vector<std::string> &values, std::string &output) const
+        {
+            for (const Segment &segment : _segments)
+            {
+                output.append(_literals, segment.offset, segment.length);
+                if (segment.field >= 0)
+                {
+                    output += values[segment.field];
+                }
+            }
+        }
+
+        Napi::Value getFields(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            Napi::Array result = Napi::Array::New(env, _fields.size());
+            for (size_t i = 0; i < _fields.size(); ++i)
+            {
+                result.Set(static_cast<uint32_t>(i), Napi::String::New(env, _fields[i]));
+            }
+            return result;
+        }
+
+        /** Render the labels of records into one buffer.
+         * records: Array of Objects (values by field name), Array of Arrays (values in
+         * the order of `fields`) or Object of columns {field: Array of values}.
+         */
+        Napi::Value render(const Napi::CallbackInfo &info)
+        {
+            MY_NODE_MODULE_ENV(info);
+            REQUIRE_ARGUMENT_OBJECT(info, 0, records);
+
+            std::vector<Napi::Value> keys;
+            for (const std::string &field : _fields)
+            {
+                keys.push_back(Napi::String::New(env, field));
+            }
+            std::vector<Napi::Array> columns;
+            uint32_t count = 0;
+            if (records.IsArray())
+            {
+                count = records.As<Napi::Array>().Length();
+            }
+            else
+            {
+                for (size_t field = 0; field < _fields.size(); ++field)
+                {
+                    Napi::Value column = records.Get(keys[field]);
+                    if (!column.IsArray())
+                    {
+                        RETURN_EXCEPTION_STR("Column " + _fields[field] + " must be an array");
+                    }
+                    columns.push_back(column.As<Napi::Array>());
+                    uint32_t length = columns.back().Length();
+                    if (field > 0 && length != count)
+                    {
+                        RETURN_EXCEPTION_STR("Columns must have the same length");
+                    }
+                    count = length;
+                }
+            }
+
+            std::string output;
+            std::vector<std::string> values(_fields.size());
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                Napi::Value record;
+                if (columns.empty())
+                {
+                    record = records.Get(i);
+                    if (!record.IsObject())
+                    {
+                        RETURN_EXCEPTION_STR("Record " + std::to_string(i) + " must be an object or an array");
+                    }
+                }
+                for (size_t field = 0; field < _fields.size(); ++field)
+                {
+                    values[field].clear();
+                    if (!columns.empty())
+                    {
+                        appendValue(columns[field].Get(i), values[field]);
+                    }
+                    else if (record.IsArray())
+                    {
+                        appendValue(record.As<Napi::Object>().Get(static_cast<uint32_t>(field)), values[field]);
+                    }
+                    else
+                    {
+                        appendValue(record.As<Napi::Object>().Get(keys[field]), values[field]);
+                    }
+                }
+                if (i == 0)
+                {
+                    // the first label gives the size of the others
+                    appendLabel(values, output);
+                    output.reserve(output.size() * count + output.size() / 2);
+                }
+                else
+                {
+                    appendLabel(values, output);
+                }
+            }
+
+            // copied: external buffers are not allowed under Electron's memory cage
+            return Napi::Buffer<char>::Copy(env, output.data(), output.size());
+        }
+    };
+}
+
+MY_NODE_MODULE_CALLBACK(compileLabelTemplate)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    Napi::Object options = (info.Length() > 1 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    return LabelTemplate::getClass(env).New({info[0], options});
+}
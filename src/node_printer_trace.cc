@@ -0,0 +1,185 @@
+#include "node_printer.hpp"
+#include "node_printer_trace.hpp"
+
+#include <mutex>
+
+namespace
+{
+    struct TraceEvent
+    {
+        uint64_t id;
+        bool start;
+        const char *operation;
+        std::string printer;
+        int jobId;
+        uint64_t bytes;
+        int status;
+        double duration;
+    };
+
+    void callTrace(Napi::Env env, Napi::Function callback, TraceSink *context, TraceEvent *event);
+
+    typedef Napi::TypedThreadSafeFunction<TraceSink, TraceEvent, &callTrace> TraceFunction;
+
+    /** Events waiting for the JS thread. Beyond it, events are dropped instead of blocking the operation
+     */
+    const size_t TRACE_QUEUE_SIZE = 10000;
+
+    std::atomic<uint64_t> nextSpanId(1);
+
+    /// Sink of the spans of the current thread: the environment's one on JS threads, the task's one on pool threads
+    thread_local std::shared_ptr<TraceSink> currentSink;
+}
+
+/** Trace callback of one environment.
+ * It is closed when the callback is replaced or when its environment is torn down
+ * (e.g. a terminated worker); pool tasks still holding it then drop their events.
+ */
+class TraceSink
+{
+public:
+    explicit TraceSink(TraceFunction function) : _function(function), _open(true)
+    {
+        ++TraceSpan::enabled;
+    }
+
+    void emit(TraceEvent *event)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_open || _function.NonBlockingCall(event) != napi_ok)
+        {
+            delete event;
+        }
+    }
+
+    /// Release the callback. Called on the JS thread of the environment
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_open)
+        {
+            _open = false;
+            --TraceSpan::enabled;
+            _function.Release();
+        }
+    }
+
+    /// The environment finalized the callback: it must not be called anymore
+    void finalize()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_open)
+        {
+            _open = false;
+            --TraceSpan::enabled;
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    TraceFunction _function;
+    bool _open;
+};
+
+namespace
+{
+    void callTrace(Napi::Env env, Napi::Function callback, TraceSink *context, TraceEvent *event)
+    {
+        if (env != nullptr)
+        {
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("id", Napi::Number::New(env, static_cast<double>(event->id)));
+            result.Set("phase", Napi::String::New(env, event->start ? "start" : "end"));
+            result.Set("operation", Napi::String::New(env, event->operation));
+            if (!event->printer.empty())
+            {
+                result.Set("printer", Napi::String::New(env, event->printer));
+            }
+            if (event->jobId > 0)
+            {
+                result.Set("jobId", Napi::Number::New(env, event->jobId));
+            }
+            if (!event->start)
+            {
+                result.Set("bytes", Napi::Number::New(env, static_cast<double>(event->bytes)));
+                result.Set("status", Napi::Number::New(env, event->status));
+                result.Set("duration", Napi::Number::New(env, event->duration));
+            }
+            callback.Call({result});
+        }
+        delete event;
+    }
+}
+
+std::shared_ptr<TraceSink> getTraceSink()
+{
+    return currentSink;
+}
+
+TraceScope::TraceScope(const std::shared_ptr<TraceSink> &sink) : _previous(currentSink)
+{
+    currentSink = sink;
+}
+
+TraceScope::~TraceScope()
+{
+    currentSink = _previous;
+}
+
+std::atomic<int> TraceSpan::enabled(0);
+
+TraceSpan::TraceSpan(const char *operation, const std::string &printer, int jobId)
+    : _id(0), _operation(operation), _jobId(jobId), _bytes(0), _status(0)
+{
+    if (!isEnabled() || !(_sink = currentSink))
+    {
+        return;
+    }
+    _id = nextSpanId.fetch_add(1, std::memory_order_relaxed);
+    _printer = printer;
+    _start = std::chrono::steady_clock::now();
+    _sink->emit(new TraceEvent{_id, true, _operation, _printer, _jobId, 0, 0, 0.0});
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!_sink)
+    {
+        return;
+    }
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+    _sink->emit(new TraceEvent{_id, false, _operation, _printer, _jobId, _bytes, _status, duration});
+}
+
+MY_NODE_MODULE_CALLBACK(setTraceCallback)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    if (!info[0].IsFunction() && !info[0].IsNull() && !info[0].IsUndefined())
+    {
+        RETURN_EXCEPTION_STR("Argument 0 must be a function or null");
+    }
+
+    if (currentSink)
+    {
+        currentSink->close();
+        currentSink.reset();
+    }
+    if (info[0].IsFunction())
+    {
+        // the finalizer keeps the sink alive until the environment is done with the function
+        std::shared_ptr<TraceSink> *owner = new std::shared_ptr<TraceSink>();
+        TraceFunction function = TraceFunction::New(env, info[0].As<Napi::Function>(), "node-printer-trace", TRACE_QUEUE_SIZE, 1, nullptr,
+                                                    [](Napi::Env, std::shared_ptr<TraceSink> *data, TraceSink *)
+                                                    {
+                                                        (*data)->finalize();
+                                                        delete data;
+                                                    },
+                                                    owner);
+        // tracing must not keep the process alive
+        function.Unref(env);
+        currentSink = std::make_shared<TraceSink>(function);
+        *owner = currentSink;
+    }
+    return env.Undefined();
+}
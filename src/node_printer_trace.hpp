@@ -0,0 +1,68 @@
+#ifndef NODE_PRINTER_TRACE_HPP
+#define NODE_PRINTER_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class TraceSink;
+
+/** Trace callback of the environment running on the calling thread, if any.
+ * Captured on the JS thread by operations handed over to other threads.
+ */
+std::shared_ptr<TraceSink> getTraceSink();
+
+/** Make the spans of the calling thread emit to sink while in scope
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const std::shared_ptr<TraceSink> &sink);
+    ~TraceScope();
+
+private:
+    std::shared_ptr<TraceSink> _previous;
+};
+
+/** Tracing of the print server operations.
+ * Spans emit a start and an end event to the trace callback of the environment
+ * (main thread or worker) that started the operation, from any thread.
+ * Without callback in any environment a span costs one atomic load.
+ */
+class TraceSpan
+{
+public:
+    /** @param operation name of the native operation, e.g. cupsCreateJob. Must be a literal
+     * @param printer target printer, empty if none
+     */
+    TraceSpan(const char *operation, const std::string &printer, int jobId = 0);
+    ~TraceSpan();
+
+    /// True if a trace callback is set in at least one environment
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed) > 0; }
+
+    void setJobId(int jobId) { _jobId = jobId; }
+    void setBytes(uint64_t bytes) { _bytes = bytes; }
+
+    /// IPP status of the operation, reported by the end event
+    void setStatus(int status) { _status = status; }
+
+private:
+    static std::atomic<int> enabled;
+
+    std::shared_ptr<TraceSink> _sink;
+    uint64_t _id;
+    const char *_operation;
+    std::string _printer;
+    int _jobId;
+    uint64_t _bytes;
+    int _status;
+    std::chrono::steady_clock::time_point _start;
+
+    friend class TraceSink;
+};
+
+#endif
@@ -50,9 +50,11 @@ namespace
 
     struct PrinterHandle
     {
-        PrinterHandle(LPWSTR iPrinterName)
+        /// @param iAccess desired access, e.g. PRINTER_ACCESS_ADMINISTER. 0 for the default user access
+        PrinterHandle(LPWSTR iPrinterName, DWORD iAccess = 0)
         {
-            _ok = OpenPrinterW(iPrinterName, &_printer, NULL);
+            PRINTER_DEFAULTSW defaults = {NULL, NULL, iAccess};
+            _ok = OpenPrinterW(iPrinterName, &_printer, iAccess != 0 ? &defaults : NULL);
         }
         ~PrinterHandle()
         {
@@ -70,14 +72,9 @@ namespace
         BOOL _ok;
     };
 
-    const StatusMapType &getStatusMap()
+    StatusMapType newStatusMap()
     {
-        static StatusMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
-        // add only first time
+        StatusMapType result;
 #define STATUS_PRINTER_ADD(value, type) result.insert(std::make_pair(value, type))
         STATUS_PRINTER_ADD("BUSY", PRINTER_STATUS_BUSY);
         STATUS_PRINTER_ADD("DOOR-OPEN", PRINTER_STATUS_DOOR_OPEN);
@@ -108,14 +105,16 @@ namespace
         return result;
     }
 
-    const StatusMapType &getJobStatusMap()
+    /// Built once, thread safe, never modified afterwards
+    const StatusMapType &getStatusMap()
     {
-        static StatusMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
-        // add only first time
+        static const StatusMapType result = newStatusMap();
+        return result;
+    }
+
+    StatusMapType newJobStatusMap()
+    {
+        StatusMapType result;
 #define STATUS_PRINTER_ADD(value, type) result.insert(std::make_pair(value, type))
         // Common statuses
         STATUS_PRINTER_ADD("PRINTING", JOB_STATUS_PRINTING);
@@ -144,14 +143,16 @@ namespace
         return result;
     }
 
-    const StatusMapType &getAttributeMap()
+    /// Built once, thread safe, never modified afterwards
+    const StatusMapType &getJobStatusMap()
     {
-        static StatusMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
-        // add only first time
+        static const StatusMapType result = newJobStatusMap();
+        return result;
+    }
+
+    StatusMapType newAttributeMap()
+    {
+        StatusMapType result;
 #define ATTRIBUTE_PRINTER_ADD(value, type) result.insert(std::make_pair(value, type))
         ATTRIBUTE_PRINTER_ADD("DIRECT", PRINTER_ATTRIBUTE_DIRECT);
         ATTRIBUTE_PRINTER_ADD("DO-COMPLETE-FIRST", PRINTER_ATTRIBUTE_DO_COMPLETE_FIRST);
@@ -184,14 +185,16 @@ namespace
         return result;
     }
 
-    const StatusMapType &getJobCommandMap()
+    /// Built once, thread safe, never modified afterwards
+    const StatusMapType &getAttributeMap()
     {
-        static StatusMapType result;
-        if (!result.empty())
-        {
-            return result;
-        }
-        // add only first time
+        static const StatusMapType result = newAttributeMap();
+        return result;
+    }
+
+    StatusMapType newJobCommandMap()
+    {
+        StatusMapType result;
 #define COMMAND_JOB_ADD(value, type) result.insert(std::make_pair(value, type))
         COMMAND_JOB_ADD("CANCEL", JOB_CONTROL_CANCEL);
         COMMAND_JOB_ADD("PAUSE", JOB_CONTROL_PAUSE);
@@ -210,6 +213,13 @@ namespace
         return result;
     }
 
+    /// Built once, thread safe, never modified afterwards
+    const StatusMapType &getJobCommandMap()
+    {
+        static const StatusMapType result = newJobCommandMap();
+        return result;
+    }
+
     void parseJobObject(JOB_INFO_2W *job, Napi::Object result_printer_job)
     {
         Napi::Env env = result_printer_job.Env();
@@ -622,6 +632,61 @@ MY_NODE_MODULE_CALLBACK(setJob)
     return Napi::Boolean::New(env, ok == TRUE);
 }
 
+MY_NODE_MODULE_CALLBACK(setJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 3);
+    REQUIRE_ARGUMENT_STRINGW(info, 0, printername);
+    if (!info[1].IsArray())
+    {
+        RETURN_EXCEPTION_STR("Argument 1 must be an array of job numbers");
+    }
+    Napi::Array jobIds = info[1].As<Napi::Array>();
+    REQUIRE_ARGUMENT_STRING(info, 2, jobCommandStr);
+    StatusMapType::const_iterator itJobCommand = getJobCommandMap().find(jobCommandStr);
+    if (itJobCommand == getJobCommandMap().end())
+    {
+        RETURN_EXCEPTION_STR("wrong job command. use getSupportedJobCommands to see the possible commands");
+    }
+    DWORD jobCommand = itJobCommand->second;
+    PrinterHandle printerHandle((LPWSTR)((char16_t *)printername.c_str()));
+    if (!printerHandle)
+    {
+        std::string error_str("error on PrinterHandle: ");
+        error_str += getLastErrorCodeAndMessage();
+        RETURN_EXCEPTION_STR(error_str.c_str());
+    }
+    // the spooler has no multi-job control: reuse one printer handle for all of them
+    bool result_ok = true;
+    for (uint32_t i = 0; i < jobIds.Length(); ++i)
+    {
+        Napi::Value jobId = jobIds.Get(i);
+        if (!jobId.IsNumber() || jobId.As<Napi::Number>().Int32Value() <= 0)
+        {
+            RETURN_EXCEPTION_STR("Argument 1 must be an array of job numbers");
+        }
+        result_ok = (SetJobW(*printerHandle, (DWORD)jobId.As<Napi::Number>().Int32Value(), 0, NULL, jobCommand) == TRUE) && result_ok;
+    }
+    return Napi::Boolean::New(env, result_ok);
+}
+
+MY_NODE_MODULE_CALLBACK(cancelAllJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+    REQUIRE_ARGUMENTS(info, 1);
+    REQUIRE_ARGUMENT_STRINGW(info, 0, printername);
+    // purging requires administer access to the printer
+    PrinterHandle printerHandle((LPWSTR)((char16_t *)printername.c_str()), PRINTER_ACCESS_ADMINISTER);
+    if (!printerHandle)
+    {
+        std::string error_str("error on PrinterHandle: ");
+        error_str += getLastErrorCodeAndMessage();
+        RETURN_EXCEPTION_STR(error_str.c_str());
+    }
+    BOOL ok = SetPrinterW(*printerHandle, 0, NULL, PRINTER_CONTROL_PURGE);
+    return Napi::Boolean::New(env, ok == TRUE);
+}
+
 MY_NODE_MODULE_CALLBACK(getSupportedJobCommands)
 {
     MY_NODE_MODULE_ENV(info);
@@ -767,3 +832,147 @@ MY_NODE_MODULE_CALLBACK(PrintFile)
     MY_NODE_MODULE_ENV(info);
     RETURN_EXCEPTION_STR("Not yet implemented on Windows");
 }
+
+MY_NODE_MODULE_CALLBACK(openPrinter)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getPrintersAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(detectDocumentFormat)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(openSpool)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(enumPrintersAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinterAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getPrinterDriverOptionsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getJobAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(setJobAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(setJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(cancelAllJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(PrintDirectAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(PrintFileAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(setCircuitBreakerOptions)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getCircuitBreakerState)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(moveJobs)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(moveJobsAsync)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(startJobTracker)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(stopJobTracker)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getJobLatencyStats)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(setBackend)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(addPrintServer)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(removePrintServer)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
+
+MY_NODE_MODULE_CALLBACK(getPrintServers)
+{
+    MY_NODE_MODULE_ENV(info);
+    RETURN_EXCEPTION_STR("not supported on windows");
+}
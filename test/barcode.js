@@ -0,0 +1,119 @@
+var printer = require("../");
+
+exports.testCode128 = function(test) {
+  printer.encodeBarcodes(['12'], {type: 'code128', moduleSize: 1, height: 2}).then(function(barcodes){
+    // start C, 12, check 14, stop: 3 * 11 + 13 modules, 10 modules of quiet zone on each side
+    test.equal(barcodes[0].width, 3 * 11 + 13 + 20);
+    test.equal(barcodes[0].height, 2);
+    var row = Array.prototype.slice.call(barcodes[0].data, 10, 21).map(function(pixel){ return pixel ? 0 : 1; }).join('');
+    // start C: 211232
+    test.equal(row, '11010011100');
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testQrAndDataMatrix = function(test) {
+  Promise.all([
+    printer.encodeBarcodes(['HELLO WORLD', 'https://example.com/track?id=42'], {type: 'qr', moduleSize: 2, ecLevel: 'Q'}),
+    printer.encodeBarcodes(['123456'], {type: 'datamatrix', moduleSize: 1, quietZone: 0})
+  ]).then(function(results){
+    // version 1 (21 modules) and version 3 (29 modules), 4 modules of quiet zone
+    test.equal(results[0][0].width, (21 + 8) * 2);
+    test.equal(results[0][1].width, (29 + 8) * 2);
+    var dm = results[1][0];
+    test.equal(dm.width, 10);
+    test.equal(dm.height, 10);
+    // finder: solid left column and bottom row, alternating top row
+    var top = Array.prototype.slice.call(dm.data, 0, 10).map(function(pixel){ return pixel ? 0 : 1; }).join('');
+    test.equal(top, '1010101010');
+    test.ok(Array.prototype.every.call(dm.data.slice(90, 100), function(pixel){ return pixel === 0; }));
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testZplOutput = function(test) {
+  printer.encodeBarcodes(['ABC'], {type: 'datamatrix', output: 'zpl', x: 5, y: 5}).then(function(barcodes){
+    var zpl = barcodes[0].data.toString();
+    test.ok(/^\^XA\^FO5,5\^GFA,\d+,\d+,\d+,.*\^FS\^XZ$/.test(zpl));
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+// codewords of a version 1 QR code, read back from its modules as a reader does
+function readQrCodewords(barcode) {
+  var size = barcode.width;
+  function dark(r, c) { return barcode.data[r * size + c] === 0; }
+  var format = 0;
+  [[8, 0], [8, 1], [8, 2], [8, 3], [8, 4], [8, 5], [8, 7], [8, 8], [7, 8], [5, 8], [4, 8], [3, 8], [2, 8], [1, 8], [0, 8]].forEach(function(p){
+    format = format << 1 | (dark(p[0], p[1]) ? 1 : 0);
+  });
+  format ^= 0x5412;
+  var masks = [
+    function(r, c){ return (r + c) % 2 === 0; },
+    function(r, c){ return r % 2 === 0; },
+    function(r, c){ return c % 3 === 0; },
+    function(r, c){ return (r + c) % 3 === 0; },
+    function(r, c){ return (Math.floor(r / 2) + Math.floor(c / 3)) % 2 === 0; },
+    function(r, c){ return r * c % 2 + r * c % 3 === 0; },
+    function(r, c){ return (r * c % 2 + r * c % 3) % 2 === 0; },
+    function(r, c){ return ((r + c) % 2 + r * c % 3) % 2 === 0; }
+  ];
+  var mask = masks[format >> 10 & 7];
+  function isFunction(r, c) {
+    return (r < 9 && c < 9) || (r < 9 && c >= size - 8) || (r >= size - 8 && c < 9) || r === 6 || c === 6;
+  }
+  var codewords = [], bits = 0, count = 0, upward = true;
+  for (var right = size - 1; right > 0; right -= 2) {
+    if (right === 6) {
+      right = 5;
+    }
+    for (var i = 0; i < size; ++i) {
+      var r = upward ? size - 1 - i : i;
+      for (var c = right; c > right - 2; --c) {
+        if (!isFunction(r, c)) {
+          bits = bits << 1 | (dark(r, c) !== mask(r, c) ? 1 : 0);
+          if (++count % 8 === 0) {
+            codewords.push(bits);
+            bits = 0;
+          }
+        }
+      }
+    }
+    upward = !upward;
+  }
+  return {level: format >> 13, codewords: codewords};
+}
+
+exports.testQrKnownVector = function(test) {
+  printer.encodeBarcodes(['HELLO WORLD'], {type: 'qr', moduleSize: 1, quietZone: 0, ecLevel: 'Q'}).then(function(barcodes){
+    test.equal(barcodes[0].width, 21);
+    var qr = readQrCodewords(barcodes[0]);
+    // level Q, then the data and error correction codewords of HELLO WORLD 1-Q
+    test.equal(qr.level, 3);
+    test.deepEqual(qr.codewords, [32, 91, 11, 120, 209, 114, 220, 77, 67, 64, 236, 17, 236,
+                                  168, 72, 22, 82, 217, 54, 156, 0, 46, 15, 180, 122, 16]);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testSizeLimit = function(test) {
+  printer.encodeBarcodes([new Array(201).join('1')], {type: 'code128', moduleSize: 100}).then(function(){
+    test.ok(false, 'should reject a barcode too large');
+    test.done();
+  }, function(err){
+    test.ok(/larger than/.test(err.message));
+    test.done();
+  });
+}
@@ -0,0 +1,34 @@
+var printer = require("../");
+
+exports.testDocuments = function(test) {
+  test.equal(printer.detectDocumentFormat(Buffer.from('%PDF-1.7\n')), 'application/pdf');
+  test.equal(printer.detectDocumentFormat('%!PS-Adobe-3.0\n'), 'application/postscript');
+  test.equal(printer.detectDocumentFormat(Buffer.from('RaS2PwgRaster')), 'image/pwg-raster');
+  test.equal(printer.detectDocumentFormat(Buffer.from('UNIRAST\0')), 'image/urf');
+  test.equal(printer.detectDocumentFormat(Buffer.from([0xff, 0xd8, 0xff, 0xe0])), 'image/jpeg');
+  test.equal(printer.detectDocumentFormat(Buffer.from([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a])), 'image/png');
+  test.done();
+}
+
+exports.testPrinterLanguages = function(test) {
+  var raw = 'application/vnd.cups-raw';
+  test.equal(printer.detectDocumentFormat('^XA^FO50,50^FDlabel^FS^XZ'), raw);
+  test.equal(printer.detectDocumentFormat('\r\n  ~SD15^XA^XZ'), raw);
+  test.equal(printer.detectDocumentFormat(Buffer.from('CT~~CD,~CC^~CT~\n^XA^XZ')), raw);
+  test.equal(printer.detectDocumentFormat(Buffer.from([0x1b, 0x40, 0x1b, 0x61, 0x01, 0x48, 0x69, 0x0a, 0x1d, 0x56, 0x41, 0x00])), raw);
+  test.equal(printer.detectDocumentFormat(Buffer.from('\x1b%-12345X@PJL\r\n')), raw);
+  test.equal(printer.detectDocumentFormat(Buffer.from('\x1bE\x1b&l0O')), raw);
+  test.equal(printer.detectDocumentFormat('plain text'), undefined);
+  test.done();
+}
+
+exports.testPartialSignatures = function(test) {
+  // a label without its end, text around ZPL commands, lone control bytes
+  test.equal(printer.detectDocumentFormat('^XA^FO50,50^FDlabel^FS'), undefined);
+  test.equal(printer.detectDocumentFormat('see ^XA^XZ'), undefined);
+  test.equal(printer.detectDocumentFormat('^FO50,50^XA^XZ'), undefined);
+  test.equal(printer.detectDocumentFormat(Buffer.from([0x1b, 0x40, 0x48, 0x69])), undefined);
+  test.equal(printer.detectDocumentFormat(Buffer.from([0x1d, 0x41, 0x42])), undefined);
+  test.equal(printer.detectDocumentFormat(Buffer.from('\x1bEnd')), undefined);
+  test.done();
+}
@@ -0,0 +1,28 @@
+var printer = require("../");
+
+exports.testRecords = function(test) {
+  var template = printer.compileLabelTemplate('^XA^FO50,50^FD{{name}}^FS^FO50,100^FD{{ code }}^FS^XZ');
+  test.deepEqual(template.fields, ['name', 'code']);
+  var expected = '^XA^FO50,50^FDfirst^FS^FO50,100^FD1^FS^XZ^XA^FO50,50^FDsecond^FS^FO50,100^FD^FS^XZ';
+  test.equal(template.render([{name: 'first', code: 1}, {name: 'second'}]).toString(), expected);
+  test.equal(template.render([['first', 1], ['second', null]]).toString(), expected);
+  test.equal(template.render({name: ['first', 'second'], code: [1, undefined]}).toString(), expected);
+  test.done();
+}
+
+exports.testBinary = function(test) {
+  var template = printer.compileLabelTemplate(Buffer.from('\x1b@<name>\n<logo>\x1dV\x00', 'latin1'), {open: '<', close: '>'});
+  var logo = Buffer.from([0x1d, 0x76, 0x30, 0x00, 0xff]);
+  var result = template.render([{name: 'café', logo: logo}]);
+  test.ok(result.equals(Buffer.concat([Buffer.from('\x1b@', 'latin1'), Buffer.from('café\n'), logo, Buffer.from('\x1dV\x00', 'latin1')])));
+  test.done();
+}
+
+exports.testErrors = function(test) {
+  test.throws(function(){ printer.compileLabelTemplate('^FD{{name^FS'); });
+  test.throws(function(){ printer.compileLabelTemplate('^FD{{}}^FS'); });
+  var template = printer.compileLabelTemplate('{{a}}{{b}}');
+  test.throws(function(){ template.render({a: [1, 2], b: [1]}); });
+  test.throws(function(){ template.render([1]); });
+  test.done();
+}
@@ -0,0 +1,247 @@
+var printer = require("../");
+
+function useMemory(options) {
+  printer.setBackend('memory', options || {printers: ['first', 'second']});
+}
+
+function printRaw(printerName, data, options) {
+  var jobId;
+  printer.printDirect({
+    data: data,
+    printer: printerName,
+    type: 'RAW',
+    options: options || {},
+    success: function(id){ jobId = id; },
+    error: function(err){ throw err; }
+  });
+  return jobId;
+}
+
+exports.tearDown = function(callback) {
+  printer.setBackend('cups');
+  callback();
+}
+
+exports.testGetPrinters = function(test) {
+  useMemory();
+  var printers = printer.getPrinters();
+  test.equal(printers.length, 2);
+  test.equal(printers[0].name, 'first');
+  test.ok(printers[0].isDefault);
+  test.throws(function(){ printer.getPrinter('missing'); });
+  test.done();
+}
+
+exports.testJobStates = function(test) {
+  useMemory();
+  var held = printRaw('first', 'held', {'job-hold-until': 'indefinite'});
+  test.deepEqual(printer.getJob('first', held).status, ['PAUSED']);
+  test.ok(printer.setJob('first', held, 'RELEASE'));
+  test.ok(printer.setJob('first', held, 'CANCEL'));
+  test.deepEqual(printer.getJob('first', held).status, ['CANCELLED']);
+  test.ok(!printer.setJob('first', held, 'CANCEL'));
+
+  // printTime 0: printed as soon as the queue is looked at
+  var printed = printRaw('second', Buffer.alloc(4096));
+  var job = printer.getJob('second', printed);
+  test.deepEqual(job.status, ['PRINTED']);
+  test.equal(job.size, 4);
+  test.done();
+}
+
+exports.testMoveJobs = function(test) {
+  useMemory();
+  var jobIds = [1, 2, 3].map(function(){
+    return printRaw('first', 'moved', {'job-hold-until': 'indefinite'});
+  });
+  test.deepEqual(printer.moveJobs('first', 'second', {jobIds: jobIds}), jobIds);
+  test.equal(printer.getPrinter('second').jobs.length, 3);
+  test.equal(printer.getPrinter('first').jobs.length, 0);
+  test.done();
+}
+
+exports.testConcurrentSubmissions = function(test) {
+  useMemory({printers: ['first'], latency: 1, printTime: 1000});
+  var submissions = [];
+  for(var i = 0; i < 64; ++i) {
+    submissions.push(printer.printDirectAsync({data: 'job ' + i, printer: 'first', type: 'RAW'}));
+  }
+  Promise.all(submissions).then(function(jobIds){
+    var unique = {};
+    jobIds.forEach(function(id){ unique[id] = true; });
+    test.equal(Object.keys(unique).length, 64);
+    // one job at a time per printer
+    var processing = printer.getPrinter('first').jobs.filter(function(job){
+      return job.status[0] === 'PRINTING';
+    });
+    test.equal(processing.length, 1);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testCoalescing = function(test) {
+  useMemory({printers: ['first'], printTime: 1000});
+  printer.setCoalescing('first', {window: 50});
+  var parts = [];
+  for(var i = 0; i < 10; ++i) {
+    parts.push(printer.printDirectAsync({data: Buffer.alloc(1024, i), printer: 'first', type: 'RAW'}));
+  }
+  Promise.all(parts).then(function(jobIds){
+    printer.setCoalescing('first', null);
+    jobIds.forEach(function(id){ test.equal(id, jobIds[0]); });
+    test.equal(printer.getPrinter('first').jobs.length, 1);
+    test.equal(printer.getJob('first', jobIds[0]).size, 10);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testCoalescingSendsConflictingPartsAlone = function(test) {
+  useMemory({printers: ['first'], printTime: 1000});
+  printer.setCoalescing('first', {window: 50});
+  Promise.all([
+    printer.printDirectAsync({data: Buffer.alloc(1024, 1), printer: 'first', type: 'RAW'}),
+    printer.printDirectAsync({data: Buffer.alloc(1024, 2), printer: 'first', type: 'RAW', docname: 'label'}),
+    printer.printDirectAsync({data: Buffer.alloc(1024, 3), printer: 'first', type: 'RAW', timeout: 1000})
+  ]).then(function(jobIds){
+    printer.setCoalescing('first', null);
+    test.notEqual(jobIds[1], jobIds[0]);
+    test.notEqual(jobIds[2], jobIds[0]);
+    test.equal(printer.getPrinter('first').jobs.length, 3);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testTimeout = function(test) {
+  useMemory({printers: ['first'], latency: 1000});
+  printer.getPrintersAsync({timeout: 20}).then(function(){
+    test.ok(false, 'should time out');
+    test.done();
+  }, function(err){
+    test.equal(err.code, 'ETIMEDOUT');
+    test.done();
+  });
+}
+
+exports.testEnumeratePrinters = function(test) {
+  useMemory({printers: ['first', 'second', 'third']});
+  var names = [];
+  printer.enumeratePrinters({timeout: 1000})
+    .on('printer', function(found){ names.push(found.name); })
+    .on('end', function(count){
+      test.equal(count, 3);
+      test.deepEqual(names, ['first', 'second', 'third']);
+      test.done();
+    })
+    .on('error', function(err){
+      test.ifError(err);
+      test.done();
+    });
+}
+
+exports.testIdempotency = function(test) {
+  useMemory({printers: ['first'], printTime: 60000});
+  printer.setIdempotencyOptions({window: 60000});
+  var data = Buffer.from('^XA^FDlabel^FS^XZ');
+  var first = printer.printDirectAsync({data: data, printer: 'first', type: 'RAW', idempotencyKey: true}),
+      retry = printer.printDirectAsync({data: data, printer: 'first', type: 'RAW', idempotencyKey: true});
+  Promise.all([first, retry]).then(function(jobIds){
+    test.equal(jobIds[0], jobIds[1]);
+    test.notEqual(printRaw('first', data, {}), jobIds[0]);
+    var sameKey;
+    printer.printDirect({data: 'other', printer: 'first', idempotencyKey: 'order-1',
+                         success: function(id){ sameKey = id; }, error: function(err){ throw err; }});
+    printer.printDirect({data: 'other', printer: 'first', idempotencyKey: 'order-1',
+                         success: function(id){ test.equal(id, sameKey); }, error: function(err){ throw err; }});
+    test.equal(printer.getPrinter('first').jobs.length, 3);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testUploadProgress = function(test) {
+  useMemory({printers: ['first'], chunkLatency: 20});
+  var data = Buffer.alloc(8 * 64 * 1024), events = [];
+  printer.printDirectAsync({data: data, printer: 'first', type: 'RAW', onProgress: function(sent, total){
+    events.push([sent, total]);
+  }}).then(function(){
+    setTimeout(function(){
+      // throttled: fewer events than chunks, growing, the last one complete
+      test.ok(events.length > 1 && events.length <= 8);
+      events.forEach(function(event, i){
+        test.equal(event[1], data.length);
+        test.ok(i === 0 || event[0] > events[i - 1][0]);
+      });
+      test.deepEqual(events[events.length - 1], [data.length, data.length]);
+      test.done();
+    }, 20);
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testDrainPrinter = function(test) {
+  useMemory({printers: ['first', 'second'], printTime: 60000});
+  var jobIds = [1, 2, 3].map(function(){ return printRaw('first', 'drained'); });
+  // the job being printed cannot be moved, it stays
+  test.deepEqual(printer.getJob('first', jobIds[0]).status, ['PRINTING']);
+  test.deepEqual(printer.drainPrinter('first', ['second']), {second: jobIds.slice(1)});
+  test.equal(printer.getPrinter('first').jobs.length, 1);
+  test.done();
+}
+
+exports.testAbortAfterSubmission = function(test) {
+  useMemory({printers: ['first'], printTime: 60000, chunkLatency: 50});
+  var controller = new AbortController(),
+      sent = printer.printDirectAsync({data: 'sent', printer: 'first', type: 'RAW', signal: controller.signal});
+  // the pool thread submits the job meanwhile
+  var until = Date.now() + 200;
+  while(Date.now() < until) {}
+  controller.abort();
+  sent.then(function(jobId){
+    test.deepEqual(printer.getJob('first', jobId).status, ['PRINTING']);
+    // aborted during its upload, the job is cancelled and the promise rejected
+    var uploading = new AbortController(),
+        cut = printer.printDirectAsync({data: Buffer.alloc(4 * 64 * 1024), printer: 'first', type: 'RAW', signal: uploading.signal});
+    setTimeout(function(){ uploading.abort(); }, 0);
+    return cut.then(function(){
+      test.ok(false, 'should be aborted');
+    }, function(err){
+      test.equal(err.code, 'ABORT_ERR');
+      test.equal(printer.getPrinter('first').jobs.length, 1);
+    });
+  }, function(err){
+    test.ok(false, 'a submitted job must not be reported as aborted: ' + err.message);
+  }).then(function(){
+    test.done();
+  });
+}
+
+exports.testStats = function(test) {
+  useMemory({printers: ['counted']});
+  printer.getStats({reset: true});
+  printRaw('counted', 'one');
+  printRaw('counted', 'two');
+  var stats = printer.getStats({reset: true});
+  test.equal(stats.operations.printDirect.calls, 2);
+  test.equal(stats.printers.counted.calls, 2);
+  test.equal(stats.printers.counted.bytes, 6);
+  test.equal(stats.printers.counted.ipp.count, 2);
+  // the reset cleared the counters
+  stats = printer.getStats();
+  test.equal(stats.operations.printDirect.calls, 0);
+  test.equal(stats.printers.counted.calls, 0);
+  test.equal(stats.printers.counted.ipp.count, 0);
+  test.done();
+}
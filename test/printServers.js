@@ -0,0 +1,53 @@
+var net = require("net"),
+    printer = require("../");
+
+// a local port nothing listens on
+function closedPort(callback) {
+  var server = net.createServer();
+  server.listen(0, '127.0.0.1', function(){
+    var port = server.address().port;
+    server.close(function(){ callback(port); });
+  });
+}
+
+exports.tearDown = function(callback) {
+  printer.setBackend('cups');
+  callback();
+}
+
+exports.testRegistry = function(test) {
+  test.throws(function(){ printer.addPrintServer('eu@1', {host: 'eu1.example.com'}); });
+  test.throws(function(){ printer.addPrintServer('eu-1', {}); });
+  test.throws(function(){ printer.addPrintServer('eu-1', {host: 'eu1.example.com', encryption: 'SOMETIMES'}); });
+  printer.addPrintServer('eu-1', {host: 'eu1.example.com', encryption: 'REQUIRED'});
+  test.deepEqual(printer.getPrintServers(), [{name: 'eu-1', host: 'eu1.example.com', port: 631, encryption: 'REQUIRED'}]);
+  test.ok(printer.removePrintServer('eu-1'));
+  test.ok(!printer.removePrintServer('eu-1'));
+  test.equal(printer.getPrintServers().length, 0);
+  test.done();
+}
+
+exports.testServerRouting = function(test) {
+  printer.setBackend('memory', {printers: ['first']});
+  closedPort(function(port){
+    printer.addPrintServer('down', {host: '127.0.0.1', port: port});
+    // queue@server printers skip the default backend
+    printer.getPrinterAsync('first@down').then(function(){
+      test.ok(false, 'should not connect');
+    }, function(err){
+      test.equal(err.code, 'ECONNREFUSED');
+      // the default server answers, the one down is left out
+      return printer.getPrintersAsync({servers: ['', 'down']});
+    }).then(function(printers){
+      test.deepEqual(printers.map(function(p){ return p.name; }), ['first']);
+      return printer.getPrintersAsync({servers: ['down', '127.0.0.1:' + port]});
+    }).then(function(){
+      test.ok(false, 'should fail when no server answers');
+    }, function(err){
+      test.equal(err.code, 'ECONNREFUSED');
+    }).then(function(){
+      printer.removePrintServer('down');
+      test.done();
+    });
+  });
+}
@@ -0,0 +1,79 @@
+var printer = require("../");
+
+function readUint32(buffer, offset) {
+  return buffer.readUInt32BE(offset);
+}
+
+exports.testPwgBlack = function(test) {
+  // 16x2 gray: left half black, right half white
+  var pixels = Buffer.alloc(32, 255);
+  pixels.fill(0, 0, 8);
+  pixels.fill(0, 16, 24);
+  printer.encodeRaster(pixels, {width: 16, height: 2, colorSpace: 'black', resolution: 300}).then(function(raster){
+    test.equal(raster.toString('ascii', 0, 4), 'RaS2');
+    var header = raster.slice(4, 4 + 1796);
+    test.equal(header.toString('ascii', 0, 9), 'PwgRaster');
+    test.equal(readUint32(header, 276), 300);
+    test.equal(readUint32(header, 372), 16);
+    test.equal(readUint32(header, 376), 2);
+    test.equal(readUint32(header, 384), 1);
+    test.equal(readUint32(header, 388), 1);
+    test.equal(readUint32(header, 392), 2);
+    test.equal(readUint32(header, 400), 3);
+    test.equal(readUint32(header, 452), 1);
+    // one line repeated once: 0xff then 0x00, two literal bytes
+    test.deepEqual(Array.prototype.slice.call(raster.slice(4 + 1796)), [1, 255, 0xff, 0x00]);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testUrfRgba = function(test) {
+  // 4x1 RGBA, transparent: white over the page
+  var pixels = Buffer.alloc(16, 0);
+  printer.encodeRaster([pixels, pixels], {width: 4, height: 1, channels: 4, format: 'urf', colorSpace: 'srgb'}).then(function(raster){
+    test.equal(raster.toString('ascii', 0, 7), 'UNIRAST');
+    test.equal(readUint32(raster, 8), 2);
+    test.equal(raster[12], 24);
+    test.equal(raster[13], 1);
+    test.equal(readUint32(raster, 12 + 12), 4);
+    // line repeat 0, 4 white pixels
+    test.deepEqual(Array.prototype.slice.call(raster.slice(12 + 32, 12 + 32 + 5)), [0, 3, 255, 255, 255]);
+    test.equal(raster.length, 2 * (32 + 5) + 12);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testInvalidSize = function(test) {
+  printer.encodeRaster(Buffer.alloc(10), {width: 16, height: 16}).then(function(){
+    test.ok(false, 'should fail');
+    test.done();
+  }, function(err){
+    test.ok(err);
+    test.done();
+  });
+}
+
+exports.testZplGraphic = function(test) {
+  // 16x3 gray: black left half on two rows, then a white row
+  var pixels = Buffer.alloc(48, 255);
+  pixels.fill(0, 0, 8);
+  pixels.fill(0, 16, 24);
+  var zpl = printer.encodeGraphic(pixels, {width: 16, height: 3, x: 10, y: 20}).toString();
+  test.equal(zpl, '^XA^FO10,20^GFA,6,6,2,FF,:,^FS^XZ');
+  test.equal(printer.encodeGraphic(pixels, {width: 16, height: 3, label: false}).toString(), '^FO0,0^GFA,6,6,2,FF,:,^FS');
+  test.done();
+}
+
+exports.testEscPosGraphic = function(test) {
+  var pixels = Buffer.alloc(8 * 3, 0);
+  var escpos = printer.encodeGraphic(pixels, {width: 8, height: 3, language: 'escpos', bandHeight: 2});
+  test.deepEqual(Array.prototype.slice.call(escpos),
+                 [0x1d, 0x76, 0x30, 0, 1, 0, 2, 0, 0xff, 0xff, 0x1d, 0x76, 0x30, 0, 1, 0, 1, 0, 0xff]);
+  test.done();
+}
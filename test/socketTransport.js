@@ -0,0 +1,103 @@
+var net = require("net"),
+    printer = require("../");
+
+function listen(callback) {
+  var server = net.createServer(),
+      state = {server: server, connections: 0, received: ''};
+  server.on('connection', function(socket){
+    ++state.connections;
+    socket.on('data', function(chunk){ state.received += chunk.toString(); });
+  });
+  server.listen(0, '127.0.0.1', function(){
+    state.uri = 'socket://127.0.0.1:' + server.address().port;
+    callback(state);
+  });
+}
+
+exports.testPersistentConnection = function(test) {
+  listen(function(state){
+    var labels = ['^XA^FDone^FS^XZ', '^XA^FDtwo^FS^XZ', '^XA^FDthree^FS^XZ'];
+    Promise.all(labels.map(function(label){
+      return printer.printDirectAsync({data: label, printer: state.uri, type: 'RAW'});
+    })).then(function(jobIds){
+      test.equal(state.connections, 1);
+      test.equal(new Set(jobIds).size, 3);
+      var job = printer.getJob(state.uri, jobIds[0]);
+      test.deepEqual(job.status, ['PRINTED']);
+      test.equal(job.printerName, state.uri);
+      // writes can be coalesced in any order, the bytes of each label stay together
+      setTimeout(function(){
+        labels.forEach(function(label){ test.ok(state.received.indexOf(label) >= 0); });
+        test.equal(state.received.length, labels.join('').length);
+        state.server.close();
+        test.done();
+      }, 50);
+    }, function(err){
+      test.ifError(err);
+      state.server.close();
+      test.done();
+    });
+  });
+}
+
+exports.testAbortInBatch = function(test) {
+  listen(function(state){
+    var sockets = [], blocked = true;
+    // the printer does not read until the abort: the large document blocks the writer
+    state.server.on('connection', function(socket){
+      if(blocked) {
+        sockets.push(socket);
+        socket.pause();
+      }
+    });
+    var controller = new AbortController(),
+        labels = ['^XA^FDtwo^FS^XZ', '^XA^FDthree^FS^XZ'],
+        large = printer.printDirectAsync({data: Buffer.alloc(32 * 1024 * 1024, 'x'), printer: state.uri, type: 'RAW',
+                                          signal: controller.signal}),
+        others = labels.map(function(label){
+          return printer.printDirectAsync({data: label, printer: state.uri, type: 'RAW'});
+        });
+    setTimeout(function(){ controller.abort(); }, 200);
+    large.then(function(){
+      test.ok(false, 'should be aborted');
+    }, function(err){
+      test.equal(err.name, 'AbortError');
+      blocked = false;
+      sockets.forEach(function(socket){ socket.resume(); });
+      return Promise.all(others);
+    }).then(function(jobIds){
+      jobIds.forEach(function(jobId){ test.deepEqual(printer.getJob(state.uri, jobId).status, ['PRINTED']); });
+      setTimeout(function(){
+        labels.forEach(function(label){ test.ok(state.received.indexOf(label) >= 0); });
+        state.server.close();
+        test.done();
+      }, 50);
+    }, function(err){
+      test.ifError(err);
+      state.server.close();
+      test.done();
+    });
+  });
+}
+
+exports.testConnectionRefused = function(test) {
+  listen(function(state){
+    state.server.close(function(){
+      printer.printDirectAsync({data: 'lost', printer: state.uri, type: 'RAW'}).then(function(){
+        test.ok(false, 'should fail');
+        test.done();
+      }, function(err){
+        test.equal(err.code, 'ECONNREFUSED');
+        test.done();
+      });
+    });
+  });
+}
+
+exports.testRawOnly = function(test) {
+  test.throws(function(){
+    printer.printDirect({data: '%PDF', printer: 'socket://127.0.0.1', type: 'PDF',
+                         success: function(){}, error: function(err){ throw err; }});
+  });
+  test.done();
+}
@@ -0,0 +1,109 @@
+var printer = require("../"),
+    fs = require("fs"),
+    os = require("os"),
+    path = require("path");
+
+function journalPath() {
+  return path.join(os.tmpdir(), 'node-printer-spool-' + process.pid + '-' + Date.now());
+}
+
+exports.setUp = function(callback) {
+  printer.setBackend('memory', {printers: ['first'], printTime: 60000});
+  callback();
+}
+
+exports.tearDown = function(callback) {
+  printer.setBackend('cups');
+  callback();
+}
+
+exports.testDrainInOrder = function(test) {
+  var file = journalPath(), results = [], sequences = [];
+  var spool = printer.openSpool(file, {onJob: function(err, entry){
+    test.ifError(err);
+    results.push(entry);
+    if(results.length < 3) {
+      return;
+    }
+    test.deepEqual(results.map(function(r){ return r.sequence; }), sequences);
+    test.ok(results[0].jobId < results[1].jobId && results[1].jobId < results[2].jobId);
+    test.throws(function(){ printer.openSpool(file); }, /another process/);
+    spool.close();
+
+    // submitted jobs are not sent again by the next process
+    var reopened = printer.openSpool(file, {onJob: function(){ test.ok(false, 'sent again'); }});
+    var entries = reopened.getEntries();
+    test.equal(entries.length, 3);
+    entries.forEach(function(entry, i){
+      test.equal(entry.status, 'SUBMITTED');
+      test.equal(entry.jobId, results[i].jobId);
+    });
+    reopened.close();
+    fs.unlinkSync(file);
+    test.done();
+  }});
+  for(var i = 0; i < 3; ++i) {
+    sequences.push(spool.add({data: 'label ' + i, printer: 'first'}));
+  }
+}
+
+function fnv1a(buffer) {
+  var hash = 2166136261;
+  for(var i = 0; i < buffer.length; ++i) {
+    hash = Math.imul(hash ^ buffer[i], 16777619) >>> 0;
+  }
+  return hash;
+}
+
+// journal of a process killed while it was submitting its records
+function writeInterruptedJournal(file, records) {
+  var header = Buffer.alloc(64);
+  header.write('NPSPOOL1', 0, 'latin1');
+  header.writeUInt32LE(0x1234, 8); // journalId
+  header.writeUInt32LE(1, 16);     // firstSequence
+  var parts = [header];
+  records.forEach(function(record, i){
+    var fields = [record.printer, record.docname, 'application/vnd.cups-raw', ''].map(function(field){ return Buffer.from(field); }),
+        payload = Buffer.concat(fields.concat([Buffer.from(record.data)])),
+        out = Buffer.alloc((48 + payload.length + 7) & ~7);
+    out.writeUInt32LE(0x5250534e, 0); // magic
+    out.writeUInt32LE(1, 4);          // SUBMITTING
+    out.writeUInt32LE(i + 1, 8);      // sequence
+    out.writeUInt32LE(fnv1a(payload), 20);
+    fields.forEach(function(field, f){ out.writeUInt32LE(field.length, 24 + 4 * f); });
+    out.writeUInt32LE(Buffer.byteLength(record.data), 40);
+    payload.copy(out, 48);
+    parts.push(out);
+  });
+  parts.push(Buffer.alloc(4));
+  fs.writeFileSync(file, Buffer.concat(parts));
+}
+
+exports.testCrashRecovery = function(test) {
+  var file = journalPath(), results = [], existingJobId;
+  // the first job reached the server before the crash
+  printer.printDirect({data: 'found', printer: 'first', type: 'RAW', docname: 'found #spool-0000000000001234-1',
+                       success: function(jobId){ existingJobId = jobId; }});
+  writeInterruptedJournal(file, [
+    {printer: 'first', docname: 'found', data: 'found'},
+    {printer: 'first', docname: 'lost', data: 'lost'},
+    // socket:// printers show no finished job: it may be printed already
+    {printer: 'socket://127.0.0.1:9', docname: 'gone', data: 'gone'}
+  ]);
+  var spool = printer.openSpool(file, {onJob: function(err, entry){
+    results.push({err: err, entry: entry});
+    if(results.length < 3) {
+      return;
+    }
+    test.ifError(results[0].err);
+    test.equal(results[0].entry.jobId, existingJobId);
+    test.ifError(results[1].err);
+    test.ok(results[1].entry.jobId > existingJobId);
+    test.equal(printer.getPrinter('first').jobs.length, 2);
+    test.ok(results[2].err);
+    test.deepEqual(spool.getEntries().map(function(entry){ return entry.status; }), ['SUBMITTED', 'SUBMITTED', 'IN_DOUBT']);
+    spool.close();
+    fs.unlinkSync(file);
+    test.done();
+  }});
+}
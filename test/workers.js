@@ -0,0 +1,60 @@
+var Worker = require("worker_threads").Worker,
+    printer = require("../");
+
+// loads the module again in each worker, with a memory backend of its own
+var WORKER_SOURCE = [
+  'var wt = require("worker_threads"), printer = require(wt.workerData.module);',
+  'printer.setBackend("memory", {printers: ["first"], latency: 1, printTime: 60000});',
+  'var jobs = [];',
+  'for(var i = 0; i < wt.workerData.jobs; ++i) {',
+  '  jobs.push(printer.printDirectAsync({data: "shard " + wt.workerData.shard + " job " + i, printer: "first", type: "RAW"}));',
+  '}',
+  'Promise.all(jobs).then(function(jobIds){ wt.parentPort.postMessage({jobIds: jobIds, queued: printer.getPrinter("first").jobs.length}); });'
+].join('\n');
+
+function runWorker(shard, jobs) {
+  return new Promise(function(resolve, reject){
+    var worker = new Worker(WORKER_SOURCE, {eval: true, workerData: {module: require.resolve("../"), shard: shard, jobs: jobs}});
+    worker.once('message', resolve);
+    worker.once('error', reject);
+  });
+}
+
+exports.tearDown = function(callback) {
+  printer.setBackend('cups');
+  callback();
+}
+
+exports.testShardedPrinting = function(test) {
+  printer.setBackend('memory', {printers: ['main']});
+  var shards = [];
+  for(var i = 0; i < 8; ++i) {
+    shards.push(runWorker(i, 16));
+  }
+  Promise.all(shards).then(function(results){
+    results.forEach(function(result){
+      test.equal(new Set(result.jobIds).size, 16);
+      test.equal(result.queued, 16);
+    });
+    // the backends of the workers left the one of the main thread alone
+    test.deepEqual(printer.getPrinters().map(function(p){ return p.name; }), ['main']);
+    test.done();
+  }, function(err){
+    test.ifError(err);
+    test.done();
+  });
+}
+
+exports.testTerminateWithPendingCalls = function(test) {
+  printer.setBackend('memory', {printers: ['first']});
+  var worker = new Worker('var p = require(require("worker_threads").workerData); p.setBackend("memory", {latency: 1000});'
+                          + 'p.getPrintersAsync(); require("worker_threads").parentPort.postMessage("queued");',
+                          {eval: true, workerData: require.resolve("../")});
+  worker.once('message', function(){
+    worker.terminate().then(function(){
+      // the module still works in the main thread
+      test.equal(printer.getPrinters().length, 1);
+      test.done();
+    });
+  });
+}
@@ -1,24 +1,361 @@
-export function getPrinters(): PrinterDetails[];
+import { EventEmitter } from "events";
+
+export function getPrinters(server?: string): PrinterDetails[];
 export function getPrinter(printerName: string): PrinterDetails;
+export function enumeratePrinters(options?: EnumeratePrintersOptions): PrinterEnumeration;
 export function getPrinterDriverOptions(printerName: string): PrinterDriverOptions;
 export function getSelectedPaperSize(printerName: string): string;
 export function getDefaultPrinterName(): string | undefined;
 export function printDirect(options: PrintDirectOptions): void;
 export function printFile(options: PrintFileOptions): void;
+export function openSpool(path: string, options?: SpoolOptions): Spool;
+export function setIdempotencyOptions(options: IdempotencyOptions): void;
+export function hashDocument(data: string | Buffer, printer: string, type: string, options: { [key: string]: string }): string;
+export function compileLabelTemplate(template: string | Buffer, options?: LabelTemplateOptions): LabelTemplate;
+export function setCoalescing(printerName: string, options: CoalescingOptions | null): Promise<void>;
+export function flushCoalesced(printerName?: string): Promise<void>;
+export function printLabels(options: PrintLabelsOptions): void;
+export function printLabelsAsync(options: PrintLabelsAsyncOptions): Promise<number>;
 export function getSupportedPrintFormats(): string[];
+export function encodeRaster(pixels: Buffer | Buffer[], options: RasterOptions): Promise<Buffer>;
+export function encodeGraphic(pixels: Buffer, options: GraphicOptions): Buffer;
+export function encodeBarcodes(payloads: Array<string | Buffer>, options: BarcodeOptions): Promise<Barcode[]>;
+export function detectDocumentFormat(data: string | Buffer): string | undefined;
 export function getJob(printerName: string, jobId: number): JobDetails;
-export function setJob(printerName: string, jobId: number, command: 'CANCEL' | string): void;
+export function setJob(printerName: string, jobId: number, command: JobCommand, value?: number): boolean;
+export function setJobs(printerName: string, jobIds: number[], command: JobCommand, value?: number): boolean;
+export function cancelAllJobs(printerName: string, purge?: boolean): boolean;
+export function moveJobs(fromPrinter: string, toPrinter: string, options: { jobIds: number[] }): number[];
+export function moveJobs(fromPrinter: string, toPrinter: string, options: { all: true }): boolean;
+export function drainPrinter(printerName: string, pool: string[]): { [printerName: string]: number[] };
 export function getSupportedJobCommands(): string[];
+export function openPrinter(printerName?: string): Printer;
+export function getPrintersAsync(options?: GetPrintersAsyncOptions): Promise<PrinterDetails[]>;
+export function getPrinterAsync(printerName?: string, options?: AsyncOptions): Promise<PrinterDetails>;
+export function getPrinterDriverOptionsAsync(printerName?: string, options?: AsyncOptions): Promise<PrinterDriverOptions>;
+export function getJobAsync(printerName: string, jobId: number, options?: AsyncOptions): Promise<JobDetails>;
+export function setJobAsync(printerName: string, jobId: number, command: JobCommand, value?: number | AsyncOptions, options?: AsyncOptions): Promise<boolean>;
+export function setJobsAsync(printerName: string, jobIds: number[], command: JobCommand, value?: number | AsyncOptions, options?: AsyncOptions): Promise<boolean>;
+export function moveJobsAsync(fromPrinter: string, toPrinter: string, options: { jobIds: number[] } & AsyncOptions): Promise<number[]>;
+export function moveJobsAsync(fromPrinter: string, toPrinter: string, options: { all: true } & AsyncOptions): Promise<boolean>;
+export function drainPrinterAsync(printerName: string, pool: string[], options?: AsyncOptions): Promise<{ [printerName: string]: number[] }>;
+export function cancelAllJobsAsync(printerName: string, purge?: boolean | AsyncOptions, options?: AsyncOptions): Promise<boolean>;
+export function printDirectAsync(options: PrintDirectAsyncOptions): Promise<number>;
+export function printFileAsync(options: PrintFileAsyncOptions): Promise<number>;
+export function setThreadPoolSize(size: number): void;
+export function getThreadPoolSize(): number;
+export function setDefaultTimeout(timeout: number): void;
+export function getDefaultTimeout(): number;
+export function setCircuitBreakerOptions(options: CircuitBreakerOptions): void;
+export function getCircuitBreakerState(): { [server: string]: CircuitBreakerState };
+export function addPrintServer(name: string, options: PrintServerOptions): void;
+export function removePrintServer(name: string): boolean;
+export function getPrintServers(): PrintServer[];
+/** Process wide: a reset from one worker thread clears the statistics of all threads */
+export function getStats(options?: { reset?: boolean | undefined }): PrinterStats;
+export function setBackend(name: 'cups'): void;
+export function setBackend(name: 'memory', options?: MemoryBackendOptions): void;
+export function startJobTracker(options?: { interval?: number | undefined }): void;
+export function stopJobTracker(): void;
+export function getJobLatencyStats(options?: { reset?: boolean | undefined }): { [printerName: string]: JobLatencyStats };
+/** diagnostics_channel name receiving TraceEvent messages */
+export const TRACE_CHANNEL: string;
+export const printerTypes: {
+    LOCAL: number;
+    CLASS: number;
+    REMOTE: number;
+    BW: number;
+    COLOR: number;
+    DUPLEX: number;
+    DISCOVERED: number;
+    SCANNER: number;
+};
 
 export interface PrintDirectOptions {
     data: string | Buffer;
     printer?: string | undefined;
     type?: 'RAW' | 'TEXT' | 'PDF' | 'JPEG' | 'POSTSCRIPT' | 'COMMAND' | 'AUTO' | undefined;
     options?: { [key: string]: string } | undefined;
+    /** a duplicate submission within the window returns the first job id; true keys on the content hash */
+    idempotencyKey?: string | true | undefined;
     success?: PrintOnSuccessFunction | undefined;
     error?: PrintOnErrorFunction | undefined;
 }
 
+/** PRIORITY takes a value from 1 to 100. See getSupportedJobCommands() for the commands of the platform */
+export type JobCommand = 'CANCEL' | 'HOLD' | 'PAUSE' | 'RELEASE' | 'RESUME' | 'RESTART' | 'PRIORITY' | string;
+
+export interface AsyncOptions {
+    signal?: AbortSignal | undefined;
+    /** milliseconds, overrides the default timeout */
+    timeout?: number | undefined;
+}
+
+export interface RasterOptions extends AsyncOptions {
+    width: number;
+    height: number;
+    /** of the input pixels: 1 gray (default), 3 RGB, 4 RGBA */
+    channels?: 1 | 3 | 4 | undefined;
+    format?: 'pwg' | 'urf' | undefined;
+    /** 'black' is 1 bit per pixel, 'sgray' by default */
+    colorSpace?: 'black' | 'sgray' | 'srgb' | undefined;
+    dither?: 'threshold' | 'ordered' | undefined;
+    /** 0-255, gray levels below are black, 128 by default */
+    threshold?: number | undefined;
+    /** dpi, 203 by default */
+    resolution?: number | undefined;
+    quality?: 'draft' | 'normal' | 'high' | undefined;
+}
+
+export interface GraphicOptions {
+    width: number;
+    height: number;
+    channels?: 1 | 3 | 4 | undefined;
+    dither?: 'threshold' | 'ordered' | undefined;
+    threshold?: number | undefined;
+    language?: 'zpl' | 'escpos' | undefined;
+    /** ZPL field origin, 0 by default */
+    x?: number | undefined;
+    y?: number | undefined;
+    /** ZPL: wrap the field in ^XA...^XZ, true by default */
+    label?: boolean | undefined;
+    /** ESC/POS: rows per GS v 0 command, 256 by default */
+    bandHeight?: number | undefined;
+}
+
+export interface BarcodeOptions extends AsyncOptions {
+    type: 'code128' | 'qr' | 'datamatrix';
+    /** 'bitmap' (8 bits gray pixels) by default */
+    output?: 'bitmap' | 'pwg' | 'zpl' | undefined;
+    /** dots per module, 3 by default */
+    moduleSize?: number | undefined;
+    /** Code 128 bar height in dots, 100 by default */
+    height?: number | undefined;
+    /** in modules */
+    quietZone?: number | undefined;
+    ecLevel?: 'L' | 'M' | 'Q' | 'H' | undefined;
+    resolution?: number | undefined;
+    x?: number | undefined;
+    y?: number | undefined;
+    label?: boolean | undefined;
+}
+
+export interface Barcode {
+    /** dots */
+    width: number;
+    height: number;
+    data: Buffer;
+}
+
+export interface PrintServerOptions {
+    host: string;
+    /** default 631 */
+    port?: number | undefined;
+    /** default: the encryption of libcups */
+    encryption?: 'IF_REQUESTED' | 'NEVER' | 'REQUIRED' | 'ALWAYS' | undefined;
+}
+
+export interface PrintServer extends PrintServerOptions {
+    name: string;
+    port: number;
+}
+
+export interface GetPrintersAsyncOptions extends AsyncOptions {
+    /** name of addPrintServer or "host[:port]", default: the server of libcups */
+    server?: string | undefined;
+    /** query these servers in parallel and merge their printers, named "queue@server".
+     * Servers failing are left out, the promise is rejected only if all of them fail */
+    servers?: string[] | undefined;
+}
+
+export interface IdempotencyOptions {
+    /** milliseconds a job id is kept, 10 minutes by default */
+    window?: number | undefined;
+    maxEntries?: number | undefined;
+    /** log file the index is reloaded from */
+    file?: string | undefined;
+}
+
+export interface SpoolOptions {
+    /** bytes, 64 MiB by default */
+    maxSize?: number | undefined;
+    sync?: boolean | undefined;
+    onJob?: ((err: Error | null, entry: { sequence: number; printer: string; jobId?: number }) => void) | undefined;
+}
+
+export interface SpoolEntry {
+    sequence: number;
+    printer: string;
+    docname: string;
+    status: "PENDING" | "SUBMITTING" | "SUBMITTED" | "FAILED" | "IN_DOUBT";
+    jobId?: number;
+}
+
+export interface Spool {
+    add(options: { data: string | Buffer; printer?: string; docname?: string; type?: PrintDirectOptions["type"]; options?: { [key: string]: string } }): number;
+    getEntries(): SpoolEntry[];
+    close(): void;
+}
+
+export interface EnumeratePrintersOptions {
+    signal?: AbortSignal | undefined;
+    /** discovery time in milliseconds, 1000 by default */
+    timeout?: number | undefined;
+    /** printer-type bits the printers must have among mask, see printerTypes */
+    type?: number | undefined;
+    mask?: number | undefined;
+    /** name of addPrintServer or "host[:port]", default: the server of libcups */
+    server?: string | undefined;
+}
+
+/** Emits 'printer' for each printer found, then 'end' with their count, or 'error' */
+export interface PrinterEnumeration extends EventEmitter {
+    cancel(): void;
+    on(event: "printer", listener: (printer: PrinterDetails) => void): this;
+    on(event: "end", listener: (count: number) => void): this;
+    on(event: "error", listener: (err: Error) => void): this;
+}
+
+/** Durations in milliseconds */
+export interface LatencyHistogram {
+    count: number;
+    sum: number;
+    max: number;
+    mean: number;
+    p50: number;
+    p90: number;
+    p99: number;
+    p999: number;
+    /** [upper bound, count] of the non empty buckets */
+    buckets: Array<[number, number]>;
+}
+
+export interface OperationStats {
+    calls: number;
+    errors: number;
+    bytes: number;
+    latency: LatencyHistogram;
+    ipp: LatencyHistogram;
+    marshal: LatencyHistogram;
+}
+
+export interface PrinterStats {
+    since: Date;
+    operations: { [operation: string]: OperationStats };
+    printers: { [printerName: string]: { calls: number; errors: number; bytes: number; ipp: LatencyHistogram } };
+}
+
+export interface MemoryBackendOptions {
+    /** default ["memory"], the first one is the default printer */
+    printers?: string[] | undefined;
+    /** milliseconds per request */
+    latency?: number | undefined;
+    /** milliseconds per uploaded chunk */
+    chunkLatency?: number | undefined;
+    /** milliseconds a job takes to print, one job at a time per printer */
+    printTime?: number | undefined;
+}
+
+export interface JobLatencyStats {
+    completed: number;
+    /** cancelled or aborted */
+    failed: number;
+    /** still tracked */
+    pending: number;
+    /** submission to processing */
+    queueWait: LatencyHistogram;
+    /** processing to completed */
+    printTime: LatencyHistogram;
+}
+
+export interface TraceEvent {
+    /** shared by the start and end events of an operation */
+    id: number;
+    phase: 'start' | 'end';
+    /** native function, e.g. cupsCreateJob */
+    operation: string;
+    printer?: string | undefined;
+    jobId?: number | undefined;
+    /** end only */
+    bytes?: number | undefined;
+    /** end only, IPP status */
+    status?: number | undefined;
+    /** end only, milliseconds */
+    duration?: number | undefined;
+}
+
+export interface CircuitBreakerOptions {
+    failureThreshold?: number | undefined;
+    resetTimeout?: number | undefined;
+}
+
+export interface CircuitBreakerState {
+    state: 'OPEN' | 'CLOSED';
+    failures: number;
+}
+
+export interface PrintDirectAsyncOptions extends AsyncOptions {
+    data: string | Buffer;
+    printer?: string | undefined;
+    docname?: string | undefined;
+    type?: PrintDirectOptions['type'];
+    options?: { [key: string]: string } | undefined;
+    idempotencyKey?: string | true | undefined;
+    onProgress?: UploadProgressCallback | undefined;
+}
+
+export interface PrintFileAsyncOptions extends AsyncOptions {
+    filename: string;
+    printer?: string | undefined;
+    docname?: string | undefined;
+    options?: { [key: string]: string } | undefined;
+    onProgress?: UploadProgressCallback | undefined;
+}
+
+/** called at most every 50 ms while a document is uploaded, then once with bytesSent === totalBytes */
+export type UploadProgressCallback = (bytesSent: number, totalBytes: number) => void;
+
+export interface CoalescingOptions {
+    /** milliseconds the first buffered job waits for others, default 20 */
+    window?: number | undefined;
+    /** size that triggers sending, default 65536 */
+    maxBytes?: number | undefined;
+    docname?: string | undefined;
+}
+
+export interface LabelTemplateOptions {
+    open?: string | undefined;
+    close?: string | undefined;
+}
+
+/** Records: Array of Objects, Array of Arrays (values in the order of fields) or Object of columns */
+export type LabelRecords = Array<{ [field: string]: any }> | any[][] | { [field: string]: any[] };
+
+export interface LabelTemplate {
+    readonly fields: string[];
+    render(records: LabelRecords): Buffer;
+}
+
+export interface PrintLabelsOptions {
+    template: string | Buffer | LabelTemplate;
+    records: LabelRecords;
+    templateOptions?: LabelTemplateOptions | undefined;
+    printer?: string | undefined;
+    docname?: string | undefined;
+    options?: { [key: string]: string } | undefined;
+    success?: PrintOnSuccessFunction | undefined;
+    error?: PrintOnErrorFunction | undefined;
+}
+
+export interface PrintLabelsAsyncOptions extends AsyncOptions {
+    template: string | Buffer | LabelTemplate;
+    records: LabelRecords;
+    templateOptions?: LabelTemplateOptions | undefined;
+    printer?: string | undefined;
+    docname?: string | undefined;
+    options?: { [key: string]: string } | undefined;
+}
+
 export interface PrintFileOptions {
     filename: string;
     printer?: string | undefined;
@@ -27,6 +364,22 @@ export interface PrintFileOptions {
     error?: PrintOnErrorFunction | undefined;
 }
 
+export interface Printer {
+    readonly name: string;
+    print(data: string | Buffer, docname: string, type: PrintDirectOptions['type'], options: { [key: string]: string }): number;
+    getJobs(which?: 'ACTIVE' | 'COMPLETED' | 'ALL'): JobDetails[];
+    getJob(jobId: number): JobDetails;
+    setJob(jobId: number, command: JobCommand, value?: number): boolean;
+    setJobs(jobIds: number[], command: JobCommand, value?: number): boolean;
+    cancelAllJobs(purge?: boolean): boolean;
+    capabilities(): PrinterCapabilities;
+    close(): void;
+}
+
+export interface PrinterCapabilities {
+    [option: string]: { supported: string[]; default?: string; };
+}
+
 export type PrintOnSuccessFunction = (jobId: string) => any;
 export type PrintOnErrorFunction = (err: Error) => any;
 